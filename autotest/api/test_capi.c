@@ -568,6 +568,29 @@ int runWindNinja()
     const double xllCorner = NinjaGetOutputGridxllCorner(ninjaArmy, nIndex);
     const double yllCorner = NinjaGetOutputGridyllCorner(ninjaArmy, nIndex);
 
+    /* get the run statistics, kept for runs that have been freed */
+    NinjaRunStatistics stats;
+    int nResiduals = 0;
+    for(int i=0; i<numNinjas; i++)
+    {
+        err = NinjaGetRunStatistics(ninjaArmy, i, &stats);
+        if(err != NINJA_SUCCESS)
+        {
+            printf("NinjaGetRunStatistics: err = %d\n", err);
+        }
+        if(stats.solverIterations <= 0 || stats.totalTime <= 0.0)
+        {
+            printf("NinjaGetRunStatistics: no statistics for run %d\n", i);
+        }
+        if(NinjaGetRunResidualHistory(ninjaArmy, i, &nResiduals) == NULL ||
+           nResiduals != stats.numResiduals)
+        {
+            printf("Error in NinjaGetRunResidualHistory\n");
+        }
+    }
+    assert( NinjaGetRunStatistics(NULL, 0, &stats) == NINJA_E_NULL_PTR );
+    assert( NinjaGetRunStatistics(ninjaArmy, numNinjas, &stats) == NINJA_E_INVALID );
+
     /* clean up */
     err = NinjaDestroyArmy(ninjaArmy);
     if(err != NINJA_SUCCESS)
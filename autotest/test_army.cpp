@@ -0,0 +1,160 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Test the scheduling of the runs of a ninjaArmy
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include <vector>
+
+#include "ninjaArmy.h"
+
+#include <boost/test/unit_test.hpp>
+
+/******************************************************************************
+*                        "ARMY" BOOST TEST SUITE
+*******************************************************************************
+*   Tests:
+*       army/memory_budget
+*       army/thread_split
+*       army/station_runs
+******************************************************************************/
+
+/*
+** Army with access to the scheduling helpers and the station list, which are
+** protected.
+*/
+class testArmy : public ninjaArmy
+{
+public:
+    testArmy( int numNinjas )
+    {
+        for( int i = 1; i < numNinjas; i++ )
+            ninjas.push_back( new ninja() );
+    }
+    using ninjaArmy::estimateRunBytes;
+    using ninjaArmy::fitRunsInBudget;
+    using ninjaArmy::splitThreads;
+
+    void setStations( const std::vector<wxStation> &stations )
+    {
+        wxStationList = stations;
+        wxStationFileName = "stations.csv";
+    }
+    ninja *getRun( int i ) { return ninjas[i]; }
+};
+
+BOOST_AUTO_TEST_SUITE( army )
+
+/**
+* The runs in flight fit in the budget with the runs waiting to start and the
+* first run, which is kept after it is done.
+*/
+BOOST_AUTO_TEST_CASE( memory_budget )
+{
+    const double MB = 1024.0 * 1024.0;
+
+    BOOST_CHECK_EQUAL( testArmy::fitRunsInBudget( 1000.0 * MB, 100.0 * MB, 0.0, 48 ), 9 );
+    BOOST_CHECK_EQUAL( testArmy::fitRunsInBudget( 1000.0 * MB, 100.0 * MB, 200.0 * MB, 48 ), 7 );
+    BOOST_CHECK_EQUAL( testArmy::fitRunsInBudget( 1000.0 * MB, 100.0 * MB, 0.0, 4 ), 4 );
+    //always at least one run, even over the budget
+    BOOST_CHECK_EQUAL( testArmy::fitRunsInBudget( 150.0 * MB, 100.0 * MB, 0.0, 48 ), 1 );
+    BOOST_CHECK_EQUAL( testArmy::fitRunsInBudget( 1000.0 * MB, 100.0 * MB, 2000.0 * MB, 48 ), 1 );
+
+    const double nNodes = 1000.0, nNonZero = 13000.0, nCells = 100.0;
+    const double shared = testArmy::estimateRunBytes( nNodes, nNonZero, nCells, true );
+    BOOST_CHECK_EQUAL( shared, ( nNonZero + 13.0 * nNodes + 24.0 * nCells ) * sizeof( double ) );
+    BOOST_CHECK_EQUAL( testArmy::estimateRunBytes( nNodes, nNonZero, nCells, false ) - shared,
+                       nNonZero * sizeof( int ) + nNodes * ( sizeof( int ) + 3 * sizeof( double ) ) );
+}
+
+/**
+* The threads are spread over the runs in flight first, the rest go to the
+* solver of each run, at most one per nodesPerThread mesh nodes.
+*/
+BOOST_AUTO_TEST_CASE( thread_split )
+{
+    const int bigMesh = 10000000;
+
+    BOOST_CHECK_EQUAL( testArmy::splitThreads( 48, 6, 6, bigMesh, 0, 20000 ), 8 );
+    BOOST_CHECK_EQUAL( testArmy::splitThreads( 48, 6, 48, bigMesh, 0, 20000 ), 8 );
+    //the memory budget limits the runs in flight
+    BOOST_CHECK_EQUAL( testArmy::splitThreads( 48, 100, 4, bigMesh, 0, 20000 ), 12 );
+    //more runs than threads
+    BOOST_CHECK_EQUAL( testArmy::splitThreads( 4, 6, 6, bigMesh, 0, 20000 ), 1 );
+
+    //the nodes per thread cap
+    BOOST_CHECK_EQUAL( testArmy::splitThreads( 48, 6, 6, 50000, 0, 20000 ), 2 );
+    BOOST_CHECK_EQUAL( testArmy::splitThreads( 48, 6, 6, 5000, 0, 20000 ), 1 );
+    BOOST_CHECK_EQUAL( testArmy::splitThreads( 48, 6, 6, 5000, 0, 0 ), 8 );
+
+    //NINJA_ARMY_THREADS_PER_RUN
+    BOOST_CHECK_EQUAL( testArmy::splitThreads( 48, 6, 6, 5000, 3, 20000 ), 3 );
+    BOOST_CHECK_EQUAL( testArmy::splitThreads( 48, 6, 6, bigMesh, 64, 20000 ), 48 );
+}
+
+/**
+* getWxStations() gives the stations of a point initialization army at the time
+* of a run that hasn't started, without copying them into the run.
+*/
+BOOST_AUTO_TEST_CASE( station_runs )
+{
+    boost::local_time::time_zone_ptr zone( new boost::local_time::posix_time_zone( "MST-07" ) );
+    const boost::posix_time::ptime t0( boost::gregorian::date( 2020, 7, 1 ),
+                                       boost::posix_time::hours( 18 ) );
+    const boost::posix_time::ptime t1 = t0 + boost::posix_time::hours( 1 );
+
+    wxStation station;
+    station.set_stationName( "test" );
+    station.set_datetime( t0 );
+    station.set_localDateTime( boost::local_time::local_date_time( t0, zone ) );
+    station.set_speed( 3.0, velocityUnits::metersPerSecond );
+    station.set_direction( 90.0 );
+    station.set_datetime( t1 );
+    station.set_localDateTime( boost::local_time::local_date_time( t1, zone ) );
+    station.set_speed( 7.0, velocityUnits::metersPerSecond );
+    station.set_direction( 180.0 );
+
+    testArmy army( 2 );
+    army.getRun( 0 )->set_date_time( boost::local_time::local_date_time( t0, zone ) );
+    army.getRun( 1 )->set_date_time( boost::local_time::local_date_time( t1, zone ) );
+    army.setStations( std::vector<wxStation>( 1, station ) );
+
+    for( int i = 0; i < 2; i++ )
+    {
+        std::vector<wxStation> stations = army.getWxStations( i );
+        BOOST_REQUIRE_EQUAL( stations.size(), 1u );
+        BOOST_CHECK( stations[0].get_currentTimeStep() == army.getRun( i )->get_date_time() );
+        BOOST_CHECK_EQUAL( stations[0].get_speed(), i == 0 ? 3.0 : 7.0 );
+        BOOST_CHECK_EQUAL( stations[0].get_direction(), i == 0 ? 90.0 : 180.0 );
+        //the run gets its own copy when it starts
+        BOOST_CHECK( army.getRun( i )->get_wxStations().empty() );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+/******************************************************************************
+*                        END "ARMY" BOOST TEST SUITE
+*****************************************************************************/
@@ -0,0 +1,111 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Test AAIGrid reading and writing
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "ascii_grid.h"
+
+#include <boost/test/unit_test.hpp>
+
+/******************************************************************************
+*                        "ASCII_GRID" BOOST TEST SUITE
+*******************************************************************************
+*   Tests:
+*       ascii_grid/write_read
+******************************************************************************/
+
+BOOST_AUTO_TEST_SUITE( ascii_grid )
+
+/**
+* The data rows written by write_Grid() are the same bytes as printf("%.*lf\t")
+* for each decimal count, including rounding ties, negative zeros and values
+* too long for the row buffer, and read_Grid() reads back the values strtod()
+* would.
+*/
+BOOST_AUTO_TEST_CASE( write_read )
+{
+    const int nRows = 9, nCols = 11;
+    AsciiGrid<double> grid( nCols, nRows, 1000.0, 2000.0, 30.0, -9999.0 );
+    const double special[] = { 0.125, 2.675, -0.001, -0.0, 0.005, 1e12, -9999.0, 1234.5675,
+                               1e300, -1.5e308 };
+    for( int i = 0; i < nRows; i++ )
+        for( int j = 0; j < nCols; j++ )
+            grid( i, j ) = ( i * nCols + j ) < 10 ? special[i * nCols + j]
+                                                 : std::sin( 0.37 * ( i * nCols + j ) ) * 321.4;
+
+    std::string path = std::string( CPLGenerateTempFilename( "ASCII_GRID_TEST" ) ) + ".asc";
+    for( int numDecimals = 0; numDecimals <= 3; numDecimals++ )
+    {
+        grid.write_Grid( path, numDecimals );
+
+        //skip the 6 header lines and compare the data to printf
+        FILE *fin = fopen( path.c_str(), "r" );
+        BOOST_REQUIRE( fin != NULL );
+        std::vector<char> line( 4096 );
+        for( int k = 0; k < 6; k++ )
+            BOOST_REQUIRE( fgets( &line[0], line.size(), fin ) != NULL );
+        for( int i = nRows - 1; i >= 0; i-- )
+        {
+            std::string expected;
+            char value[512];
+            for( int j = 0; j < nCols; j++ )
+            {
+                snprintf( value, sizeof( value ), "%.*lf\t", numDecimals, grid( i, j ) );
+                expected += value;
+            }
+            expected += "\n";
+            BOOST_REQUIRE( fgets( &line[0], line.size(), fin ) != NULL );
+            BOOST_CHECK_EQUAL( std::string( &line[0] ), expected );
+        }
+        fclose( fin );
+
+        AsciiGrid<double> readGrid( path );
+        BOOST_REQUIRE_EQUAL( readGrid.get_nRows(), nRows );
+        BOOST_REQUIRE_EQUAL( readGrid.get_nCols(), nCols );
+        for( int i = 0; i < nRows; i++ )
+        {
+            for( int j = 0; j < nCols; j++ )
+            {
+                char value[512];
+                snprintf( value, sizeof( value ), "%.*lf", numDecimals, grid( i, j ) );
+                BOOST_CHECK_EQUAL( readGrid( i, j ), strtod( value, NULL ) );
+            }
+        }
+    }
+    VSIUnlink( path.c_str() );
+    VSIUnlink( ( path.substr( 0, path.size() - 4 ) + ".prj" ).c_str() );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+/******************************************************************************
+*                        END "ASCII_GRID" BOOST TEST SUITE
+*****************************************************************************/
@@ -27,9 +27,11 @@
  *
  *****************************************************************************/
  
+#include <cmath>
 #include <string>
 
 #include "ascii_grid.h"
+#include "gridResampler.h"
 #include "ninja_conv.h"
 #include "omp_guard.h"
 
@@ -40,6 +42,8 @@
 *******************************************************************************
 *   Tests:
 *       grid_interp/order
+*       grid_interp/tables
+*       grid_interp/points
 ******************************************************************************/
 
 BOOST_AUTO_TEST_SUITE( grid_interp )
@@ -62,6 +66,147 @@ BOOST_AUTO_TEST_CASE( order )
     
 }
 
+/**
+* Test the resampling tables against interpolating each cell on its own
+*/
+BOOST_AUTO_TEST_CASE( tables )
+{
+    AsciiGrid<double> u(23, 17, 1000.0, 2000.0, 30.0, -9999.0, 0.0);
+    AsciiGrid<double> v(23, 17, 1000.0, 2000.0, 30.0, -9999.0, 0.0);
+    for(int i = 0; i < u.get_nRows(); i++)
+    {
+        for(int j = 0; j < u.get_nCols(); j++)
+        {
+            u(i, j) = i * 1.5 + j * j * 0.25;
+            v(i, j) = (i * 31 + j * 17) % 13;
+        }
+    }
+    v(8, 11) = -9999.0;
+
+    //offset and finer, so that both the edge and the bilinear cells are hit
+    AsciiGrid<double> uu(61, 43, 1007.0, 2011.0, 11.0, -1.0, 0.0);
+    AsciiGrid<double> vv(uu);
+
+    const AsciiGrid<double>::interpTypeEnum orders[] = {AsciiGrid<double>::order0,
+                                                        AsciiGrid<double>::order1};
+    for(int n = 0; n < 2; n++)
+    {
+        boost::shared_ptr<const GridResampler> resampler =
+            GridResampler::get(u, uu, orders[n]);
+        BOOST_REQUIRE(resampler == GridResampler::get(u, uu, orders[n]));
+
+        const AsciiGrid<double> *sources[] = {&u, &v};
+        AsciiGrid<double> *destinations[] = {&uu, &vv};
+        resampler->interpolate(sources, destinations, 2, 2);
+
+        BOOST_CHECK_EQUAL(vv.get_noDataValue(), -9999.0);
+        double x, y;
+        for(int i = 0; i < uu.get_nRows(); i++)
+        {
+            for(int j = 0; j < uu.get_nCols(); j++)
+            {
+                uu.get_cellPosition(i, j, &x, &y);
+                BOOST_REQUIRE_EQUAL(uu(i, j), u.interpolateGrid(x, y, orders[n]));
+                BOOST_REQUIRE_EQUAL(vv(i, j), v.interpolateGrid(x, y, orders[n]));
+            }
+        }
+    }
+
+    //destination cells outside of the source
+    AsciiGrid<double> outside(10, 10, 500.0, 2000.0, 30.0, -9999.0, 0.0);
+    BOOST_CHECK_THROW(outside.interpolateFromGrid(u, AsciiGrid<double>::order1),
+                      std::range_error);
+}
+
+/**
+* Inverse distance weighting of one cell from all the points, in the point
+* order, the way interpolateFromPoints() did before it was tiled.  Returns the
+* no data value if no point reaches the cell.
+*/
+static double weightCell(const AsciiGrid<double> &grid, int i, int j,
+                         const double *data, const double *X, const double *Y,
+                         const double *radius, int numPoints, double power)
+{
+    double x, y, distance, weight;
+    double weight_sum = 0.0;
+    double value = 0.0;
+    grid.get_cellPosition(i, j, &x, &y);
+    for(int k = 0; k < numPoints; k++)
+    {
+        distance = std::sqrt((x-X[k])*(x-X[k]) + (y-Y[k])*(y-Y[k]));
+        if(radius[k] >= 0.0 && distance > radius[k])
+            continue;
+        if(power == 2.0)
+            weight = 1.0/(distance*distance);
+        else if(power == 1.0)
+            weight = 1.0/distance;
+        else
+            weight = 1.0/std::pow(distance, power);
+        weight_sum = weight_sum + weight;
+        value = value + data[k] * weight;
+    }
+    if(weight_sum == 0)
+        return grid.get_noDataValue();
+    return value/weight_sum;
+}
+
+/**
+* Test the tiled point interpolation against weighting every point for each
+* cell on its own, with points whose influence radius only reaches a few cells
+* on either side of the tile edges (every 16 cells)
+*/
+BOOST_AUTO_TEST_CASE( points )
+{
+    //cell centers are at 1005 + 10*j and 2005 + 10*i, the tiles start at
+    //cells 16, 32 and 48.  The last point has an infinite radius and is only
+    //used in the second pass, the first pass leaves some cells without data.
+    double X[] = {1160.0, 1163.0, 1000.0, 1534.0, 1400.0, 1327.0, 1251.0};
+    double Y[] = {2160.0, 2003.0, 2400.0, 2100.0, 2300.0, 2321.0, 2197.0};
+    double radius[] = {8.0, 15.0, 120.0, 40.0, 200.0, 11.0, -1.0};
+    double u[] = {1.0, 3.5, 6.0, 8.5, 11.0, 13.5, 16.0};
+    double v[] = {10.0, 9.5, 8.0, 5.5, 2.0, -2.5, -8.0};
+    const double powers[] = {1.0, 2.0, 1.5};
+    const int threads[] = {1, 4};
+
+    for(int numPoints = 6; numPoints <= 7; numPoints++)
+    {
+        for(int p = 0; p < 3; p++)
+        {
+            for(int t = 0; t < 2; t++)
+            {
+                AsciiGrid<double> uu(53, 41, 1000.0, 2000.0, 10.0, -9999.0, 5.0);
+                AsciiGrid<double> vv(uu);
+                AsciiGrid<double> ww(uu);
+
+                AsciiGrid<double> *grids[] = {&uu, &vv};
+                double *data[] = {u, v};
+                AsciiGrid<double>::interpolateFromPoints(grids, data, 2, X, Y, radius,
+                                                         numPoints, powers[p], threads[t]);
+                ww.interpolateFromPoints(u, X, Y, radius, numPoints, powers[p], threads[t]);
+
+                int nNoData = 0;
+                for(int i = 0; i < uu.get_nRows(); i++)
+                {
+                    for(int j = 0; j < uu.get_nCols(); j++)
+                    {
+                        double ref = weightCell(uu, i, j, u, X, Y, radius, numPoints, powers[p]);
+                        BOOST_REQUIRE_EQUAL(uu(i, j), ref);
+                        BOOST_REQUIRE_EQUAL(ww(i, j), ref);
+                        BOOST_REQUIRE_EQUAL(vv(i, j),
+                            weightCell(vv, i, j, v, X, Y, radius, numPoints, powers[p]));
+                        if(ref == uu.get_noDataValue())
+                            nNoData++;
+                    }
+                }
+                if(numPoints == 6)
+                    BOOST_CHECK(nNoData > 0);
+                else
+                    BOOST_CHECK_EQUAL(nNoData, 0);
+            }
+        }
+    }
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
 /******************************************************************************
@@ -29,6 +29,7 @@
  
 #include "ninja_conv.h"
 #include "omp_guard.h" 
+#include "windProfile.h"
  
 #include <boost/test/unit_test.hpp>
 /******************************************************************************
@@ -36,6 +37,7 @@
 *******************************************************************************
 *   Tests:
 *       init/gdal
+*       init/profile_shape
 ******************************************************************************/
 
 BOOST_AUTO_TEST_SUITE( init )
@@ -55,6 +57,67 @@ BOOST_AUTO_TEST_CASE( gdal )
     */
 }
 
+/**
+* Test windProfile::getWindSpeed() and the velocity built from
+* windProfile::getProfileShape() against the values of the profiles before
+* they were split, for each profile, above and below the upper wind limit and
+* the boundary layer height.
+*/
+BOOST_AUTO_TEST_CASE( profile_shape )
+{
+    windProfile profile;
+    profile.inputWindHeight = 6.096;
+    profile.Roughness = 0.1;
+    profile.Rough_h = 1.0;
+    profile.Rough_d = 0.5;
+    profile.GroundASL = 1000.0;
+    profile.ObukovLength = -50.0;
+    profile.ABL_height = 400.0;
+    profile.useUpper = true;
+    profile.inputWindUpperLimit = 1460.0;
+    profile.inputWindUpperHeight = 20.0;
+    profile.inputWindSpeed = -4.5;
+    profile.inputWindUpperSpeed = 12.0;
+
+    const windProfile::eProfile profiles[] = { windProfile::uniform,
+                                               windProfile::logarithmic,
+                                               windProfile::power_law_askervein,
+                                               windProfile::monin_obukov_similarity };
+    const double heights[] = { 0.0, 0.3, 0.9, 5.0, 50.0, 350.0, 450.0 };
+    //speed at each height, then 500 m higher (above the upper wind limit)
+    const double expected[4][14] = {
+        { 0, 12, -4.5, 12, -4.5, 12, -4.5, 12, -4.5, 12, -4.5, 12, -4.5, 12 },
+        { 0, 12, 0, 12, -4.5, 12, -4.5, 12, -4.5, 12, -4.5, 12, -4.5, 12 },
+        { 0, 19.014576946891324, -2.925360709970771, 19.016207978303107,
+          -3.4230068133520293, 19.019467528184393, -4.3742519626511651, 19.041651995256608,
+          -6.0800030250771613, 19.275507498286583, -8.030689139114072, 20.513551830631194,
+          -8.3245444036661134, 20.842433870274206 },
+        { 0, 15.363790099557947, -0.55445554676083408, 15.363790099557947,
+          -1.6633666402825023, 15.363790099557947, -4.1520491914048021, 15.363790099557947,
+          -5.9660099117561831, 15.363790099557947, -6.8671851333713692, 15.363790099557947,
+          -6.9148856083038659, 15.363790099557947 } };
+    double numerator, denominator, scale;
+    bool upper;
+    for( int p = 0; p < 4; p++ )
+    {
+        profile.profile_switch = profiles[p];
+        for( int h = 0; h < 7; h++ )
+        {
+            for( int l = 0; l < 2; l++ )
+            {
+                profile.AGL = heights[h] + l * 500.0;
+                BOOST_CHECK_CLOSE( profile.getWindSpeed(), expected[p][2 * h + l], 1e-10 );
+
+                profile.getProfileShape( numerator, denominator, scale, upper );
+                BOOST_CHECK_EQUAL( upper, l == 1 );
+                double speed = upper ? profile.inputWindUpperSpeed : profile.inputWindSpeed;
+                BOOST_CHECK_CLOSE( windProfile::scaleWindSpeed( speed, numerator, denominator, scale ),
+                                   expected[p][2 * h + l], 1e-10 );
+            }
+        }
+    }
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
 /******************************************************************************
@@ -0,0 +1,183 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Test whole runs on a DEM with different solver settings
+ * Author:
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY,
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <clocale>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include "ninja.h"
+#include "ninja_conv.h"
+#include "runStatistics.h"
+
+#include <boost/test/unit_test.hpp>
+
+/******************************************************************************
+*                        "RUN" BOOST TEST SUITE
+*******************************************************************************
+*   Tests:
+*       run/mixed_precision
+*       run/assembly_threads
+*       run/statistics_json
+******************************************************************************/
+
+/*
+** Domain average run on the small Big Butte DEM, 10 m/s from the southwest on
+** the coarse mesh, without any output files.
+*/
+static void setupRun( ninja &windsim )
+{
+    windsim.set_ninjaCommunication( 0, ninjaComClass::ninjaQuietCom );
+    windsim.set_numberCPUs( 1 );
+    windsim.set_initializationMethod( WindNinjaInputs::domainAverageInitializationFlag );
+    windsim.set_DEM( FindDataPath( "big_butte_small.tif" ) );
+    windsim.set_inputSpeed( 10.0, velocityUnits::metersPerSecond );
+    windsim.set_inputDirection( 225.0 );
+    windsim.set_inputWindHeight( 10.0, lengthUnits::meters );
+    windsim.set_outputWindHeight( 10.0, lengthUnits::meters );
+    windsim.set_outputSpeedUnits( velocityUnits::metersPerSecond );
+    windsim.set_diurnalWinds( false );
+    windsim.set_uniVegetation( WindNinjaInputs::grass );
+    windsim.set_meshResChoice( Mesh::coarse );
+    windsim.set_numVertLayers( 20 );
+}
+
+BOOST_AUTO_TEST_SUITE( run )
+
+/**
+* NINJA_SOLVER_PRECISION=mixed stops on the same double precision residual as
+* the default, so the output winds only differ by the solver tolerance.  The
+* directions are only compared where the wind isn't close to calm.
+*/
+BOOST_AUTO_TEST_CASE( mixed_precision )
+{
+    GDALAllRegister();
+    const char *precisions[] = { "double", "mixed" };
+    AsciiGrid<double> speed[2], direction[2];
+    for( int n = 0; n < 2; n++ )
+    {
+        CPLSetConfigOption( "NINJA_SOLVER_PRECISION", precisions[n] );
+        ninja windsim;
+        setupRun( windsim );
+        BOOST_REQUIRE( windsim.simulate_wind() );
+        speed[n] = windsim.VelocityGrid;
+        direction[n] = windsim.AngleGrid;
+    }
+    CPLSetConfigOption( "NINJA_SOLVER_PRECISION", NULL );
+
+    BOOST_REQUIRE( speed[0].checkForCoincidentGrids( speed[1] ) );
+    double maxSpeedDiff = 0.0, maxDirectionDiff = 0.0;
+    for( int i = 0; i < speed[0].get_nRows(); i++ )
+    {
+        for( int j = 0; j < speed[0].get_nCols(); j++ )
+        {
+            maxSpeedDiff = std::max( maxSpeedDiff, std::fabs( speed[0]( i, j ) - speed[1]( i, j ) ) );
+            if( speed[0]( i, j ) < 1.0 )
+                continue;
+            double d = std::fabs( direction[0]( i, j ) - direction[1]( i, j ) );
+            if( d > 180.0 )
+                d = 360.0 - d;
+            maxDirectionDiff = std::max( maxDirectionDiff, d );
+        }
+    }
+    BOOST_TEST_MESSAGE( "max speed difference " << maxSpeedDiff << " m/s, max direction difference "
+                        << maxDirectionDiff << " degrees" );
+    BOOST_CHECK_LT( maxSpeedDiff, 0.1 );
+    BOOST_CHECK_LT( maxDirectionDiff, 1.0 );
+}
+
+/**
+* The colored assembly (the default NINJA_ASSEMBLY_MODE) sums every SK and RHS
+* entry in the same order for any number of threads, so the equations built on
+* 1 and 4 threads are the same to the bit.
+*/
+BOOST_AUTO_TEST_CASE( assembly_threads )
+{
+    GDALAllRegister();
+    ninja serial, threaded;
+    setupRun( serial );
+    setupRun( threaded );
+    threaded.set_numberCPUs( 4 );
+    BOOST_REQUIRE( serial.buildBatchEquations() );
+    BOOST_REQUIRE( threaded.buildBatchEquations() );
+
+    const int numNodes = serial.mesh.NUMNP;
+    const int numEntries = serial.get_SKSize();
+    BOOST_REQUIRE_EQUAL( threaded.mesh.NUMNP, numNodes );
+    BOOST_REQUIRE_EQUAL( threaded.get_SKSize(), numEntries );
+    BOOST_REQUIRE( numEntries > 0 );
+    BOOST_CHECK( std::memcmp( serial.get_SK(), threaded.get_SK(), numEntries * sizeof( double ) ) == 0 );
+    BOOST_CHECK( std::memcmp( serial.get_RHS(), threaded.get_RHS(), numNodes * sizeof( double ) ) == 0 );
+}
+
+/**
+* The statistics file is JSON in any locale: '.' as the decimal separator, even
+* under a decimal comma locale when the system has one, and null for the values
+* that aren't finite.
+*/
+BOOST_AUTO_TEST_CASE( statistics_json )
+{
+    RunStatistics stats;
+    stats.meshTime = 0.5;
+    stats.totalTime = 1.25;
+    stats.finalResidual = std::numeric_limits<double>::quiet_NaN();
+    stats.peakMemoryMB = std::numeric_limits<double>::infinity();
+    stats.residualHistory.push_back( 0.125 );
+    stats.residualHistory.push_back( -std::numeric_limits<double>::infinity() );
+
+    const std::string oldLocale = setlocale( LC_NUMERIC, NULL );
+    if( !setlocale( LC_NUMERIC, "de_DE.UTF-8" ) && !setlocale( LC_NUMERIC, "de_DE" ) )
+        setlocale( LC_NUMERIC, "German" );
+    const std::string filename = std::string( CPLGenerateTempFilename( "stats" ) ) + ".json";
+    const bool written = stats.writeJson( filename );
+    setlocale( LC_NUMERIC, oldLocale.c_str() );
+    BOOST_REQUIRE( written );
+
+    std::ifstream in( filename.c_str() );
+    std::stringstream json;
+    json << in.rdbuf();
+    in.close();
+    VSIUnlink( filename.c_str() );
+
+    const std::string text = json.str();
+    BOOST_CHECK( text.find( "\"final_residual\":null," ) != std::string::npos );
+    BOOST_CHECK( text.find( "\"mesh\":0.5," ) != std::string::npos );
+    BOOST_CHECK( text.find( "\"total\":1.25\n" ) != std::string::npos );
+    BOOST_CHECK( text.find( "\"peak_memory_mb\":null," ) != std::string::npos );
+    BOOST_CHECK( text.find( "\"residual_history\":[0.125,null]" ) != std::string::npos );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+/******************************************************************************
+*                        END "RUN" BOOST TEST SUITE
+*****************************************************************************/
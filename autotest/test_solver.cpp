@@ -0,0 +1,416 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Test the sparse solver kernels
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "sparseMatVec.h"
+#include "preconditioner.h"
+#include "batchSolver.h"
+
+#include <boost/test/unit_test.hpp>
+
+/******************************************************************************
+*                        "SOLVER" BOOST TEST SUITE
+*******************************************************************************
+*   Tests:
+*       solver/spmv_modes
+*       solver/spmv_stencil_dimensions
+*       solver/precond_mcssor
+*       solver/precond_multigrid
+*       solver/spmv_block
+*       solver/spmv_single_precision
+*       solver/batch_solve
+******************************************************************************/
+
+/*
+** Small symmetric 27 point system stored like ninja::discretize() does it:
+** upper triangle only, diagonal first in each row, nodes ordered k, i, j.
+*/
+static void BuildStencilSystem( int nrows, int ncols, int nlayers,
+                                std::vector<double> &A,
+                                std::vector<int> &row_ptr,
+                                std::vector<int> &col_ind )
+{
+    int nxy = nrows * ncols;
+    int numnp = nxy * nlayers;
+    row_ptr.assign( numnp + 1, 0 );
+    col_ind.clear();
+    A.clear();
+    for( int k = 0; k < nlayers; k++ )
+    {
+        for( int i = 0; i < nrows; i++ )
+        {
+            for( int j = 0; j < ncols; j++ )
+            {
+                int row = k * nxy + i * ncols + j;
+                row_ptr[row] = col_ind.size();
+                for( int kk = -1; kk < 2; kk++ )
+                    for( int ii = -1; ii < 2; ii++ )
+                        for( int jj = -1; jj < 2; jj++ )
+                        {
+                            if( i + ii < 0 || i + ii >= nrows ||
+                                j + jj < 0 || j + jj >= ncols ||
+                                k + kk < 0 || k + kk >= nlayers )
+                                continue;
+                            int col = ( k + kk ) * nxy + ( i + ii ) * ncols + j + jj;
+                            if( col < row )
+                                continue;
+                            col_ind.push_back( col );
+                            A.push_back( col == row ? 30.0 + ( row % 7 ) : -1.0 - 0.01 * ( col % 5 ) );
+                        }
+            }
+        }
+    }
+    row_ptr[numnp] = col_ind.size();
+}
+
+BOOST_AUTO_TEST_SUITE( solver )
+
+/**
+* All of the SpMV modes give the same product as a dense reference.
+*/
+BOOST_AUTO_TEST_CASE( spmv_modes )
+{
+    std::vector<double> A;
+    std::vector<int> row_ptr, col_ind;
+    BuildStencilSystem( 7, 5, 4, A, row_ptr, col_ind );
+    int n = row_ptr.size() - 1;
+
+    std::vector<double> x( n ), ref( n, 0.0 ), y( n );
+    for( int i = 0; i < n; i++ )
+        x[i] = std::sin( 0.3 * i ) + 2.0;
+    for( int i = 0; i < n; i++ )
+    {
+        for( int j = row_ptr[i]; j < row_ptr[i + 1]; j++ )
+        {
+            ref[i] += A[j] * x[col_ind[j]];
+            if( col_ind[j] != i )
+                ref[col_ind[j]] += A[j] * x[i];
+        }
+    }
+
+    SparseMatVec::eSpMVMode modes[] = { SparseMatVec::serial,
+                                        SparseMatVec::symmetric,
+                                        SparseMatVec::expanded,
+                                        SparseMatVec::stencil };
+    for( int m = 0; m < 4; m++ )
+    {
+        SparseMatVec Ax;
+        BOOST_REQUIRE( Ax.initialize( n, &A[0], &row_ptr[0], &col_ind[0], modes[m], 7, 5, 4 ) );
+        BOOST_CHECK_EQUAL( Ax.get_bandwidth(), 5 * 7 + 5 + 1 );
+#ifdef _OPENMP
+        for( int t = 1; t <= 5; t++ )
+        {
+            Ax.set_numThreads( t );
+#endif
+            Ax.multiply( &x[0], &y[0] );
+            for( int i = 0; i < n; i++ )
+                BOOST_CHECK_CLOSE( y[i], ref[i], 1e-10 );
+#ifdef _OPENMP
+        }
+#endif
+    }
+}
+
+/**
+* The stencil mode refuses matrices that don't fit the mesh.
+*/
+BOOST_AUTO_TEST_CASE( spmv_stencil_dimensions )
+{
+    std::vector<double> A;
+    std::vector<int> row_ptr, col_ind;
+    BuildStencilSystem( 7, 5, 4, A, row_ptr, col_ind );
+    int n = row_ptr.size() - 1;
+
+    SparseMatVec Ax;
+    BOOST_CHECK( !Ax.initialize( n, &A[0], &row_ptr[0], &col_ind[0], SparseMatVec::stencil ) );
+    BOOST_CHECK( !Ax.initialize( n, &A[0], &row_ptr[0], &col_ind[0], SparseMatVec::stencil, 5, 7, 4 ) );
+}
+
+/**
+* The multicolor SSOR preconditioner is symmetric, doesn't depend on the
+* number of threads, and refuses matrices that don't fit the mesh.
+*/
+BOOST_AUTO_TEST_CASE( precond_mcssor )
+{
+    std::vector<double> A;
+    std::vector<int> row_ptr, col_ind;
+    BuildStencilSystem( 7, 5, 4, A, row_ptr, col_ind );
+    int n = row_ptr.size() - 1;
+    char matdescra[6] = { 's', 'u', 'n', 'c', 0, 0 };
+
+    Preconditioner bad;
+    BOOST_CHECK( !bad.initialize( n, &A[0], &row_ptr[0], &col_ind[0],
+                                  Preconditioner::MCSSOR, matdescra ) );
+
+    Preconditioner M;
+    BOOST_REQUIRE( M.initialize( n, &A[0], &row_ptr[0], &col_ind[0],
+                                 Preconditioner::get_precondType( "MCSSOR" ),
+                                 matdescra, 7, 5, 4 ) );
+
+    std::vector<double> u( n ), v( n ), Mu( n ), Mv( n ), ref( n );
+    for( int i = 0; i < n; i++ )
+    {
+        u[i] = std::sin( 0.3 * i ) + 2.0;
+        v[i] = std::cos( 0.7 * i );
+    }
+    M.solve( &u[0], &Mu[0], &row_ptr[0], &col_ind[0] );
+    M.solve( &v[0], &Mv[0], &row_ptr[0], &col_ind[0] );
+    double uMv = 0.0, vMu = 0.0;
+    for( int i = 0; i < n; i++ )
+    {
+        uMv += u[i] * Mv[i];
+        vMu += v[i] * Mu[i];
+    }
+    BOOST_CHECK_CLOSE( uMv, vMu, 1e-10 );
+
+#ifdef _OPENMP
+    for( int t = 1; t <= 5; t++ )
+    {
+        M.set_numThreads( t );
+        M.solve( &u[0], &ref[0], &row_ptr[0], &col_ind[0] );
+        for( int i = 0; i < n; i++ )
+            BOOST_CHECK_EQUAL( ref[i], Mu[i] );
+    }
+#endif
+}
+
+/**
+* The multigrid V-cycle solves small systems exactly on the coarsest level, and
+* on a system with coarse levels it is symmetric and doesn't depend on the
+* number of threads.
+*/
+BOOST_AUTO_TEST_CASE( precond_multigrid )
+{
+    std::vector<double> A;
+    std::vector<int> row_ptr, col_ind;
+    char matdescra[6] = { 's', 'u', 'n', 'c', 0, 0 };
+
+    BuildStencilSystem( 7, 5, 4, A, row_ptr, col_ind );
+    int n = row_ptr.size() - 1;
+    {
+        Preconditioner M;
+        BOOST_REQUIRE( M.initialize( n, &A[0], &row_ptr[0], &col_ind[0],
+                                     Preconditioner::get_precondType( "multigrid" ),
+                                     matdescra, 7, 5, 4 ) );
+        SparseMatVec Ax;
+        BOOST_REQUIRE( Ax.initialize( n, &A[0], &row_ptr[0], &col_ind[0], SparseMatVec::symmetric ) );
+        std::vector<double> r( n ), z( n ), Az( n );
+        for( int i = 0; i < n; i++ )
+            r[i] = std::sin( 0.3 * i ) + 2.0;
+        M.solve( &r[0], &z[0], &row_ptr[0], &col_ind[0] );
+        Ax.multiply( &z[0], &Az[0] );
+        for( int i = 0; i < n; i++ )
+            BOOST_CHECK_CLOSE( Az[i], r[i], 1e-8 );
+    }
+
+    BuildStencilSystem( 13, 12, 9, A, row_ptr, col_ind );
+    n = row_ptr.size() - 1;
+    GeometricMultigrid mg;
+    BOOST_REQUIRE( mg.initialize( n, &A[0], &row_ptr[0], &col_ind[0], 13, 12, 9 ) );
+    BOOST_REQUIRE( mg.get_numLevels() > 1 );
+
+    std::vector<double> u( n ), v( n ), Mu( n ), Mv( n ), ref( n );
+    for( int i = 0; i < n; i++ )
+    {
+        u[i] = std::sin( 0.3 * i ) + 2.0;
+        v[i] = std::cos( 0.7 * i );
+    }
+    mg.apply( &u[0], &Mu[0] );
+    mg.apply( &v[0], &Mv[0] );
+    double uMv = 0.0, vMu = 0.0, uMu = 0.0;
+    for( int i = 0; i < n; i++ )
+    {
+        uMv += u[i] * Mv[i];
+        vMu += v[i] * Mu[i];
+        uMu += u[i] * Mu[i];
+    }
+    BOOST_CHECK_CLOSE( uMv, vMu, 1e-9 );
+    BOOST_CHECK( uMu > 0.0 );
+
+#ifdef _OPENMP
+    for( int t = 1; t <= 5; t++ )
+    {
+        mg.set_numThreads( t );
+        mg.apply( &u[0], &ref[0] );
+        for( int i = 0; i < n; i++ )
+            BOOST_CHECK_EQUAL( ref[i], Mu[i] );
+    }
+#endif
+}
+
+/**
+* The block product gives the same result as one product per vector in all of
+* the modes.
+*/
+BOOST_AUTO_TEST_CASE( spmv_block )
+{
+    std::vector<double> A;
+    std::vector<int> row_ptr, col_ind;
+    BuildStencilSystem( 7, 5, 4, A, row_ptr, col_ind );
+    int n = row_ptr.size() - 1;
+    const int nVec = 3;
+
+    std::vector<double> X( n * nVec ), Y( n * nVec ), x( n ), y( n );
+    for( int i = 0; i < n * nVec; i++ )
+        X[i] = std::sin( 0.3 * i ) + 2.0;
+
+    SparseMatVec::eSpMVMode modes[] = { SparseMatVec::serial,
+                                        SparseMatVec::symmetric,
+                                        SparseMatVec::expanded,
+                                        SparseMatVec::stencil };
+    for( int m = 0; m < 4; m++ )
+    {
+        SparseMatVec Ax;
+        BOOST_REQUIRE( Ax.initialize( n, &A[0], &row_ptr[0], &col_ind[0], modes[m], 7, 5, 4 ) );
+        Ax.multiplyBlock( &X[0], &Y[0], nVec );
+        for( int v = 0; v < nVec; v++ )
+        {
+            for( int i = 0; i < n; i++ )
+                x[i] = X[i * nVec + v];
+            Ax.multiply( &x[0], &y[0] );
+            for( int i = 0; i < n; i++ )
+                BOOST_CHECK_CLOSE( Y[i * nVec + v], y[i], 1e-10 );
+        }
+    }
+}
+
+/**
+* The float coefficients of the expanded and stencil modes give the double
+* product to float accuracy, single and block, and the modes that use the
+* caller's CSR arrays stay in double.
+*/
+BOOST_AUTO_TEST_CASE( spmv_single_precision )
+{
+    std::vector<double> A;
+    std::vector<int> row_ptr, col_ind;
+    BuildStencilSystem( 7, 5, 4, A, row_ptr, col_ind );
+    int n = row_ptr.size() - 1;
+    const int nVec = 2;
+
+    std::vector<double> X( n * nVec ), Y( n * nVec ), YRef( n * nVec );
+    for( int i = 0; i < n * nVec; i++ )
+        X[i] = std::sin( 0.3 * i ) + 2.0;
+
+    SparseMatVec ref;
+    BOOST_REQUIRE( ref.initialize( n, &A[0], &row_ptr[0], &col_ind[0], SparseMatVec::symmetric ) );
+    BOOST_CHECK( !ref.convertToSinglePrecision() );
+    BOOST_CHECK( !ref.is_singlePrecision() );
+    ref.multiplyBlock( &X[0], &YRef[0], nVec );
+    std::vector<double> x( X.begin(), X.begin() + n ), y( n ), yRef( n );
+    ref.multiply( &x[0], &yRef[0] );
+    //rows can cancel to near zero, compare to the size of the products instead
+    double scale = 0.0;
+    for( int i = 0; i < n * nVec; i++ )
+        scale = std::max( scale, std::fabs( YRef[i] ) );
+
+    SparseMatVec::eSpMVMode modes[] = { SparseMatVec::expanded,
+                                        SparseMatVec::stencil };
+    for( int m = 0; m < 2; m++ )
+    {
+        SparseMatVec Ax;
+        BOOST_REQUIRE( Ax.initialize( n, &A[0], &row_ptr[0], &col_ind[0], modes[m], 7, 5, 4 ) );
+        size_t doubleBytes = Ax.get_matrixBytes();
+        BOOST_REQUIRE( Ax.convertToSinglePrecision() );
+        BOOST_CHECK( Ax.is_singlePrecision() );
+        BOOST_CHECK( Ax.get_matrixBytes() < doubleBytes );
+
+        Ax.multiplyBlock( &X[0], &Y[0], nVec );
+        for( int i = 0; i < n * nVec; i++ )
+            BOOST_CHECK_SMALL( Y[i] - YRef[i], 1e-6 * scale );
+
+        Ax.multiply( &x[0], &y[0] );
+        for( int i = 0; i < n; i++ )
+            BOOST_CHECK_SMALL( y[i] - yRef[i], 1e-6 * scale );
+    }
+}
+
+/**
+* Solving several right hand sides together converges each of them in the same
+* number of iterations as solving it alone.
+*/
+BOOST_AUTO_TEST_CASE( batch_solve )
+{
+    std::vector<double> A;
+    std::vector<int> row_ptr, col_ind;
+    BuildStencilSystem( 13, 12, 9, A, row_ptr, col_ind );
+    int n = row_ptr.size() - 1;
+    const int nVec = 4;
+    const double tol = 1e-8;
+
+    std::vector<std::vector<double> > b( nVec, std::vector<double>( n ) );
+    std::vector<std::vector<double> > x( nVec, std::vector<double>( n, 0.0 ) );
+    std::vector<double*> pb( nVec ), px( nVec );
+    for( int v = 0; v < nVec; v++ )
+    {
+        for( int i = 0; i < n; i++ )
+            b[v][i] = std::sin( 0.3 * i * ( v + 1 ) ) + v;
+        pb[v] = &b[v][0];
+        px[v] = &x[v][0];
+    }
+
+    BatchSolver batch;
+    BOOST_REQUIRE( batch.initialize( n, &A[0], &row_ptr[0], &col_ind[0],
+                                     Preconditioner::Jacobi, SparseMatVec::symmetric, 13, 12, 9 ) );
+    BOOST_CHECK_EQUAL( batch.get_spmvMode(), SparseMatVec::stencil );
+    BOOST_REQUIRE( batch.solve( pb, px, 1000, tol ) );
+
+    SparseMatVec Ax;
+    BOOST_REQUIRE( Ax.initialize( n, &A[0], &row_ptr[0], &col_ind[0], SparseMatVec::symmetric ) );
+    std::vector<double> Axv( n );
+    for( int v = 0; v < nVec; v++ )
+    {
+        Ax.multiply( px[v], &Axv[0] );
+        double rr = 0.0, bb = 0.0;
+        for( int i = 0; i < n; i++ )
+        {
+            rr += ( b[v][i] - Axv[i] ) * ( b[v][i] - Axv[i] );
+            bb += b[v][i] * b[v][i];
+        }
+        BOOST_CHECK( std::sqrt( rr / bb ) <= tol );
+
+        //the same right hand side alone
+        BatchSolver single;
+        BOOST_REQUIRE( single.initialize( n, &A[0], &row_ptr[0], &col_ind[0],
+                                          Preconditioner::Jacobi, SparseMatVec::stencil, 13, 12, 9 ) );
+        std::vector<double> x1( n, 0.0 );
+        BOOST_REQUIRE( single.solve( std::vector<double*>( 1, pb[v] ),
+                                     std::vector<double*>( 1, &x1[0] ), 1000, tol ) );
+        BOOST_CHECK_EQUAL( single.get_iterations()[0], batch.get_iterations()[v] );
+        for( int i = 0; i < n; i++ )
+            BOOST_CHECK_CLOSE( x1[i], x[v][i], 1e-6 );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+/******************************************************************************
+*                        END "SOLVER" BOOST TEST SUITE
+*****************************************************************************/
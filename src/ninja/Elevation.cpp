@@ -28,6 +28,7 @@
  *****************************************************************************/
 
 #include "Elevation.h"
+#include "hillValleyField.h"
 
 Elevation::Elevation():AsciiGrid<double>()
 {
@@ -70,6 +71,7 @@ Elevation::Elevation(const Elevation &rhs) : AsciiGrid<double>(rhs)
   fileName = rhs.fileName;
   grid_made = rhs.grid_made;
   elevationUnits = rhs.elevationUnits;
+  hillValleyFieldSlot = rhs.hillValleyFieldSlot;
 }
 
 Elevation::~Elevation()
@@ -153,6 +155,49 @@ Elevation &Elevation::operator=(const Elevation &rhs)
         fileName = rhs.fileName;
         grid_made = rhs.grid_made;
         elevationUnits = rhs.elevationUnits;
+        hillValleyFieldSlot = rhs.hillValleyFieldSlot;
     }
     return *this;
 }
+
+/**
+ * @brief Get the hill top/valley bottom walks of the DEM for the diurnal flow.
+ *
+ * The walks are done the first time they are needed and kept for the later
+ * calls of this Elevation, its copies and the Elevations sharing them through
+ * share_hillValleyField().  They are done again if the DEM has changed since.
+ *
+ * @param aspect Aspect grid of the DEM.
+ * @param numThreads Number of threads to use for the walks.
+ * @return The walks.
+ */
+boost::shared_ptr<const HillValleyField> Elevation::get_hillValleyField(const Aspect &aspect, int numThreads) const
+{
+    boost::shared_ptr<const HillValleyField> field;
+    //hash the DEM before the lock, so the runs don't wait on each other's hashes
+    const uint64_t demKey = HillValleyField::computeKey(*this);
+#pragma omp critical(hillValleyField)
+    {
+        if(!hillValleyFieldSlot)
+            hillValleyFieldSlot.reset(new boost::shared_ptr<const HillValleyField>());
+        if(!*hillValleyFieldSlot || !(*hillValleyFieldSlot)->matches(demKey))
+            hillValleyFieldSlot->reset(new HillValleyField(*this, aspect, numThreads, demKey));
+        field = *hillValleyFieldSlot;
+    }
+    return field;
+}
+
+/**
+ * @brief Use the same hill top/valley bottom walks as another Elevation.
+ *
+ * Both Elevations have to be on the same DEM for the walks to be reused, if
+ * they aren't the walks are done again for the one asking.
+ *
+ * @param rhs Elevation to share the walks with.
+ */
+void Elevation::share_hillValleyField(const Elevation &rhs)
+{
+    if(!rhs.hillValleyFieldSlot)
+        rhs.hillValleyFieldSlot.reset(new boost::shared_ptr<const HillValleyField>());
+    hillValleyFieldSlot = rhs.hillValleyFieldSlot;
+}
@@ -36,6 +36,11 @@
 //#include <process.h>
 #include <string>
 
+#include <boost/shared_ptr.hpp>
+
+class Aspect;
+class HillValleyField;
+
 class Elevation : public AsciiGrid<double>
 {
 public:
@@ -65,7 +70,15 @@ public:
 	eElevDistanceUnits elevationUnits;	//these are the vertical units, ALL HORIZONTAL UNITS MUST ALWAYS BE IN METERS, INCLUDING WHEN THEY ARE READ IN!
         GDALDatasetH hDS; //in-memory dataset for DEM for API
 	bool grid_made;	
-	
+
+	boost::shared_ptr<const HillValleyField> get_hillValleyField(const Aspect &aspect, int numThreads) const;
+	void share_hillValleyField(const Elevation &rhs);
+
+private:
+	//hill top/valley bottom walks of the DEM, built on first use.  The slot is
+	//shared by copies and by share_hillValleyField() so the walks are only done
+	//once for all of them
+	mutable boost::shared_ptr<boost::shared_ptr<const HillValleyField> > hillValleyFieldSlot;
 };
 
 #endif	//ELEVATION_H
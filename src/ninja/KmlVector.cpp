@@ -60,18 +60,18 @@ KmlVector::~KmlVector()
     OCTDestroyCoordinateTransformation( coordTransform );
 }
 
-void KmlVector::setSpeedGrid(AsciiGrid<double> &s, velocityUnits::eVelocityUnits units)
+void KmlVector::setSpeedGrid(const AsciiGrid<double> &s, velocityUnits::eVelocityUnits units)
 {
 	speedUnits = units;
-	spd = s;
+	spd = s;	//copied, setProj4() changes the grids and divide_gridData() isn't const
 }
 
-void KmlVector::setDirGrid(AsciiGrid<double> &d)
+void KmlVector::setDirGrid(const AsciiGrid<double> &d)
 {
 	dir = d;
 }
 
-void KmlVector::setTurbulenceGrid(AsciiGrid<double> &turb, velocityUnits::eVelocityUnits units)
+void KmlVector::setTurbulenceGrid(const AsciiGrid<double> &turb, velocityUnits::eVelocityUnits units)
 {
 	speedUnits = units;
 	turbulence = turb;
@@ -79,14 +79,14 @@ void KmlVector::setTurbulenceGrid(AsciiGrid<double> &turb, velocityUnits::eVeloc
 
 
 #ifdef FRICTION_VELOCITY
-void KmlVector::setUstarGrid(AsciiGrid<double> &ust)
+void KmlVector::setUstarGrid(const AsciiGrid<double> &ust)
 {
 	ustar = ust;
 }
 #endif
 
 #ifdef EMISSIONS
-void KmlVector::setDustGrid(AsciiGrid<double> &dst)
+void KmlVector::setDustGrid(const AsciiGrid<double> &dst)
 {
 	dust = dst;
 }
@@ -138,16 +138,16 @@ public:
 	void setInputSpeedFile(std::string fileName){inputSpeedFile = fileName;}
 	void setInputDirFile(std::string fileName){inputDirFile = fileName;}
 
-	void setSpeedGrid(AsciiGrid<double> &s, velocityUnits::eVelocityUnits units);
-	void setDirGrid(AsciiGrid<double> &d);
-	void setTurbulenceGrid(AsciiGrid<double> &turb, velocityUnits::eVelocityUnits units);
+	void setSpeedGrid(const AsciiGrid<double> &s, velocityUnits::eVelocityUnits units);
+	void setDirGrid(const AsciiGrid<double> &d);
+	void setTurbulenceGrid(const AsciiGrid<double> &turb, velocityUnits::eVelocityUnits units);
 	void setTurbulenceFlag(bool inputTurbulenceFlag){turbulenceFlag = inputTurbulenceFlag;}
 	#ifdef FRICTION_VELOCITY
-	void setUstarGrid(AsciiGrid<double> &ust);
+	void setUstarGrid(const AsciiGrid<double> &ust);
 	void setUstarFlag(bool inputUstarFlag){ustarFlag = inputUstarFlag;}
 	#endif
 	#ifdef EMISSIONS
-	void setDustGrid(AsciiGrid<double> &dst);
+	void setDustGrid(const AsciiGrid<double> &dst);
 	void setDustFlag(bool inputDustFlag){dustFlag = inputDustFlag;}
 	#endif
 	void setTime(const boost::local_time::local_date_time& timeIn){kmlTime = timeIn;}
@@ -167,7 +167,7 @@ void OutputWriter::setSize( const double w, const double h )
 }
 
 #ifdef EMISSIONS
-void OutputWriter::setDustGrid(AsciiGrid<double> &d)
+void OutputWriter::setDustGrid(const AsciiGrid<double> &d)
 {
     dust = d;
     return;
@@ -175,7 +175,7 @@ void OutputWriter::setDustGrid(AsciiGrid<double> &d)
 #endif
 
     void
-OutputWriter::setSpeedGrid ( AsciiGrid<double> &s,
+OutputWriter::setSpeedGrid ( const AsciiGrid<double> &s,
                              velocityUnits::eVelocityUnits u )
 {
     spd = s;
@@ -185,7 +185,7 @@ OutputWriter::setSpeedGrid ( AsciiGrid<double> &s,
 
 
     void
-OutputWriter::setDirGrid ( AsciiGrid<double> &d )
+OutputWriter::setDirGrid ( const AsciiGrid<double> &d )
 {
     dir = d;
     return;
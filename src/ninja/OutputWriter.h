@@ -80,11 +80,11 @@ class OutputWriter
         /* ====================  ACCESSORS     ======================================= */
 
         /* ====================  MUTATORS      ======================================= */
-        void setSpeedGrid(AsciiGrid<double> &s,
+        void setSpeedGrid(const AsciiGrid<double> &s,
                           velocityUnits::eVelocityUnits units);
-        void setDirGrid(AsciiGrid<double> &d);
+        void setDirGrid(const AsciiGrid<double> &d);
 #ifdef EMISSIONS
-        void setDustGrid(AsciiGrid<double> &d);
+        void setDustGrid(const AsciiGrid<double> &d);
 #endif
         void setDEMfile(std::string fname) {demFile=fname;}
         void setNinjaTime(std::string t) {ninjaTime=t;}
@@ -209,7 +209,7 @@ bool Shade::compute_gridShade()
 		{			
 				
 			////  inner loop (threaded)
-			#pragma omp parallel for private(iY,X,Y,px,py)
+			#pragma omp parallel for private(iY,X,Y,px,py) num_threads(number_CPUs)
 			for(iY = 0; iY < inner_loop_num; iY++)
 			{
 				// travel along the terrain until we:
@@ -38,12 +38,12 @@ ShapeVector::~ShapeVector()
 
 }
 
-void ShapeVector::setDirGrid(AsciiGrid<double> &d)
+void ShapeVector::setDirGrid(const AsciiGrid<double> &d)
 {
 	dir = d;
 }
 
-void ShapeVector::setSpeedGrid(AsciiGrid<double> &s)
+void ShapeVector::setSpeedGrid(const AsciiGrid<double> &s)
 {
 	spd = s;
 }
@@ -48,8 +48,8 @@ public:
 
 	inline void setResolution(double r){resolution = r;}
 
-	void setSpeedGrid(AsciiGrid<double> &s);
-	void setDirGrid(AsciiGrid<double> &d);
+	void setSpeedGrid(const AsciiGrid<double> &s);
+	void setDirGrid(const AsciiGrid<double> &d);
 	//#ifdef EMISSIONS
 	//void setDustGrid(AsciiGrid<double> &dst);
 	//#endif
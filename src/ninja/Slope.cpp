@@ -98,7 +98,7 @@ bool Slope::compute_gridSlope()
 	
 	if(!grid_made)
 	{
-		#pragma omp parallel for default(none) private(j,k,a,b,c,d,e,f,g,h,i,dzdx,dzdy,rise_run)
+		#pragma omp parallel for default(none) private(j,k,a,b,c,d,e,f,g,h,i,dzdx,dzdy,rise_run) num_threads(number_CPUs)
 		for(j = 0;j < get_nRows();j++)
 		{
 			for(k = 0;k < get_nCols();k++)
@@ -174,7 +174,7 @@ bool Slope::compute_gridSlope(Elevation const* elev, int number_threads)
 
 	set_headerData(elevation->get_nCols(), elevation->get_nRows(), elevation->get_xllCorner(), elevation->get_yllCorner(), elevation->get_cellSize(), elevation->get_noDataValue(), 0.0);
 	
-	#pragma omp parallel for default(none) private(j,k,a,b,c,d,e,f,g,h,i,dzdx,dzdy,rise_run)
+	#pragma omp parallel for default(none) private(j,k,a,b,c,d,e,f,g,h,i,dzdx,dzdy,rise_run) num_threads(number_CPUs)
 	for(j = 0;j < get_nRows();j++)
 	{
 		for(k = 0;k < get_nCols();k++)
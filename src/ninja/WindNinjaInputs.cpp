@@ -36,6 +36,9 @@ WindNinjaInputs::WindNinjaInputs()
     hSpdMemDs = NULL;
     hDirMemDs = NULL;
     hDustMemDs = NULL;
+    outputCube = NULL;
+    outputCubeBand = 0;
+    forecastCache = NULL;
     armySize = 1;
     vegetation = WindNinjaInputs::trees;
     initializationMethod = WindNinjaInputs::noInitializationFlag;
@@ -91,6 +94,9 @@ WindNinjaInputs::WindNinjaInputs()
     wxModelAsciiOutFlag = false;
     txtOutFlag = false;
     volVTKOutFlag = false;
+    volVTKWriteFormat = "ascii";
+    volVTKFloat32 = false;
+    volVTKCompress = false;
     kmlFile = "!set";
     kmzFile = "!set";
     wxModelKmlFile = "!set";
@@ -171,7 +177,6 @@ WindNinjaInputs::WindNinjaInputs()
     outputPath = "!set";
 
 #ifdef _OPENMP
-    omp_set_nested(false);
     omp_set_dynamic(false);
 #endif //_OPENMP
 
@@ -233,6 +238,9 @@ WindNinjaInputs &WindNinjaInputs::operator=(const WindNinjaInputs &rhs)
       hSpdMemDs = rhs.hSpdMemDs;
       hDirMemDs = rhs.hDirMemDs;
       hDustMemDs = rhs.hDustMemDs;
+      outputCube = rhs.outputCube;
+      outputCubeBand = rhs.outputCubeBand;
+      forecastCache = rhs.forecastCache;
       
       vegetation = rhs.vegetation;
 
@@ -318,6 +326,9 @@ WindNinjaInputs &WindNinjaInputs::operator=(const WindNinjaInputs &rhs)
       wxModelAsciiOutFlag = rhs.wxModelAsciiOutFlag;
       txtOutFlag = rhs.txtOutFlag;
       volVTKOutFlag = rhs.volVTKOutFlag;
+      volVTKWriteFormat = rhs.volVTKWriteFormat;
+      volVTKFloat32 = rhs.volVTKFloat32;
+      volVTKCompress = rhs.volVTKCompress;
       kmlFile = rhs.kmlFile;
       kmzFile = rhs.kmzFile;
       wxModelKmlFile = rhs.wxModelKmlFile;
@@ -381,7 +392,6 @@ WindNinjaInputs &WindNinjaInputs::operator=(const WindNinjaInputs &rhs)
       surface = rhs.surface;
 
 #ifdef _OPENMP
-      omp_set_nested(false);
       omp_set_dynamic(false);
 #endif //_OPENMP
 
@@ -46,6 +46,9 @@
 #include "ninjaCom.h"
 #include "ninja_conv.h"
 
+class OutputCube;
+class ForecastCache;
+
 struct WindNinjaInputs
 {
 public:
@@ -115,6 +118,9 @@ public:
     GDALDatasetH hSpdMemDs;
     GDALDatasetH hDirMemDs;
     GDALDatasetH hDustMemDs;
+    OutputCube *outputCube;     //multi-band output shared by the runs of an army, NULL if not used
+    int outputCubeBand;         //band of this run in outputCube
+    ForecastCache *forecastCache;   //forecast bands warped once for the runs of an army, NULL if not used
 
 
     //DEM input
@@ -207,6 +213,9 @@ public:
     bool wxModelShpOutFlag;		//flag specifying if a wxModel shapefile should be written
     bool wxModelAsciiOutFlag;		//flag specifying if wxModel ESRI Ascii Raster files should be written
     bool volVTKOutFlag;			//flag specifying if a volume VTK file should be written
+    std::string volVTKWriteFormat;	//format of the volume VTK files, "ascii", "binary" (legacy VTK) or "vts" (VTK XML StructuredGrid)
+    bool volVTKFloat32;			//flag specifying if "vts" data is written as 32 bit floats
+    bool volVTKCompress;		//flag specifying if "vts" data is zlib compressed
     std::string kmlFile;
     std::string kmzFile;
     std::string wxModelKmlFile;
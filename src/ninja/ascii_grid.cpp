@@ -1,4 +1,8 @@
 #include "ascii_grid.h"
+#include "gridResampler.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 inline void check(CPLErr res) {
@@ -8,6 +12,16 @@ inline void check(CPLErr res) {
     }
 }
 
+//threads of the resampling methods, the count of the calling thread, which a run
+//sets to its number of CPUs (see ninja::startSimulation())
+inline int resampleThreads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
 template <class T> GDALDataType getGdalDataType() { return GDT_Unknown; }
 template<> GDALDataType getGdalDataType<double>() { return GDT_Float64; }
 template<> GDALDataType getGdalDataType<short>() { return GDT_Int16; }
@@ -20,6 +34,196 @@ template<> string dataFormat<double>(const char* fmt) { return std::regex_replac
 template<> string dataFormat<int>(const char* fmt) { return std::regex_replace(std::string(fmt), regex("<T>"), std::string("d")); } 
 template<> string dataFormat<short>(const char* fmt) { return std::regex_replace(std::string(fmt), regex("<T>"), std::string("hd")); } 
 
+/*
+** Fast text conversions for the AAIGrid reader and writer.  They give the
+** same values and bytes as the scanf/printf calls they replace, and fall back
+** to them for anything unusual.
+*/
+
+static const double adfPow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                   1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+                                   1e20, 1e21, 1e22 };
+
+/*
+** Parse the number at pszToken, ending at the first white space.  Plain
+** decimals with up to 15 digits are exact as an integer divided by a power of
+** ten, the same as strtod() gives.  Anything else goes to CPLStrtod(), which,
+** unlike fscanf(), doesn't depend on the locale.  Returns false if there is
+** no number.
+*/
+static bool ParseGridValue(const char *pszToken, const char **ppszEnd, double *pdfValue)
+{
+    const char *p = pszToken;
+    bool bNegative = false;
+    if(*p == '-' || *p == '+')
+    {
+        bNegative = (*p == '-');
+        p++;
+    }
+
+    unsigned long long nMantissa = 0;
+    int nDigits = 0, nFraction = 0;
+    bool bDigits = false;
+    while(*p >= '0' && *p <= '9')
+    {
+        if(nMantissa != 0 || *p != '0')
+            nDigits++;
+        nMantissa = nMantissa*10 + (*p - '0');
+        bDigits = true;
+        p++;
+        if(nDigits > 15)
+            break;
+    }
+    if(*p == '.' && nDigits <= 15)
+    {
+        p++;
+        while(*p >= '0' && *p <= '9' && nDigits <= 15)
+        {
+            if(nMantissa != 0 || *p != '0')
+                nDigits++;
+            nMantissa = nMantissa*10 + (*p - '0');
+            nFraction++;
+            bDigits = true;
+            p++;
+        }
+    }
+
+    if(bDigits && nDigits <= 15 && nFraction <= 22 &&
+       (*p == '\0' || *p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+    {
+        double dfValue = (double)nMantissa / adfPow10[nFraction];
+        *pdfValue = bNegative ? -dfValue : dfValue;
+        *ppszEnd = p;
+        return true;
+    }
+
+    char *pszEnd;
+    *pdfValue = CPLStrtod(pszToken, &pszEnd);
+    *ppszEnd = pszEnd;
+    return pszEnd != pszToken;
+}
+
+/*
+** Write value with numDecimals (0-3) decimals and a tab, like
+** printf("%.*f\t").  The value is scaled and rounded in double, which is only
+** used when it can't be off: printf() rounds the exact binary value, so values
+** near a rounding tie, large values (where the scaling error gets near the
+** tie margin) and non-finite values are passed to snprintf().  Returns the
+** number of characters of the value, like snprintf(): if it is nSize or more
+** the value didn't fit and pszOut has to be grown.  nSize is at least
+** nMinGridValueSize.
+*/
+static const size_t nMinGridValueSize = 64;
+
+static int FormatGridValue(double dfValue, int numDecimals, char *pszOut, size_t nSize)
+{
+    const double dfScaled = fabs(dfValue) * adfPow10[numDecimals];
+    const double dfRounded = floor(dfScaled + 0.5);
+    if(!(dfScaled < 1e9) || fabs(dfScaled - floor(dfScaled) - 0.5) < 1e-6)
+        return snprintf(pszOut, nSize, "%.*f\t", numDecimals, dfValue);
+
+    unsigned long long nValue = (unsigned long long)dfRounded;
+    char szDigits[24];
+    int nLen = 0;
+    do
+    {
+        szDigits[nLen++] = (char)('0' + nValue % 10);
+        nValue /= 10;
+    }while(nValue != 0 || nLen <= numDecimals);
+
+    int n = 0;
+    if(std::signbit(dfValue))
+        pszOut[n++] = '-';
+    while(nLen > numDecimals)
+        pszOut[n++] = szDigits[--nLen];
+    if(numDecimals > 0)
+    {
+        pszOut[n++] = '.';
+        while(nLen > 0)
+            pszOut[n++] = szDigits[--nLen];
+    }
+    pszOut[n++] = '\t';
+    return n;
+}
+
+/*
+** Write the rows of a grid, last row first, nRowsPerBlock rows at a time.
+** The rows of a block are formatted in parallel and written in order.  A row
+** is grown when a value doesn't fit, for values too large for nMaxRowLength.
+*/
+template <class T, class Formatter>
+static void WriteGridRows(FILE *fout, const Array2D<T> &data, Formatter formatValue)
+{
+    const int nRows = data.get_numRows();
+    const int nCols = data.get_numCols();
+    const int nRowsPerBlock = 64;
+    const size_t nMaxRowLength = (size_t)nCols * nMinGridValueSize + 2;
+    std::vector<std::string> aosRows(nRowsPerBlock);
+
+    for(int iBlock = nRows - 1; iBlock >= 0; iBlock -= nRowsPerBlock)
+    {
+        const int nBlockRows = iBlock + 1 < nRowsPerBlock ? iBlock + 1 : nRowsPerBlock;
+        int r;
+
+#pragma omp parallel for schedule(static)
+        for(r = 0; r < nBlockRows; r++)
+        {
+            const int i = iBlock - r;
+            std::string &osRow = aosRows[r];
+            osRow.resize(nMaxRowLength);
+            size_t nLen = 0;
+            for(int j = 0; j < nCols; j++)
+            {
+                if(osRow.size() - nLen < nMinGridValueSize + 1)
+                    osRow.resize(2 * osRow.size() + nMinGridValueSize);
+                size_t nValueLen = formatValue(data(i,j), &osRow[nLen], osRow.size() - nLen);
+                if(nValueLen >= osRow.size() - nLen)
+                {
+                    osRow.resize(nLen + nValueLen + nMinGridValueSize + 1);
+                    nValueLen = formatValue(data(i,j), &osRow[nLen], osRow.size() - nLen);
+                }
+                nLen += nValueLen;
+            }
+            osRow[nLen++] = '\n';
+            osRow.resize(nLen);
+        }
+
+        for(r = 0; r < nBlockRows; r++)
+            fwrite(aosRows[r].data(), 1, aosRows[r].size(), fout);
+    }
+}
+
+struct FixedFormatter
+{
+    int numDecimals;
+    explicit FixedFormatter(int n) : numDecimals(n) {}
+    template <class T> int operator()(T value, char *pszOut, size_t nSize) const
+    { return FormatGridValue((double)value, numDecimals, pszOut, nSize); }
+};
+
+struct IntegralFormatter
+{
+    template <class T> int operator()(T value, char *pszOut, size_t /*nSize*/) const
+    {
+        //printf("%ld\t", (long)value), at most 21 characters
+        long nValue = (long)value;
+        unsigned long nAbs = nValue < 0 ? 0UL - (unsigned long)nValue : (unsigned long)nValue;
+        char szDigits[24];
+        int nLen = 0, n = 0;
+        do
+        {
+            szDigits[nLen++] = (char)('0' + nAbs % 10);
+            nAbs /= 10;
+        }while(nAbs != 0);
+        if(nValue < 0)
+            pszOut[n++] = '-';
+        while(nLen > 0)
+            pszOut[n++] = szDigits[--nLen];
+        pszOut[n++] = '\t';
+        return n;
+    }
+};
+
 template <class T> inline T epsClr() { throw std::runtime_error("unknown eps value"); }
 template<> inline double epsClr<double>() { return 0.001; }
 template<> inline int epsClr<int>() { return 1; }
@@ -346,7 +550,6 @@ void AsciiGrid<T>::read_Grid(const std::string inputFile)
     string noDataFmt = dataFormat<T>("%s %<T>");
 
     T value;
-    string valueFmt = dataFormat<T>("%<T>");
 
     fscanf(fin, "%d", &nCols);
     fscanf(fin, "%s %d", krap, &nRows);
@@ -357,13 +560,32 @@ void AsciiGrid<T>::read_Grid(const std::string inputFile)
 
     data.setMatrix(nRows,nCols,noDataValue);
 
+    //read the rest of the file at once and parse it in memory
+    long nStart = ftell(fin);
+    fseek(fin, 0, SEEK_END);
+    long nEnd = ftell(fin);
+    fseek(fin, nStart, SEEK_SET);
+    std::vector<char> buffer(nEnd > nStart ? nEnd - nStart + 1 : 1);
+    size_t nRead = fread(&buffer[0], 1, buffer.size() - 1, fin);
+    buffer[nRead] = '\0';
+    fclose(fin);
+
+    const char *p = &buffer[0];
+    const char *pszEnd;
+    double dfValue = 0.0;
+    value = noDataValue;
     for(int i = nRows - 1;i >= 0;i--) {
         for (int j = 0;j < nCols;j++) {
-            fscanf(fin, valueFmt.c_str(), &value);
-            data(i,j) = T(value);
+            while(*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == '\f' || *p == '\v')
+                p++;
+            if(*p != '\0' && ParseGridValue(p, &pszEnd, &dfValue))
+            {
+                value = T(dfValue);
+                p = pszEnd;
+            }
+            data(i,j) = value;  //like fscanf(), keep the last value if there are no more
         }
     }
-    fclose(fin);
 
     if(data.size() == 0)
         throw std::runtime_error("File has no data values in AsciiGrid<T>::read_Grid().");
@@ -601,7 +823,7 @@ bool AsciiGrid<T>::check_inBounds(double X, double Y) const
 }
 
 template <class T>
-AsciiGrid<T> AsciiGrid<T>::resample_Grid(double resampleCellSize, interpTypeEnum interpType)
+AsciiGrid<T> AsciiGrid<T>::resample_Grid(double resampleCellSize, interpTypeEnum interpType) const
 {
     double xDim = get_xDimension();
     double yDim = get_yDimension();
@@ -627,18 +849,7 @@ AsciiGrid<T> AsciiGrid<T>::resample_Grid(double resampleCellSize, interpTypeEnum
 
     AsciiGrid<T>A(newNumCols, newNumRows, xllCorner, yllCorner, resampleCellSize, data.getNoDataValue(), data.getNoDataValue(), prjString);
 
-    double xC = 0;
-    double yC = 0;
-
-    for(int i = 0;i < newNumRows;i++)
-    {
-        for(int j = 0;j < newNumCols;j++)
-        {
-            A.get_cellPosition(i, j, &xC, &yC);
-
-            A.set_cellValue(i, j, interpolateGrid(xC, yC, interpType));
-        }
-    }
+    GridResampler::get(*this, A, interpType)->interpolate(*this, A, resampleThreads());
     return A;
 }
 
@@ -668,18 +879,7 @@ void AsciiGrid<T>::resample_Grid_in_place(double resampleCellSize, interpTypeEnu
 
         AsciiGrid<T>A(newNumCols, newNumRows, xllCorner, yllCorner, resampleCellSize, data.getNoDataValue(), data.getNoDataValue(), prjString);
 
-        double xC = 0;
-        double yC = 0;
-
-        for(int i = 0;i < newNumRows;i++)
-        {
-            for(int j = 0;j < newNumCols;j++)
-            {
-                A.get_cellPosition(i, j, &xC, &yC);
-
-                A.set_cellValue(i, j, interpolateGrid(xC, yC, interpType));
-            }
-        }
+        GridResampler::get(*this, A, interpType)->interpolate(*this, A, resampleThreads());
         *this = A;
     }
 }
@@ -715,18 +915,7 @@ void AsciiGrid<T>::resample_Grid_in_place(int arraySize, interpTypeEnum interpTy
 
         AsciiGrid<T>A(newNumCols, newNumRows, xllCorner, yllCorner, resampleCellSize, data.getNoDataValue(), data.getNoDataValue(), prjString);
 
-        double xC = 0;
-        double yC = 0;
-
-        for(int i = 0;i < newNumRows;i++)
-        {
-            for(int j = 0;j < newNumCols;j++)
-            {
-                A.get_cellPosition(i, j, &xC, &yC);
-
-                A.set_cellValue(i, j, interpolateGrid(xC, yC, interpType));
-            }
-        }
+        GridResampler::get(*this, A, interpType)->interpolate(*this, A, resampleThreads());
 
         *this = A;
     }
@@ -997,71 +1186,144 @@ void AsciiGrid<T>::BufferAroundGridInPlace( int nAddCols, int nAddRows )
 }
 
 template <class T>
-void AsciiGrid<T>::interpolateFromGrid(AsciiGrid &A, interpTypeEnum interpType)
+void AsciiGrid<T>::interpolateFromGrid(const AsciiGrid &A, interpTypeEnum interpType)
 {   //Function interpolates data from A onto the current grid
-
-    double xC, yC;
-
-    //Set noData value to be the same (since A.interpolateGrid() returns its noDataValue if xC,yC is out of bounds)
-    data.setNoDataValue(A.data.getNoDataValue());
-
-    for(int i = 0;i < data.get_numRows();i++)
-    {
-        for(int j = 0;j < data.get_numCols();j++)
-        {
-            get_cellPosition(i, j, &xC, &yC);
-
-            set_cellValue(i, j, A.interpolateGrid(xC, yC, interpType));
-        }
-    }
+    //The noData value is set to A's (see GridResampler::interpolate())
+    GridResampler::get(A, *this, interpType)->interpolate(A, *this, resampleThreads());
 }
 
 template <class T>
-void AsciiGrid<T>::interpolateFromPoints(T* pointData, double* X, double* Y, double* influenceRadius, int numPoints, double interpDistPower)
+void AsciiGrid<T>::interpolateFromPoints(T* pointData, double* X, double* Y, double* influenceRadius, int numPoints, double interpDistPower, int numThreads)
 {   //Function interpolates from an array of point data using inverse distance squared weighting
     //pointData is the array of values at the points, X and Y are the coordinates of the points, influenceRadius is
     //the array containing the maximum interpolation distance for each station (if <0 then infinite influence radius)
     //numPoints is the number of points, and
     //interpDistPower is the power used for the distance weighting (usually 1.0 or 2.0 for inverse distance weighting or inverse distance squared weighting, respectively)
+    //numThreads is the number of threads doing the tiles
 
+    AsciiGrid<T>* grids[1] = { this };
+    interpolateFromPoints(grids, &pointData, 1, X, Y, influenceRadius, numPoints, interpDistPower, numThreads);
+}
 
-    double weight, weight_sum, distance, xC, yC;
-    T value;
-
+/**
+ * @brief Interpolate several fields from the same points at once.
+ *
+ * Same as the member interpolateFromPoints(), but the distance weights of
+ * each cell are computed once and used for all the fields, e.g. the u and v
+ * components of the station winds.  The grids must have the same size and
+ * position.
+ *
+ * The grid is split in tiles and only the points whose influence radius
+ * reaches a tile are looked at for its cells.  The tiles are done in
+ * parallel on numThreads threads.  The points are summed in the same order
+ * as one cell at a time, so the results don't depend on the tiling or the
+ * number of threads.
+ *
+ * @param grids grids to fill, numGrids of them
+ * @param pointData values at the points for each grid, pointData[g][k]
+ * @param numGrids number of grids
+ * @param X x coordinates of the points
+ * @param Y y coordinates of the points
+ * @param influenceRadius maximum interpolation distance of each point, <0 for infinite
+ * @param numPoints number of points
+ * @param interpDistPower power of the inverse distance weighting
+ * @param numThreads number of threads doing the tiles
+ */
+template <class T>
+void AsciiGrid<T>::interpolateFromPoints(AsciiGrid<T>** grids, T** pointData, int numGrids, double* X, double* Y, double* influenceRadius, int numPoints, double interpDistPower, int numThreads)
+{
     if(interpDistPower <= 0)
         throw std::out_of_range("interpDistPower in AsciiGrid<T>::interpolateFromPoints() must be greater than 0.");
     if(numPoints <=0)
         throw std::out_of_range("numPoints in AsciiGrid<T>::interpolateFromPoints() must be greater than 0.");
-
-
-    *this = data.getNoDataValue();
-
-    for(int i = 0;i < data.get_numRows();i++)
-    {
-        for(int j = 0;j < data.get_numCols();j++)
+    if(numGrids <= 0)
+        throw std::out_of_range("numGrids in AsciiGrid<T>::interpolateFromPoints() must be greater than 0.");
+    for(int g = 1; g < numGrids; g++)
+    {
+        if(!grids[0]->checkForCoincidentGrids(*grids[g]))
+            throw std::runtime_error("The grids in AsciiGrid<T>::interpolateFromPoints() must have the same size and position.");
+    }
+
+    for(int g = 0; g < numGrids; g++)
+        *grids[g] = grids[g]->data.getNoDataValue();
+
+    const AsciiGrid<T> &grid = *grids[0];
+    const int nRows = grid.data.get_numRows();
+    const int nCols = grid.data.get_numCols();
+    const int tileSize = 16;
+    const int nTileRows = (nRows + tileSize - 1) / tileSize;
+    const int nTileCols = (nCols + tileSize - 1) / tileSize;
+    const int nTiles = nTileRows * nTileCols;
+    //1 and 2 are the usual powers, don't go through std::pow() for them
+    const int powerCase = interpDistPower == 1.0 ? 1 : (interpDistPower == 2.0 ? 2 : 0);
+    int tile;
+
+#pragma omp parallel for num_threads(numThreads) schedule(dynamic) default(shared) private(tile)
+    for(tile = 0; tile < nTiles; tile++)
+    {
+        const int iStart = (tile / nTileCols) * tileSize;
+        const int jStart = (tile % nTileCols) * tileSize;
+        const int iEnd = std::min(iStart + tileSize, nRows);
+        const int jEnd = std::min(jStart + tileSize, nCols);
+        double xMin, yMin, xMax, yMax, dx, dy;
+        double weight, weight_sum, distance, xC, yC;
+        std::vector<int> tilePoints;
+        std::vector<T> value(numGrids);
+
+        grid.get_cellPosition(iStart, jStart, &xMin, &yMin);
+        grid.get_cellPosition(iEnd - 1, jEnd - 1, &xMax, &yMax);
+
+        //points that reach at least one cell center of the tile, in order
+        for(int k = 0; k < numPoints; k++)
         {
-            value = 0.0;
-            get_cellPosition(i, j, &xC, &yC);
-            weight_sum = 0.0;
+            if(influenceRadius[k] >= 0.0)
+            {
+                dx = std::max(std::max(xMin - X[k], X[k] - xMax), 0.0);
+                dy = std::max(std::max(yMin - Y[k], Y[k] - yMax), 0.0);
+                if(std::sqrt(dx*dx + dy*dy) > influenceRadius[k])
+                    continue;
+            }
+            tilePoints.push_back(k);
+        }
+        if(tilePoints.empty())
+            continue;
 
-            for(int k = 0; k < numPoints; k++)
+        for(int i = iStart; i < iEnd; i++)
+        {
+            for(int j = jStart; j < jEnd; j++)
             {
-                distance = std::sqrt((xC-X[k])*(xC-X[k]) + (yC-Y[k])*(yC-Y[k]));
-                if(influenceRadius[k] >= 0.0)   //negative influence radius means infinite influence radius
+                grid.get_cellPosition(i, j, &xC, &yC);
+                weight_sum = 0.0;
+                for(int g = 0; g < numGrids; g++)
+                    value[g] = 0.0;
+
+                for(size_t n = 0; n < tilePoints.size(); n++)
+                {
+                    const int k = tilePoints[n];
+                    distance = std::sqrt((xC-X[k])*(xC-X[k]) + (yC-Y[k])*(yC-Y[k]));
+                    if(influenceRadius[k] >= 0.0)   //negative influence radius means infinite influence radius
+                    {
+                        if(distance > influenceRadius[k])   //if distance from current cell location to station is larger than the influence radius, skip this station
+                            continue;
+                    }
+                    if(powerCase == 2)
+                        weight = 1.0/(distance*distance);
+                    else if(powerCase == 1)
+                        weight = 1.0/distance;
+                    else
+                        weight = 1.0/std::pow(distance,interpDistPower);
+                    weight_sum = weight_sum + weight;
+                    for(int g = 0; g < numGrids; g++)
+                        value[g] = value[g] + pointData[g][k] * weight;
+                }
+                if(weight_sum != 0) //if value IS zero, then don't set the value because this means all points don't have an influence radius that reaches this cell (this effectively leaves the value as the no_data value)
                 {
-                    if(distance > influenceRadius[k])   //if distance from current cell location to station is larger than the influence radius, skip this station
-                        continue;
+                    for(int g = 0; g < numGrids; g++)
+                        grids[g]->data(i,j) = value[g]/weight_sum;
                 }
-                weight = 1.0/std::pow(distance,interpDistPower);
-                weight_sum = weight_sum + weight;
-                value = value + pointData[k] * weight;
             }
-            if(weight_sum != 0) //if value IS zero, then don't set the value because this means all points don't have an influence radius that reaches this cell (this effectively leaves the value as the no_data value)
-                set_cellValue(i, j, value/weight_sum);
         }
     }
-
-
 }
 
 template <class T>
@@ -1384,31 +1646,25 @@ void AsciiGrid<T>::write_GridInfo(FILE *fileOut)
 
 template <class T>
 void AsciiGrid<T>::write_integralGridData (FILE* fout) {
-    int nRows = data.get_numRows();
-    int nCols = data.get_numCols();
-
-    for (int i=nRows-1; i>=0; i--) {
-        for (int j=0; j<nCols; j++) {
-            fprintf(fout,"%ld\t", (long)data(i,j));
-        }
-        fprintf(fout,"\n");
-    }
+    WriteGridRows(fout, data, IntegralFormatter());
 }
 
 
 template <class T>
 void AsciiGrid<T>::write_fpGridData (FILE* fout, int numDecimals) {
-    string fmt = dataFormat<T>("%.*<T>\t");
-
-    int nRows = data.get_numRows();
-    int nCols = data.get_numCols();
-
-    for (int i=nRows-1; i>=0; i--) {
-        for (int j=0; j<nCols; j++) {
-            fprintf(fout,fmt.c_str(), numDecimals, data(i,j));
+    if(numDecimals < 0 || numDecimals > 3 || std::numeric_limits<T>::is_integer)
+    {
+        //the fast path is for 0-3 decimals of floating point values, like write_Grid() uses
+        string fmt = dataFormat<T>("%.*<T>\t");
+        for (int i=data.get_numRows()-1; i>=0; i--) {
+            for (int j=0; j<data.get_numCols(); j++) {
+                fprintf(fout,fmt.c_str(), numDecimals, data(i,j));
+            }
+            fprintf(fout,"\n");
         }
-        fprintf(fout,"\n");
+        return;
     }
+    WriteGridRows(fout, data, FixedFormatter(numDecimals));
 }
 
 template <class T>
@@ -37,6 +37,7 @@
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <vector>
 #include <cmath>
 #include <stdio.h>
 #include <stdlib.h>
@@ -161,16 +162,20 @@ public:
     bool check_inBounds(double X, double Y) const;
 
     AsciiGrid<T> resample_Grid(double resampleCellSize,
-                               interpTypeEnum interpType);
+                               interpTypeEnum interpType) const;
     void resample_Grid_in_place(double resampleCellSize,
                                 interpTypeEnum interpType);
     void resample_Grid_in_place(int arraySize, interpTypeEnum interpType);
 
-    void interpolateFromGrid(AsciiGrid &A, interpTypeEnum interpType);
+    void interpolateFromGrid(const AsciiGrid &A, interpTypeEnum interpType);
 
     void interpolateFromPoints(T* pointData, double* X, double* Y,
                                double* influenceRadius, int numPoints,
-                               double interpDistPower);
+                               double interpDistPower, int numThreads);
+    static void interpolateFromPoints(AsciiGrid<T>** grids, T** pointData,
+                                      int numGrids, double* X, double* Y,
+                                      double* influenceRadius, int numPoints,
+                                      double interpDistPower, int numThreads);
 
     void clipGridInPlaceSnapToCells(double percentClip);
 
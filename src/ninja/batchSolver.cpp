@@ -0,0 +1,321 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Conjugate gradient solve of several right hand sides at once
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "batchSolver.h"
+
+BatchSolver::BatchSolver()
+{
+    NUMNP = 0;
+    numThreads = 1;
+#ifdef _OPENMP
+    numThreads = omp_get_max_threads();
+#endif
+    row_ptr = NULL;
+    col_ind = NULL;
+    precondType = Preconditioner::Jacobi;
+    setupTime = 0.0;
+    spmvTime = 0.0;
+    precondTime = 0.0;
+}
+
+BatchSolver::~BatchSolver()
+{
+
+}
+
+/**
+ * @brief Set the number of threads of the parallel regions.
+ *
+ * Also sets it on the preconditioner and the block product, call it before
+ * initialize().
+ *
+ * @param n Number of threads, at least 1.
+ */
+void BatchSolver::set_numThreads(int n)
+{
+    numThreads = n > 0 ? n : 1;
+    M.set_numThreads(numThreads);
+    Ax.set_numThreads(numThreads);
+}
+
+/**
+ * @brief Set up the preconditioner and the block product for a matrix.
+ *
+ * If the preconditioner can't be built, the Jacobi preconditioner is used
+ * instead (see get_precondType()).
+ *
+ * @param numnp Number of rows (and columns) in A.
+ * @param A Upper triangle of the symmetric matrix in CSR storage, diagonal first in each row.
+ * @param row_ptr Row pointers into A, size numnp+1.
+ * @param col_ind Column index of each entry in A.
+ * @param preconditionerType Preconditioner::precondType to use.
+ * @param spmvMode Requested SpMV mode, changed to one with a block product if needed.
+ * @param nrows Number of rows in the mesh.
+ * @param ncols Number of columns in the mesh.
+ * @param nlayers Number of layers in the mesh.
+ * @return true on success.
+ */
+bool BatchSolver::initialize(int numnp, double *A, int *row_ptr, int *col_ind,
+                             int preconditionerType, SparseMatVec::eSpMVMode spmvMode,
+                             int nrows, int ncols, int nlayers)
+{
+    char matdescra[6];
+    matdescra[0]='s';	//symmetric
+    matdescra[1]='u';	//upper triangle stored
+    matdescra[2]='n';	//non-unit diagonal
+    matdescra[3]='c';	//c-style array (ie 0 is index of first element, not 1 like in Fortran)
+
+    const double startTime = omp_get_wtime();
+    NUMNP = numnp;
+    this->row_ptr = row_ptr;
+    this->col_ind = col_ind;
+
+    precondType = preconditionerType;
+    if(M.initialize(NUMNP, A, row_ptr, col_ind, precondType, matdescra,
+                    nrows, ncols, nlayers)==false)
+    {
+        precondType = Preconditioner::Jacobi;
+        if(M.initialize(NUMNP, A, row_ptr, col_ind, precondType, matdescra)==false)
+            return false;
+    }
+
+    if(spmvMode != SparseMatVec::expanded)
+        spmvMode = SparseMatVec::stencil;
+    bool status = Ax.initialize(NUMNP, A, row_ptr, col_ind, spmvMode, nrows, ncols, nlayers);
+    if(status == false)
+        status = Ax.initialize(NUMNP, A, row_ptr, col_ind, SparseMatVec::expanded);
+
+    setupTime = omp_get_wtime() - startTime;
+    return status;
+}
+
+/**
+ * @brief Solve A*x[v] = b[v] for every v.
+ *
+ * Uses the same stopping test as ninja::solve(), ||b - A*x|| <= tol*||b||.
+ *
+ * @param b Right hand sides, each of size NUMNP.
+ * @param x Initial guesses, each of size NUMNP, replaced by the solutions.
+ * @param max_iter Maximum number of iterations.
+ * @param tol Convergence tolerance on the relative residual.
+ * @return true if all of the right hand sides converged.
+ */
+bool BatchSolver::solve(const std::vector<double*> &b, const std::vector<double*> &x,
+                        int max_iter, double tol)
+{
+    const int nVec = (int)b.size();
+    int i, k, v, n;
+
+    if((int)x.size() != nVec)
+        throw std::logic_error("BatchSolver::solve() needs one x for each b.");
+
+    iterations.assign(nVec, 0);
+    residuals.assign(nVec, 0.0);
+    residualHistory.assign(nVec, std::vector<double>());
+    spmvTime = 0.0;
+    precondTime = 0.0;
+    double t;
+    if(nVec == 0)
+        return true;
+
+    std::vector<std::vector<double> > r(nVec, std::vector<double>(NUMNP));
+    std::vector<std::vector<double> > z(nVec, std::vector<double>(NUMNP));
+    std::vector<double> normb(nVec), rho(nVec), rho_1(nVec);
+    std::vector<int> cols;  //right hand side of each column of P and Q, the unconverged ones
+
+    //initial residuals, r = b - A*x
+    for(v=0; v<nVec; v++)
+    {
+        Ax.multiply(x[v], &r[v][0]);
+
+        double bb = 0.0, rr = 0.0;
+        #pragma omp parallel for reduction(+:bb,rr) num_threads(numThreads)
+        for(n=0; n<NUMNP; n++)
+        {
+            r[v][n] = b[v][n] - r[v][n];
+            bb += b[v][n]*b[v][n];
+            rr += r[v][n]*r[v][n];
+        }
+        normb[v] = bb > 0.0 ? std::sqrt(bb) : 1.0;
+        residuals[v] = std::sqrt(rr) / normb[v];
+        if(residuals[v] > tol)
+            cols.push_back(v);
+    }
+
+    int nCols = (int)cols.size();
+    std::vector<double> P((size_t)NUMNP*nCols, 0.0);   //search directions, interleaved
+    std::vector<double> Q((size_t)NUMNP*nCols);         //A*P, interleaved
+
+    std::vector<double> beta(nVec), alpha(nVec), pq(nVec), rr(nVec);
+    std::vector<double*> zp(nVec), rp(nVec);
+    for(v=0; v<nVec; v++)
+    {
+        zp[v] = &z[v][0];
+        rp[v] = &r[v][0];
+    }
+
+    for(i=1; i<=max_iter && nCols>0; i++)
+    {
+        //precondition each residual, the preconditioners work on one vector
+        for(k=0; k<nCols; k++)
+        {
+            v = cols[k];
+            iterations[v] = i;
+
+            t = omp_get_wtime();
+            M.solve(rp[v], zp[v], row_ptr, col_ind);
+            precondTime += omp_get_wtime() - t;
+
+            const double *zv = zp[v];
+            const double *rv = rp[v];
+            double dot = 0.0;
+            #pragma omp parallel for reduction(+:dot) num_threads(numThreads)
+            for(n=0; n<NUMNP; n++)
+                dot += zv[n]*rv[n];
+            rho[v] = dot;
+            beta[k] = (i == 1) ? 0.0 : rho[v] / rho_1[v];
+        }
+
+        //update the search directions in one pass over P
+        #pragma omp parallel for private(k) num_threads(numThreads)
+        for(n=0; n<NUMNP; n++)
+        {
+            double *p = &P[(size_t)n*nCols];
+            for(k=0; k<nCols; k++)
+                p[k] = zp[cols[k]][n] + beta[k]*p[k];
+        }
+
+        //one product for all of the search directions
+        t = omp_get_wtime();
+        Ax.multiplyBlock(&P[0], &Q[0], nCols);
+        spmvTime += omp_get_wtime() - t;
+
+        columnDots(&P[0], &Q[0], nCols, &pq[0]);
+        for(k=0; k<nCols; k++)
+            alpha[k] = rho[cols[k]] / pq[k];
+
+        //update the solutions and residuals in one pass
+        std::fill(rr.begin(), rr.end(), 0.0);
+        #pragma omp parallel private(k, v) num_threads(numThreads)
+        {
+            std::vector<double> rrLocal(nCols, 0.0);
+
+            #pragma omp for
+            for(n=0; n<NUMNP; n++)
+            {
+                const double *p = &P[(size_t)n*nCols];
+                const double *q = &Q[(size_t)n*nCols];
+                for(k=0; k<nCols; k++)
+                {
+                    v = cols[k];
+                    x[v][n] += alpha[k]*p[k];
+                    rp[v][n] -= alpha[k]*q[k];
+                    rrLocal[k] += rp[v][n]*rp[v][n];
+                }
+            }
+
+            #pragma omp critical
+            for(k=0; k<nCols; k++)
+                rr[k] += rrLocal[k];
+        }
+
+        std::vector<int> keep;  //columns of P that haven't converged
+        for(k=0; k<nCols; k++)
+        {
+            v = cols[k];
+            residuals[v] = std::sqrt(rr[k]) / normb[v];
+            residualHistory[v].push_back(residuals[v]);
+            rho_1[v] = rho[v];
+            if(residuals[v] > tol)
+                keep.push_back(k);
+        }
+
+        //take the converged right hand sides out of P, so the products skip them
+        if((int)keep.size() < nCols)
+        {
+            const int nKeep = (int)keep.size();
+            std::vector<double> packed((size_t)NUMNP*nKeep);
+            #pragma omp parallel for private(k) num_threads(numThreads)
+            for(n=0; n<NUMNP; n++)
+                for(k=0; k<nKeep; k++)
+                    packed[(size_t)n*nKeep + k] = P[(size_t)n*nCols + keep[k]];
+            P.swap(packed);
+            Q.resize((size_t)NUMNP*nKeep);
+
+            for(k=0; k<nKeep; k++)
+                cols[k] = cols[keep[k]];
+            cols.resize(nKeep);
+            nCols = nKeep;
+        }
+    }
+
+    return nCols == 0;
+}
+
+/**
+ * @brief Dot products of the matching columns of two interleaved multivectors.
+ *
+ * @param X First multivector, X[n*nVec+v].
+ * @param Y Second multivector, Y[n*nVec+v].
+ * @param nVec Number of columns.
+ * @param dots Output, dots[v] = sum over n of X[n*nVec+v]*Y[n*nVec+v].
+ */
+void BatchSolver::columnDots(const double *X, const double *Y, int nVec, double *dots) const
+{
+    int n, v;
+
+    for(v=0; v<nVec; v++)
+        dots[v] = 0.0;
+
+    #pragma omp parallel private(v) num_threads(numThreads)
+    {
+        std::vector<double> local(nVec, 0.0);
+
+        #pragma omp for
+        for(n=0; n<NUMNP; n++)
+        {
+            const double *xn = X + (size_t)n*nVec;
+            const double *yn = Y + (size_t)n*nVec;
+            for(v=0; v<nVec; v++)
+                local[v] += xn[v]*yn[v];
+        }
+
+        #pragma omp critical
+        for(v=0; v<nVec; v++)
+            dots[v] += local[v];
+    }
+}
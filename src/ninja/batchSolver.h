@@ -0,0 +1,103 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Conjugate gradient solve of several right hand sides at once
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef BATCH_SOLVER_H
+#define BATCH_SOLVER_H
+
+#include <vector>
+
+#include "sparseMatVec.h"
+#include "preconditioner.h"
+
+/**
+ * @brief Solves A*x = b for several right hand sides with the same matrix.
+ *
+ * Runs that only differ in the initial wind (for example a domain average
+ * sweep over directions and speeds with no stability) build the same stiffness
+ * matrix, only the right hand side changes.  Solving them one at a time reads
+ * the matrix once per iteration per run.  Here a preconditioned conjugate
+ * gradient iteration is done for all of the right hand sides in lockstep, and
+ * the matrix products of an iteration are done together with
+ * SparseMatVec::multiplyBlock(), which reads the matrix once for all of them.
+ *
+ * Each right hand side has its own CG coefficients, so the result (and the
+ * number of iterations) for each one is the same as a separate solve with the
+ * same preconditioner and product.  A right hand side that has converged is
+ * dropped from the updates, and its column is packed out of the search
+ * directions so the block products only work on the unconverged ones.
+ *
+ * The preconditioner is applied to each right hand side separately.  The block
+ * product only exists for the expanded and stencil SpMV modes, so the
+ * symmetric and serial modes are changed to the stencil mode (or the expanded
+ * mode if the stencil mode can't be used).
+ */
+class BatchSolver
+{
+public:
+    BatchSolver();
+    ~BatchSolver();
+
+    bool initialize(int numnp, double *A, int *row_ptr, int *col_ind,
+                    int preconditionerType, SparseMatVec::eSpMVMode spmvMode,
+                    int nrows, int ncols, int nlayers);
+    bool solve(const std::vector<double*> &b, const std::vector<double*> &x,
+               int max_iter, double tol);
+
+    void set_numThreads(int n);
+    int get_precondType() const { return precondType; }
+    SparseMatVec::eSpMVMode get_spmvMode() const { return Ax.get_mode(); }
+    const std::vector<int> &get_iterations() const { return iterations; }
+    const std::vector<double> &get_residuals() const { return residuals; }
+    const std::vector<double> &get_residualHistory(int v) const { return residualHistory[v]; }
+    double get_setupTime() const { return setupTime; }
+    double get_spmvTime() const { return spmvTime; }
+    double get_precondTime() const { return precondTime; }
+
+private:
+    int NUMNP;
+    int numThreads; //threads of the parallel regions, omp_get_max_threads() when constructed
+    int *row_ptr, *col_ind;
+    int precondType;
+    Preconditioner M;
+    SparseMatVec Ax;
+
+    std::vector<int> iterations;    //CG iterations of each right hand side in the last solve()
+    std::vector<double> residuals;  //final relative residual of each right hand side
+    std::vector<std::vector<double> > residualHistory;  //relative residual of each right hand side after each iteration
+    double setupTime;       //seconds in initialize()
+    double spmvTime;        //seconds in the block products of the last solve()
+    double precondTime;     //seconds applying the preconditioner in the last solve()
+
+    void columnDots(const double *X, const double *Y, int nVec, double *dots) const;
+
+    BatchSolver(const BatchSolver &rhs);
+    BatchSolver &operator=(const BatchSolver &rhs);
+};
+
+#endif	//BATCH_SOLVER_H
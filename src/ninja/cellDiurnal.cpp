@@ -31,7 +31,7 @@
 
 cellDiurnal::cellDiurnal()
 {
-
+    hillValleyField = NULL;
 }
 
 cellDiurnal::cellDiurnal(Elevation const* incomingDem, Shade const* shd, 
@@ -75,6 +75,9 @@ cellDiurnal::cellDiurnal(Elevation const* incomingDem, Shade const* shd,
     sinAlphaLocal = 0;
     S = 0;
     cellDist_shadeFlag = true;
+    hillValleyField = NULL;
+    shadeHasShaded = true;
+    shadeHasUnshaded = true;
     g = 9.81;
 
     Cd_downslope = downDragCoeff; //0.0001;
@@ -154,6 +157,9 @@ cellDiurnal::cellDiurnal(cellDiurnal &c)
     sinAlphaLocal = c.sinAlphaLocal;
     S = c.S;
     cellDist_shadeFlag = c.cellDist_shadeFlag;
+    hillValleyField = c.hillValleyField;
+    shadeHasShaded = c.shadeHasShaded;
+    shadeHasUnshaded = c.shadeHasUnshaded;
     g = c.g;
     Cd_downslope = c.Cd_downslope;
     entrainment_coeff_downslope = c.entrainment_coeff_downslope;
@@ -226,6 +232,9 @@ void cellDiurnal::create(Elevation const* incomingDem, Shade const* shd, Solar *
     sinAlphaLocal = 0;
     S = 0;
     cellDist_shadeFlag = true;
+    hillValleyField = NULL;
+    shadeHasShaded = true;
+    shadeHasUnshaded = true;
     g = 9.81;
 
     Cd_downslope = 0.0001;
@@ -445,6 +454,12 @@ void cellDiurnal::compute_Bl_height()
 //                 1 => downslope flow (compute distance to hill top)
 void cellDiurnal::compute_cellHillDist()
 {
+    if(hillValleyField != NULL)
+    {
+        compute_cellHillDistFromField();
+        return;
+    }
+
     //indicates number of cell distances moved per step upslope or downslope along tracking path
     //BE SURE STEPMULTIPLIER IS GREATER THAN 1.41421... (SQUARE ROOT OF 2) OR TRACKING CORNER 
     //TO CORNER ON A CELL WON'T MAKE IT ACROSS THE CELL
@@ -538,6 +553,110 @@ void cellDiurnal::compute_cellHillDist()
     }
 }
 
+/**
+ * Use precomputed hill top/valley bottom walks.
+ *
+ * The walks in field have to be done on the dem of this cellDiurnal.  Only
+ * the shade still has to be checked along the walk, and not even that if the
+ * shade grid has no cell that can stop it.
+ *
+ * @param field walks of the dem, NULL to walk the dem for each cell
+ */
+void cellDiurnal::set_hillValleyField(HillValleyField const* field)
+{
+    hillValleyField = field;
+    shadeHasShaded = false;
+    shadeHasUnshaded = false;
+    if(hillValleyField == NULL)
+        return;
+
+    for(int m = 0; m < shade->get_nRows(); m++)
+    {
+        for(int n = 0; n < shade->get_nCols(); n++)
+        {
+            if((*shade)(m,n) == shade->shaded)
+                shadeHasShaded = true;
+            else if((*shade)(m,n) == shade->unshaded)
+                shadeHasUnshaded = true;
+        }
+    }
+}
+
+/*
+ * Same as compute_cellHillDist(), but the number of steps the walk takes
+ * before the elevation stops changing comes from hillValleyField.  The path
+ * is still followed for shaded/unshaded cells, with the same arithmetic, so
+ * the results are identical.
+ */
+void cellDiurnal::compute_cellHillDistFromField()
+{
+    stepMultiplier = HillValleyField::stepMultiplier;
+    interp_order = AsciiGrid<double>::order1;
+    dem->get_cellIndex(xord, yord, &i, &j);
+
+    xComponent = cos(n_to_xy(aspect)*pi/180.0);
+    yComponent = sin(n_to_xy(aspect)*pi/180.0);
+    if(up_down == 1)
+    {
+        xComponent = xComponent*(-1.0);
+        yComponent = yComponent*(-1.0);
+    }
+
+    dem->get_cellPosition(i, j, &xStart, &yStart);
+    X = xStart;
+    Y = yStart;
+
+    const int steps = hillValleyField->get_steps(i, j, up_down == 1);
+    const short stopValue = (up_down == 0) ? shade->shaded : shade->unshaded;
+    const bool checkShade = cellDist_shadeFlag &&
+            ((up_down == 0) ? shadeHasShaded : shadeHasUnshaded);
+    int stepsTaken = steps;
+
+    for(int k = 1; k <= steps; k++)
+    {
+        X = X + (stepMultiplier * xComponent * dem->get_cellSize());
+        Y = Y + (stepMultiplier * yComponent * dem->get_cellSize());
+        if(checkShade && shade->interpolateGrid(X, Y, AsciiGrid<short>::order0) == stopValue)
+        {
+            stepsTaken = k - 1;
+            break;
+        }
+    }
+    if(stepsTaken == steps)    //the step that ended the walk
+    {
+        X = X + (stepMultiplier * xComponent * dem->get_cellSize());
+        Y = Y + (stepMultiplier * yComponent * dem->get_cellSize());
+    }
+
+    //step back to last position to get distance
+    X = X - (stepMultiplier * xComponent * dem->get_cellSize());
+    Y = Y - (stepMultiplier * yComponent * dem->get_cellSize());
+
+    if(stepsTaken == steps)
+        elevOld = hillValleyField->get_endElevation(i, j, up_down == 1);
+    else if(stepsTaken == 0)
+        elevOld = (*dem)(i,j);
+    else
+    {
+        //elevation at the last step taken, computed at the same point as the walk
+        double xStep = xStart, yStep = yStart;
+        for(int k = 1; k <= stepsTaken; k++)
+        {
+            xStep = xStep + (stepMultiplier * xComponent * dem->get_cellSize());
+            yStep = yStep + (stepMultiplier * yComponent * dem->get_cellSize());
+        }
+        elevOld = dem->interpolateGrid(xStep, yStep, interp_order);
+    }
+
+    elev_change = fabs(elevOld - (*dem)(i,j));
+    hillValleyDist = std::sqrt((X - xStart)*(X - xStart) +
+                            (Y - yStart)*(Y - yStart) +
+                            (elevOld - ((*dem)(i,j)))*(elevOld - (*dem)(i,j)));
+
+    if(up_down == 1)
+        sinAlphaLocal = hillValleyField->get_sinAlphaLocal(i, j);
+}
+
 void cellDiurnal::compute_S()
 {
     if((diurnal_wind == false) || ((hillValleyDist - epsilon) < 0.0))
@@ -621,6 +740,7 @@ void cellDiurnal::compute_cell_diurnal_wind(int I, int J, double *U,
 {
     i = I;	//Set i,j of current cell
     j = J;
+    elev_change = 0.0;	//only set by compute_cellHillDist(), don't carry it over from the last cell
 
     compute_solarIntensity();
     compute_Qsw();
@@ -41,6 +41,7 @@
 #include "Aspect.h"
 #include "Slope.h"
 #include "Shade.h"
+#include "hillValleyField.h"
 #include "air.h"
 #include "solar.h"
 #include "SurfProperties.h"
@@ -50,6 +51,11 @@
 ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 Class that stores and computes the diurnal component of wind flow for
 one cell.
+
+The results for a cell only depend on the cell and the inputs, not on the
+cells computed before it, but the work variables are members, so one object
+can't be used by several threads at once.  Give each thread its own copy
+(see initialize::addDiurnal()); the DEM and shade grids are only read.
 ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 */
 class cellDiurnal
@@ -70,6 +76,10 @@ class cellDiurnal
         
         void create(Elevation const* incomingDem, Shade const* shd, Solar *solarInput);
 
+        //Use the hill top/valley bottom walks stored in field instead of walking
+        //the DEM for every cell (NULL to walk again)
+        void set_hillValleyField(HillValleyField const* field);
+
         void initialize(double& Xord, double& Yord, const double& asp,
         const double& slp, const double& cloudCover,
         const double& airTemperature, const double& WindSpeed,
@@ -99,6 +109,7 @@ class cellDiurnal
 	void compute_Qh();
 	void compute_Bl_height();
 	void compute_cellHillDist();
+	void compute_cellHillDistFromField();
 	void compute_S();
 	void compute_UVW();
 
@@ -137,6 +148,9 @@ class cellDiurnal
         //Other models (CALMET) don't do this
 	bool cellDist_shadeFlag;
 
+        HillValleyField const* hillValleyField;  //precomputed walks of dem, NULL if not used
+        bool shadeHasShaded, shadeHasUnshaded;  //does the shade grid have any cell that can stop a walk
+
         double xComponent, yComponent;
 	double X, Y, xStart, yStart;  //keeps track of current x and y coordinate along tracking path
 	double stepMultiplier;  //adjusts how far each step upslope or downslope is along tracking path
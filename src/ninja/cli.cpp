@@ -215,6 +215,9 @@ int windNinjaCLI(int argc, char* argv[])
         po::options_description config("Simulation options");
         config.add_options()
                 ("num_threads", po::value<int>()->default_value(1), "number of threads to use during simulation")
+                ("warm_start_solver", po::value<bool>()->default_value(false), "run a time series in order, starting each solve from the previous time step's solution (true, false)")
+                ("batch_solve", po::value<bool>()->default_value(false), "solve the equations of runs on the same mesh together, sharing the matrix products (true, false)")
+                ("output_cube", po::value<std::string>()->default_value("none"), "write the speed, direction and cloud cover grids of all runs in one multi-band file per variable (none, gtiff, netcdf)")
                 ("elevation_file", po::value<std::string>(), "input elevation path/filename (*.asc, *.lcp, *.tif, *.img)")
                 ("fetch_elevation", po::value<std::string>(), "download an elevation file from an internet server and save to path/filename")
                 ("north", po::value<double>(), "north extent of elevation file bounding box to download")
@@ -303,6 +306,9 @@ int windNinjaCLI(int argc, char* argv[])
                 ("ascii_out_resolution", po::value<double>()->default_value(-1.0), "resolution of ascii fire behavior output files (-1 to use mesh resolution)")
                 ("units_ascii_out_resolution", po::value<std::string>()->default_value("m"), "units of ascii fire behavior output file resolution (ft, m)")
                 ("write_vtk_output", po::value<bool>()->default_value(false), "write VTK output file (true, false)")
+                ("vtk_out_format", po::value<std::string>()->default_value("ascii"), "format of VTK output files (ascii, binary, vts)")
+                ("vtk_out_float32", po::value<bool>()->default_value(false), "write vts output data as 32 bit floats (true, default:false)")
+                ("vtk_out_compress", po::value<bool>()->default_value(false), "zlib compress vts output data (true, default:false)")
                 ("write_farsite_atm", po::value<bool>()->default_value(false), "write a FARSITE atm file (true, false)")
                 ("write_pdf_output", po::value<bool>()->default_value(false), "write PDF output file (true, false)")
                 ("pdf_out_resolution", po::value<double>()->default_value(-1.0), "resolution of pdf output file (-1 to use mesh resolution)")
@@ -1846,6 +1852,8 @@ int windNinjaCLI(int argc, char* argv[])
             if(vm["write_vtk_output"].as<bool>())
             {
                 windsim.setVtkOutFlag( i_, true );
+                windsim.setVtkWriteFormat( i_, vm["vtk_out_format"].as<std::string>(),
+                        vm["vtk_out_float32"].as<bool>(), vm["vtk_out_compress"].as<bool>() );
             }
             if(vm["write_pdf_output"].as<bool>())
             {
@@ -1932,6 +1940,10 @@ int windNinjaCLI(int argc, char* argv[])
             }
         }
 
+        windsim.set_warmStartSolver(vm["warm_start_solver"].as<bool>());
+        windsim.set_batchSolve(vm["batch_solve"].as<bool>());
+        windsim.set_outputCubeFormat(vm["output_cube"].as<std::string>());
+
         //run the simulations
         if(!windsim.startRuns(vm["num_threads"].as<int>()))
         {
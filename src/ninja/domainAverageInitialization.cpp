@@ -51,7 +51,7 @@ void domainAverageInitialization::initializeFields(WindNinjaInputs &input,
 
     setInitializationGrids(input);
 
-    initializeWindToZero(mesh, u0, v0, w0);
+    initializeWindToZero(mesh, u0, v0, w0, input.numberCPUs);
 
     initializeBoundaryLayer(input);
 
@@ -160,7 +160,7 @@ void domainAverageInitialization::initializeBoundaryLayer(WindNinjaInputs& input
                 f = 1e-8;	//if latitude is zero, set f small
 
             //compute neutral ABL height
-#pragma omp parallel for default(shared) private(i,j)
+#pragma omp parallel for default(shared) private(i,j) num_threads(input.numberCPUs)
             for(i=0;i<input.dem.get_nRows();i++)
             {
                 for(j=0;j<input.dem.get_nCols();j++)
@@ -0,0 +1,145 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Mesh and matrix structure shared by the runs of an army
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include "domainCache.h"
+
+/**
+ * @brief Build the cache from a mesh that has been built with Mesh::buildStandardMesh().
+ *
+ * @param mesh Built mesh, its coordinates are copied.
+ * @param withQuadratureGeometry Also build the quadrature point geometry tables.
+ * @param numThreads Number of threads building the quadrature point tables.
+ */
+DomainCache::DomainCache(const Mesh &mesh, bool withQuadratureGeometry, int numThreads)
+    : mesh_(mesh)
+{
+    row_ptr_.resize(mesh_.NUMNP + 1);
+    col_ind_.resize(countNonZero(mesh_));
+    buildStructure(mesh_, &row_ptr_[0], &col_ind_[0]);
+
+    //built from the copy, so it matches the meshes sharing its coordinates
+    if(withQuadratureGeometry)
+        quadGeometry_.reset(new QuadratureGeometry(mesh_, numThreads));
+}
+
+DomainCache::~DomainCache()
+{
+}
+
+/**
+ * @brief Check if the matrix structure can be used for a mesh.
+ *
+ * The structure only depends on the number of nodes in each direction.
+ *
+ * @param mesh Mesh of the run.
+ * @return true if get_row_ptr() and get_col_ind() can be used for mesh.
+ */
+bool DomainCache::hasStructure(const Mesh &mesh) const
+{
+    return mesh.nrows == mesh_.nrows && mesh.ncols == mesh_.ncols &&
+           mesh.nlayers == mesh_.nlayers;
+}
+
+/**
+ * @brief Memory used by the cache, in bytes.
+ */
+size_t DomainCache::get_bytes() const
+{
+    return 3 * (size_t)mesh_.NUMNP * sizeof(double) +
+           (row_ptr_.size() + col_ind_.size()) * sizeof(int) +
+           (quadGeometry_ ? quadGeometry_->get_bytes() : 0);
+}
+
+/**
+ * @brief Number of entries stored in the upper triangle of the stiffness matrix.
+ *
+ * Each node is connected to the nodes in the 3x3x3 block around it, only the
+ * ones with a column number >= the row number are stored.
+ *
+ * @param mesh Mesh to count for.
+ * @return Number of stored entries (length of col_ind).
+ */
+int DomainCache::countNonZero(const Mesh &mesh)
+{
+    //in each direction a node has 3 neighbors (including itself), 2 on the edges
+    const long long rows = 3LL*mesh.nrows - 2, cols = 3LL*mesh.ncols - 2, layers = 3LL*mesh.nlayers - 2;
+    const long long full = rows * cols * layers;    //all connections, both triangles
+
+    return (int)((full - mesh.NUMNP) / 2 + mesh.NUMNP);
+}
+
+/**
+ * @brief Build the compressed row storage structure of the upper triangle of
+ * the stiffness matrix.
+ *
+ * Nodes are numbered k*nrows*ncols + i*ncols + j.  The columns of each row are
+ * in increasing order, so the diagonal is the first entry of each row.
+ *
+ * @param mesh Mesh to build for.
+ * @param row_ptr Array of NUMNP+1 values, filled with the start of each row.
+ * @param col_ind Array of countNonZero(mesh) values, filled with the column numbers.
+ */
+void DomainCache::buildStructure(const Mesh &mesh, int *row_ptr, int *col_ind)
+{
+    const int nrows = mesh.nrows, ncols = mesh.ncols, nlayers = mesh.nlayers;
+    const int nxy = nrows*ncols;
+    int i, j, k, ii, jj, kk, row, col;
+    int pos = 0;
+
+    for(k=0;k<nlayers;k++)
+    {
+        for(i=0;i<nrows;i++)
+        {
+            for(j=0;j<ncols;j++)
+            {
+                row = k*nxy + i*ncols + j;
+                row_ptr[row] = pos;
+                for(kk=-1;kk<2;kk++)
+                {
+                    if(k+kk < 0 || k+kk > nlayers-1)
+                        continue;
+                    for(ii=-1;ii<2;ii++)
+                    {
+                        if(i+ii < 0 || i+ii > nrows-1)
+                            continue;
+                        for(jj=-1;jj<2;jj++)
+                        {
+                            if(j+jj < 0 || j+jj > ncols-1)
+                                continue;
+                            col = (k+kk)*nxy + (i+ii)*ncols + (j+jj);
+                            if(col >= row)  //only the upper triangle is stored
+                                col_ind[pos++] = col;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    row_ptr[mesh.NUMNP] = pos;
+}
@@ -0,0 +1,86 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Mesh and matrix structure shared by the runs of an army
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef DOMAIN_CACHE_H
+#define DOMAIN_CACHE_H
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "mesh.h"
+#include "quadratureGeometry.h"
+
+/**
+ * @brief Data that only depends on the DEM and the mesh settings, built once
+ * and shared (read only) by all of the runs in a ninjaArmy.
+ *
+ * Holds:
+ *   - the mesh node coordinates.  Runs on the same mesh share the XORD, YORD
+ *     and ZORD memory through Mesh::buildStandardMesh(input, &get_mesh()).
+ *   - the compressed row storage structure (row_ptr and col_ind) of the
+ *     symmetric stiffness matrix built in ninja::discretize().
+ *   - optionally, the quadrature point geometry tables of the mesh (see
+ *     QuadratureGeometry).
+ *
+ * The object is not changed after it is built, so it can be used by runs on
+ * different threads at the same time.  It is passed around in a
+ * boost::shared_ptr and freed with the last run using it.  With
+ * NINJA_ARMY_DOMAIN_CACHE=NO every run builds its own mesh and structure.
+ */
+class DomainCache
+{
+public:
+    DomainCache(const Mesh &mesh, bool withQuadratureGeometry = false, int numThreads = 1);
+    ~DomainCache();
+
+    const Mesh &get_mesh() const { return mesh_; }
+
+    bool hasStructure(const Mesh &mesh) const;
+    int *get_row_ptr() const { return const_cast<int*>(&row_ptr_[0]); }   //the solver takes int*, but nothing is written
+    int *get_col_ind() const { return const_cast<int*>(&col_ind_[0]); }
+    int get_numNonZero() const { return (int)col_ind_.size(); }
+    boost::shared_ptr<const QuadratureGeometry> get_quadratureGeometry() const { return quadGeometry_; }
+
+    size_t get_bytes() const;
+
+    static int countNonZero(const Mesh &mesh);
+    static void buildStructure(const Mesh &mesh, int *row_ptr, int *col_ind);
+
+private:
+    Mesh mesh_;
+    std::vector<int> row_ptr_;
+    std::vector<int> col_ind_;
+    boost::shared_ptr<const QuadratureGeometry> quadGeometry_;
+
+    DomainCache(const DomainCache &rhs);
+    DomainCache &operator=(const DomainCache &rhs);
+};
+
+#endif	//DOMAIN_CACHE_H
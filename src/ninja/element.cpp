@@ -28,6 +28,69 @@
  *****************************************************************************/
 
 #include "element.h"
+#include "quadratureGeometry.h"
+
+#include <cmath>
+#include <exception>
+
+/*
+** Index of the first node n in [1, nNodes) with value <= coord(n), less one,
+** or -1 if there isn't one.  This is the cell the linear scans over the mesh
+** rows, columns and layers used to find.  coord() must be increasing.  The
+** cell a uniform spacing gives is checked first, which is the answer on the
+** horizontal axes of a WindNinja mesh, then it falls back to a binary search.
+*/
+template <class Coord>
+static int findCell(double const& value, int nNodes, Coord const& coord)
+{
+    if(nNodes < 2 || !(value <= coord(nNodes - 1)))
+        return -1;
+
+    const double first = coord(0);
+    const double spacing = (coord(nNodes - 1) - first) / (nNodes - 1);
+    if(spacing > 0.0)
+    {
+        double guess = std::ceil((value - first) / spacing);
+        int n = guess < 1.0 ? 1 : (guess > nNodes - 1 ? nNodes - 1 : (int)guess);
+        if(value <= coord(n) && (n == 1 || value > coord(n - 1)))
+            return n - 1;
+    }
+
+    int lo = 1;
+    int hi = nNodes - 1;
+    while(lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if(value <= coord(mid))
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo - 1;
+}
+
+struct RowCoord
+{
+    Mesh const* mesh;
+    double operator()(int n) const { return mesh->YORD(n, 0, 0); }
+};
+
+struct ColCoord
+{
+    Mesh const* mesh;
+    double operator()(int n) const { return mesh->XORD(0, n, 0); }
+};
+
+//height of a layer, averaged over the four corners of column (i, j)
+struct LayerCoord
+{
+    Mesh const* mesh;
+    int i, j;
+    double operator()(int k) const
+    {
+        return (mesh->ZORD(i, j, k) + mesh->ZORD(i, j+1, k) + mesh->ZORD(i+1, j, k) + mesh->ZORD(i+1, j+1, k)) / 4.0;
+    }
+};
 
 element::element(Mesh const* m)
 {
@@ -45,6 +108,7 @@ element::element(Mesh const* m)
 	DNDZ=NULL;
 	RJACV=NULL;
 	RJACVI=NULL;
+	geometry_=NULL;
 }
 
 element::~element()
@@ -208,6 +272,21 @@ void element::initializeQuadPtArrays()
      }
 }
 
+/**
+ * @brief Use precomputed quadrature point geometry.
+ *
+ * computeJacobianQuadraturePoint() then copies DETJ, DNDX, DNDY, DNDZ (and x, y, z)
+ * from the tables instead of computing them.  RJACV and RJACVI are not set.
+ *
+ * @param g Tables built for the mesh of this element, or NULL to compute the values.
+ */
+void element::set_geometry(QuadratureGeometry const* g)
+{
+	if(g != NULL && (g->get_numQuadPts() != NUMQPTV || g->get_numNodesPerElem() != mesh_->NNPE))
+		throw std::logic_error("Quadrature geometry tables don't match the element.");
+	geometry_ = g;
+}
+
 //element::element(const element &e)	// Copy constructor
 //{
 //
@@ -317,6 +396,16 @@ void element::computeJacobianQuadraturePoint(const int &localQuadPointNum, const
 	//Given localQuadPointNum and elementNum, function computes the Jacobian, inverse Jacobian, determinant of the Jacobian, and (x,y,z)
 	if(SFV == NULL)
 		initializeQuadPtArrays();
+
+	if(geometry_ != NULL)
+	{
+		const size_t p = (size_t)elementNum*NUMQPTV + localQuadPointNum;
+		x = geometry_->XJ[p];
+		y = geometry_->YJ[p];
+		z = geometry_->ZJ[p];
+		loadGeometry(p);
+		return;
+	}
 	
 	x=0.0;
     y=0.0;
@@ -380,6 +469,12 @@ void element::computeJacobianQuadraturePoint(const int &localQuadPointNum, const
 	//Given localQuadPointNum and elementNum, function computes the Jacobian, inverse Jacobian, determinant of the Jacobian, and (x,y,z)
 	if(SFV == NULL)
 		initializeQuadPtArrays();
+
+	if(geometry_ != NULL)
+	{
+		loadGeometry((size_t)elementNum*NUMQPTV + localQuadPointNum);
+		return;
+	}
 	
 	//x=0.0;
     //y=0.0;
@@ -437,6 +532,20 @@ void element::computeJacobianQuadraturePoint(const int &localQuadPointNum, const
 	}
 }
 
+void element::loadGeometry(const size_t &quadPt)
+{
+	//Copy DETJ and dN/dx, dN/dy, dN/dz of quadrature point quadPt from the precomputed tables
+	const size_t n = quadPt*mesh_->NNPE;
+
+	DETJ = geometry_->DETJ[quadPt];
+	for(int k=0;k<mesh_->NNPE;k++)
+	{
+		DNDX[k] = geometry_->DNDX[n+k];
+		DNDY[k] = geometry_->DNDY[n+k];
+		DNDZ[k] = geometry_->DNDZ[n+k];
+	}
+}
+
 //void element::computeElementStiffnessMatrix(const int &elementNum, const wn_3dScalarField &u0, const wn_3dScalarField &v0, const wn_3dScalarField &w0, const double &alpha)
 //{	
 //	//Given the above parameters, function computes the element stiffness matrix
@@ -702,29 +811,10 @@ double element::interpolate_z(double const& x, double const& y, double const& la
     cell_i = -1;
     cell_j = -1;
 
-    //compute cell i value
-    for(node_i=1; node_i<mesh_->nrows; node_i++)
-    {
-        if(y <= mesh_->YORD(node_i, 0, 0))
-        {
-            cell_i = node_i - 1;
-            break;
-        }
-    }
-    if(cell_i<0)
-        throw std::range_error("Range error in element::interpolate_xy()");
-
-    //compute cell j value
-    for(node_j=1; node_j<mesh_->ncols; node_j++)
-    {
-        if(x <= mesh_->XORD(0, node_j, 0))
-        {
-            cell_j = node_j - 1;
-            break;
-        }
-    }
-    if(cell_j<0)
-        throw std::range_error("Range error in element::interpolate_xy()");
+    //compute cell i and j values
+    locateCell_ij(x, y, cell_i, cell_j, "Range error in element::interpolate_xy()");
+    node_i = cell_i + 1;
+    node_j = cell_j + 1;
 
     answer = (mesh_->ZORD(node_i-1, node_j-1, node_k) +
               mesh_->ZORD(node_i-1, node_j, node_k) +
@@ -750,36 +840,7 @@ double element::interpolate_z(double const& x, double const& y, double const& la
 void element::get_ij(double const& x,double const& y,
                       int& cell_i, int& cell_j)
 {
-    int node_i, node_j;
-
-    //initialize cell values
-    cell_i = -1;
-    cell_j = -1;
-
-    //compute cell i value
-    for(node_i=1; node_i<mesh_->nrows; node_i++)
-    {
-        if(y <= mesh_->YORD(node_i, 0, 0))
-        {
-            cell_i = node_i - 1;
-            break;
-        }
-    }
-    if(cell_i<0)
-        throw std::range_error("Range error in element::get_ij()");
-
-    //compute cell j value
-    for(node_j=1; node_j<mesh_->ncols; node_j++)
-    {
-        if(x <= mesh_->XORD(0, node_j, 0))
-        {
-            cell_j = node_j - 1;
-            break;
-        }
-    }
-    if(cell_j<0)
-        throw std::range_error("Range error in element::get_ij()");
-
+    locateCell_ij(x, y, cell_i, cell_j, "Range error in element::get_ij()");
 }                  
 
 void element::get_uv(double const& x,double const& y,
@@ -787,37 +848,8 @@ void element::get_uv(double const& x,double const& y,
                      double& u, double &v)	//Given (x,y), this function locates the cell (i,j) that the point is in AND 
 	                                                //    the internal "parent" local cell coordinates (u,v) 
 {
-	int node_i, node_j;
-
-	//initialize cell values
-	cell_i = -1;
-	cell_j = -1;
-
-	//compute cell i value
-	for(node_i=1; node_i<mesh_->nrows; node_i++)
-	{
-		if(y <= mesh_->YORD(node_i, 0, 0))
-		//if(y < mesh_->YORD(node_i, 0, 0))
-		{
-			cell_i = node_i - 1;
-			break;
-		}
-	}
-	if(cell_i<0)
-		throw std::range_error("Range error in element::get_uv()");
-
-	//compute cell j value
-	for(node_j=1; node_j<mesh_->ncols; node_j++)
-	{
-		if(x <= mesh_->XORD(0, node_j, 0))
-		//if(x < mesh_->XORD(0, node_j, 0))
-		{
-			cell_j = node_j - 1;
-			break;
-		}
-	}
-	if(cell_j<0)
-		throw std::range_error("Range error in element::get_uv()");
+	//compute cell i and j values
+	locateCell_ij(x, y, cell_i, cell_j, "Range error in element::get_uv()");
 
 	
 	interpLocalCoords_xy(x, y, cell_i, cell_j, u, v);
@@ -859,56 +891,11 @@ void element::get_uvw(double const& x,double const& y, double const& z,
 	                                                //    the internal "parent" local cell coordinates (u,v,w) for use in interpolation in
 	                                                //    functions such as wn_3dScalarField::interpolate().
 {
-	int node_i, node_j, node_k;
-	double zAverage, zAverage_ground;
-
-	//initialize cell values
-	cell_i = -1;
-	cell_j = -1;
-	cell_k = -1;
-
-	//compute cell i value
-	for(node_i=1; node_i<mesh_->nrows; node_i++)
-	{
-		if(y <= mesh_->YORD(node_i, 0, 0))
-		//if(y < mesh_->YORD(node_i, 0, 0))
-		{
-			cell_i = node_i - 1;
-			break;
-		}
-	}
-	if(cell_i<0)
-		throw std::range_error("Range error in element::get_uvw()");
-
-	//compute cell j value
-	for(node_j=1; node_j<mesh_->ncols; node_j++)
-	{
-		if(x <= mesh_->XORD(0, node_j, 0))
-		//if(x < mesh_->XORD(0, node_j, 0))
-		{
-			cell_j = node_j - 1;
-			break;
-		}
-	}
-	if(cell_j<0)
-		throw std::range_error("Range error in element::get_uvw()");
+	//compute cell i, j and k values (k estimated using the average of the 4 points surrounding)
+	locateCell_ij(x, y, cell_i, cell_j, "Range error in element::get_uvw()");
+	LayerCoord layers = {mesh_, cell_i, cell_j};
+	cell_k = findCell(z, mesh_->nlayers, layers);
 
-	//compute cell k value (estimate using average of 4 points surrounding)
-	for(node_k=1; node_k<mesh_->nlayers; node_k++)
-	{	    
-		zAverage = (mesh_->ZORD(node_i-1, node_j-1, node_k) + mesh_->ZORD(node_i-1, node_j, node_k) + mesh_->ZORD(node_i, node_j-1, node_k) + mesh_->ZORD(node_i, node_j, node_k)) / 4.0; 
-		//zAverage_ground = (mesh_->ZORD(node_i-1, node_j-1, 0) + mesh_->ZORD(node_i-1, node_j, 0) + mesh_->ZORD(node_i, node_j-1, 0) + mesh_->ZORD(node_i, node_j, 0)) / 4.0; 
-
-		
-		if(z <= zAverage)
-		//if(z < zAverage)
-		{
-			cell_k = node_k - 1;
-			break;
-		}
-	}
-	
-			
 	if(cell_k<0)
 		throw std::range_error("Range error in element::get_uvw()");
 	
@@ -963,87 +950,82 @@ void element::get_uvw(double const& x,double const& y, double const& z,
 	                                                //    the internal "parent" local cell coordinates (u,v,w) for use in interpolation in
 	                                                //    functions such as wn_3dScalarField::interpolate().
 {
-	int node_i, node_j, node_k;
 	int cell_i, cell_j, cell_k;
-	double zAverage;
+	get_uvw(x, y, z, cell_i, cell_j, cell_k, u, v, w);
+}
 
-	//compute cell i value
-	for(node_i=1; node_i<mesh_->nrows; node_i++)
-	{
-		if(y <= mesh_->YORD(node_i, 0, 0))
-		//if(y < mesh_->YORD(node_i, 0, 0))
-		{
-			cell_i = node_i - 1;
-			break;
-		}
-	}
-	//compute cell j value
-	for(node_j=1; node_j<mesh_->ncols; node_j++)
-	{
-		if(x <= mesh_->XORD(0, node_j, 0))
-		//if(x < mesh_->XORD(0, node_j, 0))
-		{
-			cell_j = node_j - 1;
-			break;
-		}
-	}
-	//compute cell k value (estimate using average of 4 points surrounding)
-	for(node_k=1; node_k<mesh_->nlayers; node_k++)
-	{
-		zAverage = (mesh_->ZORD(node_i-1, node_j-1, node_k) + mesh_->ZORD(node_i-1, node_j, node_k) + mesh_->ZORD(node_i, node_j-1, node_k) + mesh_->ZORD(node_i, node_j, node_k)) / 4.0; 
-		if(z <= zAverage)
-		//if(z < zAverage)
-		{
-			cell_k = node_k - 1;
-			break;
-		}
-	}
-	
-	interpLocalCoords(x, y, z, cell_i, cell_j, cell_k, u, v, w);
+/**
+ * @brief Locate many points at once, see the single point get_uvw().
+ *
+ * The points are spread over numThreads threads, each using its own element since
+ * the local coordinate iteration works in the element's Jacobian arrays.
+ *
+ * @param nPoints Number of points.
+ * @param x,y,z Point coordinates, in WN coordinates.
+ * @param cell_i,cell_j,cell_k Filled with the cell holding each point, -1 for
+ * points outside of the mesh.
+ * @param u,v,w Filled with the local "parent" cell coordinates of each point.
+ * @param numThreads Number of threads locating the points.
+ * @throws std::range_error if a point is outside of the mesh, after all of the
+ * other points are located.
+ */
+void element::get_uvw(int nPoints, double const* x, double const* y, double const* z,
+                      int* cell_i, int* cell_j, int* cell_k,
+                      double* u, double* v, double* w, int numThreads)
+{
+    bool outOfMesh = false;
+    std::exception_ptr error;
 
-	
-    if(u > 1.0)
-	{
-        do{
-		    cell_j++;
-		    interpLocalCoords(x, y, z, cell_i, cell_j, cell_k, u, v, w);
-        }while(u > 1.0);
-	}
-	if(v > 1.0)
-	{
-        do{
-		    cell_i++;
-		    interpLocalCoords(x, y, z, cell_i, cell_j, cell_k, u, v, w);
-        }while(v > 1.0);
-	}
-	if(w > 1.0)
-	{
-        do{
-		    cell_k++;
-		    interpLocalCoords(x, y, z, cell_i, cell_j, cell_k, u, v, w);
-        }while(w > 1.0);
-	}
-	if(u < -1.0)
-	{
-        do{
-		    cell_j--;
-		    interpLocalCoords(x, y, z, cell_i, cell_j, cell_k, u, v, w);
-        }while(u < -1.0);
-	}
-	if(v < -1.0)
-	{
-        do{
-		    cell_i--;
-		    interpLocalCoords(x, y, z, cell_i, cell_j, cell_k, u, v, w);
-        }while(v < -1.0);
-	}
-	if(w < -1.0)
-	{
-        do{
-            cell_k--;
-		    interpLocalCoords(x, y, z, cell_i, cell_j, cell_k, u, v, w);
-        }while(w < -1.0);
-	}
+    #pragma omp parallel num_threads(numThreads)
+    {
+        element threadElem(mesh_);
+        int n;
+        #pragma omp for schedule(dynamic, 16)
+        for(n = 0; n < nPoints; n++)
+        {
+            try
+            {
+                threadElem.get_uvw(x[n], y[n], z[n], cell_i[n], cell_j[n], cell_k[n], u[n], v[n], w[n]);
+            }
+            catch(std::range_error &)
+            {
+                cell_i[n] = cell_j[n] = cell_k[n] = -1;
+                #pragma omp critical(elementLocate)
+                outOfMesh = true;
+            }
+            catch(...)
+            {
+                #pragma omp critical(elementLocate)
+                {
+                    if(!error)
+                        error = std::current_exception();
+                }
+            }
+        }
+    }
+    if(error)
+        std::rethrow_exception(error);
+    if(outOfMesh)
+        throw std::range_error("Range error in element::get_uvw()");
+}
+
+/*
+** Cell (i, j) holding (x, y), found from the uniform horizontal spacing of the
+** mesh instead of scanning the rows and columns.
+*/
+void element::locateCell_ij(double const& x, double const& y, int& cell_i, int& cell_j,
+                            const char *rangeError) const
+{
+    RowCoord rows = {mesh_};
+    ColCoord cols = {mesh_};
+
+    cell_i = findCell(y, mesh_->nrows, rows);
+    if(cell_i<0)
+        throw std::range_error(rangeError);
+
+    cell_j = findCell(x, mesh_->ncols, cols);
+    if(cell_j<0)
+        throw std::range_error(rangeError);
 }
 
 void element::interpLocalCoords_xy(const double &x,const double &y,
@@ -34,6 +34,7 @@
 #include "mesh.h"
 
 class Mesh;
+class QuadratureGeometry;
 class element
 {
 	public:
@@ -47,6 +48,7 @@ class element
 		void deallocate();
 
 		void initializeQuadPtArrays();
+		void set_geometry(QuadratureGeometry const* g);	//read DETJ, DNDX, ... from precomputed tables instead of computing them
 
 		void get_xyz(const int &elementNum, const double &u, const double &v, const double &w, double &x, double &y, double &z);
 		void computeJacobianEtc(int &elementNum, const double &u, const double &v, const double &w, double &x, double &y, double &z);
@@ -71,6 +73,9 @@ class element
 		         double& u, double &v, double& w);	//Given (x,y,z), this function locates the cell (i,j,k) that the point is in AND
 	                                                //    the internal "parent" local cell coordinates (u,v,w) for use in interpolation in
 	                                                //    functions such as wn_3dScalarField::interpolate().
+		void get_uvw(int nPoints, double const* x, double const* y, double const* z,
+		         int* cell_i, int* cell_j, int* cell_k,
+				 double* u, double* v, double* w, int numThreads);	//get_uvw() for nPoints points at once, on numThreads threads
 
 		double SFNV(const double &u, const double &v, const double &w, const int &n);
 
@@ -99,6 +104,11 @@ class element
 	private:
 
 		double iterativeInterpTol;
+		QuadratureGeometry const* geometry_;	//precomputed quadrature point geometry, or NULL
+
+		void loadGeometry(const size_t &quadPt);
+		void locateCell_ij(double const& x, double const& y, int& cell_i, int& cell_j,
+		                   const char *rangeError) const;	//throws std::range_error(rangeError) outside of the mesh
 
 	    double SFNVu(const double &u, const double &v, const double &w, const int &n);
 	    double SFNVv(const double &u, const double &v, const double &w, const int &n);
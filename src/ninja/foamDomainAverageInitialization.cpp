@@ -53,7 +53,7 @@ void foamDomainAverageInitialization::initializeFields(WindNinjaInputs &input,
     
     setInitializationGrids(input);
 
-    initializeWindToZero(mesh, u0, v0, w0);
+    initializeWindToZero(mesh, u0, v0, w0, input.numberCPUs);
 
     initializeBoundaryLayer(input);
     
@@ -0,0 +1,208 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Forecast bands warped once and shared by the runs of an army
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include "forecastCache.h"
+
+#include "cpl_conv.h"
+#include "cpl_string.h"
+
+#ifdef _OPENMP
+#include "omp_guard.h"
+#endif
+
+bool ForecastCache::Key::operator<(Key const& rhs) const
+{
+    if(srcName != rhs.srcName)
+        return srcName < rhs.srcName;
+    if(srcWkt != rhs.srcWkt)
+        return srcWkt < rhs.srcWkt;
+    return dstWkt < rhs.dstWkt;
+}
+
+ForecastCache::Entry::Entry()
+    : ready(false)
+    , nXSize(0)
+    , nYSize(0)
+    , nBands(0)
+{
+#ifdef _OPENMP
+    omp_init_lock(&lock);
+#endif
+}
+
+ForecastCache::Entry::~Entry()
+{
+#ifdef _OPENMP
+    omp_destroy_lock(&lock);
+#endif
+}
+
+ForecastCache::ForecastCache()
+{
+}
+
+ForecastCache::~ForecastCache()
+{
+    for(std::map<Key, Entry*>::iterator it = entries_.begin(); it != entries_.end(); ++it)
+        delete it->second;
+}
+
+/**
+ * @brief Get the bands of a forecast variable warped to dstWkt.
+ *
+ * The first call for a (srcName, srcWkt, dstWkt) warps srcDS with
+ * psWarpOptions, the same way GDALAutoCreateWarpedVRT() is used by the
+ * wxModelInitialization classes.  Later calls don't use srcDS or
+ * psWarpOptions.
+ *
+ * @param srcName Name srcDS was opened with, e.g. NETCDF:"file":variable.
+ * @param srcDS Opened source dataset.
+ * @param srcWkt Projection of the source.
+ * @param dstWkt Projection to warp to.
+ * @param psWarpOptions Options for the warped VRT, not taken over.
+ * @return An in-memory dataset with the warped bands, to be closed with
+ * GDALClose() by the caller, or NULL if the source couldn't be warped.
+ */
+GDALDataset *ForecastCache::warp(std::string const& srcName, GDALDataset *srcDS,
+                                 std::string const& srcWkt, std::string const& dstWkt,
+                                 GDALWarpOptions *psWarpOptions)
+{
+    Key key;
+    key.srcName = srcName;
+    key.srcWkt = srcWkt;
+    key.dstWkt = dstWkt;
+
+    Entry *entry = NULL;
+    #pragma omp critical(forecastCache)
+    {
+        Entry *&slot = entries_[key];
+        if(slot == NULL)
+            slot = new Entry();
+        entry = slot;
+    }
+
+#ifdef _OPENMP
+    omp_guard guard(entry->lock);
+#endif
+    if(!entry->ready)
+    {
+        if(!load(*entry, srcDS, srcWkt, dstWkt, psWarpOptions))
+            return NULL;
+        CPLDebug("NINJA", "Forecast cache: %s warped once, %d bands", srcName.c_str(), entry->nBands);
+    }
+    return createView(*entry);
+}
+
+/**
+ * @brief Memory used by the warped bands, in bytes.
+ */
+size_t ForecastCache::get_bytes()
+{
+    size_t bytes = 0;
+    #pragma omp critical(forecastCache)
+    {
+        for(std::map<Key, Entry*>::iterator it = entries_.begin(); it != entries_.end(); ++it)
+            bytes += it->second->values.size() * sizeof(double);
+    }
+    return bytes;
+}
+
+bool ForecastCache::load(Entry &entry, GDALDataset *srcDS, std::string const& srcWkt,
+                         std::string const& dstWkt, GDALWarpOptions *psWarpOptions)
+{
+    if(srcDS == NULL)
+        return false;
+
+    GDALDatasetH hWrpDS = GDALAutoCreateWarpedVRT((GDALDatasetH)srcDS, srcWkt.c_str(),
+                                                  dstWkt.c_str(), GRA_NearestNeighbour,
+                                                  1.0, psWarpOptions);
+    if(hWrpDS == NULL)
+        return false;
+
+    const int nXSize = GDALGetRasterXSize(hWrpDS);
+    const int nYSize = GDALGetRasterYSize(hWrpDS);
+    const int nBands = GDALGetRasterCount(hWrpDS);
+    std::vector<double> values((size_t)nXSize * nYSize * nBands);
+
+    //all of the bands in one request, so each block of the source is warped once
+    CPLErr eErr = CE_None;
+    if(!values.empty())
+        eErr = GDALDatasetRasterIO(hWrpDS, GF_Read, 0, 0, nXSize, nYSize, &values[0],
+                                   nXSize, nYSize, GDT_Float64, nBands, NULL, 0, 0, 0);
+    if(eErr != CE_None)
+    {
+        GDALClose(hWrpDS);
+        return false;
+    }
+
+    entry.nXSize = nXSize;
+    entry.nYSize = nYSize;
+    entry.nBands = nBands;
+    GDALGetGeoTransform(hWrpDS, entry.adfGeoTransform);
+    entry.projection = GDALGetProjectionRef(hWrpDS);
+    entry.hasNoData.resize(nBands);
+    entry.noData.resize(nBands);
+    for(int b = 0; b < nBands; b++)
+    {
+        GDALRasterBandH hBand = GDALGetRasterBand(hWrpDS, b + 1);
+        entry.noData[b] = GDALGetRasterNoDataValue(hBand, &entry.hasNoData[b]);
+    }
+    entry.values.swap(values);
+    entry.ready = true;
+
+    GDALClose(hWrpDS);
+    return true;
+}
+
+/*
+** A MEM dataset per caller over the shared values, so no GDAL handle is used
+** by two threads.  The values aren't written through it.
+*/
+GDALDataset *ForecastCache::createView(Entry &entry)
+{
+    GDALDriverH hDriver = GDALGetDriverByName("MEM");
+    GDALDatasetH hDS = GDALCreate(hDriver, "", entry.nXSize, entry.nYSize, 0, GDT_Float64, NULL);
+    if(hDS == NULL)
+        return NULL;
+
+    const size_t bandSize = (size_t)entry.nXSize * entry.nYSize;
+    for(int b = 0; b < entry.nBands; b++)
+    {
+        char szPointer[64];
+        szPointer[CPLPrintPointer(szPointer, &entry.values[b * bandSize], sizeof(szPointer))] = '\0';
+        char **papszOptions = CSLSetNameValue(NULL, "DATAPOINTER", szPointer);
+        GDALAddBand(hDS, GDT_Float64, papszOptions);
+        CSLDestroy(papszOptions);
+        if(entry.hasNoData[b])
+            GDALSetRasterNoDataValue(GDALGetRasterBand(hDS, b + 1), entry.noData[b]);
+    }
+    GDALSetGeoTransform(hDS, entry.adfGeoTransform);
+    GDALSetProjection(hDS, entry.projection.c_str());
+    return (GDALDataset*)hDS;
+}
@@ -0,0 +1,119 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Forecast bands warped once and shared by the runs of an army
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef FORECAST_CACHE_H
+#define FORECAST_CACHE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "gdal_priv.h"
+#include "gdalwarper.h"
+
+/**
+ * @brief Forecast variables warped to the DEM projection, decoded once for all
+ * of the runs of a weather model army.
+ *
+ * Each time step of a forecast is a run of its own, and each run used to open
+ * the forecast, build a warped VRT and warp the bands it needs, so the same
+ * variable was decoded and reprojected once per time step.  warp() does it the
+ * first time a (source, projection) pair is asked for, reading every band of
+ * the warped VRT into memory.  Every call, the first one included, then gets
+ * an in-memory dataset over those values that can be read with
+ * GDAL2AsciiGrid() like the warped VRT it replaces.
+ *
+ * warp() can be called by runs on several threads.  A run asking for a
+ * variable that another one is decoding waits for it.  The values stay in
+ * memory for the life of the cache, which is owned by ninjaArmy::startRuns().
+ *
+ * Every band of a variable is kept as doubles, including the time steps no run
+ * of the army uses: a variable takes 8 bytes per warped cell per band of the
+ * forecast file, for as long as the army runs.  get_bytes() gives the total,
+ * printed at the end of the runs with CPL_DEBUG=NINJA.
+ *
+ * Only the NAM, NAM Alaska, GFS, RAP and generic forecast initializations use
+ * it, and only when NINJA_FORECAST_CACHE is on (the default).
+ */
+class ForecastCache
+{
+public:
+    ForecastCache();
+    ~ForecastCache();
+
+    GDALDataset *warp(std::string const& srcName, GDALDataset *srcDS,
+                      std::string const& srcWkt, std::string const& dstWkt,
+                      GDALWarpOptions *psWarpOptions);
+
+    size_t get_bytes();
+
+private:
+    ForecastCache(ForecastCache const&);
+    ForecastCache &operator=(ForecastCache const&);
+
+    struct Key
+    {
+        std::string srcName;
+        std::string srcWkt;
+        std::string dstWkt;
+
+        bool operator<(Key const& rhs) const;
+    };
+
+    struct Entry
+    {
+        Entry();
+        ~Entry();
+
+        bool ready;
+        int nXSize;
+        int nYSize;
+        int nBands;
+        double adfGeoTransform[6];
+        std::string projection;
+        std::vector<double> values;     //band sequential
+        std::vector<int> hasNoData;
+        std::vector<double> noData;
+#ifdef _OPENMP
+        omp_lock_t lock;    //held while the bands are read
+#endif
+    };
+
+    static bool load(Entry &entry, GDALDataset *srcDS, std::string const& srcWkt,
+                     std::string const& dstWkt, GDALWarpOptions *psWarpOptions);
+    static GDALDataset *createView(Entry &entry);
+
+    std::map<Key, Entry*> entries_;
+};
+
+#endif /* FORECAST_CACHE_H */
@@ -448,10 +448,7 @@ void genericSurfInitialization::setSurfaceGrids( WindNinjaInputs &input,
             CSLSetNameValue( psWarpOptions->papszWarpOptions,
                             "INIT_DEST", "NO_DATA" );
 
-        wrpDS = (GDALDataset*) GDALAutoCreateWarpedVRT( srcDS, srcWkt.c_str(),
-                                                        dstWkt.c_str(),
-                                                        GRA_NearestNeighbour,
-                                                        1.0, psWarpOptions );
+        wrpDS = warpForecast( input, temp, srcDS, srcWkt, dstWkt, psWarpOptions );
 
         if( varList[i] == "Temperature_height_above_ground" ) {
             GDAL2AsciiGrid( wrpDS, bandNum, airGrid );
@@ -0,0 +1,132 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Table driven interpolation between two grids
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include "gridResampler.h"
+
+#include <algorithm>
+#include <deque>
+
+bool GridResampler::Geometry::operator==(Geometry const& rhs) const
+{
+    return nRows == rhs.nRows && nCols == rhs.nCols &&
+           xllCorner == rhs.xllCorner && yllCorner == rhs.yllCorner &&
+           cellSize == rhs.cellSize;
+}
+
+GridResampler::GridResampler(Geometry const& source, Geometry const& destination, int interpType)
+    : source_(source)
+    , destination_(destination)
+    , interpType_(interpType)
+{
+    build();
+}
+
+bool GridResampler::matches(Geometry const& source, Geometry const& destination, int interpType) const
+{
+    return interpType_ == interpType && source_ == source && destination_ == destination;
+}
+
+boost::shared_ptr<const GridResampler> GridResampler::get(Geometry const& source,
+                                                          Geometry const& destination, int interpType)
+{
+    //a handful covers the grids of a forecast and the output resolutions
+    static const size_t nMaxCached = 8;
+    static std::deque<boost::shared_ptr<const GridResampler> > cache;
+
+    boost::shared_ptr<const GridResampler> resampler;
+    #pragma omp critical(gridResampler)
+    {
+        for(size_t n = 0; n < cache.size(); n++)
+        {
+            if(cache[n]->matches(source, destination, interpType))
+            {
+                resampler = cache[n];
+                break;
+            }
+        }
+    }
+    if(resampler)
+        return resampler;
+
+    //built outside of the critical section, it can throw
+    resampler.reset(new GridResampler(source, destination, interpType));
+    #pragma omp critical(gridResampler)
+    {
+        cache.push_back(resampler);
+        if(cache.size() > nMaxCached)
+            cache.pop_front();
+    }
+    return resampler;
+}
+
+void GridResampler::build()
+{
+    //no cell is interpolated, so nothing can be out of the source grid
+    if(destination_.nRows == 0 || destination_.nCols == 0)
+        return;
+
+    buildAxis(destination_.nRows, destination_.yllCorner, destination_.cellSize,
+              source_.nRows, source_.yllCorner, source_.cellSize, interpType_, rows_);
+    buildAxis(destination_.nCols, destination_.xllCorner, destination_.cellSize,
+              source_.nCols, source_.xllCorner, source_.cellSize, interpType_, cols_);
+}
+
+/*
+** Same arithmetic as AsciiGrid<T>::get_cellPosition(), get_cellIndex() and
+** interpolateGrid(), one axis at a time, so the values match bit for bit.
+*/
+void GridResampler::buildAxis(int nDestination, double destinationOrigin, double destinationCellSize,
+                              int nSource, double sourceOrigin, double sourceCellSize,
+                              int interpType, std::vector<Axis> &axis)
+{
+    const double sourceDimension = sourceCellSize * nSource;
+    axis.resize(nDestination);
+    for(int n = 0; n < nDestination; n++)
+    {
+        const double coord = (destinationCellSize / 2.0) + (n * destinationCellSize) + destinationOrigin;
+        if(coord < sourceOrigin || coord > (sourceOrigin + sourceDimension))
+            throw std::range_error("Invalid cell reference in AsciiGrid<T>::get_cellIndex().");
+
+        Axis &a = axis[n];
+        a.nearest = std::min(int(long((coord - sourceOrigin) / sourceCellSize)), nSource - 1);
+        a.lower = a.nearest;
+        a.weight = 0.0;
+        a.edge = interpType != AsciiGrid<double>::order1 ||
+                 coord >= (sourceOrigin + (sourceDimension - (sourceCellSize / 2))) ||
+                 coord <= sourceOrigin + (sourceCellSize / 2);
+        if(a.edge)
+            continue;
+
+        const int i = long(((coord - sourceCellSize / 2) - sourceOrigin) / sourceCellSize);
+        a.lower = i;
+        a.weight = (coord - ((i * sourceCellSize + (sourceCellSize / 2)) + sourceOrigin)) /
+                   ((((i + 1) * sourceCellSize + (sourceCellSize / 2)) + sourceOrigin) -
+                   (((i * sourceCellSize + (sourceCellSize / 2))) + sourceOrigin));
+    }
+}
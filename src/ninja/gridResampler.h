@@ -0,0 +1,278 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Table driven interpolation between two grids
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef GRID_RESAMPLER_H
+#define GRID_RESAMPLER_H
+
+#include <vector>
+#include <stdexcept>
+
+#include <boost/shared_ptr.hpp>
+
+#include "ascii_grid.h"
+
+/**
+ * @brief Interpolation tables from one grid onto another, built once and
+ * applied to any number of fields on the same pair of grids.
+ *
+ * AsciiGrid<T>::interpolateGrid() finds the source cells and the weights of
+ * every destination cell again for every field.  Both grids are regular, so
+ * the source row and the row weight only depend on the destination row, and
+ * the column and its weight only on the destination column.  The tables keep
+ * those per row and per column, which makes them small (rows + columns
+ * entries) and cheap to build.
+ *
+ * interpolate() gives the same values as calling interpolateGrid() on each
+ * destination cell center, for order0 and order1.  Like interpolateGrid(),
+ * order2 and order3 give 0.  The rows are spread over the number of threads
+ * given by the caller, and several fields are done in the same pass over the
+ * tables.
+ *
+ * The tables are not changed after they are built, so one resampler can be
+ * used from several threads at the same time.  get() keeps the last few
+ * resamplers built, so the runs of a forecast, which interpolate the same
+ * weather model grid onto the same DEM at every time step, share one set of
+ * tables.
+ */
+class GridResampler
+{
+public:
+    template <class T>
+    GridResampler(const AsciiGrid<T> &source, const AsciiGrid<T> &destination,
+                  typename AsciiGrid<T>::interpTypeEnum interpType);
+
+    template <class T>
+    static boost::shared_ptr<const GridResampler> get(const AsciiGrid<T> &source,
+                                                      const AsciiGrid<T> &destination,
+                                                      typename AsciiGrid<T>::interpTypeEnum interpType);
+
+    template <class T>
+    bool matches(const AsciiGrid<T> &source, const AsciiGrid<T> &destination,
+                 typename AsciiGrid<T>::interpTypeEnum interpType) const;
+
+    template <class T>
+    void interpolate(const AsciiGrid<T> &source, AsciiGrid<T> &destination,
+                     int numThreads) const;
+    template <class T>
+    void interpolate(const AsciiGrid<T> *const *sources,
+                     AsciiGrid<T> *const *destinations, int nGrids,
+                     int numThreads) const;
+
+private:
+    struct Geometry
+    {
+        int nRows;
+        int nCols;
+        double xllCorner;
+        double yllCorner;
+        double cellSize;
+
+        bool operator==(Geometry const& rhs) const;
+    };
+
+    /*
+    ** Source rows (or columns) of a destination row (or column).  nearest holds
+    ** the destination cell center.  For order1 away from the edges, lower is the
+    ** first of the two cells interpolated between and weight the distance from
+    ** it in cells.
+    */
+    struct Axis
+    {
+        int nearest;
+        int lower;
+        double weight;
+        bool edge;  //nearest cell only, whatever the other axis is
+    };
+
+    template <class T>
+    static Geometry geometryOf(const AsciiGrid<T> &grid);
+
+    GridResampler(Geometry const& source, Geometry const& destination, int interpType);
+    static boost::shared_ptr<const GridResampler> get(Geometry const& source,
+                                                      Geometry const& destination, int interpType);
+    bool matches(Geometry const& source, Geometry const& destination, int interpType) const;
+
+    void build();
+    static void buildAxis(int nDestination, double destinationOrigin, double destinationCellSize,
+                          int nSource, double sourceOrigin, double sourceCellSize,
+                          int interpType, std::vector<Axis> &axis);
+
+    template <class T>
+    void interpolateRow(int i, const AsciiGrid<T> &source, AsciiGrid<T> &destination) const;
+
+    Geometry source_;
+    Geometry destination_;
+    int interpType_;
+    std::vector<Axis> rows_;
+    std::vector<Axis> cols_;
+};
+
+template <class T>
+GridResampler::Geometry GridResampler::geometryOf(const AsciiGrid<T> &grid)
+{
+    Geometry g;
+    g.nRows = grid.get_nRows();
+    g.nCols = grid.get_nCols();
+    g.xllCorner = grid.get_xllCorner();
+    g.yllCorner = grid.get_yllCorner();
+    g.cellSize = grid.get_cellSize();
+    return g;
+}
+
+/**
+ * @brief Build the tables to interpolate source onto destination.
+ *
+ * Only the headers of the grids are used.
+ *
+ * @param source Grid the values are interpolated from.
+ * @param destination Grid the values are interpolated to.
+ * @param interpType Interpolation order.
+ * @throws std::range_error if a destination cell center is outside the source
+ * grid, like AsciiGrid<T>::get_cellIndex().
+ */
+template <class T>
+GridResampler::GridResampler(const AsciiGrid<T> &source, const AsciiGrid<T> &destination,
+                             typename AsciiGrid<T>::interpTypeEnum interpType)
+    : source_(geometryOf(source))
+    , destination_(geometryOf(destination))
+    , interpType_(interpType)
+{
+    build();
+}
+
+/**
+ * @brief Get the resampler from source to destination, reusing a recently
+ * built one with the same headers.
+ *
+ * @throws std::range_error if a destination cell center is outside the source
+ * grid.
+ */
+template <class T>
+boost::shared_ptr<const GridResampler> GridResampler::get(const AsciiGrid<T> &source,
+                                                          const AsciiGrid<T> &destination,
+                                                          typename AsciiGrid<T>::interpTypeEnum interpType)
+{
+    return get(geometryOf(source), geometryOf(destination), interpType);
+}
+
+/**
+ * @brief Check if the tables were built for grids with these headers.
+ */
+template <class T>
+bool GridResampler::matches(const AsciiGrid<T> &source, const AsciiGrid<T> &destination,
+                            typename AsciiGrid<T>::interpTypeEnum interpType) const
+{
+    return matches(geometryOf(source), geometryOf(destination), interpType);
+}
+
+template <class T>
+void GridResampler::interpolate(const AsciiGrid<T> &source, AsciiGrid<T> &destination,
+                                int numThreads) const
+{
+    const AsciiGrid<T> *sources[] = {&source};
+    AsciiGrid<T> *destinations[] = {&destination};
+    interpolate(sources, destinations, 1, numThreads);
+}
+
+/**
+ * @brief Interpolate each of the sources onto the matching destination.
+ *
+ * The destinations take the no data value of their source, like
+ * AsciiGrid<T>::interpolateFromGrid().
+ *
+ * @param sources grids interpolated from, nGrids of them
+ * @param destinations grids interpolated onto, nGrids of them
+ * @param nGrids number of grids
+ * @param numThreads number of threads doing the rows
+ * @throws std::logic_error if a grid doesn't have the headers the tables were
+ * built for.
+ */
+template <class T>
+void GridResampler::interpolate(const AsciiGrid<T> *const *sources,
+                                AsciiGrid<T> *const *destinations, int nGrids,
+                                int numThreads) const
+{
+    for(int k = 0; k < nGrids; k++)
+    {
+        if(!(geometryOf(*sources[k]) == source_) || !(geometryOf(*destinations[k]) == destination_))
+            throw std::logic_error("Grid doesn't match the tables in GridResampler::interpolate().");
+        destinations[k]->data.setNoDataValue(sources[k]->data.getNoDataValue());
+    }
+
+    int i;
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+    for(i = 0; i < destination_.nRows; i++)
+    {
+        for(int k = 0; k < nGrids; k++)
+            interpolateRow(i, *sources[k], *destinations[k]);
+    }
+}
+
+template <class T>
+void GridResampler::interpolateRow(int i, const AsciiGrid<T> &source, AsciiGrid<T> &destination) const
+{
+    const int nCols = destination_.nCols;
+    if(interpType_ != AsciiGrid<T>::order0 && interpType_ != AsciiGrid<T>::order1)
+    {
+        for(int j = 0; j < nCols; j++)
+            destination.data(i, j) = 0;
+        return;
+    }
+
+    const Axis &row = rows_[i];
+    const T noData = source.data.getNoDataValue();
+    //the weights are T, as in AsciiGrid<T>::interpolateGrid()
+    const T t = row.weight;
+    for(int j = 0; j < nCols; j++)
+    {
+        const Axis &col = cols_[j];
+        if(row.edge || col.edge)
+        {
+            destination.data(i, j) = source.data(row.nearest, col.nearest);
+            continue;
+        }
+
+        const T u = col.weight;
+        const T val1 = source.data(row.lower, col.lower);
+        const T val2 = source.data(row.lower + 1, col.lower);
+        const T val3 = source.data(row.lower + 1, col.lower + 1);
+        const T val4 = source.data(row.lower, col.lower + 1);
+        if(val1 == noData || val2 == noData || val3 == noData || val4 == noData)
+        {
+            destination.data(i, j) = noData;
+            continue;
+        }
+        destination.data(i, j) = (1 - t) * (1 - u) * val1
+                          + t * (1 - u) * val2
+                          + t * u * val3
+                          + (1 - t) * u * val4;
+    }
+}
+
+#endif /* GRID_RESAMPLER_H */
@@ -63,7 +63,7 @@ void griddedInitialization::initializeFields(WindNinjaInputs &input,
 
     setInitializationGrids(input);
 
-    initializeWindToZero(mesh, u0, v0, w0);
+    initializeWindToZero(mesh, u0, v0, w0, input.numberCPUs);
 
     initializeBoundaryLayer(input);
     
@@ -0,0 +1,169 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Hill top and valley bottom walks of a DEM for the diurnal slope flow
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include <cstring>
+
+#include "hillValleyField.h"
+#include "ninjaMathUtility.h"
+
+const double HillValleyField::stepMultiplier = 1.5;
+
+/**
+ * @brief Do the walks for every cell of a DEM.
+ *
+ * Uses the same arithmetic as cellDiurnal::compute_cellHillDist(), so the
+ * results are identical.
+ *
+ * @param dem DEM to walk on.
+ * @param aspect Aspect grid of the DEM.
+ * @param numThreads Number of threads to use.
+ * @param demKey computeKey() of dem, kept to check later DEMs with matches().
+ */
+HillValleyField::HillValleyField(const Elevation &dem, const Aspect &aspect, int numThreads, uint64_t demKey)
+{
+    nRows = dem.get_nRows();
+    nCols = dem.get_nCols();
+    key = demKey;
+
+    const size_t nCells = (size_t)nRows*nCols;
+    stepsUp.resize(nCells);
+    stepsDown.resize(nCells);
+    elevUp.resize(nCells);
+    elevDown.resize(nCells);
+    sinAlphaLocal.resize(nCells);
+
+    const double cellSize = dem.get_cellSize();
+    const AsciiGrid<double>::interpTypeEnum interp_order = AsciiGrid<double>::order1;
+    int i;
+
+    //walk lengths vary a lot from cell to cell, hand out rows dynamically
+#pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+    for(i=0; i<nRows; i++)
+    {
+        double xComponent, yComponent, xStart, yStart, X, Y, elevOld, elevNew, dist;
+        int n;
+
+        for(int j=0; j<nCols; j++)
+        {
+            const size_t cell = (size_t)i*nCols + j;
+
+            dem.get_cellPosition(i, j, &xStart, &yStart);
+
+            for(int downslope=0; downslope<2; downslope++)
+            {
+                //downhill for upslope flow, uphill for downslope flow
+                xComponent = cos(n_to_xy(aspect(i,j))*pi/180.0);
+                yComponent = sin(n_to_xy(aspect(i,j))*pi/180.0);
+                if(downslope)
+                {
+                    xComponent = xComponent*(-1.0);
+                    yComponent = yComponent*(-1.0);
+                }
+
+                X = xStart;
+                Y = yStart;
+                elevNew = dem(i,j);
+                n = 0;
+                for(;;)
+                {
+                    X = X + (stepMultiplier * xComponent * cellSize);
+                    Y = Y + (stepMultiplier * yComponent * cellSize);
+                    elevOld = elevNew;
+                    if(!dem.check_inBounds(X, Y))
+                        break;
+                    elevNew = dem.interpolateGrid(X, Y, interp_order);
+                    if(downslope ? !(elevOld < elevNew) : !(elevOld > elevNew))
+                        break;
+                    n++;
+                }
+
+                if(downslope)
+                {
+                    stepsDown[cell] = n;
+                    elevDown[cell] = elevOld;
+
+                    X = xStart + (stepMultiplier * xComponent * cellSize);
+                    Y = yStart + (stepMultiplier * yComponent * cellSize);
+                    if(!dem.check_inBounds(X, Y))
+                        sinAlphaLocal[cell] = 0.0;
+                    else
+                    {
+                        dist = std::sqrt((X - xStart)*(X - xStart) + (Y - yStart)*(Y - yStart));
+                        sinAlphaLocal[cell] = sin(atan((fabs(dem.interpolateGrid(X, Y, interp_order) - dem(i,j))) / dist));
+                    }
+                }else
+                {
+                    stepsUp[cell] = n;
+                    elevUp[cell] = elevOld;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Memory used by the walk results.
+ *
+ * @return Size in bytes.
+ */
+size_t HillValleyField::get_bytes() const
+{
+    return (stepsUp.size() + stepsDown.size()) * sizeof(int) +
+           (elevUp.size() + elevDown.size() + sinAlphaLocal.size()) * sizeof(double);
+}
+
+/**
+ * @brief 64 bit FNV-1a hash of the DEM header and elevations.
+ *
+ * Two DEMs with the same key have the same size, position and elevations, so
+ * the walks of one can be used for the other.
+ *
+ * @param dem DEM to hash.
+ * @return The hash.
+ */
+uint64_t HillValleyField::computeKey(const Elevation &dem)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const double header[5] = { (double)dem.get_nRows(), (double)dem.get_nCols(),
+                               dem.get_xllCorner(), dem.get_yllCorner(), dem.get_cellSize() };
+    unsigned char bytes[sizeof(double)];
+    double value;
+
+    for(int k=-5; k<dem.get_nRows()*dem.get_nCols(); k++)
+    {
+        value = k < 0 ? header[k+5] : dem(k/dem.get_nCols(), k%dem.get_nCols());
+        memcpy(bytes, &value, sizeof(double));
+        for(size_t b=0; b<sizeof(double); b++)
+        {
+            hash ^= bytes[b];
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
@@ -0,0 +1,94 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Hill top and valley bottom walks of a DEM for the diurnal slope flow
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef HILL_VALLEY_FIELD_H
+#define HILL_VALLEY_FIELD_H
+
+#include <vector>
+
+#include <stdint.h>
+
+#include "Elevation.h"
+#include "Aspect.h"
+
+/**
+ * @brief Result of the cellDiurnal hill top and valley bottom walks of every
+ * DEM cell, computed once per DEM.
+ *
+ * cellDiurnal::compute_cellHillDist() walks from the cell center along the
+ * aspect direction in steps of stepMultiplier cells, downhill for upslope
+ * flow (to the valley bottom) and uphill for downslope flow (to the hill top),
+ * until the elevation stops changing in that direction or the walk leaves the
+ * grid.  The walks only depend on the DEM, so the number of steps taken and
+ * the elevation reached are stored here for both directions, along with the
+ * local slope angle used for downslope flow.
+ *
+ * The walk can also be stopped early at a shaded (or unshaded) point, which
+ * changes with the time of day.  That part is left to cellDiurnal, which only
+ * has to look at the shade along the stored number of steps.
+ *
+ * The object is not changed after it is built, so it can be used by several
+ * threads and runs at once (see Elevation::get_hillValleyField()).  It takes
+ * 32 bytes per DEM cell, and the runs of an army share one when
+ * NINJA_ARMY_DOMAIN_CACHE is on.
+ */
+class HillValleyField
+{
+public:
+    HillValleyField(const Elevation &dem, const Aspect &aspect, int numThreads, uint64_t demKey);
+
+    bool matches(uint64_t demKey) const { return demKey == key; }
+
+    int get_steps(int i, int j, bool downslope) const
+    { return downslope ? stepsDown[i*nCols+j] : stepsUp[i*nCols+j]; }
+    double get_endElevation(int i, int j, bool downslope) const
+    { return downslope ? elevDown[i*nCols+j] : elevUp[i*nCols+j]; }
+    double get_sinAlphaLocal(int i, int j) const { return sinAlphaLocal[i*nCols+j]; }
+
+    size_t get_bytes() const;
+
+    static uint64_t computeKey(const Elevation &dem);
+
+    static const double stepMultiplier;    //cells moved per step, more than sqrt(2)
+
+private:
+    int nRows, nCols;
+    uint64_t key;   //computeKey() of the DEM the walks were done on
+
+    std::vector<int> stepsUp;       //steps downhill, upslope flow
+    std::vector<int> stepsDown;     //steps uphill, downslope flow
+    std::vector<double> elevUp;     //elevation after stepsUp steps
+    std::vector<double> elevDown;   //elevation after stepsDown steps
+    std::vector<double> sinAlphaLocal;  //local sine of the slope angle one step uphill
+
+    HillValleyField(const HillValleyField &rhs);
+    HillValleyField &operator=(const HillValleyField &rhs);
+};
+
+#endif	//HILL_VALLEY_FIELD_H
@@ -53,12 +53,13 @@ initialize::~initialize()
 void initialize::initializeWindToZero( Mesh const& mesh,
                                     wn_3dScalarField& u0,
                                     wn_3dScalarField& v0,
-                                    wn_3dScalarField& w0)
+                                    wn_3dScalarField& w0,
+                                    int numThreads)
 {
     int i, j, k;
 
     //initialize u0, v0, w0 equal to zero
-    #pragma omp parallel for default(shared) private(i,j,k)
+    #pragma omp parallel for num_threads(numThreads) default(shared) private(i,j,k)
     for(k=0;k<mesh.nlayers;k++)
     {
         for(i=0;i<mesh.nrows;i++)
@@ -80,54 +81,84 @@ void initialize::initializeWindFromProfile(WindNinjaInputs &input,
                                 wn_3dScalarField& v0,
                                 wn_3dScalarField& w0)
 {
-    int i, j, k;
-//#pragma omp parallel for default(shared) firstprivate(profile) private(i,j,k)
-    double uUpper, vUpper;
+    double uUpper = 0.0, vUpper = 0.0;
     if(input.upperWindUse){
         profile.useUpper = input.upperWindUse;
         profile.inputWindUpperLimit = input.upperWindLimit;
         profile.inputWindUpperHeight = input.upperWindHeight;
         wind_sd_to_uv(input.upperWindSpeed, input.upperWindDirection, &uUpper, &vUpper);
     }
-    for(i=0;i<input.dem.get_nRows();i++)
+    profile.inputWindHeight = input.inputWindHeight;
+
+    const int nLayers = mesh.nlayers;
+    bool badProfile = false;
+
+    //The shape of the profile only depends on the column and the layer, so it
+    //is computed once per node and used for u, v and w.
+    //The input speed of w is 0, but above the upper wind limit the speed used
+    //is the upper wind speed, which was left at the v one for w.
+#pragma omp parallel default(shared) num_threads(input.numberCPUs)
     {
-        for(j=0;j<input.dem.get_nCols();j++)
+        windProfile columnProfile(profile);
+        std::vector<double> numerator(nLayers), denominator(nLayers), scale(nLayers);
+        std::vector<double> uSpeed(nLayers), vSpeed(nLayers), wSpeed(nLayers);
+        bool upper;
+        int i, j, k;
+
+#pragma omp for
+        for(i=0;i<input.dem.get_nRows();i++)
         {
-            profile.ObukovLength = L(i,j);
-            profile.ABL_height = bl_height(i,j);
-            profile.Roughness = input.surface.Roughness(i,j);
-            profile.Rough_h = input.surface.Rough_h(i,j);
-            profile.Rough_d = input.surface.Rough_d(i,j);
-            profile.inputWindHeight = input.inputWindHeight;
-            for(k=0;k<mesh.nlayers;k++)
+            try
             {
-                //this is height above THE GROUND!! (not "z=0" for the log profile)
-                profile.AGL=mesh.ZORD(i, j, k)-input.dem(i,j);
-                profile.GroundASL=input.dem(i,j);
-
-                if(input.upperWindZeroMiddleLayer && mesh.ZORD(i, j, k)<input.upperWindLimit && mesh.ZORD(i, j, k+1)>=input.upperWindLimit){
-                    profile.inputWindSpeed = 0;
-                    profile.inputWindUpperSpeed = 0;
-                }else{
-                    profile.inputWindSpeed = uInitializationGrid(i,j);    
-                    profile.inputWindUpperSpeed = uUpper;
-                }
-                u0(i, j, k) += profile.getWindSpeed();
-                
-                if(input.upperWindZeroMiddleLayer && mesh.ZORD(i, j, k)<input.upperWindLimit && mesh.ZORD(i, j, k+1)>=input.upperWindLimit){
-                    profile.inputWindSpeed = 0;
-                    profile.inputWindUpperSpeed = 0;
-                }else{
-                    profile.inputWindSpeed = vInitializationGrid(i,j);
-                    profile.inputWindUpperSpeed = vUpper;
+                for(j=0;j<input.dem.get_nCols();j++)
+                {
+                    columnProfile.ObukovLength = L(i,j);
+                    columnProfile.ABL_height = bl_height(i,j);
+                    columnProfile.Roughness = input.surface.Roughness(i,j);
+                    columnProfile.Rough_h = input.surface.Rough_h(i,j);
+                    columnProfile.Rough_d = input.surface.Rough_d(i,j);
+                    columnProfile.GroundASL = input.dem(i,j);
+                    for(k=0;k<nLayers;k++)
+                    {
+                        //this is height above THE GROUND!! (not "z=0" for the log profile)
+                        columnProfile.AGL = mesh.ZORD(i, j, k)-input.dem(i,j);
+                        columnProfile.getProfileShape(numerator[k], denominator[k], scale[k], upper);
+
+                        if(input.upperWindZeroMiddleLayer && k+1<nLayers && mesh.ZORD(i, j, k)<input.upperWindLimit && mesh.ZORD(i, j, k+1)>=input.upperWindLimit){
+                            uSpeed[k] = 0.0;
+                            vSpeed[k] = 0.0;
+                            wSpeed[k] = 0.0;
+                        }else if(upper){
+                            uSpeed[k] = uUpper;
+                            vSpeed[k] = vUpper;
+                            wSpeed[k] = vUpper;
+                        }else{
+                            uSpeed[k] = uInitializationGrid(i,j);
+                            vSpeed[k] = vInitializationGrid(i,j);
+                            wSpeed[k] = 0.0;
+                        }
+                    }
+                    for(k=0;k<nLayers;k++)
+                    {
+                        uSpeed[k] = windProfile::scaleWindSpeed(uSpeed[k], numerator[k], denominator[k], scale[k]);
+                        vSpeed[k] = windProfile::scaleWindSpeed(vSpeed[k], numerator[k], denominator[k], scale[k]);
+                        wSpeed[k] = windProfile::scaleWindSpeed(wSpeed[k], numerator[k], denominator[k], scale[k]);
+                    }
+                    for(k=0;k<nLayers;k++)
+                    {
+                        u0(i, j, k) += uSpeed[k];
+                        v0(i, j, k) += vSpeed[k];
+                        w0(i, j, k) += wSpeed[k];
+                    }
                 }
-                v0(i, j, k) += profile.getWindSpeed();
-
-                profile.inputWindSpeed = 0.0;
-                w0(i, j, k) += profile.getWindSpeed();
+            }catch(std::runtime_error &e)
+            {
+                badProfile = true;
             }
         }
     }
+    if(badProfile)
+        throw std::runtime_error("Could not identify profile switch.\n");
 }
 
 void initialize::initializeBoundaryLayer(WindNinjaInputs& input)
@@ -171,7 +202,7 @@ void initialize::initializeBoundaryLayer(WindNinjaInputs& input)
             f = 1e-8;	//if latitude is zero, set f small
 
         //compute neutral ABL height
-#pragma omp parallel for default(shared) private(i,j)
+#pragma omp parallel for default(shared) private(i,j) num_threads(input.numberCPUs)
         for(i=0;i<input.dem.get_nRows();i++)
         {
             for(j=0;j<input.dem.get_nCols();j++)
@@ -199,8 +230,20 @@ void initialize::addDiurnal(WindNinjaInputs& input, Aspect const* asp, Slope con
 	double u_, v_, w_, height_, L_, U_star_, BL_height_, Xord, Yord, WindSpeed;
 	int i,j;
 
+	//the hill top/valley bottom walks only depend on the DEM, do them once
+	boost::shared_ptr<const HillValleyField> hillValleyField =
+		input.dem.get_hillValleyField(*asp, input.numberCPUs);
+	cDiurnal.set_hillValleyField(hillValleyField.get());
+
 	// DO THE WORK
-//	#pragma omp parallel for default(none) private(i,j,u_,v_,w_,height_,L_,U_star_,BL_height_, Xord, Yord, WindSpeed, Z) firstprivate(cDiurnal) shared(input.dem,uDiurnal,vDiurnal,wDiurnal,height,L,u_star,bl_height, airTempGrid, asp, cloudCoverGrid, slp, input.surface)
+	//cellDiurnal keeps the state of the cell it's working on, so each thread
+	//gets its own copy; the DEM, shade and input grids are only read
+#pragma omp parallel default(shared) private(i,j,u_,v_,w_,height_,L_,U_star_,BL_height_,Xord,Yord,WindSpeed) num_threads(input.numberCPUs)
+    {
+    cellDiurnal threadDiurnal(cDiurnal);
+
+    //rows with long hill/valley paths take longer, hand them out dynamically
+#pragma omp for schedule(dynamic)
     for(i = 0; i < input.dem.get_nRows(); i++)
     {
         for(j = 0; j < input.dem.get_nCols(); j++)
@@ -209,14 +252,14 @@ void initialize::addDiurnal(WindNinjaInputs& input, Aspect const* asp, Slope con
 
             input.dem.get_cellPosition(i, j, &Xord, &Yord);
 
-            cDiurnal.initialize(Xord, Yord, (*asp)(i,j),(*slp)(i,j),
+            threadDiurnal.initialize(Xord, Yord, (*asp)(i,j),(*slp)(i,j),
                     cloudCoverGrid(i,j), airTempGrid(i,j), WindSpeed, input.surface.Z,
                     input.surface.Albedo(i,j), input.surface.Bowen(i,j),
                     input.surface.Cg(i,j), input.surface.Anthropogenic(i,j),
                     input.surface.Roughness(i,j), input.surface.Rough_h(i,j),
                     input.surface.Rough_d(i,j));
 
-            cDiurnal.compute_cell_diurnal_wind(i, j, &u_, &v_, &w_,
+            threadDiurnal.compute_cell_diurnal_wind(i, j, &u_, &v_, &w_,
                     &height_, &L_, &U_star_, &BL_height_);
 
             uDiurnal.set_cellValue(i, j, u_);
@@ -228,6 +271,7 @@ void initialize::addDiurnal(WindNinjaInputs& input, Aspect const* asp, Slope con
             bl_height.set_cellValue(i, j, BL_height_);
         }
     }
+    }
 }
 
 void initialize::addDiurnalComponent(WindNinjaInputs &input,
@@ -238,7 +282,7 @@ void initialize::addDiurnalComponent(WindNinjaInputs &input,
 {
     int i, j, k;
     double AGL=0; //height above top of roughness elements
-#pragma omp parallel for default(shared) private(i,j,k,AGL)
+#pragma omp parallel for default(shared) private(i,j,k,AGL) num_threads(input.numberCPUs)
     //start at 1, not zero because ground nodes must be zero for boundary conditions to work properly
     for(k=1;k<mesh.nlayers;k++)	
     {
@@ -82,7 +82,8 @@ class initialize
         void initializeWindToZero(Mesh const& mesh,
                                 wn_3dScalarField& u0,
                                 wn_3dScalarField& v0,
-                                wn_3dScalarField& w0);
+                                wn_3dScalarField& w0,
+                                int numThreads);
 
         void initializeWindFromProfile(WindNinjaInputs &input,
                                 const Mesh& mesh,
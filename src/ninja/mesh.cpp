@@ -56,6 +56,8 @@ Mesh::Mesh()
     coarseTargetCells=4000; //IF THESE ARE CHANGED, make sure to change the ones in the windninja GUI
     mediumTargetCells=10000;
     fineTargetCells=20000;
+
+    sharesCoordinates = false;
 }
 
 Mesh::~Mesh()
@@ -92,6 +94,8 @@ Mesh::Mesh(Mesh const& m) // Copy constructor
     coarseTargetCells = m.coarseTargetCells;
     mediumTargetCells = m.mediumTargetCells;
     fineTargetCells = m.fineTargetCells;
+
+    sharesCoordinates = false;  //the coordinates were copied
 }
 
 Mesh& Mesh::operator= (Mesh const& m)
@@ -125,6 +129,8 @@ Mesh& Mesh::operator= (Mesh const& m)
         coarseTargetCells = m.coarseTargetCells;
         mediumTargetCells = m.mediumTargetCells;
         fineTargetCells = m.fineTargetCells;
+
+        sharesCoordinates = false;  //the coordinates were copied
     }
     return *this;
 }
@@ -207,7 +213,18 @@ void Mesh::buildFrom3dWeatherModel(const WindNinjaInputs &input,
     }
 }
 
-void Mesh::buildStandardMesh(WindNinjaInputs& input)
+/**
+ * @brief Build the "standard" WindNinja mesh.
+ *
+ * The DEM (and surface grids) in input are resampled to the mesh resolution,
+ * then the node coordinates are computed from the DEM.
+ *
+ * @param input Inputs of the run, input.dem and input.surface are resampled in place.
+ * @param sharedMesh An already built mesh, for example from a DomainCache.  If it has
+ *        the same dimensions, vertical layering and ground elevations, XORD, YORD and
+ *        ZORD share its memory (read only) instead of being computed again.
+ */
+void Mesh::buildStandardMesh(WindNinjaInputs& input, const Mesh *sharedMesh)
 {
     int i;   //"i" is row number with 0 being the South row
     int j;   //"j" is column number with 0 being the West row
@@ -273,12 +290,22 @@ void Mesh::buildStandardMesh(WindNinjaInputs& input)
     //hexahedral elements are being used
     NNPE=8; //number of nodes per element
 
+    if(sharedMesh != NULL && hasSameCoordinates(*sharedMesh, input.dem))
+    {
+        XORD.share(sharedMesh->XORD);
+        YORD.share(sharedMesh->YORD);
+        ZORD.share(sharedMesh->ZORD);
+        sharesCoordinates = true;
+        return;
+    }
+    sharesCoordinates = false;
+
     XORD.allocate(nrows, ncols, nlayers);
     YORD.allocate(nrows, ncols, nlayers);
     ZORD.allocate(nrows, ncols, nlayers);
 
     //Set xyz coordinates ---------------------------------------------------------------
-    #pragma omp parallel for default(shared) private(i,j,k)
+    #pragma omp parallel for default(shared) private(i,j,k) num_threads(input.numberCPUs)
     for(k=0;k<nlayers;k++)
     {
         for(i=0;i<nrows;i++)
@@ -327,6 +354,36 @@ void Mesh::buildStandardMesh(WindNinjaInputs& input)
 #endif //NINJA_DEBUG_VERBOSE
 }
 
+/**
+ * @brief Check if m has the coordinates this mesh would get from buildStandardMesh().
+ *
+ * The node (x,y) come from the resolution and the z from the ground elevation
+ * and the vertical layering, so these are compared (the ground layer of m
+ * is the DEM it was built from).  The dimensions must already be set.
+ *
+ * @param m Mesh to compare to.
+ * @param dem Resampled DEM of this mesh.
+ * @return true if the coordinates of m can be shared.
+ */
+bool Mesh::hasSameCoordinates(const Mesh &m, const Elevation &dem) const
+{
+    if(m.nrows != nrows || m.ncols != ncols || m.nlayers != nlayers ||
+       m.XORD.rows_ != nrows || m.XORD.cols_ != ncols || m.XORD.layers_ != nlayers ||
+       m.meshResolution != meshResolution || m.domainHeight != domainHeight ||
+       m.numVertLayers != numVertLayers || m.vertGrowth != vertGrowth)
+        return false;
+
+    for(int i=0;i<nrows;i++)
+    {
+        for(int j=0;j<ncols;j++)
+        {
+            if(m.ZORD(i, j, 0) != dem(i,j))
+                return false;
+        }
+    }
+    return true;
+}
+
 double Mesh::get_z(const int& i, const int& j, const int& k, const double& elev)
 {
     double z;
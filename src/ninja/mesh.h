@@ -104,12 +104,15 @@ public:
                                  double dxWX, int nrowsWX, 
                                  int ncolsWX, int nlayersWX,
                                  double xOffset, double yOffset);		//build a mesh from a 3d weather model file
-	void buildStandardMesh(WindNinjaInputs& input);				//build the "standard" WindNinja mesh using domain top, numbers of cells, grow, etc...
+	void buildStandardMesh(WindNinjaInputs& input, const Mesh *sharedMesh = NULL);	//build the "standard" WindNinja mesh using domain top, numbers of cells, grow, etc...
+	bool get_sharesCoordinates() const {return sharesCoordinates;}	//true if XORD, YORD, ZORD are shared with another mesh (see buildStandardMesh())
 
     bool checkInBounds(const Mesh &wnMesh, const int &i, const int &j);  // checks if WX mesh point is within WN x-y extent
 
 private:
 
+	bool sharesCoordinates;
+	bool hasSameCoordinates(const Mesh &m, const Elevation &dem) const;
 	double get_z(const int& i, const int& j, const int& k, const double& elev);
 	double get_aspect_ratio(int NUMEL, int NUMNP, wn_3dArray& XORD, wn_3dArray& YORD, wn_3dArray& ZORD, int nrows, int ncols, int nlayers);
 	double get_equiangle_skew(int NUMEL, int NUMNP, wn_3dArray& XORD, wn_3dArray& YORD, wn_3dArray& ZORD, int nrows, int ncols, int nlayers);
@@ -0,0 +1,582 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Geometric multigrid preconditioner for the structured mesh
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include "multigrid.h"
+
+GeometricMultigrid::GeometricMultigrid()
+{
+    numThreads = 1;
+#ifdef _OPENMP
+    numThreads = omp_get_max_threads();
+#endif
+}
+
+GeometricMultigrid::~GeometricMultigrid()
+{
+}
+
+/**
+ * @brief Build the multigrid hierarchy.
+ *
+ * @param numnp Number of rows in A.
+ * @param A Upper triangle CSR values, diagonal first in each row.
+ * @param row_ptr Row pointers of A.
+ * @param col_ind Column indices of A.
+ * @param nrows Number of rows of nodes in the mesh.
+ * @param ncols Number of columns of nodes in the mesh.
+ * @param nlayers Number of layers of nodes in the mesh.
+ * @return false if A doesn't fit the mesh or the coarse matrix isn't positive definite.
+ */
+bool GeometricMultigrid::initialize(int numnp, const double *A, const int *row_ptr, const int *col_ind,
+                                    int nrows, int ncols, int nlayers)
+{
+    levels.clear();
+    cholesky.clear();
+
+    levels.reserve(64);
+    levels.push_back(Level());
+    if(!buildFineLevel(numnp, A, row_ptr, col_ind, nrows, ncols, nlayers))
+    {
+        levels.clear();
+        return false;
+    }
+
+    bool coarsen[3];
+    while(levels.back().N > maxCoarseNodes && chooseCoarsening(levels.back(), coarsen))
+    {
+        Level &fine = levels.back();
+        for(int d=0; d<3; d++)
+            buildTransfer(fine.dim[d], coarsen[d], fine.transfer[d]);
+        fine.res.resize(fine.N);
+
+        levels.push_back(Level());
+        buildCoarseLevel(levels[levels.size()-2], levels.back());
+    }
+
+    if(!factorCoarsest())
+    {
+        levels.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void GeometricMultigrid::get_levelDims(int level, int &nrows, int &ncols, int &nlayers) const
+{
+    nlayers = levels[level].dim[0];
+    nrows = levels[level].dim[1];
+    ncols = levels[level].dim[2];
+}
+
+/**
+ * @brief Memory used by the hierarchy, in bytes.
+ */
+size_t GeometricMultigrid::get_bytes() const
+{
+    size_t bytes = cholesky.size() * sizeof(double);
+    for(unsigned int l=0; l<levels.size(); l++)
+    {
+        const Level &L = levels[l];
+        bytes += (L.coef.size() + L.invDiag.size() + L.x.size() + L.b.size() + L.res.size()) * sizeof(double);
+    }
+    return bytes;
+}
+
+bool GeometricMultigrid::buildFineLevel(int numnp, const double *A, const int *row_ptr, const int *col_ind,
+                                        int nrows, int ncols, int nlayers)
+{
+    Level &L = levels[0];
+    int n, p, m;
+
+    if(nrows < 2 || ncols < 2 || nlayers < 2 || (long long)nrows*ncols*nlayers != numnp)
+        return false;
+
+    L.dim[0] = nlayers;
+    L.dim[1] = nrows;
+    L.dim[2] = ncols;
+    L.N = numnp;
+    L.coef.assign((size_t)numnp*nStencil, 0.0);
+    L.invDiag.resize(numnp);
+
+    const int nxy = nrows*ncols;
+    for(n=0; n<numnp; n++)
+    {
+        const int k = n / nxy;
+        const int i = (n % nxy) / ncols;
+        const int j = n % ncols;
+        if(col_ind[row_ptr[n]] != n || A[row_ptr[n]] <= 0.0)
+            return false;
+
+        for(p=row_ptr[n]; p<row_ptr[n+1]; p++)
+        {
+            m = col_ind[p];
+            const int dk = m / nxy - k;
+            const int di = (m % nxy) / ncols - i;
+            const int dj = m % ncols - j;
+            if(dk < -1 || dk > 1 || di < -1 || di > 1 || dj < -1 || dj > 1)
+                return false;   //not a 27 point stencil on this mesh
+            const int s = (dk+1)*9 + (di+1)*3 + (dj+1);
+            L.coef[(size_t)n*nStencil + s] = A[p];
+            if(m != n)
+                L.coef[(size_t)m*nStencil + (nStencil-1-s)] = A[p];
+        }
+        L.invDiag[n] = 1.0 / A[row_ptr[n]];
+    }
+
+    return true;
+}
+
+/**
+ * @brief Decide which directions of a level to coarsen.
+ *
+ * The coupling in direction d is S_d = -1/2 sum(a_nm * (offset_d)^2), which is
+ * about (coefficient * volume / h_d^2) for a diffusion operator.  Directions
+ * within a factor of 4 of the strongest one are coarsened; a coarsened
+ * direction's S drops by 4 on the next level, so the grid becomes isotropic
+ * in this sense and then coarsens fully.
+ *
+ * @return false if no direction can be coarsened.
+ */
+bool GeometricMultigrid::chooseCoarsening(const Level &fine, bool coarsen[3])
+{
+    double S[3] = {0.0, 0.0, 0.0};
+    int d, s;
+
+    for(s=0; s<nStencil; s++)
+    {
+        if(s == centerSlot)
+            continue;
+        const int off[3] = {s/9 - 1, (s/3)%3 - 1, s%3 - 1};
+        double sum = 0.0;
+        #pragma omp parallel for reduction(+:sum) num_threads(numThreads)
+        for(int n=0; n<fine.N; n++)
+            sum += fine.coef[(size_t)n*nStencil + s];
+        for(d=0; d<3; d++)
+            S[d] -= 0.5 * sum * off[d] * off[d];
+    }
+
+    double Smax = 0.0;
+    bool any = false;
+    for(d=0; d<3; d++)
+    {
+        if(fine.dim[d] >= 3)
+        {
+            any = true;
+            if(S[d] > Smax)
+                Smax = S[d];
+        }
+    }
+    if(!any)
+        return false;
+
+    for(d=0; d<3; d++)
+        coarsen[d] = fine.dim[d] >= 3 && (Smax <= 0.0 || S[d] >= 0.25*Smax);
+
+    return true;
+}
+
+void GeometricMultigrid::buildTransfer(int nFine, bool coarsen, Transfer1D &t)
+{
+    int f, c;
+
+    t.coarsened = coarsen;
+    t.c0.resize(nFine);
+    t.c1.resize(nFine);
+    t.w0.resize(nFine);
+    t.w1.resize(nFine);
+
+    //coarse nodes are the even fine indices, plus the last one
+    std::vector<int> position;
+    if(coarsen)
+    {
+        for(f=0; f<nFine; f+=2)
+            position.push_back(f);
+        if(position.back() != nFine-1)
+            position.push_back(nFine-1);
+    }else
+    {
+        for(f=0; f<nFine; f++)
+            position.push_back(f);
+    }
+    t.nCoarse = (int)position.size();
+
+    c = 0;
+    for(f=0; f<nFine; f++)
+    {
+        while(c+1 < t.nCoarse && position[c+1] <= f)
+            c++;
+        if(position[c] == f)
+        {
+            t.c0[f] = c;
+            t.c1[f] = -1;
+            t.w0[f] = 1.0;
+            t.w1[f] = 0.0;
+        }else
+        {
+            t.c0[f] = c;
+            t.c1[f] = c+1;
+            t.w1[f] = double(f - position[c]) / (position[c+1] - position[c]);
+            t.w0[f] = 1.0 - t.w1[f];
+        }
+    }
+
+    //transpose, for the restriction
+    t.rCount.assign(t.nCoarse, 0);
+    t.rFine.resize(3*t.nCoarse);
+    t.rWeight.resize(3*t.nCoarse);
+    for(f=0; f<nFine; f++)
+    {
+        c = t.c0[f];
+        t.rFine[3*c + t.rCount[c]] = f;
+        t.rWeight[3*c + t.rCount[c]++] = t.w0[f];
+        if(t.c1[f] >= 0)
+        {
+            c = t.c1[f];
+            t.rFine[3*c + t.rCount[c]] = f;
+            t.rWeight[3*c + t.rCount[c]++] = t.w1[f];
+        }
+    }
+}
+
+/**
+ * @brief Galerkin coarse matrix A_c = P^T * A * P, one coarse row per iteration.
+ */
+void GeometricMultigrid::buildCoarseLevel(const Level &fine, Level &coarse)
+{
+    const Transfer1D *t = fine.transfer;
+    int d;
+
+    for(d=0; d<3; d++)
+        coarse.dim[d] = t[d].nCoarse;
+    coarse.N = coarse.dim[0]*coarse.dim[1]*coarse.dim[2];
+    coarse.coef.assign((size_t)coarse.N*nStencil, 0.0);
+    coarse.invDiag.resize(coarse.N);
+    coarse.x.resize(coarse.N);
+    coarse.b.resize(coarse.N);
+
+    const int fStride0 = fine.dim[1]*fine.dim[2];
+    const int fStride1 = fine.dim[2];
+
+    #pragma omp parallel for num_threads(numThreads)
+    for(int C=0; C<coarse.N; C++)
+    {
+        const int K = C / (coarse.dim[1]*coarse.dim[2]);
+        const int I = (C / coarse.dim[2]) % coarse.dim[1];
+        const int J = C % coarse.dim[2];
+        double *row = &coarse.coef[(size_t)C*nStencil];
+
+        for(int a=0; a<t[0].rCount[K]; a++)
+        for(int b=0; b<t[1].rCount[I]; b++)
+        for(int c=0; c<t[2].rCount[J]; c++)
+        {
+            const int k = t[0].rFine[3*K+a];
+            const int i = t[1].rFine[3*I+b];
+            const int j = t[2].rFine[3*J+c];
+            const double wi = t[0].rWeight[3*K+a] * t[1].rWeight[3*I+b] * t[2].rWeight[3*J+c];
+            const int n = k*fStride0 + i*fStride1 + j;
+
+            for(int s=0; s<nStencil; s++)
+            {
+                const double A = fine.coef[(size_t)n*nStencil + s];
+                if(A == 0.0)
+                    continue;
+                //the fine neighbor, and the coarse nodes it interpolates from
+                const int nb[3] = {k + s/9 - 1, i + (s/3)%3 - 1, j + s%3 - 1};
+                int cc[3][2];
+                double cw[3][2];
+                int cn[3];
+                for(int e=0; e<3; e++)
+                {
+                    const Transfer1D &te = t[e];
+                    cc[e][0] = te.c0[nb[e]];
+                    cw[e][0] = te.w0[nb[e]];
+                    cn[e] = 1;
+                    if(te.c1[nb[e]] >= 0 && te.w1[nb[e]] != 0.0)
+                    {
+                        cc[e][1] = te.c1[nb[e]];
+                        cw[e][1] = te.w1[nb[e]];
+                        cn[e] = 2;
+                    }
+                }
+                for(int p=0; p<cn[0]; p++)
+                for(int q=0; q<cn[1]; q++)
+                for(int r=0; r<cn[2]; r++)
+                {
+                    const int slot = (cc[0][p]-K+1)*9 + (cc[1][q]-I+1)*3 + (cc[2][r]-J+1);
+                    row[slot] += wi * A * cw[0][p] * cw[1][q] * cw[2][r];
+                }
+            }
+        }
+        coarse.invDiag[C] = (row[centerSlot] != 0.0) ? 1.0/row[centerSlot] : 0.0;
+    }
+}
+
+/**
+ * @brief Dense Cholesky factorization of the coarsest level (lower triangle, row major).
+ */
+bool GeometricMultigrid::factorCoarsest()
+{
+    Level &L = levels.back();
+    const int n = L.N;
+    int r, c, k;
+
+    cholesky.assign((size_t)n*n, 0.0);
+    for(r=0; r<n; r++)
+    {
+        const int K = r / (L.dim[1]*L.dim[2]);
+        const int I = (r / L.dim[2]) % L.dim[1];
+        const int J = r % L.dim[2];
+        for(int s=0; s<nStencil; s++)
+        {
+            const int kk = K + s/9 - 1, ii = I + (s/3)%3 - 1, jj = J + s%3 - 1;
+            if(kk < 0 || kk >= L.dim[0] || ii < 0 || ii >= L.dim[1] || jj < 0 || jj >= L.dim[2])
+                continue;
+            const int m = (kk*L.dim[1] + ii)*L.dim[2] + jj;
+            cholesky[(size_t)r*n + m] = L.coef[(size_t)r*nStencil + s];
+        }
+    }
+
+    for(c=0; c<n; c++)
+    {
+        double *rowc = &cholesky[(size_t)c*n];
+        double diag = rowc[c];
+        for(k=0; k<c; k++)
+            diag -= rowc[k]*rowc[k];
+        if(diag <= 0.0)
+            return false;
+        diag = sqrt(diag);
+        rowc[c] = diag;
+
+        #pragma omp parallel for num_threads(numThreads)
+        for(int rr=c+1; rr<n; rr++)
+        {
+            double *rowr = &cholesky[(size_t)rr*n];
+            double sum = rowr[c];
+            for(int kk=0; kk<c; kk++)
+                sum -= rowr[kk]*rowc[kk];
+            rowr[c] = sum / diag;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief z = M^-1 * r, one V-cycle starting from z = 0.
+ */
+void GeometricMultigrid::apply(const double *r, double *z)
+{
+    cycle(0, r, z);
+}
+
+void GeometricMultigrid::cycle(int l, const double *b, double *x)
+{
+    Level &L = levels[l];
+
+    if(l == (int)levels.size()-1)
+    {
+        solveCoarsest(b, x);
+        return;
+    }
+
+    Level &C = levels[l+1];
+
+    #pragma omp parallel for num_threads(numThreads)
+    for(int n=0; n<L.N; n++)
+        x[n] = 0.0;
+
+    for(int s=0; s<nSmooth; s++)
+        smooth(L, b, x, true);
+
+    residual(L, b, x, &L.res[0]);
+    restrictResidual(L, &L.res[0], &C.b[0]);
+
+    cycle(l+1, &C.b[0], &C.x[0]);
+
+    prolongateCorrection(L, &C.x[0], x);
+
+    for(int s=0; s<nSmooth; s++)
+        smooth(L, b, x, false);
+}
+
+/**
+ * @brief One 8 color Gauss-Seidel sweep, colors 0..7 (forward) or 7..0 (backward).
+ */
+void GeometricMultigrid::smooth(Level &L, const double *b, double *x, bool forward)
+{
+    const int nk = L.dim[0], ni = L.dim[1], nj = L.dim[2];
+    const int nxy = ni*nj;
+
+    #pragma omp parallel num_threads(numThreads)
+    {
+        for(int step=0; step<8; step++)
+        {
+            const int color = forward ? step : 7-step;
+            const int kp = (color >> 2) & 1, ip = (color >> 1) & 1, jp = color & 1;
+            const int nkc = (nk - kp + 1) / 2;
+            const int nic = (ni - ip + 1) / 2;
+
+            #pragma omp for
+            for(int t=0; t<nkc*nic; t++)
+            {
+                const int k = kp + 2*(t / nic);
+                const int i = ip + 2*(t % nic);
+                const int dk0 = (k > 0) ? -1 : 0, dk1 = (k < nk-1) ? 1 : 0;
+                const int di0 = (i > 0) ? -1 : 0, di1 = (i < ni-1) ? 1 : 0;
+                for(int j=jp; j<nj; j+=2)
+                {
+                    const int n = k*nxy + i*nj + j;
+                    const int dj0 = (j > 0) ? -1 : 0, dj1 = (j < nj-1) ? 1 : 0;
+                    const double *a = &L.coef[(size_t)n*nStencil];
+                    double sum = b[n];
+                    for(int dk=dk0; dk<=dk1; dk++)
+                        for(int di=di0; di<=di1; di++)
+                            for(int dj=dj0; dj<=dj1; dj++)
+                                sum -= a[(dk+1)*9 + (di+1)*3 + dj+1] * x[n + dk*nxy + di*nj + dj];
+                    //the loop also subtracted the diagonal term
+                    x[n] = (sum + a[centerSlot]*x[n]) * L.invDiag[n];
+                }
+            }
+        }
+    }
+}
+
+void GeometricMultigrid::residual(Level &L, const double *b, const double *x, double *res)
+{
+    const int nk = L.dim[0], ni = L.dim[1], nj = L.dim[2];
+    const int nxy = ni*nj;
+
+    #pragma omp parallel for num_threads(numThreads)
+    for(int t=0; t<nk*ni; t++)
+    {
+        const int k = t / ni;
+        const int i = t % ni;
+        const int dk0 = (k > 0) ? -1 : 0, dk1 = (k < nk-1) ? 1 : 0;
+        const int di0 = (i > 0) ? -1 : 0, di1 = (i < ni-1) ? 1 : 0;
+        for(int j=0; j<nj; j++)
+        {
+            const int n = k*nxy + i*nj + j;
+            const int dj0 = (j > 0) ? -1 : 0, dj1 = (j < nj-1) ? 1 : 0;
+            const double *a = &L.coef[(size_t)n*nStencil];
+            double sum = b[n];
+            for(int dk=dk0; dk<=dk1; dk++)
+                for(int di=di0; di<=di1; di++)
+                    for(int dj=dj0; dj<=dj1; dj++)
+                        sum -= a[(dk+1)*9 + (di+1)*3 + dj+1] * x[n + dk*nxy + di*nj + dj];
+            res[n] = sum;
+        }
+    }
+}
+
+void GeometricMultigrid::restrictResidual(const Level &fine, const double *res, double *bCoarse)
+{
+    const Transfer1D *t = fine.transfer;
+    const int cni = t[1].nCoarse, cnj = t[2].nCoarse;
+    const int nCoarse = t[0].nCoarse*cni*cnj;
+    const int fStride0 = fine.dim[1]*fine.dim[2];
+    const int fStride1 = fine.dim[2];
+
+    #pragma omp parallel for num_threads(numThreads)
+    for(int C=0; C<nCoarse; C++)
+    {
+        const int K = C / (cni*cnj);
+        const int I = (C / cnj) % cni;
+        const int J = C % cnj;
+        double sum = 0.0;
+        for(int a=0; a<t[0].rCount[K]; a++)
+        for(int b=0; b<t[1].rCount[I]; b++)
+        for(int c=0; c<t[2].rCount[J]; c++)
+            sum += t[0].rWeight[3*K+a] * t[1].rWeight[3*I+b] * t[2].rWeight[3*J+c] *
+                   res[t[0].rFine[3*K+a]*fStride0 + t[1].rFine[3*I+b]*fStride1 + t[2].rFine[3*J+c]];
+        bCoarse[C] = sum;
+    }
+}
+
+void GeometricMultigrid::prolongateCorrection(const Level &fine, const double *xCoarse, double *x)
+{
+    const Transfer1D *t = fine.transfer;
+    const int ni = fine.dim[1], nj = fine.dim[2];
+    const int cStride0 = t[1].nCoarse*t[2].nCoarse;
+    const int cStride1 = t[2].nCoarse;
+
+    #pragma omp parallel for num_threads(numThreads)
+    for(int n=0; n<fine.N; n++)
+    {
+        const int k = n / (ni*nj);
+        const int i = (n / nj) % ni;
+        const int j = n % nj;
+        const int ck[2] = {t[0].c0[k], t[0].c1[k]};
+        const int ci[2] = {t[1].c0[i], t[1].c1[i]};
+        const int cj[2] = {t[2].c0[j], t[2].c1[j]};
+        const double wk[2] = {t[0].w0[k], t[0].w1[k]};
+        const double wi[2] = {t[1].w0[i], t[1].w1[i]};
+        const double wj[2] = {t[2].w0[j], t[2].w1[j]};
+        double sum = 0.0;
+        for(int a=0; a<2; a++)
+        {
+            if(ck[a] < 0)
+                continue;
+            for(int b=0; b<2; b++)
+            {
+                if(ci[b] < 0)
+                    continue;
+                for(int c=0; c<2; c++)
+                {
+                    if(cj[c] < 0)
+                        continue;
+                    sum += wk[a]*wi[b]*wj[c] * xCoarse[ck[a]*cStride0 + ci[b]*cStride1 + cj[c]];
+                }
+            }
+        }
+        x[n] += sum;
+    }
+}
+
+void GeometricMultigrid::solveCoarsest(const double *b, double *x)
+{
+    const int n = levels.back().N;
+    int r, c;
+
+    for(r=0; r<n; r++)  //L*y = b
+    {
+        const double *row = &cholesky[(size_t)r*n];
+        double sum = b[r];
+        for(c=0; c<r; c++)
+            sum -= row[c]*x[c];
+        x[r] = sum / row[r];
+    }
+    for(r=n-1; r>=0; r--)   //L^T*x = y
+    {
+        double sum = x[r];
+        for(c=r+1; c<n; c++)
+            sum -= cholesky[(size_t)c*n + r]*x[c];
+        x[r] = sum / cholesky[(size_t)r*n + r];
+    }
+}
@@ -0,0 +1,127 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Geometric multigrid preconditioner for the structured mesh
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef GEOMETRIC_MULTIGRID_H
+#define GEOMETRIC_MULTIGRID_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * @brief Multigrid V-cycle for the symmetric, upper triangle CSR matrix built
+ * in ninja::discretize(), used as a preconditioner in ninja::solve().
+ *
+ * The mesh from Mesh::buildStandardMesh() is a logically structured
+ * nlayers x nrows x ncols grid of nodes, so the hierarchy is built
+ * geometrically:
+ *
+ *   - Each level stores the full 27 point stencil of every node.
+ *   - A direction is coarsened by keeping every other node (and always the
+ *     last one).  Only the directions with strong coupling are coarsened
+ *     (semi-coarsening), which handles the thin layers near the ground.  The
+ *     coupling in a direction is measured from the second moment of the
+ *     stencil, which is ~ coefficient / h^2.
+ *   - Interpolation is trilinear in node index space, restriction is its
+ *     transpose and the coarse matrices are the Galerkin products R*A*P, so
+ *     the terrain following geometry is inherited without remeshing.
+ *   - The smoother is 8 color Gauss-Seidel (forward before, backward after
+ *     the coarse correction), so the V-cycle is symmetric and can be used in
+ *     conjugate gradient, and each color is relaxed in parallel.
+ *   - The coarsest level is solved with a dense Cholesky factorization.
+ */
+class GeometricMultigrid
+{
+public:
+    GeometricMultigrid();
+    ~GeometricMultigrid();
+
+    bool initialize(int numnp, const double *A, const int *row_ptr, const int *col_ind,
+                    int nrows, int ncols, int nlayers);
+    void apply(const double *r, double *z);
+
+    void set_numThreads(int n) { numThreads = n > 0 ? n : 1; }
+    int get_numLevels() const { return (int)levels.size(); }
+    void get_levelDims(int level, int &nrows, int &ncols, int &nlayers) const;
+    size_t get_bytes() const;
+
+private:
+    enum{ nStencil = 27, centerSlot = 13, maxCoarseNodes = 500, nSmooth = 1 };
+
+    int numThreads; //threads of the parallel regions, omp_get_max_threads() when constructed
+
+    //1D interpolation from a coarse to a fine direction
+    struct Transfer1D
+    {
+        bool coarsened;
+        int nCoarse;
+        std::vector<int> c0, c1;        //coarse neighbors of each fine index (c1 = -1 if none)
+        std::vector<double> w0, w1;
+        std::vector<int> rCount;        //fine indices feeding each coarse index (up to 3)
+        std::vector<int> rFine;
+        std::vector<double> rWeight;
+    };
+
+    struct Level
+    {
+        int dim[3];                 //nodes in k (layers), i (rows), j (cols)
+        int N;
+        std::vector<double> coef;   //coef[n*nStencil+s], s = (dk+1)*9 + (di+1)*3 + (dj+1)
+        std::vector<double> invDiag;
+        std::vector<double> x, b, res;
+        Transfer1D transfer[3];     //to the next coarser level
+    };
+
+    std::vector<Level> levels;
+    std::vector<double> cholesky;   //dense factor of the coarsest level
+
+    bool buildFineLevel(int numnp, const double *A, const int *row_ptr, const int *col_ind,
+                        int nrows, int ncols, int nlayers);
+    bool chooseCoarsening(const Level &fine, bool coarsen[3]);
+    void buildTransfer(int nFine, bool coarsen, Transfer1D &t);
+    void buildCoarseLevel(const Level &fine, Level &coarse);
+    bool factorCoarsest();
+
+    void cycle(int l, const double *b, double *x);
+    void smooth(Level &L, const double *b, double *x, bool forward);
+    void residual(Level &L, const double *b, const double *x, double *res);
+    void restrictResidual(const Level &fine, const double *res, double *bCoarse);
+    void prolongateCorrection(const Level &fine, const double *xCoarse, double *x);
+    void solveCoarsest(const double *b, double *x);
+
+    GeometricMultigrid(const GeometricMultigrid &rhs);
+    GeometricMultigrid &operator=(const GeometricMultigrid &rhs);
+};
+
+#endif	//GEOMETRIC_MULTIGRID_H
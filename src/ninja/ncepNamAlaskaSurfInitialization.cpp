@@ -480,8 +480,7 @@ void ncepNamAlaskaSurfInitialization::setSurfaceGrids( WindNinjaInputs &input,
         CSLSetNameValue( psWarpOptions->papszWarpOptions,
                  "INIT_DEST", "NO_DATA" );
 
-        wrpDS = (GDALDataset*) GDALAutoCreateWarpedVRT( srcDS, srcWkt.c_str(), dstWkt.c_str(),
-                GRA_NearestNeighbour, 1.0, psWarpOptions );
+        wrpDS = warpForecast( input, temp, srcDS, srcWkt, dstWkt, psWarpOptions );
 
         if(wrpDS == NULL)
         {
@@ -482,10 +482,7 @@ void ncepNamSurfInitialization::setSurfaceGrids( WindNinjaInputs &input,
         ** FIXME(kyle): valgrind reporting memory leak as psWarpOptions is
         ** cloned internally and then not freed
         */
-        wrpDS = (GDALDataset*) GDALAutoCreateWarpedVRT( srcDS, srcWkt.c_str(),
-                                                        dstWkt.c_str(),
-                                                        GRA_NearestNeighbour,
-                                                        1.0, psWarpOptions );
+        wrpDS = warpForecast( input, temp, srcDS, srcWkt, dstWkt, psWarpOptions );
         if(wrpDS == NULL)
         {
             throw badForecastFile("Could not warp the forecast file, "
@@ -470,10 +470,7 @@ void ncepRapSurfInitialization::setSurfaceGrids(  WindNinjaInputs &input,
         CSLSetNameValue( psWarpOptions->papszWarpOptions,
                  "INIT_DEST", "NO_DATA" );
 
-        wrpDS = (GDALDataset*) GDALAutoCreateWarpedVRT( srcDS, srcWkt.c_str(),
-                                                        dstWkt.c_str(),
-                                                        GRA_NearestNeighbour,
-                                                        1.0, psWarpOptions );
+        wrpDS = warpForecast( input, temp, srcDS, srcWkt, dstWkt, psWarpOptions );
         if(wrpDS == NULL)
         {
             throw badForecastFile("Could not warp the forecast file, "
@@ -28,6 +28,7 @@
 
 
 #include "ninja.h"
+#include "batchSolver.h"
 
 extern boost::local_time::tz_database globalTimeZoneDB;
 
@@ -73,6 +74,9 @@ ninja::ninja()
     solar=NULL;
     outputDirectionArray=NULL;
     outputSpeedArray=NULL;
+    warmStart = false;
+    solverIterations = 0;
+    sharedStructure = false;
     nMaxMatchingIters = atoi( CPLGetConfigOption( "NINJA_POINT_MAX_MATCH_ITERS",
                                                   "150" ) );
     CPLDebug( "NINJA", "Maximum match iterations set to: %d", nMaxMatchingIters );
@@ -139,6 +143,10 @@ ninja::ninja(const ninja &rhs)
     num_outer_iter_tries_u = rhs.num_outer_iter_tries_u;
     num_outer_iter_tries_v = rhs.num_outer_iter_tries_v;
     num_outer_iter_tries_w = rhs.num_outer_iter_tries_w;
+    warmStart = rhs.warmStart;
+    solverIterations = 0;
+    domainCache = rhs.domainCache;
+    sharedStructure = false;
 
     //Timers
     startTotal=0.0;
@@ -215,6 +223,12 @@ ninja &ninja::operator=(const ninja &rhs)
         num_outer_iter_tries_u = rhs.num_outer_iter_tries_u;
         num_outer_iter_tries_v = rhs.num_outer_iter_tries_v;
         num_outer_iter_tries_w = rhs.num_outer_iter_tries_w;
+        warmStart = rhs.warmStart;
+        solverIterations = 0;
+        runStats.reset();
+        domainCache = rhs.domainCache;
+        sharedStructure = false;
+        quadGeometry.reset();
 
         //Timers
         startTotal=0.0;
@@ -256,29 +270,7 @@ ninja &ninja::operator=(const ninja &rhs)
  */
 bool ninja::simulate_wind()
 {
-	checkCancel();
-
-	input.Com->ninjaCom(ninjaComClass::ninjaNone, "Reading elevation file...");
-	
-	readInputFile();
-	set_position();
-
-	checkInputs();
-
-	if(!input.ninjaTime.is_not_a_date_time())
-	{
-	    std::ostringstream out;
-	    out << "Simulation time is " << input.ninjaTime;
-	    input.Com->ninjaCom(ninjaComClass::ninjaNone, out.str().c_str());
-	}
-
-	#ifdef _OPENMP
-	input.Com->ninjaCom(ninjaComClass::ninjaNone, "Run number %d started with %d threads.", input.inputsRunNumber, input.numberCPUs);
-	#endif
-
-	#ifdef _OPENMP
-		startTotal = omp_get_wtime();
-	#endif
+	startSimulation();
 
 	 //taucs_double *SK;
 
@@ -294,26 +286,6 @@ bool ninja::simulate_wind()
     */
     int max_matching_iters = nMaxMatchingIters;		//maximum number of outer iterations to do (for matching observations)
 
-/*  ----------------------------------------*/
-/*  MESH GENERATION                         */
-/*  ----------------------------------------*/
-
-	#ifdef _OPENMP
-		startMesh = omp_get_wtime();
-	#endif
-
-	input.Com->ninjaCom(ninjaComClass::ninjaNone, "Generating mesh...");
-	//generate mesh
-	mesh.buildStandardMesh(input);
-	
-	u0.allocate(&mesh);		//u is positive toward East
-	v0.allocate(&mesh);		//v is positive toward North
-	w0.allocate(&mesh);		//w is positive up
-
-	#ifdef _OPENMP
-		endMesh = omp_get_wtime();
-	#endif
-
 /*  ----------------------------------------*/
 /*  START OUTER INTERATIVE LOOP FOR         */
 /*	MATCHING INPUT POINTS					*/
@@ -349,21 +321,7 @@ do
             input.Com->ninjaCom(ninjaComClass::ninjaNone, "\"matching\" loop iteration %i...", matchingIterCount);
         }
 
-#ifdef _OPENMP
-                startInit = omp_get_wtime();
-#endif
-
-		input.Com->ninjaCom(ninjaComClass::ninjaNone, "Initializing flow...");
-
-		//initialize
-                init.reset(initializationFactory::makeInitialization(input));
-                init->initializeFields(input, mesh, u0, v0, w0, CloudGrid);
-
-#ifdef _OPENMP
-                endInit = omp_get_wtime();
-#endif
-
-		checkCancel();
+		initializeFlow();
 
 /*  ----------------------------------------*/
 /*  CHECK FOR "NULL" RUN                    */
@@ -371,37 +329,7 @@ do
 		if(checkForNullRun())	//if it's a run with all zero velocity...
 			break;
 
-/*  ----------------------------------------*/
-/*  BUILD "A" ARRAY OF AX=B                 */
-/*  ----------------------------------------*/
-		#ifdef _OPENMP
-			startBuildEq = omp_get_wtime();
-		#endif
-
-		input.Com->ninjaCom(ninjaComClass::ninjaNone, "Building equations...");
-
-		//build A arrray
-		discretize();
-
-        checkCancel();
-
-/*  ----------------------------------------*/
-/*  SET BOUNDARY CONDITIONS                 */
-/*  ----------------------------------------*/
-
-		//set boundary conditions
-		setBoundaryConditions();
-
-		//#define WRITE_A_B
-		#ifdef WRITE_A_B	//used for debugging...
-			 write_A_and_b(1000, SK, col_ind, row_ptr, RHS);
-		#endif
-
-		#ifdef _OPENMP
-			endBuildEq = omp_get_wtime();
-		#endif
-
-		 checkCancel();
+		buildEquations();
 
 /*  ----------------------------------------*/
 /*  CALL SOLVER                             */
@@ -426,27 +354,7 @@ do
 
 		checkCancel();
 
-		 if(SK)
-		 {
-			delete[] SK;
-			SK=NULL;
-		 }
-
-		 if(col_ind)
-		 {
-			delete[] col_ind;
-			col_ind=NULL;
-		 }
-		 if(row_ptr)
-		 {
-			delete[] row_ptr;
-			row_ptr=NULL;
-		 }
-		 if(RHS)
-		 {
-			delete[] RHS;
-			RHS=NULL;
-		 }
+		deleteEquations();
 
 /*  ----------------------------------------*/
 /*  COMPUTE UVW WIND FIELD                   */
@@ -481,6 +389,167 @@ if(input.matchWxStations == true && !isNullRun)
 	}
 }
 
+	return finishSimulation();
+}
+
+/**
+ * @brief First part of a simulation: read the inputs and build the mesh.
+ */
+void ninja::startSimulation()
+{
+	checkCancel();
+
+	input.Com->ninjaCom(ninjaComClass::ninjaNone, "Reading elevation file...");
+	
+	readInputFile();
+	set_position();
+
+	checkInputs();
+
+	if(!input.ninjaTime.is_not_a_date_time())
+	{
+	    std::ostringstream out;
+	    out << "Simulation time is " << input.ninjaTime;
+	    input.Com->ninjaCom(ninjaComClass::ninjaNone, out.str().c_str());
+	}
+
+	#ifdef _OPENMP
+	input.Com->ninjaCom(ninjaComClass::ninjaNone, "Run number %d started with %d threads.", input.inputsRunNumber, input.numberCPUs);
+	//the regions of the grid and mesh classes take the count of the calling thread,
+	//set here for this thread only when the run is nested in an army loop
+	omp_set_num_threads(input.numberCPUs);
+	#endif
+
+	#ifdef _OPENMP
+		startTotal = omp_get_wtime();
+	#endif
+
+	solverIterations = 0;
+	runStats.reset();
+	runStats.runNumber = input.inputsRunNumber;
+	runStats.numThreads = input.numberCPUs;
+
+/*  ----------------------------------------*/
+/*  MESH GENERATION                         */
+/*  ----------------------------------------*/
+
+	#ifdef _OPENMP
+		startMesh = omp_get_wtime();
+	#endif
+
+	input.Com->ninjaCom(ninjaComClass::ninjaNone, "Generating mesh...");
+	//generate mesh
+	mesh.buildStandardMesh(input, domainCache ? &domainCache->get_mesh() : NULL);
+	quadGeometry.reset();	//built for the old mesh, rebuilt in discretize() if it's used
+	
+	u0.allocate(&mesh);		//u is positive toward East
+	v0.allocate(&mesh);		//v is positive toward North
+	w0.allocate(&mesh);		//w is positive up
+
+	runStats.numNodes = mesh.NUMNP;
+
+	#ifdef _OPENMP
+		endMesh = omp_get_wtime();
+	#endif
+}
+
+/**
+ * @brief Initialize the flow field (u0, v0, w0).
+ */
+void ninja::initializeFlow()
+{
+#ifdef _OPENMP
+	startInit = omp_get_wtime();
+#endif
+
+	input.Com->ninjaCom(ninjaComClass::ninjaNone, "Initializing flow...");
+
+	//initialize
+	init.reset(initializationFactory::makeInitialization(input));
+	init->initializeFields(input, mesh, u0, v0, w0, CloudGrid);
+
+#ifdef _OPENMP
+	endInit = omp_get_wtime();
+#endif
+
+	checkCancel();
+}
+
+/**
+ * @brief Build the equations (SK and RHS) and set the boundary conditions.
+ */
+void ninja::buildEquations()
+{
+/*  ----------------------------------------*/
+/*  BUILD "A" ARRAY OF AX=B                 */
+/*  ----------------------------------------*/
+	#ifdef _OPENMP
+		startBuildEq = omp_get_wtime();
+	#endif
+
+	input.Com->ninjaCom(ninjaComClass::ninjaNone, "Building equations...");
+
+	//build A arrray
+	discretize();
+
+	checkCancel();
+
+/*  ----------------------------------------*/
+/*  SET BOUNDARY CONDITIONS                 */
+/*  ----------------------------------------*/
+
+	//set boundary conditions
+	setBoundaryConditions();
+
+	//#define WRITE_A_B
+	#ifdef WRITE_A_B	//used for debugging...
+		 write_A_and_b(1000, SK, col_ind, row_ptr, RHS);
+	#endif
+
+	#ifdef _OPENMP
+		endBuildEq = omp_get_wtime();
+	#endif
+
+	checkCancel();
+}
+
+/**
+ * @brief Free the equations after they're solved, PHI is kept.
+ */
+void ninja::deleteEquations()
+{
+	if(SK)
+	{
+		delete[] SK;
+		SK=NULL;
+	}
+	if(col_ind)
+	{
+		if(!sharedStructure)
+			delete[] col_ind;
+		col_ind=NULL;
+	}
+	if(row_ptr)
+	{
+		if(!sharedStructure)
+			delete[] row_ptr;
+		row_ptr=NULL;
+	}
+	if(RHS)
+	{
+		delete[] RHS;
+		RHS=NULL;
+	}
+}
+
+/**
+ * @brief Last part of a simulation: compute the friction velocity and dust
+ * (if used), write the outputs and free memory.
+ *
+ * @return true.
+ */
+bool ninja::finishSimulation()
+{
 /*  ----------------------------------------*/
 /*  COMPUTE FRICTION VELOCITY               */
 /*  ----------------------------------------*/
@@ -548,6 +617,11 @@ if(input.frictionVelocityFlag == 1){
 
 	//write timers
 	#ifdef _OPENMP
+			runStats.meshTime = endMesh-startMesh;
+			runStats.initializationTime = endInit-startInit;
+			runStats.equationBuildTime = endBuildEq-startBuildEq;
+			runStats.outputTime = endWriteOut-startWriteOut;
+			runStats.totalTime = endTotal-startTotal;
 			input.Com->ninjaCom(ninjaComClass::ninjaNone, "Meshing time was %lf seconds.",endMesh-startMesh);
 			input.Com->ninjaCom(ninjaComClass::ninjaNone, "Initialization time was %lf seconds.",endInit-startInit);
 			input.Com->ninjaCom(ninjaComClass::ninjaNone, "Equation building time was %lf seconds.",endBuildEq-startBuildEq);
@@ -566,6 +640,14 @@ if(input.frictionVelocityFlag == 1){
 			input.Com->ninjaCom(ninjaComClass::ninjaNone, "Total simulation time was %lf seconds.",endTotal-startTotal);
 	#endif
 
+     runStats.peakMemoryMB = RunStatistics::getPeakMemoryMB();
+     if(CSLTestBoolean(CPLGetConfigOption("NINJA_RUN_STATISTICS_JSON", "NO")))
+     {
+         std::string statsFile = derived_pathname(input.velFile.c_str(), NULL, "(?:_[^_]+)?\\.[^.]+$", "_stats.json");
+         if(!runStats.writeJson(statsFile))
+             input.Com->ninjaCom(ninjaComClass::ninjaWarning, "Cannot write run statistics to %s.", statsFile.c_str());
+     }
+
      input.Com->ninjaCom(ninjaComClass::ninjaNone, "Run number %d done!", input.inputsRunNumber);
 
      //If its a pointInitialization Run, explicitly set run completion to 100 when they finish
@@ -580,6 +662,10 @@ if(input.frictionVelocityFlag == 1){
      }
 
 
+	 //keep the solution as the initial guess for the next time step
+	 if(warmStart && PHI != NULL)
+	     warmStartPHI.assign(PHI, PHI + mesh.NUMNP);
+
 	 deleteDynamicMemory();
 	 if(!input.keepOutGridsInMemory)
 	 {
@@ -603,6 +689,166 @@ if(input.frictionVelocityFlag == 1){
      return true;
 }
 
+/**
+ * @brief First part of a run whose equations are solved with other runs (see solveBatch()).
+ *
+ * Reads the inputs, builds the mesh, initializes the flow and builds the
+ * equations.  Must be followed by solveBatch() and finishBatchRun().  Can't be
+ * used with a "matching" point initialization.
+ *
+ * @return false if it's a null run (no equations to solve), true otherwise.
+ */
+bool ninja::buildBatchEquations()
+{
+    if(input.matchWxStations == true)
+        throw std::logic_error("A point initialization with station matching can't be solved in a batch.");
+
+    startSimulation();
+    initializeFlow();
+    if(checkForNullRun())
+        return false;
+
+    buildEquations();
+    return true;
+}
+
+/**
+ * @brief Last part of a run started with buildBatchEquations().
+ *
+ * @return true if the run completes without error.
+ */
+bool ninja::finishBatchRun()
+{
+#ifdef _OPENMP
+    omp_set_num_threads(input.numberCPUs);  //may be on another thread than buildBatchEquations(), see startSimulation()
+#endif
+    if(!isNullRun)
+    {
+        deleteEquations();
+        computeUVWField();
+        checkCancel();
+    }
+    return finishSimulation();
+}
+
+/**
+ * @brief Solve the equations of several runs built with buildBatchEquations().
+ *
+ * Runs with exactly the same stiffness matrix (same mesh, and neutral stability
+ * so alpha is the same everywhere) only differ in the right hand side.  These
+ * are solved together with a BatchSolver, which does the matrix products for all
+ * of them at once.  A run with a different matrix is solved on its own.  Null
+ * runs are skipped.
+ *
+ * @param runs Runs to solve.
+ * @param numThreads Number of threads of the solver, a run solved on its own
+ * uses it too instead of its numberCPUs.
+ */
+void ninja::solveBatch(std::vector<ninja*> &runs, int numThreads)
+{
+    //same as simulate_wind()
+    const int MAXITS = 100000;
+    const double stop_tol = 1E-1;
+    const int print_iters = 10;
+
+    ninja *lead = NULL;
+    std::vector<ninja*> batch;
+    std::vector<double*> b, x;
+    for(unsigned int i = 0; i < runs.size(); i++)
+    {
+        ninja *run = runs[i];
+        if(run->isNullRun)
+            continue;
+
+        if(lead == NULL)
+            lead = run;
+
+        const int NZND = run->row_ptr[run->mesh.NUMNP];
+        const bool sameMatrix = run == lead ||
+            (run->mesh.NUMNP == lead->mesh.NUMNP &&
+             NZND == lead->row_ptr[lead->mesh.NUMNP] &&
+             (run->row_ptr == lead->row_ptr ||
+              (memcmp(run->row_ptr, lead->row_ptr, (run->mesh.NUMNP+1)*sizeof(int)) == 0 &&
+               memcmp(run->col_ind, lead->col_ind, NZND*sizeof(int)) == 0)) &&
+             memcmp(run->SK, lead->SK, NZND*sizeof(double)) == 0);
+
+        #ifdef _OPENMP
+            run->startSolve = omp_get_wtime();
+        #endif
+        if(sameMatrix)
+        {
+            batch.push_back(run);
+            b.push_back(run->RHS);
+            x.push_back(run->PHI);
+        }else
+        {
+            run->input.Com->ninjaCom(ninjaComClass::ninjaNone, "Solving (not batched, the equations differ)...");
+            const int runCPUs = run->input.numberCPUs;
+            run->input.numberCPUs = numThreads;
+            if(run->solve(run->SK, run->RHS, run->PHI, run->row_ptr, run->col_ind, run->mesh.NUMNP, MAXITS, print_iters, stop_tol)==false)
+                if(run->solveMinres(run->SK, run->RHS, run->PHI, run->row_ptr, run->col_ind, run->mesh.NUMNP, MAXITS, print_iters, stop_tol)==false)
+                {
+                    run->input.numberCPUs = runCPUs;
+                    throw std::runtime_error("Solver returned false.");
+                }
+            run->input.numberCPUs = runCPUs;
+            #ifdef _OPENMP
+                run->endSolve = omp_get_wtime();
+            #endif
+        }
+    }
+
+    if(batch.empty())
+        return;
+
+    double startSolverTime = omp_get_wtime();
+    for(unsigned int i = 0; i < batch.size(); i++)
+        batch[i]->input.Com->ninjaCom(ninjaComClass::ninjaNone, "Solving (batched with %d runs)...", (int)batch.size());
+
+    BatchSolver solver;
+    solver.set_numThreads(numThreads);
+    int precondType = Preconditioner::get_precondType(CPLGetConfigOption("NINJA_PRECONDITIONER", "ssor"));
+    if(solver.initialize(lead->mesh.NUMNP, lead->SK, lead->row_ptr, lead->col_ind, precondType,
+                         SparseMatVec::get_eSpMVMode(CPLGetConfigOption("NINJA_SPMV_MODE", "symmetric")),
+                         lead->mesh.nrows, lead->mesh.ncols, lead->mesh.nlayers)==false)
+        throw std::runtime_error("Initialization of the batched solver failed.");
+    if(solver.get_precondType() != precondType)
+        lead->input.Com->ninjaCom(ninjaComClass::ninjaWarning, "Initialization of %s preconditioner failed, using Jacobi preconditioner...",
+                                  Preconditioner::get_precondName(precondType));
+
+    const bool converged = solver.solve(b, x, MAXITS, stop_tol);
+    const double solverTime = omp_get_wtime()-startSolverTime;
+
+    for(unsigned int i = 0; i < batch.size(); i++)
+    {
+        ninja *run = batch[i];
+        run->solverIterations += solver.get_iterations()[i];
+
+        //the setup and products are shared, each run gets the batch's times
+        RunStatistics &stats = run->runStats;
+        stats.preconditioner = Preconditioner::get_precondName(solver.get_precondType());
+        stats.solverIterations += solver.get_iterations()[i];
+        stats.finalResidual = solver.get_residuals()[i];
+        stats.residualHistory.insert(stats.residualHistory.end(), solver.get_residualHistory(i).begin(),
+                                     solver.get_residualHistory(i).end());
+        stats.preconditionerSetupTime += solver.get_setupTime();
+        stats.spmvTime += solver.get_spmvTime();
+        stats.preconditionerTime += solver.get_precondTime();
+        stats.solverTime += solverTime;
+        run->input.Com->ninjaCom(ninjaComClass::ninjaNone, "Solver (batched with %d runs, %s preconditioner): %d iterations, %lf seconds.",
+                                 (int)batch.size(), Preconditioner::get_precondName(solver.get_precondType()),
+                                 solver.get_iterations()[i], solverTime);
+        #ifdef _OPENMP
+            run->endSolve = omp_get_wtime();
+        #endif
+        if(solver.get_residuals()[i] <= stop_tol)
+            run->input.Com->ninjaCom(ninjaComClass::ninjaSolverProgress, "%d", 100);
+    }
+
+    if(!converged)
+        throw std::runtime_error("Solution did not converge.\nMAXITS reached.");
+}
+
 /**Method used to get the smallest radius of influence from a vector of wxStation.
  *
  * @return Value of smallest radius of influence.
@@ -646,8 +892,6 @@ double ninja::getSmallestRadiusOfInfluence()
 bool ninja::solve(double *A, double *b, double *x, int *row_ptr, int *col_ind, int NUMNP, int max_iter, int print_iters, double tol)
 {
     //stuff for sparse BLAS MV multiplication
-    char transa='n';
-    double one=1.E0, zero=0.E0;
     char matdescra[6];
     matdescra[0]='s';	//symmetric
     matdescra[1]='u';	//upper triangle stored
@@ -663,13 +907,54 @@ bool ninja::solve(double *A, double *b, double *x, int *row_ptr, int *col_ind, i
 
     residual_percent_complete_old = -1.;
 
+    int iterations = 0;
+    double startSolverTime = omp_get_wtime();
+    double spmvTime = 0.0, precondTime = 0.0, t;
+
     Preconditioner M;
-    if(M.initialize(NUMNP, A, row_ptr, col_ind, M.SSOR, matdescra)==false)
+    M.set_numThreads(input.numberCPUs);
+    int precondType = Preconditioner::get_precondType(CPLGetConfigOption("NINJA_PRECONDITIONER", "ssor"));
+    if(M.initialize(NUMNP, A, row_ptr, col_ind, precondType, matdescra,
+                    mesh.nrows, mesh.ncols, mesh.nlayers)==false)
     {
-        input.Com->ninjaCom(ninjaComClass::ninjaWarning, "Initialization of SSOR preconditioner failed, trying Jacobi preconditioner...");
+        input.Com->ninjaCom(ninjaComClass::ninjaWarning, "Initialization of %s preconditioner failed, trying Jacobi preconditioner...",
+                            Preconditioner::get_precondName(precondType));
+        precondType = M.Jacobi;
         if(M.initialize(NUMNP, A, row_ptr, col_ind, M.Jacobi, matdescra)==false)
             throw std::runtime_error("Initialization of Jacobi preconditioner failed.");
     }
+    runStats.preconditioner = Preconditioner::get_precondName(precondType);
+    runStats.preconditionerSetupTime += omp_get_wtime()-startSolverTime;
+
+    //NINJA_SOLVER_PRECISION=mixed: the CG iterations use a float copy of the matrix (Ap), summing in
+    //double.  When they reach tol, the residual is computed again with the double matrix (Ax), and
+    //the iterations start over from x if that residual is still above tol (iterative refinement).
+    //The preconditioner stays in double.
+    const bool mixedPrecision = EQUAL(CPLGetConfigOption("NINJA_SOLVER_PRECISION", "double"), "mixed");
+    SparseMatVec::eSpMVMode spmvMode = SparseMatVec::get_eSpMVMode(CPLGetConfigOption("NINJA_SPMV_MODE", "symmetric"));
+
+    SparseMatVec Ax, ApSingle;
+    SparseMatVec *Ap = &Ax;
+    Ax.set_numThreads(input.numberCPUs);
+    ApSingle.set_numThreads(input.numberCPUs);
+    if(mixedPrecision)
+    {
+        //only the stencil and expanded products have their own copy of the matrix to store as floats
+        if(spmvMode != SparseMatVec::expanded)
+            spmvMode = SparseMatVec::stencil;
+        if(ApSingle.initialize(NUMNP, A, row_ptr, col_ind, spmvMode, mesh.nrows, mesh.ncols, mesh.nlayers)==false)
+            ApSingle.initialize(NUMNP, A, row_ptr, col_ind, SparseMatVec::expanded);
+        ApSingle.convertToSinglePrecision();
+        Ap = &ApSingle;
+        //the residual checks are rare, do them on the caller's CSR arrays instead of another copy
+        spmvMode = SparseMatVec::symmetric;
+    }
+    if(Ax.initialize(NUMNP, A, row_ptr, col_ind, spmvMode,
+                     mesh.nrows, mesh.ncols, mesh.nlayers)==false)
+    {
+        input.Com->ninjaCom(ninjaComClass::ninjaWarning, "Initialization of the stencil matrix-vector product failed, using the symmetric product...");
+        Ax.initialize(NUMNP, A, row_ptr, col_ind, SparseMatVec::symmetric);
+    }
 
 //#define NINJA_DEBUG_VERBOSE
 #ifdef NINJA_DEBUG_VERBOSE
@@ -688,7 +973,9 @@ bool ninja::solve(double *A, double *b, double *x, int *row_ptr, int *col_ind, i
     //Anorm=new double[NUMNP];
 
     //matrix vector multiplication A*x=Ax
-    mkl_dcsrmv(&transa, &NUMNP, &NUMNP, &one, matdescra, A, col_ind, row_ptr, &row_ptr[1], x, &zero, r);
+    t = omp_get_wtime();
+    Ax.multiply(x, r);
+    spmvTime += omp_get_wtime()-t;
 
     for(i=0;i<NUMNP;i++){
         r[i]=b[i]-r[i];                  //calculate the initial residual
@@ -706,34 +993,50 @@ bool ninja::solve(double *A, double *b, double *x, int *row_ptr, int *col_ind, i
 
     if (resid <= tol)
     {
-        tol = resid;
-        max_iter = 0;
+        //the initial guess (warm start) already satisfies the tolerance
+        delete[] p;
+        delete[] z;
+        delete[] q;
+        delete[] r;
+        runStats.finalResidual = resid;
+        runStats.spmvTime += spmvTime;
+        runStats.solverTime += omp_get_wtime()-startSolverTime;
+        input.Com->ninjaCom(ninjaComClass::ninjaNone, "Solver (%s preconditioner): 0 iterations, %lf seconds.",
+                            Preconditioner::get_precondName(precondType), omp_get_wtime()-startSolverTime);
         return true;
     }
 
+    int cgStart = 1;    //iteration the current CG sequence started on, changes after a refinement
+    int refinements = 0;
+
     //start iterating---------------------------------------------------------------------------------------
     for (int i = 1; i <= max_iter; i++)
     {
         checkCancel();
+        iterations = i;
 
+        t = omp_get_wtime();
         M.solve(r, z, row_ptr, col_ind);	//apply preconditioner
+        precondTime += omp_get_wtime()-t;
 
         rho = cblas_ddot(NUMNP, z, 1, r, 1);
         //rho = dot(NUMNP, z, r);
 
-        if (i == 1)
+        if (i == cgStart)
         {
             cblas_dcopy(NUMNP, z, 1, p, 1);
         }else {
             beta = rho / rho_1;
 
-#pragma omp parallel for
+#pragma omp parallel for num_threads(input.numberCPUs)
             for(j=0; j<NUMNP; j++)
                 p[j] = z[j] + beta*p[j];
         }
 
         //matrix vector multiplication!!!		q = A*p;
-        mkl_dcsrmv(&transa, &NUMNP, &NUMNP, &one, matdescra, A, col_ind, row_ptr, &row_ptr[1], p, &zero, q);
+        t = omp_get_wtime();
+        Ap->multiply(p, q);
+        spmvTime += omp_get_wtime()-t;
 
         alpha = rho / cblas_ddot(NUMNP, p, 1, q, 1);
         //alpha = rho / dot(NUMNP, p, q);
@@ -746,6 +1049,7 @@ bool ninja::solve(double *A, double *b, double *x, int *row_ptr, int *col_ind, i
 
         resid = cblas_dnrm2(NUMNP, r, 1) / normb;	//compute resid
         //resid = nrm2(NUMNP, r) / normb;
+        runStats.residualHistory.push_back(resid);
 
         if(i==1) {
             start_resid = resid;
@@ -784,6 +1088,24 @@ bool ninja::solve(double *A, double *b, double *x, int *row_ptr, int *col_ind, i
             input.Com->ninjaCom(ninjaComClass::ninjaSolverProgress, "%d",(int) (time_percent_complete+0.5)); //Tell the GUI what the percentage to complete for the ninja is
         }
 
+        if (resid <= tol && Ap != &Ax)
+        {
+            //the residual above is for the float matrix, check it with the double matrix
+            t = omp_get_wtime();
+            Ax.multiply(x, q);
+            spmvTime += omp_get_wtime()-t;
+#pragma omp parallel for num_threads(input.numberCPUs)
+            for(j=0; j<NUMNP; j++)
+                r[j] = b[j] - q[j];
+            resid = cblas_dnrm2(NUMNP, r, 1) / normb;
+            if (resid > tol)
+            {
+                refinements++;
+                cgStart = i+1;
+                continue;
+            }
+        }
+
         if (resid <= tol)	//check residual against tolerance
         {
             break;
@@ -820,6 +1142,18 @@ bool ninja::solve(double *A, double *b, double *x, int *row_ptr, int *col_ind, i
     fclose(convergence_history);
 #endif //NINJA_DEBUG_VERBOSE
 
+    solverIterations += iterations;
+    runStats.solverIterations += iterations;
+    runStats.finalResidual = resid;
+    runStats.spmvTime += spmvTime;
+    runStats.preconditionerTime += precondTime;
+    runStats.solverTime += omp_get_wtime()-startSolverTime;
+    input.Com->ninjaCom(ninjaComClass::ninjaNone, "Solver (%s preconditioner): %d iterations, %lf seconds.",
+                        Preconditioner::get_precondName(precondType), iterations, omp_get_wtime()-startSolverTime);
+    if(Ap != &Ax)
+        input.Com->ninjaCom(ninjaComClass::ninjaNone, "Mixed precision solve: %.1lf MB float matrix, %d refinements.",
+                            Ap->get_matrixBytes() / (1024.0 * 1024.0), refinements);
+
     if(resid>tol)
     {
         throw std::runtime_error("Solution did not converge.\nMAXITS reached.");
@@ -857,8 +1191,6 @@ bool ninja::solveMinres(double *A, double *b, double *x, int *row_ptr, int *col_
   WOOLD = new double[n];
 
   //stuff for sparse BLAS MV multiplication
-  char transa='n';
-  double one=1.E0, zero=0.E0;
   char matdescra[6];
   //matdescra[0]='s'; //s = symmetric
   matdescra[0]='g'; //g = generic
@@ -889,6 +1221,15 @@ bool ninja::solveMinres(double *A, double *b, double *x, int *row_ptr, int *col_
 	  }
   }
 
+  SparseMatVec Ax;
+  if(Ax.initialize(n, A, row_ptr, col_ind,
+                   SparseMatVec::get_eSpMVMode(CPLGetConfigOption("NINJA_SPMV_MODE", "symmetric")),
+                   mesh.nrows, mesh.ncols, mesh.nlayers)==false)
+  {
+      input.Com->ninjaCom(ninjaComClass::ninjaWarning, "Initialization of the stencil matrix-vector product failed, using the symmetric product...");
+      Ax.initialize(n, A, row_ptr, col_ind, SparseMatVec::symmetric);
+  }
+
   //ksp->its = 0;
 
   for(j=0;j<n;j++)	UOLD[j] = 0.0;	//  u_old  <-   0
@@ -896,7 +1237,7 @@ bool ninja::solveMinres(double *A, double *b, double *x, int *row_ptr, int *col_
   cblas_dcopy(n, UOLD, 1, W, 1);	//	w      <-   0
   cblas_dcopy(n, UOLD, 1, WOLD, 1);	//	w_old  <-   0
 
-  mkl_dcsrmv(&transa, &n, &n, &one, matdescra, A, col_ind, row_ptr, &row_ptr[1], x, &zero, R); // r <- b - A*x
+  Ax.multiply(x, R); // r <- b - A*x
 
   for(j=0;j<n;j++)	R[j] = b[j] - R[j];
 
@@ -936,7 +1277,7 @@ bool ninja::solveMinres(double *A, double *b, double *x, int *row_ptr, int *col_
 
 	  //Lanczos
 
-	  mkl_dcsrmv(&transa, &n, &n, &one, matdescra, A, col_ind, row_ptr, &row_ptr[1], U, &zero, R); // r <- A*x
+	  Ax.multiply(U, R); // r <- A*x
 
 	  alpha = cblas_ddot(n, U, 1, R, 1);	//  alpha <- r'*u
 	  precond.solve(R, Z, row_ptr, col_ind);	//apply preconditioner    M*z = r
@@ -1123,7 +1464,7 @@ double ninja::cblas_ddot(const int N, const double *X, const int incX, const dou
 	double val=0.0;
 	int i;
 
-	#pragma omp parallel for reduction(+:val)
+	#pragma omp parallel for reduction(+:val) num_threads(input.numberCPUs)
 	for(i=0;i<N;i++)
 		val += X[i]*Y[i];
 
@@ -1143,7 +1484,7 @@ void ninja::cblas_daxpy(const int N, const double alpha, const double *X, const
 {
 	int i;
 
-	#pragma omp parallel for
+	#pragma omp parallel for num_threads(input.numberCPUs)
 	for(i=0; i<N; i++)
 		Y[i] += alpha*X[i];
 }
@@ -1168,73 +1509,6 @@ double ninja::cblas_dnrm2(const int N, const double *X, const int incX)
 	return val;
 }
 
-/**
- * @brief Computes the vector-matrix product A*x=y.
- *
- * This is a limited version of the BLAS function dcsrmv().
- * It is limited in that the matrix must be in compressed sparse row
- * format, and symmetric with only the upper triangular part stored.
- * ALPHA=1 and BETA=0 must also be true.
- *
- * @note My version of MKL's compressed sparse row (CSR) matrix vector product function
- * MINE ONLY WORKS FOR A SYMMETRICALLY STORED, UPPER TRIANGULAR MATRIX!!!!!!
- * AND ALPHA==1 AND BETA==0
- *
- * @param transa Not used here, but included to stay with the BLAS.
- * @param m Number of rows in "A" matrix. Must equal k in this implementation.
- * @param k Number of columns in "A" matrix. Must equal m in this implementation.
- * @param alpha Must be one for this implementation.
- * @param matdescra Not used here, but included to stay with the BLAS.
- * @param val This is the "A" array.  Must be in compressed sparse row format, and symmetric with only the upper triangular part stored.
- * @param indx An array describing the column index of "A" (sometimes called "col_ind").
- * @param pntrb A pointer containing indices of "A" of the starting locations of the rows.
- * @param pntre A pointer containg indices of "A" of the ending locations of the rows.
- * @param x Vector of size m (and k) in the A*x=y computation.
- * @param beta Not used here, but included to stay with the BLAS.
- * @param y Vector of size m (and k) in the A*x=y computation.
- */
-void ninja::mkl_dcsrmv(char *transa, int *m, int *k, double *alpha, char *matdescra, double *val, int *indx, int *pntrb, int *pntre, double *x, double *beta, double *y)
-{	// My version of MKL's compressed sparse row (CSR) matrix vector product function
-	// MINE ONLY WORKS FOR A SYMMETRICALLY STORED, UPPER TRIANGULAR MATRIX!!!!!!
-	// AND ALPHA==1 AND BETA==0
-
-		//function multiplies a sparse matrix "val" times a vector "x", result is stored in "y"
-		//		ie. Ax = y
-		//"m" and "k" are equal to the number of rows and columns in "A" (must be equal in mine)
-		//"indx" is an array describing the column index of "A" (sometimes called "col_ind")
-		//"pntrb" is a pointer containing indices of "A" of the starting locations of the rows
-		//"pntre" is a pointer containg indices of "A" of the ending locations of the rows
-		int i,j,N;
-		N=*m;
-
-    #pragma omp parallel private(i,j)
-    {
-        #pragma omp for
-        for(i=0;i<N;i++)
-            y[i]=0.0;
-
-        #pragma omp for
-        for(i=0;i<N;i++)
-        {
-            y[i] += val[pntrb[i]]*x[i];	// diagonal
-            for(j=pntrb[i]+1;j<pntre[i];j++)
-            {
-                y[i] += val[j]*x[indx[j]];
-            }
-        }
-    }	//end parallel region
-
-    for(i=0;i<N;i++)
-    {
-        for(j=pntrb[i]+1;j<pntre[i];j++)
-        {
-            {
-                y[indx[j]] += val[j]*x[i];
-            }
-        }
-    }
-}
-
 /**
  * @brief Computes the vector-matrix product A^T*x=y.
  *
@@ -1277,7 +1551,7 @@ void ninja::mkl_trans_dcsrmv(char *transa, int *m, int *k, double *alpha, char *
             temp[i] = 0.0;
 		}
 
-    #pragma omp parallel private(i,j)
+    #pragma omp parallel private(i,j) num_threads(input.numberCPUs)
     {
 
         #pragma omp for
@@ -1310,7 +1584,7 @@ void ninja::mkl_trans_dcsrmv(char *transa, int *m, int *k, double *alpha, char *
  */
 void ninja::interp_uvw()
 {
-#pragma omp parallel default(shared)
+#pragma omp parallel default(shared) num_threads(input.numberCPUs)
     {
 
         int i,j,k;
@@ -1498,168 +1772,57 @@ void ninja::discretize()
 	if(PHI == NULL)
 		PHI=new double[mesh.NUMNP];
 
-     int interrows=input.dem.get_nRows()-2;
-     int intercols=input.dem.get_nCols()-2;
-     int interlayers=mesh.nlayers-2;
-	 int i, ii, j, jj, k, kk, l;
+	 int i;
                          //NZND is the # of nonzero elements in the SK stiffness array that are stored
-     int NZND=(8*8)+(intercols*4+interrows*4+interlayers*4)*12+(intercols*interlayers*2+interrows*interlayers*2+intercols*interrows*2)*18+(intercols*interrows*interlayers)*27;
-
-     NZND = (NZND - mesh.NUMNP)/2 + mesh.NUMNP;	//this is because we will only store the upper half of the SK matrix since it's symmetric
+                         //(only the upper half of the SK matrix since it's symmetric)
+     int NZND = DomainCache::countNonZero(mesh);
 
 	 SK = new double[NZND];	//This is the final global stiffness matrix in Compressed Row Storage (CRS) and symmetric 
 	 //SK = new taucs_double[NZND];
 
-	 col_ind=new int[NZND];      //This holds the global column number of the corresponding element in the CRS storage
-	 row_ptr=new int[mesh.NUMNP+1];     //This holds the element number in the SK array (CRS) of the first non-zero entry for the global row (the "+1" is so we can use the last entry to quit loops; ie. so we know how many non-zero elements are in the last node)
-	 RHS=new double[mesh.NUMNP];       //This is the final right hand side (RHS) matrix
+     //The structure of SK only depends on the mesh dimensions, so runs in an army share it
+     if(domainCache && domainCache->hasStructure(mesh))
+     {
+          col_ind=domainCache->get_col_ind();
+          row_ptr=domainCache->get_row_ptr();
+          sharedStructure=true;
+     }else
+     {
+          col_ind=new int[NZND];      //This holds the global column number of the corresponding element in the CRS storage
+          row_ptr=new int[mesh.NUMNP+1];     //This holds the element number in the SK array (CRS) of the first non-zero entry for the global row (the "+1" is so we can use the last entry to quit loops; ie. so we know how many non-zero elements are in the last node)
+          sharedStructure=false;
 
-     int type;                     //This is the type of node (corner, edge, side, internal)
-     int temp,temp1;
+          //Set up Compressed Row Storage (CRS) format (only store upper triangular SK matrix)
+          DomainCache::buildStructure(mesh, row_ptr, col_ind);
+     }
+	 RHS=new double[mesh.NUMNP];       //This is the final right hand side (RHS) matrix
 
-     #pragma omp parallel for default(shared) private(i)
+     #pragma omp parallel for default(shared) private(i) num_threads(input.numberCPUs)
 	 for(i=0;i<mesh.NUMNP;i++)
      {
           PHI[i]=0.;
           RHS[i]=0.;
-          row_ptr[i]=0;
      }
 
-	 #pragma omp parallel for default(shared) private(i)
+     //start from the previous time step's solution if it is on the same mesh
+     if(warmStart && !warmStartPHI.empty())
+     {
+          if((int)warmStartPHI.size() == mesh.NUMNP)
+          {
+               #pragma omp parallel for default(shared) private(i) num_threads(input.numberCPUs)
+               for(i=0;i<mesh.NUMNP;i++)
+                    PHI[i]=warmStartPHI[i];
+          }else
+               CPLDebug("NINJA", "Warm start solution has %d nodes, mesh has %d, starting from zero.",
+                        (int)warmStartPHI.size(), mesh.NUMNP);
+     }
+
+	 #pragma omp parallel for default(shared) private(i) num_threads(input.numberCPUs)
      for(i=0;i<NZND;i++)
      {
-          col_ind[i]=0;
           SK[i]=0.;
      }
 
-	 int row, col;
-
-     //Set up Compressed Row Storage (CRS) format (only store upper triangular SK matrix)
-     temp=0;        //temp stores the location (in the SK and col_ind arrays) where the first non-zero element for the current row is located
-	 for(k=0;k<mesh.nlayers;k++)
-     {
-          for(i=0;i<input.dem.get_nRows();i++)
-          {
-               for(j=0;j<input.dem.get_nCols();j++)     //Looping over all nodes using i,j,k notation
-               {
-				   type=mesh.get_node_type(i,j,k);
-                    if(type==0)         //internal node
-                    {
-                         row = k*input.dem.get_nCols()*input.dem.get_nRows()+i*input.dem.get_nCols()+j;
-						 row_ptr[row]=temp;
-                         temp1=temp;
-                         for(kk=-1;kk<2;kk++)
-                         {
-                              for(ii=-1;ii<2;ii++)
-                              {
-                                   for(jj=-1;jj<2;jj++)
-                                   {
-                                       col = (k+kk)*input.dem.get_nCols()*input.dem.get_nRows()+(i+ii)*input.dem.get_nCols()+(j+jj);
-                                       if(col >= row)	//only do if we're on the upper triangular part of SK
-									   {
-                                           col_ind[temp1]=col;
-                                           temp1++;
-                                       }
-                                   }
-                              }
-                         }
-                         //temp=temp+27;
-			             temp=temp1;
-                    }else if(type==1)   //face node
-                    {
-                         row = k*input.dem.get_nCols()*input.dem.get_nRows()+i*input.dem.get_nCols()+j;
-						 row_ptr[row]=temp;
-						 temp1=temp;
-                         for(kk=-1;kk<2;kk++)
-                         {
-                              for(ii=-1;ii<2;ii++)
-                              {
-                                   for(jj=-1;jj<2;jj++)
-                                   {
-                                        if(((i+ii)<0)||((i+ii)>(input.dem.get_nRows()-1)))
-                                             continue;
-                                        if(((j+jj)<0)||((j+jj)>(input.dem.get_nCols()-1)))
-                                             continue;
-                                        if(((k+kk)<0)||((k+kk)>(mesh.nlayers-1)))
-                                             continue;
-
-                                        col = (k+kk)*input.dem.get_nCols()*input.dem.get_nRows()+(i+ii)*input.dem.get_nCols()+(j+jj);
-                                        if(col >= row)	//only do if we're on the upper triangular part of SK
-                                        {
-                                            col_ind[temp1]=col;
-                                            temp1++;
-                                        }
-                                   }
-                              }
-                         }
-                         //temp=temp+18;
-			             temp=temp1;
-                    }else if(type==2)   //edge node
-                    {
-                         row = k*input.dem.get_nCols()*input.dem.get_nRows()+i*input.dem.get_nCols()+j;
-						 row_ptr[row]=temp;
-						 temp1=temp;
-                         for(kk=-1;kk<2;kk++)
-                         {
-                              for(ii=-1;ii<2;ii++)
-                              {
-                                   for(jj=-1;jj<2;jj++)
-                                   {
-                                        if(((i+ii)<0)||((i+ii)>(input.dem.get_nRows()-1)))
-                                             continue;
-                                        if(((j+jj)<0)||((j+jj)>(input.dem.get_nCols()-1)))
-                                             continue;
-                                        if(((k+kk)<0)||((k+kk)>(mesh.nlayers-1)))
-                                             continue;
-
-                                        col = (k+kk)*input.dem.get_nCols()*input.dem.get_nRows()+(i+ii)*input.dem.get_nCols()+(j+jj);
-                                        if(col >= row)	//only do if we're on the upper triangular part of SK
-                                        {
-                                            col_ind[temp1]=col;
-                                            temp1++;
-                                        }
-                                   }
-                              }
-                         }
-                         //temp=temp+12;
-			             temp=temp1;
-                    }else if(type==3)   //corner node
-                    {
-                         row = k*input.dem.get_nCols()*input.dem.get_nRows()+i*input.dem.get_nCols()+j;
-						 row_ptr[row]=temp;
-						 temp1=temp;
-                         for(kk=-1;kk<2;kk++)
-                         {
-                              for(ii=-1;ii<2;ii++)
-                              {
-                                   for(jj=-1;jj<2;jj++)
-                                   {
-                                        if(((i+ii)<0)||((i+ii)>(input.dem.get_nRows()-1)))
-                                             continue;
-                                        if(((j+jj)<0)||((j+jj)>(input.dem.get_nCols()-1)))
-                                             continue;
-                                        if(((k+kk)<0)||((k+kk)>(mesh.nlayers-1)))
-                                             continue;
-
-					                    col = (k+kk)*input.dem.get_nCols()*input.dem.get_nRows()+(i+ii)*input.dem.get_nCols()+(j+jj);
-                                        if(col >= row)	//only do if we're on the upper triangular part of SK
-                                        {
-                                            col_ind[temp1]=col;
-                                            temp1++;
-                                        }
-                                   }
-                              }
-                         }
-                         //temp=temp+8;
-			             temp=temp1;
-                    }
-                    else
-			             throw std::logic_error("Error arranging SK array.  Exiting...");
-               }
-          }
-     }
-     row_ptr[mesh.NUMNP]=temp;     //Set last value of row_ptr, so we can use "row_ptr+1" to use to index to in loops
-
 	 checkCancel();
 
     CPLDebug("STABILITY", "input.initializationMethod = %i\n", input.initializationMethod);
@@ -1769,139 +1932,240 @@ void ninja::discretize()
 
     CPLDebug("STABILITY", "alphaVfield(0,0,0) = %lf\n", alphaVfield(0,0,0));
 
-#pragma omp parallel default(shared) private(i,j,k,l)
+    //Elements can be assembled two ways:
+    //  colored - elements are split into 8 colors by the parity of their (i,j,k) index.  Elements of
+    //            the same color share no nodes, so each color is assembled in parallel without atomics
+    //            and the colors are done in order.  Every SK[] and RHS[] entry is summed in the same
+    //            order for any number of threads, so the result is bit-identical.
+    //  atomic  - one parallel loop over all elements with atomic updates (the original method).
+    const bool coloredAssembly = !EQUAL(CPLGetConfigOption("NINJA_ASSEMBLY_MODE", "colored"), "atomic");
+
+    prepareQuadratureGeometry();
+
+#pragma omp parallel default(shared) private(i) num_threads(input.numberCPUs)
 	 {
 		 element elem(&mesh);
-		 int pos;  
-         double alphaV; //used for summing over nodal points below
+		 elem.set_geometry(quadGeometry.get());
+
+		 if(coloredAssembly)
+		 {
+			 for(int color=0; color<8; color++)
+			 {
+				 const int ci = color & 1;
+				 const int cj = (color >> 1) & 1;
+				 const int ck = (color >> 2) & 1;
+				 const int ni = (mesh.nrowsElem - ci + 1)/2;	//number of elements of this color in each direction
+				 const int nj = (mesh.ncolsElem - cj + 1)/2;
+				 const int nk = (mesh.nlayersElem - ck + 1)/2;
 
 #pragma omp for
-		 for(i=0;i<mesh.NUMEL;i++)                    //Start loop over elements
+				 for(i=0; i<ni*nj*nk; i++)
+				 {
+					 int elem_k = ck + 2*(i/(ni*nj));
+					 int elem_i = ci + 2*((i/nj)%ni);
+					 int elem_j = cj + 2*(i%nj);
+					 int elemNum = mesh.get_elemNum(elem_i, elem_j, elem_k);
+
+					 computeElementEquations(elem, elemNum);
+					 addElementEquations(elem, elemNum, false);
+				 }	//implied barrier, so the next color starts after this one is done
+			 }
+		 }
+		 else
 		 {
-			 /*-----------------------------------------------------*/
-			 /*      NO SURFACE QUADRATURE NEEDED SINCE NONE OF     */
-			 /*      THE BOUNDARY CONDITIONS HAVE A NON-ZERO FLUX   */
-			 /*      SPECIFICATION:                                 */
-			 /*      Flow through =>  Phi = 0                       */
-			 /*      Ground       =>  normal flux = 0               */
-			 /*-----------------------------------------------------*/
+#pragma omp for
+			 for(i=0;i<mesh.NUMEL;i++)                    //Start loop over elements
+			 {
+				 computeElementEquations(elem, i);
+				 addElementEquations(elem, i, true);
+			 }                                  //End loop over elements
+		 }
+	 }		//End parallel region
 
-			 //elem.computeElementStiffnessMatrix(i, u0, v0, w0, alpha);
+     stb.alphaField.deallocate();
+}
 
-			 //Given the above parameters, function computes the element stiffness matrix
+/**
+ * @brief Get the quadrature point geometry tables used by discretize() and computeUVWField().
+ *
+ * Only done if the NINJA_QUADRATURE_CACHE config option is on.  The tables are
+ * taken from the domain cache if it has them for this mesh, otherwise they are
+ * built once per mesh and kept through the "matching" iterations.  The memory
+ * used is reported, the tables take about 290 bytes per element.  With the
+ * option off, the size they would take is printed with CPL_DEBUG=ON.
+ */
+void ninja::prepareQuadratureGeometry()
+{
+    if(!CSLTestBoolean(CPLGetConfigOption("NINJA_QUADRATURE_CACHE", "NO")))
+    {
+        CPLDebug("NINJA", "Quadrature geometry tables not used, they would take %.1lf MB.",
+                 QuadratureGeometry::estimateBytes(mesh) / (1024.0 * 1024.0));
+        return;
+    }
 
-			 if(elem.SFV == NULL)
-				 elem.initializeQuadPtArrays();
+    if(quadGeometry && quadGeometry->hasMesh(mesh))
+        return;
 
-			 for(j=0;j<mesh.NNPE;j++)
-			 {
-				 elem.QE[j]=0.0;
-				 for(int k=0;k<mesh.NNPE;k++)
-					 elem.S[j*mesh.NNPE+k]=0.0;
+    if(domainCache && domainCache->get_quadratureGeometry() &&
+       domainCache->get_quadratureGeometry()->hasMesh(mesh))
+    {
+        quadGeometry = domainCache->get_quadratureGeometry();
+        CPLDebug("NINJA", "Using the shared quadrature geometry tables.");
+        return;
+    }
 
-			 }
-			 //Begin quadrature for current element
+    quadGeometry.reset(new QuadratureGeometry(mesh, input.numberCPUs));
+    input.Com->ninjaCom(ninjaComClass::ninjaNone, "Quadrature geometry tables: %.1lf MB.",
+                        quadGeometry->get_bytes() / (1024.0 * 1024.0));
+}
 
-			 elem.node0=mesh.get_node0(i);  //get the global nodal number of local node 0 of element i
+/**
+ * @brief Computes the element stiffness matrix and right hand side.
+ *
+ * The results are stored in elem.S and elem.QE.
+ *
+ * @param elem Element object to use for the computations (one per thread).
+ * @param elemNum Element number.
+ */
+void ninja::computeElementEquations(element &elem, const int elemNum)
+{
+    int j, k, l;
+    double alphaV; //used for summing over nodal points below
 
+    /*-----------------------------------------------------*/
+    /*      NO SURFACE QUADRATURE NEEDED SINCE NONE OF     */
+    /*      THE BOUNDARY CONDITIONS HAVE A NON-ZERO FLUX   */
+    /*      SPECIFICATION:                                 */
+    /*      Flow through =>  Phi = 0                       */
+    /*      Ground       =>  normal flux = 0               */
+    /*-----------------------------------------------------*/
 
-			 for(j=0;j<elem.NUMQPTV;j++)             //Start loop over quadrature points in the element
-			 {
-				 elem.computeJacobianQuadraturePoint(j, i);
+    if(elem.SFV == NULL)
+        elem.initializeQuadPtArrays();
 
-				 //Calculate the coefficient H here and the alpha-squared term in front of the second partial of z in governing equation (we are still on element i, quadrature point j)
-				 //
-				 //           d u0   d v0   d w0
-				 //     H = ( ---- + ---- + ---- )
-				 //           d x    d y    d z
-				 //
-				 //                and
-                 //
-                 //                     1                          1
-                 //     Rx = Ry =  ------------          Rz = ------------
-                 //                 2*alphaH^2                 2*alphaV^2
+    for(j=0;j<mesh.NNPE;j++)
+    {
+        elem.QE[j]=0.0;
+        for(k=0;k<mesh.NNPE;k++)
+            elem.S[j*mesh.NNPE+k]=0.0;
+    }
+    //Begin quadrature for current element
 
+    elem.node0=mesh.get_node0(elemNum);  //get the global nodal number of local node 0 of element elemNum
 
-				 elem.HVJ=0.0;
+    for(j=0;j<elem.NUMQPTV;j++)             //Start loop over quadrature points in the element
+    {
+        elem.computeJacobianQuadraturePoint(j, elemNum);
 
-				 alphaV = 0; //used for summing over the nodes in the element, reset to 0 each time through loop 
+        //Calculate the coefficient H here and the alpha-squared term in front of the second partial of z in governing equation (we are still on element elemNum, quadrature point j)
+        //
+        //           d u0   d v0   d w0
+        //     H = ( ---- + ---- + ---- )
+        //           d x    d y    d z
+        //
+        //                and
+        //
+        //                     1                          1
+        //     Rx = Ry =  ------------          Rz = ------------
+        //                 2*alphaH^2                 2*alphaV^2
 
-				 for(k=0;k<mesh.NNPE;k++)          //Start loop over nodes in the element
-				 {
-					 elem.NPK=mesh.get_global_node(k, i);            //NPK is the global nodal number
+        elem.HVJ=0.0;
 
-					 elem.HVJ=elem.HVJ+((elem.DNDX[k]*u0(elem.NPK))+(elem.DNDY[k]*v0(elem.NPK))+(elem.DNDZ[k]*w0(elem.NPK)));
+        alphaV = 0; //used for summing over the nodes in the element, reset to 0 each time through loop
 
-					 alphaV=alphaV+elem.SFV[0*mesh.NNPE*elem.NUMQPTV+k*elem.NUMQPTV+j]*alphaVfield(elem.NPK);
-				 }                             //End loop over nodes in the element
+        for(k=0;k<mesh.NNPE;k++)          //Start loop over nodes in the element
+        {
+            elem.NPK=mesh.get_global_node(k, elemNum);            //NPK is the global nodal number
 
-				 elem.RX = 1.0/(2.0*alphaH*alphaH);
-				 elem.RY = 1.0/(2.0*alphaH*alphaH);
-				 elem.RZ = 1.0/(2.0*alphaV*alphaV);
-				 elem.DV=elem.DETJ;                      //DV is the DV for the volume integration (could be eliminated and just use DETJ everywhere)
+            elem.HVJ=elem.HVJ+((elem.DNDX[k]*u0(elem.NPK))+(elem.DNDY[k]*v0(elem.NPK))+(elem.DNDZ[k]*w0(elem.NPK)));
 
-				 if(elem.NUMQPTV==27)
-				 {
-					 if(j<=7)
-					 {
-						 elem.WT=elem.WT1;
-					 }else if(j<=19)
-					 {
-						 elem.WT=elem.WT2;
-					 }else if(j<=25)
-					 {
-						 elem.WT=elem.WT3;
-					 }else
-					 {
-						 elem.WT=elem.WT4;
-					 }
-				 }
-
-				 //Create element stiffness matrix---------------------------------------------
-				 for(k=0;k<mesh.NNPE;k++)          //Start loop over nodes in the element
-				 {
-					 elem.QE[k] = elem.QE[k] + elem.WT * elem.SFV[0*mesh.NNPE*elem.NUMQPTV + k*elem.NUMQPTV + j] * elem.HVJ * elem.DV;
-					 for(l=0;l<mesh.NNPE;l++)
-					 {
-                        elem.S[k*mesh.NNPE+l]=elem.S[k*mesh.NNPE+l]+elem.WT*(elem.DNDX[k]*elem.RX*elem.DNDX[l] + elem.DNDY[k]*elem.RY*elem.DNDY[l] + elem.DNDZ[k]*elem.RZ*elem.DNDZ[l])*elem.DV;
-					 }
-				 }                            //End loop over nodes in the element
-			 }                                  //End loop over quadrature points in the element
+            alphaV=alphaV+elem.SFV[0*mesh.NNPE*elem.NUMQPTV+k*elem.NUMQPTV+j]*alphaVfield(elem.NPK);
+        }                             //End loop over nodes in the element
 
-			 //Place completed element matrix in global SK and Q matrices
+        elem.RX = 1.0/(2.0*alphaH*alphaH);
+        elem.RY = 1.0/(2.0*alphaH*alphaH);
+        elem.RZ = 1.0/(2.0*alphaV*alphaV);
+        elem.DV=elem.DETJ;                      //DV is the DV for the volume integration (could be eliminated and just use DETJ everywhere)
 
-			 for(j=0;j<mesh.NNPE;j++)                          //Start loop over nodes in the element (also, it is the row # in S[])
-			 {
-				 elem.NPK=mesh.get_global_node(j, i);            //elem.NPK is the global row number of the element stiffness matrix
+        if(elem.NUMQPTV==27)
+        {
+            if(j<=7)
+            {
+                elem.WT=elem.WT1;
+            }else if(j<=19)
+            {
+                elem.WT=elem.WT2;
+            }else if(j<=25)
+            {
+                elem.WT=elem.WT3;
+            }else
+            {
+                elem.WT=elem.WT4;
+            }
+        }
 
-#pragma omp atomic
-				 RHS[elem.NPK] += elem.QE[j];
+        //Create element stiffness matrix---------------------------------------------
+        for(k=0;k<mesh.NNPE;k++)          //Start loop over nodes in the element
+        {
+            elem.QE[k] = elem.QE[k] + elem.WT * elem.SFV[0*mesh.NNPE*elem.NUMQPTV + k*elem.NUMQPTV + j] * elem.HVJ * elem.DV;
+            for(l=0;l<mesh.NNPE;l++)
+            {
+                elem.S[k*mesh.NNPE+l]=elem.S[k*mesh.NNPE+l]+elem.WT*(elem.DNDX[k]*elem.RX*elem.DNDX[l] + elem.DNDY[k]*elem.RY*elem.DNDY[l] + elem.DNDZ[k]*elem.RZ*elem.DNDZ[l])*elem.DV;
+            }
+        }                            //End loop over nodes in the element
+    }                                  //End loop over quadrature points in the element
+}
 
-				 for(k=0;k<mesh.NNPE;k++)           //k is the local column number in S[]
-				 {
-					 elem.KNP=mesh.get_global_node(k, i);
-
-					 if(elem.KNP >= elem.NPK)	//do only if we're on the upper triangular region of SK[]
-					 {
-						 pos=-1;                  //pos is the position # in SK[] to place S[j*mesh.NNPE+k]
-						 l=0;                     //l increments through col_ind[] starting from where row_ptr[] says until we find the column number we're looking for
-						 do
-						 {
-							 if(col_ind[row_ptr[elem.NPK]+l]==elem.KNP)   //Check if we're at the correct position
-								 pos=row_ptr[elem.NPK]+l;           //If so, save that position in pos
-							 l++;
-						 }while(pos<0);
+/**
+ * @brief Adds an element's stiffness matrix and right hand side to SK[] and RHS[].
+ *
+ * @param elem Element holding the results of computeElementEquations().
+ * @param elemNum Element number.
+ * @param useAtomics If true, updates are atomic so elements sharing nodes can be
+ *        added concurrently.  If false, the caller must make sure no other thread
+ *        is adding an element with a shared node.
+ */
+void ninja::addElementEquations(element &elem, const int elemNum, const bool useAtomics)
+{
+    int j, k, l, pos;
 
+    for(j=0;j<mesh.NNPE;j++)                          //Start loop over nodes in the element (also, it is the row # in S[])
+    {
+        elem.NPK=mesh.get_global_node(j, elemNum);            //elem.NPK is the global row number of the element stiffness matrix
+
+        if(useAtomics)
+        {
 #pragma omp atomic
-						 SK[pos] += elem.S[j*mesh.NNPE+k];     //Here is the final global stiffness matrix in symmetric storage
-					 }
-				 }
+            RHS[elem.NPK] += elem.QE[j];
+        }
+        else
+            RHS[elem.NPK] += elem.QE[j];
 
-			 }                             //End loop over nodes in the element
-		 }                                  //End loop over elements
-	 }		//End parallel region
+        for(k=0;k<mesh.NNPE;k++)           //k is the local column number in S[]
+        {
+            elem.KNP=mesh.get_global_node(k, elemNum);
 
-     stb.alphaField.deallocate();
+            if(elem.KNP >= elem.NPK)	//do only if we're on the upper triangular region of SK[]
+            {
+                pos=-1;                  //pos is the position # in SK[] to place S[j*mesh.NNPE+k]
+                l=0;                     //l increments through col_ind[] starting from where row_ptr[] says until we find the column number we're looking for
+                do
+                {
+                    if(col_ind[row_ptr[elem.NPK]+l]==elem.KNP)   //Check if we're at the correct position
+                        pos=row_ptr[elem.NPK]+l;           //If so, save that position in pos
+                    l++;
+                }while(pos<0);
+
+                if(useAtomics)
+                {
+#pragma omp atomic
+                    SK[pos] += elem.S[j*mesh.NNPE+k];     //Here is the final global stiffness matrix in symmetric storage
+                }
+                else
+                    SK[pos] += elem.S[j*mesh.NNPE+k];
+            }
+        }
+    }                             //End loop over nodes in the element
 }
 
 /**Sets up boundary conditions for the simulation.
@@ -1922,7 +2186,7 @@ void ninja::setBoundaryConditions()
 	  bool *isBoundaryNode;
 	  isBoundaryNode=new bool[mesh.NUMNP];       //flag to specify if it's a boundary node
 
-	  #pragma omp parallel default(shared) private(i,j,k,l,NPK,KNP)
+	  #pragma omp parallel default(shared) private(i,j,k,l,NPK,KNP) num_threads(input.numberCPUs)
 	  {
 	  #pragma omp for
 	  for(k=0;k<mesh.nlayers;k++)
@@ -1973,6 +2237,74 @@ void ninja::setBoundaryConditions()
 
 }
 
+/**
+ * @brief Add the smoothed gradient of PHI in one element to its nodes.
+ *
+ * Computes dPHI/dx, dPHI/dy and dPHI/dz at each quadrature point of the
+ * element and adds them to the element's nodes, weighted by the inverse
+ * distance from the quadrature point to the node (see computeUVWField()).
+ *
+ * @param elem Element work space.
+ * @param elemNum Element number.
+ * @param WGHT Precomputed weights, or NULL to compute them.
+ * @param uSum Sums of the weighted dPHI/dx at the nodes.
+ * @param vSum Sums of the weighted dPHI/dy at the nodes.
+ * @param wSum Sums of the weighted dPHI/dz at the nodes.
+ * @param diagSum Sums of the weights at the nodes.
+ */
+void ninja::addElementGradient(element &elem, const int elemNum, const double *WGHT,
+                               double *uSum, double *vSum, double *wSum, double *diagSum)
+{
+    double DPHIDX, DPHIDY, DPHIDZ;
+    double XJ, YJ, ZJ;
+    double wght, XK, YK, ZK;
+    int j, k;
+
+    elem.node0 = mesh.get_node0(elemNum);  //get the global node number of local node 0 of element elemNum
+    for(j=0;j<elem.NUMQPTV;j++)             //Start loop over quadrature points in the element
+    {
+        DPHIDX=0.0;     //Set DPHI/DX, etc. to zero for the new quad point
+        DPHIDY=0.0;
+        DPHIDZ=0.0;
+
+        elem.computeJacobianQuadraturePoint(j, elemNum, XJ, YJ, ZJ);
+
+        //Calculate dN/dx, dN/dy, dN/dz (Remember we're using the transpose of the inverse!)
+        for(k=0;k<mesh.NNPE;k++)
+        {
+            elem.NPK=mesh.get_global_node(k, elemNum);            //NPK is the global node number
+
+            DPHIDX=DPHIDX+elem.DNDX[k]*PHI[elem.NPK];       //Calculate the DPHI/DX, etc. for the quad point we are on
+            DPHIDY=DPHIDY+elem.DNDY[k]*PHI[elem.NPK];
+            DPHIDZ=DPHIDZ+elem.DNDZ[k]*PHI[elem.NPK];
+        }
+
+        //Now we know DPHI/DX, etc. for quad point j.  We will distribute this inverse distance weighted average to each nodal point for the cell we're on
+        for(k=0;k<mesh.NNPE;k++)          //Start loop over nodes in the element
+        {                            //Calculate the Jacobian at the quad point
+            elem.NPK=mesh.get_global_node(k, elemNum);            //NPK is the global nodal number
+
+            if(WGHT)
+            {
+                wght=WGHT[((size_t)elemNum*elem.NUMQPTV+j)*mesh.NNPE+k];
+            }else
+            {
+                XK=mesh.XORD(elem.NPK);            //Coodinates of the nodal point
+                YK=mesh.YORD(elem.NPK);
+                ZK=mesh.ZORD(elem.NPK);
+
+                wght=std::pow((XK-XJ),2)+std::pow((YK-YJ),2)+std::pow((ZK-ZJ),2);
+                wght=1.0/(std::sqrt(wght));
+            }
+
+            uSum[elem.NPK]=uSum[elem.NPK]+wght*DPHIDX;   //Here we store the summing values of DPHI/DX, etc. for later use (to actually calculate u,v,w)
+            vSum[elem.NPK]=vSum[elem.NPK]+wght*DPHIDY;
+            wSum[elem.NPK]=wSum[elem.NPK]+wght*DPHIDZ;
+            diagSum[elem.NPK]=diagSum[elem.NPK]+wght;     //Store the sum of the weights for the node
+        }                             //End loop over nodes in the element
+    }                                  //End loop over quadrature points in the element
+}
+
 /**
  * @brief Computes the u,v,w 3d volume wind field.
  *
@@ -2021,7 +2353,8 @@ void ninja::computeUVWField()
      /*     of the surrounding cells.                       */
      /*-----------------------------------------------------*/
 
-	 int i, j, k;
+	 int i;
+	 const double startTime = omp_get_wtime();
 
 	 u.allocate(&mesh);           //u is positive toward East
 	 v.allocate(&mesh);           //v is positive toward North
@@ -2037,24 +2370,51 @@ void ninja::computeUVWField()
 	    DIAG[i]=0.;
      }
 
-	#pragma omp parallel default(shared) private(i,j,k)
+	//How the gradients are summed at the nodes (NINJA_GRADIENT_MODE):
+	//  colored - the elements are done in the same 8 colors as the equation assembly, the
+	//            elements of a color share no nodes so they are summed straight into u, v, w
+	//            and DIAG.  No extra memory, and the sums don't depend on the number of threads.
+	//  scratch - each thread sums into its own 4 arrays of NUMNP values (32 bytes per node per
+	//            thread), which are then added together one thread at a time (the original method).
+	const bool coloredGradient = !EQUAL(CPLGetConfigOption("NINJA_GRADIENT_MODE", "colored"), "scratch");
+
+	#pragma omp parallel default(shared) private(i) num_threads(input.numberCPUs)
 	{
 
 	 element elem(&mesh);
+	 elem.set_geometry(quadGeometry.get());
+	 const double *WGHT = quadGeometry ? &quadGeometry->WGHT[0] : NULL;	//precomputed weights
+
+	 if(coloredGradient)
+	 {
+		 for(int color=0; color<8; color++)
+		 {
+			 const int ci = color & 1;
+			 const int cj = (color >> 1) & 1;
+			 const int ck = (color >> 2) & 1;
+			 const int ni = (mesh.nrowsElem - ci + 1)/2;	//number of elements of this color in each direction
+			 const int nj = (mesh.ncolsElem - cj + 1)/2;
+			 const int nk = (mesh.nlayersElem - ck + 1)/2;
+
+			 #pragma omp for
+			 for(i=0; i<ni*nj*nk; i++)
+			 {
+				 int elem_k = ck + 2*(i/(ni*nj));
+				 int elem_i = ci + 2*((i/nj)%ni);
+				 int elem_j = cj + 2*(i%nj);
 
-     double DPHIDX, DPHIDY, DPHIDZ;
-	 double XJ, YJ, ZJ;
-     double wght, XK, YK, ZK;
+				 addElementGradient(elem, mesh.get_elemNum(elem_i, elem_j, elem_k), WGHT,
+									&u(0), &v(0), &w(0), DIAG);
+			 }	//implied barrier, so the next color starts after this one is done
+		 }
+	 }else
+	 {
 	 double *uScratch, *vScratch, *wScratch, *DIAGScratch;
-	 uScratch=NULL;
-	 vScratch=NULL;
-	 wScratch=NULL;
-	 DIAGScratch=NULL;
 
-	 uScratch=new double[mesh.nlayers*input.dem.get_nRows()*input.dem.get_nCols()];
-	 vScratch=new double[mesh.nlayers*input.dem.get_nRows()*input.dem.get_nCols()];
-	 wScratch=new double[mesh.nlayers*input.dem.get_nRows()*input.dem.get_nCols()];
-	 DIAGScratch=new double[mesh.nlayers*input.dem.get_nRows()*input.dem.get_nCols()];
+	 uScratch=new double[mesh.NUMNP];
+	 vScratch=new double[mesh.NUMNP];
+	 wScratch=new double[mesh.NUMNP];
+	 DIAGScratch=new double[mesh.NUMNP];
 
      for(i=0;i<mesh.NUMNP;i++)                         //Initialize scratch u,v, and w
      {
@@ -2066,51 +2426,7 @@ void ninja::computeUVWField()
 
 	 #pragma omp for
      for(i=0;i<mesh.NUMEL;i++)                  //Start loop over elements
-     {
-          elem.node0 = mesh.get_node0(i);  //get the global node number of local node 0 of element i
-          for(j=0;j<elem.NUMQPTV;j++)             //Start loop over quadrature points in the element
-          {
-
-			   DPHIDX=0.0;     //Set DPHI/DX, etc. to zero for the new quad point
-               DPHIDY=0.0;
-               DPHIDZ=0.0;
-
-			   elem.computeJacobianQuadraturePoint(j, i, XJ, YJ, ZJ);
-
-               //Calculate dN/dx, dN/dy, dN/dz (Remember we're using the transpose of the inverse!)
-               for(k=0;k<mesh.NNPE;k++)
-               {
-                    elem.NPK=mesh.get_global_node(k, i);            //NPK is the global node number
-
-                    DPHIDX=DPHIDX+elem.DNDX[k]*PHI[elem.NPK];       //Calculate the DPHI/DX, etc. for the quad point we are on
-                    DPHIDY=DPHIDY+elem.DNDY[k]*PHI[elem.NPK];
-                    DPHIDZ=DPHIDZ+elem.DNDZ[k]*PHI[elem.NPK];
-               }
-
-               //Now we know DPHI/DX, etc. for quad point j.  We will distribute this inverse distance weighted average to each nodal point for the cell we're on
-               for(k=0;k<mesh.NNPE;k++)          //Start loop over nodes in the element
-               {                            //Calculate the Jacobian at the quad point
-                    elem.NPK=mesh.get_global_node(k, i);            //NPK is the global nodal number
-
-                    XK=mesh.XORD(elem.NPK);            //Coodinates of the nodal point
-                    YK=mesh.YORD(elem.NPK);
-                    ZK=mesh.ZORD(elem.NPK);
-
-                    wght=std::pow((XK-XJ),2)+std::pow((YK-YJ),2)+std::pow((ZK-ZJ),2);
-                    wght=1.0/(std::sqrt(wght));
-//c				    #pragma omp critical
-				    {
-                    uScratch[elem.NPK]=uScratch[elem.NPK]+wght*DPHIDX;   //Here we store the summing values of DPHI/DX, etc. in the u,v,w arrays for later use (to actually calculate u,v,w)
-                    vScratch[elem.NPK]=vScratch[elem.NPK]+wght*DPHIDY;
-                    wScratch[elem.NPK]=wScratch[elem.NPK]+wght*DPHIDZ;
-                    DIAGScratch[elem.NPK]=DIAGScratch[elem.NPK]+wght;     //Store the sum of the weights for the node
-					}
-
-               }                             //End loop over nodes in the element
-
-
-          }                                  //End loop over quadrature points in the element
-     }                                       //End loop over elements
+          addElementGradient(elem, i, WGHT, uScratch, vScratch, wScratch, DIAGScratch);
 
 	 #pragma omp critical
 	 {
@@ -2123,28 +2439,13 @@ void ninja::computeUVWField()
 	 }
 	 } //end critical
 
-	 if(uScratch)
-	 {
-		delete[] uScratch;
-		uScratch=NULL;
-	 }
-	 if(vScratch)
-	 {
-		delete[] vScratch;
-		vScratch=NULL;
-	 }
-	 if(wScratch)
-	 {
-		delete[] wScratch;
-		wScratch=NULL;
-	 }
-	 if(DIAGScratch)
-	 {
-		delete[] DIAGScratch;
-		DIAGScratch=NULL;
-	 }
+	 delete[] uScratch;
+	 delete[] vScratch;
+	 delete[] wScratch;
+	 delete[] DIAGScratch;
 
      #pragma omp barrier
+	 }
 
      double alphaV = 1.0;
 
@@ -2185,6 +2486,8 @@ void ninja::computeUVWField()
         testGrid.write_Grid(filename.c_str(), 2);
     }
     testGrid.deallocate();*/
+
+    runStats.gradientRecoveryTime += omp_get_wtime()-startTime;
 }
 
 /**Prepares for writing output files.
@@ -2422,18 +2725,41 @@ bool ninja::matched(int iter)
 		input.Com->ninjaCom(ninjaComClass::ninjaNone, "Stations matching check:");
 		//input.Com->ninjaCom(ninjaComClass::ninjaNone, "Station #\tmeas_u\tcomp_u\tmeas_v\tcomp_v\tmeas_w\tcomp_w");
 
+		//Get cell number and "parent cell" coordinates of all the station locations at once.
+		//Stations that aren't in the mesh can't be matched, they're skipped.
+		std::vector<int> stationLocation(input.stations.size(), -1);
+		std::vector<double> xLoc, yLoc, zLoc;
 		for(unsigned int i=0; i<input.stations.size(); i++)
 		{
-			//Get (x,y,z) value of station
 			x = input.stations[i].get_xord();
 			y = input.stations[i].get_yord();
-            //Check if station is in mesh, if not, can't do matching so skip
             if(!mesh.inMeshXY(x, y))
                 continue;
             z = input.stations[i].get_height() + input.surface.Rough_h.interpolateGridLocalCoordinates(x, y, AsciiGrid<double>::order1) + input.dem.interpolateGridLocalCoordinates(x, y, AsciiGrid<double>::order1);
+            stationLocation[i] = xLoc.size();
+            xLoc.push_back(x);
+            yLoc.push_back(y);
+            zLoc.push_back(z);
+		}
+		const int nLocated = xLoc.size();
+		std::vector<int> iLoc(nLocated), jLoc(nLocated), kLoc(nLocated);
+		std::vector<double> uLoc(nLocated), vLoc(nLocated), wLoc(nLocated);
+		if(nLocated > 0)
+			elem.get_uvw(nLocated, &xLoc[0], &yLoc[0], &zLoc[0], &iLoc[0], &jLoc[0], &kLoc[0],
+			             &uLoc[0], &vLoc[0], &wLoc[0], input.numberCPUs);
 
-			//Get cell number and "parent cell" coordinates of station location
-			elem.get_uvw(x, y, z, cell_i, cell_j, cell_k, u_loc, v_loc, w_loc);
+		for(unsigned int i=0; i<input.stations.size(); i++)
+		{
+            //Check if station is in mesh, if not, can't do matching so skip
+            const int loc = stationLocation[i];
+            if(loc < 0)
+                continue;
+			cell_i = iLoc[loc];
+			cell_j = jLoc[loc];
+			cell_k = kLoc[loc];
+			u_loc = uLoc[loc];
+			v_loc = vLoc[loc];
+			w_loc = wLoc[loc];
 
             //Get velocity at the station location
             try_output_u = u.interpolate(elem, cell_i, cell_j, cell_k, u_loc, v_loc, w_loc);
@@ -2798,14 +3124,32 @@ void ninja::writeOutputFiles()
 {
     set_outputFilenames(mesh.meshResolution, mesh.meshResolutionUnits);
 
+	//Set this run's band of the army's output cube
+	if(input.outputCube != NULL)
+	{
+		try{
+            boost::posix_time::ptime cubeTime;  //not_a_date_time for runs without a time
+            if(!input.ninjaTime.is_not_a_date_time())
+                cubeTime = input.ninjaTime.utc_time();
+            input.outputCube->set_band(input.outputCubeBand, "vel", VelocityGrid,
+                                       velocityUnits::getString(input.outputSpeedUnits), cubeTime);
+            input.outputCube->set_band(input.outputCubeBand, "ang", AngleGrid, "degrees", cubeTime);
+            input.outputCube->set_band(input.outputCubeBand, "cld", CloudGrid, "fraction", cubeTime);
+		}catch (exception& e)
+		{
+			input.Com->ninjaCom(ninjaComClass::ninjaWarning, "Exception caught during output cube writing: %s", e.what());
+		}
+	}
+
 	//Write volume data to VTK format (always in m/s?)
 	if(input.volVTKOutFlag)
 	{
 		try{
-            // can pick between "ascii" and "binary" format for the vtk write format
-            std::string vtkWriteFormat = "ascii";//"binary";//"ascii";
-            volVTK VTK(u0, v0, w0, mesh.XORD, mesh.YORD, mesh.ZORD, input.dem.get_nCols(), input.dem.get_nRows(), mesh.nlayers, input.volVTKFileInitial, vtkWriteFormat);
-			volVTK VTK2(u, v, w, mesh.XORD, mesh.YORD, mesh.ZORD, input.dem.get_nCols(), input.dem.get_nRows(), mesh.nlayers, input.volVTKFile, vtkWriteFormat);
+            // "ascii" and "binary" write legacy VTK files, "vts" writes VTK XML files
+            volVTK VTK(u0, v0, w0, mesh.XORD, mesh.YORD, mesh.ZORD, input.dem.get_nCols(), input.dem.get_nRows(), mesh.nlayers, input.volVTKFileInitial,
+                       input.volVTKWriteFormat, input.volVTKFloat32, input.volVTKCompress);
+			volVTK VTK2(u, v, w, mesh.XORD, mesh.YORD, mesh.ZORD, input.dem.get_nCols(), input.dem.get_nRows(), mesh.nlayers, input.volVTKFile,
+                        input.volVTKWriteFormat, input.volVTKFloat32, input.volVTKCompress);
             
 		}catch (exception& e)
 		{
@@ -2820,7 +3164,10 @@ void ninja::writeOutputFiles()
 	v.deallocate();
 	w.deallocate();
 
-	#pragma omp parallel sections
+	//grids resampled to the output resolutions, shared by the writers below
+	OutputGridCache outputGrids;
+
+	#pragma omp parallel sections num_threads(input.numberCPUs)
 	{
 
 	//write FARSITE files
@@ -2833,8 +3180,9 @@ void ninja::writeOutputFiles()
                     velTempGrid=NULL;
                     angTempGrid=NULL;
 
-                    angTempGrid = new AsciiGrid<double> (AngleGrid.resample_Grid(input.angResolution, AsciiGrid<double>::order0));
-                    velTempGrid = new AsciiGrid<double> (VelocityGrid.resample_Grid(input.velResolution, AsciiGrid<double>::order0));
+                    //copies, they're buffered in place below
+                    angTempGrid = new AsciiGrid<double> (outputGrids.get(AngleGrid, input.angResolution));
+                    velTempGrid = new AsciiGrid<double> (outputGrids.get(VelocityGrid, input.velResolution));
 
                     AsciiGrid<double> tempCloud(CloudGrid);
                     tempCloud *= 100.0;  //Change to percent, which is what FARSITE needs
@@ -2864,7 +3212,7 @@ void ninja::writeOutputFiles()
                         AsciiGrid<double> *ustarTempGrid;
                         ustarTempGrid=NULL;
 
-                        ustarTempGrid = new AsciiGrid<double> (UstarGrid.resample_Grid(input.velResolution, AsciiGrid<double>::order0));
+                        ustarTempGrid = new AsciiGrid<double> (outputGrids.get(UstarGrid, input.velResolution));
 
                         ustarTempGrid->write_Grid(input.ustarFile.c_str(), 2);
 
@@ -2880,7 +3228,7 @@ void ninja::writeOutputFiles()
                         AsciiGrid<double> *dustTempGrid;
                         dustTempGrid=NULL;
 
-                        dustTempGrid = new AsciiGrid<double> (DustGrid.resample_Grid(input.velResolution, AsciiGrid<double>::order0));
+                        dustTempGrid = new AsciiGrid<double> (outputGrids.get(DustGrid, input.velResolution));
 
                         dustTempGrid->write_Grid(input.dustFile.c_str(), 2);
 
@@ -2942,32 +3290,13 @@ void ninja::writeOutputFiles()
 	try{
 		if(input.shpOutFlag==true)
 		{
-			AsciiGrid<double> *velTempGrid, *angTempGrid, *ustarTempGrid;
-			velTempGrid=NULL;
-			angTempGrid=NULL;
-			ustarTempGrid=NULL;
-
 			ShapeVector ninjaShapeFiles;
 
-			angTempGrid = new AsciiGrid<double> (AngleGrid.resample_Grid(input.shpResolution, AsciiGrid<double>::order0));
-			velTempGrid = new AsciiGrid<double> (VelocityGrid.resample_Grid(input.shpResolution, AsciiGrid<double>::order0));
-
-			ninjaShapeFiles.setDirGrid(*angTempGrid);
-			ninjaShapeFiles.setSpeedGrid(*velTempGrid);
+			ninjaShapeFiles.setDirGrid(outputGrids.get(AngleGrid, input.shpResolution));
+			ninjaShapeFiles.setSpeedGrid(outputGrids.get(VelocityGrid, input.shpResolution));
 			ninjaShapeFiles.setDataBaseName(input.dbfFile);
 			ninjaShapeFiles.setShapeFileName(input.shpFile);
 			ninjaShapeFiles.makeShapeFiles();
-
-			if(angTempGrid)
-			{
-				delete angTempGrid;
-				angTempGrid=NULL;
-			}
-			if(velTempGrid)
-			{
-				delete velTempGrid;
-				velTempGrid=NULL;
-			}
 		}
 	}catch (exception& e)
 	{
@@ -2986,68 +3315,28 @@ void ninja::writeOutputFiles()
 		if(input.googOutFlag==true)
 
 		{
-			AsciiGrid<double> *velTempGrid, *angTempGrid;
-#ifdef NINJAFOAM
-			AsciiGrid<double> *turbTempGrid;
-
-#endif
-			velTempGrid=NULL;
-			angTempGrid=NULL;
-#ifdef NINJAFOAM
-			turbTempGrid=NULL;
-#endif
-
 			KmlVector ninjaKmlFiles;
 
-			angTempGrid = new AsciiGrid<double> (AngleGrid.resample_Grid(input.kmzResolution, AsciiGrid<double>::order0));
-			velTempGrid = new AsciiGrid<double> (VelocityGrid.resample_Grid(input.kmzResolution, AsciiGrid<double>::order0));
-
 #ifdef NINJAFOAM
                         if(input.writeTurbulence)
                         {
-                            turbTempGrid = new AsciiGrid<double> (TurbulenceGrid.resample_Grid(input.kmzResolution, 
-                                        AsciiGrid<double>::order0));
-                            
                             ninjaKmlFiles.setTurbulenceFlag("true");
-                            ninjaKmlFiles.setTurbulenceGrid(*turbTempGrid, input.outputSpeedUnits);
+                            ninjaKmlFiles.setTurbulenceGrid(outputGrids.get(TurbulenceGrid, input.kmzResolution),
+                                                            input.outputSpeedUnits);
                         }
 #endif //NINJAFOAM
 
 			#ifdef FRICTION_VELOCITY
 			if(input.frictionVelocityFlag == 1){
-			    AsciiGrid<double> *ustarTempGrid;
-
-			    ustarTempGrid=NULL;
-
-                ustarTempGrid = new AsciiGrid<double> (UstarGrid.resample_Grid(input.kmzResolution, AsciiGrid<double>::order0));
-
                 ninjaKmlFiles.setUstarFlag(input.frictionVelocityFlag);
-                ninjaKmlFiles.setUstarGrid(*ustarTempGrid);
-
-                if(ustarTempGrid)
-                {
-                    delete ustarTempGrid;
-                    ustarTempGrid=NULL;
-                }
+                ninjaKmlFiles.setUstarGrid(outputGrids.get(UstarGrid, input.kmzResolution));
 			}
             #endif //FRICTION_VELOCITY
 
 			#ifdef EMISSIONS
 			if(input.dustFlag == 1){
-			    AsciiGrid<double> *dustTempGrid;
-
-                dustTempGrid=NULL;
-
-                dustTempGrid = new AsciiGrid<double> (DustGrid.resample_Grid(input.kmzResolution, AsciiGrid<double>::order0));
-
                 ninjaKmlFiles.setDustFlag(input.dustFlag);
-                ninjaKmlFiles.setDustGrid(*dustTempGrid);
-
-                if(dustTempGrid)
-                {
-                    delete dustTempGrid;
-                    dustTempGrid=NULL;
-                }
+                ninjaKmlFiles.setDustGrid(outputGrids.get(DustGrid, input.kmzResolution));
 			}
             #endif //EMISSIONS
 
@@ -3058,8 +3347,8 @@ void ninja::writeOutputFiles()
 
 			ninjaKmlFiles.setLegendFile(input.legFile);
 			ninjaKmlFiles.setDateTimeLegendFile(input.dateTimeLegFile, input.ninjaTime);
-			ninjaKmlFiles.setSpeedGrid(*velTempGrid, input.outputSpeedUnits);
-			ninjaKmlFiles.setDirGrid(*angTempGrid);
+			ninjaKmlFiles.setSpeedGrid(outputGrids.get(VelocityGrid, input.kmzResolution), input.outputSpeedUnits);
+			ninjaKmlFiles.setDirGrid(outputGrids.get(AngleGrid, input.kmzResolution));
 
             ninjaKmlFiles.setLineWidth(input.googLineWidth);
 			ninjaKmlFiles.setTime(input.ninjaTime);
@@ -3073,23 +3362,6 @@ void ninja::writeOutputFiles()
 				if(ninjaKmlFiles.makeKmz())
 					ninjaKmlFiles.removeKmlFile();
 			}
-			if(angTempGrid)
-			{
-				delete angTempGrid;
-				angTempGrid=NULL;
-			}
-			if(velTempGrid)
-			{
-				delete velTempGrid;
-				velTempGrid=NULL;
-			}
-#ifdef NINJAFOAM            
-			if(turbTempGrid)
-			{
-				delete turbTempGrid;
-				turbTempGrid=NULL;
-			}
-#endif
 		}
 	}catch (exception& e)
 	{
@@ -3105,34 +3377,15 @@ void ninja::writeOutputFiles()
 	try{
 		if(input.pdfOutFlag==true)
 		{
-			AsciiGrid<double> *velTempGrid, *angTempGrid;
-			velTempGrid=NULL;
-			angTempGrid=NULL;
             OutputWriter output;
 
-			angTempGrid = new AsciiGrid<double> (AngleGrid.resample_Grid(input.pdfResolution, AsciiGrid<double>::order0));
-			velTempGrid = new AsciiGrid<double> (VelocityGrid.resample_Grid(input.pdfResolution, AsciiGrid<double>::order0));
-
-			output.setDirGrid(*angTempGrid);
-			output.setSpeedGrid(*velTempGrid, input.outputSpeedUnits);
+			output.setDirGrid(outputGrids.get(AngleGrid, input.pdfResolution));
+			output.setSpeedGrid(outputGrids.get(VelocityGrid, input.pdfResolution), input.outputSpeedUnits);
             output.setDEMfile(input.pdfDEMFileName);
             output.setLineWidth(input.pdfLineWidth);
             output.setDPI(input.pdfDPI);
             output.setSize(input.pdfWidth, input.pdfHeight);
             output.write(input.pdfFile, "PDF");
-
-
-
-			if(angTempGrid)
-			{
-				delete angTempGrid;
-				angTempGrid=NULL;
-		}
-			if(velTempGrid)
-			{
-				delete velTempGrid;
-				velTempGrid=NULL;
-			}
 		}
 	}catch (exception& e)
 	{
@@ -3185,6 +3438,7 @@ void ninja::writeOutputFiles()
  */
 void ninja::deleteDynamicMemory()
 {
+	quadGeometry.reset();	//freed here unless it's shared through the domain cache
 	if(solar)
 	{	delete solar;
 		solar=NULL;
@@ -3226,11 +3480,13 @@ void ninja::deleteDynamicMemory()
 		SK=NULL;
 	}
 	if(col_ind)
-	{	delete[] col_ind;
+	{	if(!sharedStructure)
+			delete[] col_ind;
 		col_ind=NULL;
 	}
 	if(row_ptr)
-	{	delete[] row_ptr;
+	{	if(!sharedStructure)
+			delete[] row_ptr;
 		row_ptr=NULL;
 	}
 	if(RHS)
@@ -4234,6 +4490,30 @@ void ninja::set_memDs(GDALDatasetH hSpdMemDs, GDALDatasetH hDirMemDs, GDALDatase
     input.hDustMemDs = hDustMemDs;
 }
 
+/**
+ * Sets the multi-band output of the army this run is in.  The speed, direction
+ * and cloud cover grids are set in the run's band in writeOutputFiles(), in
+ * addition to the other outputs requested.
+ * @param cube Cube owned by the army, NULL to not use one.
+ * @param band Index of this run in the army.
+ */
+void ninja::set_outputCube(OutputCube *cube, int band)
+{
+    input.outputCube = cube;
+    input.outputCubeBand = band;
+}
+
+/**
+ * Sets the forecast cache of the army this run is in.  The weather model
+ * initialization takes the warped forecast bands from it instead of warping
+ * the forecast file again.
+ * @param cache Cache owned by the army, NULL to not use one.
+ */
+void ninja::set_forecastCache(ForecastCache *cache)
+{
+    input.forecastCache = cache;
+}
+
 /**
  * Sets the flag indicating whether station fetch is on or off 
  * @param flag true if station fetch is enbaled, otherwise false 
@@ -4516,6 +4796,99 @@ void ninja::set_numberCPUs(int CPUs)
     //ninjaCom(ninjaComClass::ninjaDebug, "In parallel = %d", omp_in_parallel());
 }
 
+/**
+ * @brief Start the solver from the solution of a previous run on the same mesh.
+ *
+ * When set, PHI is initialized from the vector passed to swap_warmStartPHI()
+ * (if it has one value per mesh node) instead of zero, and the converged PHI is
+ * kept at the end of simulate_wind() so it can be passed to the next run.
+ *
+ * @param flag true to warm start.
+ */
+void ninja::set_warmStart(bool flag)
+{
+    warmStart = flag;
+}
+
+/**
+ * @brief Exchange the warm start PHI with phi.
+ *
+ * Before simulate_wind(), pass the previous time step's solution; after it,
+ * the same call returns this run's solution.
+ *
+ * @param phi Vector to swap with the stored warm start PHI.
+ */
+void ninja::swap_warmStartPHI(std::vector<double> &phi)
+{
+    warmStartPHI.swap(phi);
+}
+
+/**
+ * @brief Number of conjugate gradient iterations in the last simulate_wind().
+ *
+ * @return The iterations, summed over all outer "matching" iterations.
+ */
+int ninja::get_solverIterations() const
+{
+    return solverIterations;
+}
+
+/**
+ * @brief Timings and solver counters of the last simulate_wind().
+ *
+ * @return The statistics, complete once the run is finished.
+ */
+const RunStatistics &ninja::get_runStatistics() const
+{
+    return runStats;
+}
+
+/**
+ * @brief Stiffness matrix of a run built with buildBatchEquations().
+ *
+ * @return The get_SKSize() nonzero entries in compressed row storage, or NULL
+ * if no equations are built.  Valid until finishBatchRun().
+ */
+const double *ninja::get_SK() const
+{
+    return SK;
+}
+
+/**
+ * @brief Right hand side of a run built with buildBatchEquations().
+ *
+ * @return The mesh.NUMNP entries, or NULL if no equations are built.  Valid
+ * until finishBatchRun().
+ */
+const double *ninja::get_RHS() const
+{
+    return RHS;
+}
+
+/**
+ * @brief Number of nonzero entries of get_SK().
+ *
+ * @return The entries, 0 if no equations are built.
+ */
+int ninja::get_SKSize() const
+{
+    return row_ptr ? row_ptr[mesh.NUMNP] : 0;
+}
+
+/**
+ * @brief Set the cache of domain data shared with other runs.
+ *
+ * If the mesh built in simulate_wind() matches the cached one, its coordinates
+ * and the SK sparsity structure are shared instead of being rebuilt.  The cache
+ * is read only, so it can be shared by runs on several threads.
+ *
+ * @param cache Cache built from a mesh on the same domain, or an empty pointer.
+ */
+void ninja::set_domainCache(boost::shared_ptr<const DomainCache> cache)
+{
+    domainCache = cache;
+}
+
 double* ninja::get_outputSpeedGrid()
 {
     outputSpeedArray = new double[VelocityGrid.get_arraySize()];
@@ -4771,6 +5144,15 @@ void ninja::set_vtkOutFlag(bool flag)
     input.volVTKOutFlag = flag;
 }
 
+void ninja::set_vtkWriteFormat(std::string format, bool useFloat32, bool compress)
+{
+    if(format != "ascii" && format != "binary" && format != "vts")
+        throw std::range_error("VTK write format must be \"ascii\", \"binary\" or \"vts\".");
+    input.volVTKWriteFormat = format;
+    input.volVTKFloat32 = useFloat32;
+    input.volVTKCompress = compress;
+}
+
 void ninja::set_outputPath(std::string path)
 {
     VSIStatBufL sStat;
@@ -4998,8 +5380,9 @@ void ninja::set_outputFilenames(double& meshResolution,
     //wxModelVelFile = "wxModel" + wxModelTimeAppend + "_vel.asc";
     //wxModelAngFile = "wxModel" + wxModelTimeAppend + "_ang.asc";
 
-    input.volVTKFile = rootFile + fileAppend + ".vtk";
-    input.volVTKFileInitial = rootFile + fileAppend + "_initial.vtk";
+    std::string vtkExtension = (input.volVTKWriteFormat == "vts") ? ".vts" : ".vtk";
+    input.volVTKFile = rootFile + fileAppend + vtkExtension;
+    input.volVTKFileInitial = rootFile + fileAppend + "_initial" + vtkExtension;
 
     input.legFile = rootFile + kmz_fileAppend + ".bmp";
     if( input.ninjaTime.is_not_a_date_time() )	//date and time not set?
@@ -68,10 +68,16 @@
 #include "KmlVector.h"
 #include "ShapeVector.h"
 #include "preconditioner.h"
+#include "sparseMatVec.h"
 #include "volVTK.h"
 #include "ninjaCom.h"
 #include "ninjaException.h"
 #include "mesh.h"
+#include "domainCache.h"
+#include "runStatistics.h"
+#include "outputCube.h"
+#include "forecastCache.h"
+#include "outputGridCache.h"
 #include "wn_3dArray.h"
 #include "wn_3dScalarField.h"
 #include "wn_3dVectorField.h"
@@ -128,6 +134,11 @@ public:
     ninja &operator=(const ninja &rhs);
 
     virtual bool simulate_wind();
+
+    //simulate_wind() in three steps, so the equations of several runs can be solved together
+    bool buildBatchEquations();
+    static void solveBatch(std::vector<ninja*> &runs, int numThreads);
+    bool finishBatchRun();
     inline virtual std::string identify() {return std::string("ninja");}
     bool cancel;	//if set to "false" during a simulation (ie when "simulate_wind()" is running), the simulation will attempt to end
     Mesh mesh;
@@ -185,6 +196,8 @@ public:
     void setSurfaceGrids();
 
     void set_memDs(GDALDatasetH hSpdMemDs, GDALDatasetH hDirMemDs, GDALDatasetH hDustMemDs); 
+    void set_outputCube(OutputCube *cube, int band);   //the run's grids are set in band of the army's cube
+    void set_forecastCache(ForecastCache *cache);   //forecast bands shared by the army's runs
     void setArmySize(int n);
     void set_DEM(std::string dem_file_name);		//Sets elevation filename (Should be in units of meters!)
     void set_DEM(const double* dem, const int nXSize, const int nYSize, const double* geoRef,
@@ -308,6 +321,14 @@ public:
     void set_position(double lat_degrees, double lat_minutes, double long_degrees, double long_minutes);	//input as degrees, decimal minutes
     void set_position(double lat_degrees, double lat_minutes, double lat_seconds, double long_degrees, double long_minutes, double long_seconds);	//input as degrees, minutes, seconds
     void set_numberCPUs(int CPUs);
+    void set_warmStart(bool flag);
+    void swap_warmStartPHI(std::vector<double> &phi);
+    int get_solverIterations() const;
+    const RunStatistics &get_runStatistics() const;
+    const double *get_SK() const;
+    const double *get_RHS() const;
+    int get_SKSize() const;
+    void set_domainCache(boost::shared_ptr<const DomainCache> cache);
     double *get_outputSpeedGrid();
     double *get_outputDirectionGrid();
     const char* get_outputGridProjection();
@@ -343,6 +364,7 @@ public:
     void set_asciiResolution(double Resolution, lengthUnits::eLengthUnits units);	//sets the output resolution of the velocity and angle ASCII grid output files, if negative value the computational mesh resolution is used
     void set_txtOutFlag(bool flag);
     void set_vtkOutFlag(bool flag);		//determines if VTK volume output files will be written
+    void set_vtkWriteFormat(std::string format, bool useFloat32, bool compress);	//"ascii", "binary" or "vts", the last two only apply to "vts"
     void set_pdfOutFlag(bool flag);
     void set_pdfResolution(double Resolution, lengthUnits::eLengthUnits units);
     void set_pdfDEM(std::string dem_file_name);
@@ -388,6 +410,13 @@ private:
     double *DIAG;
     double *PHI, *RHS, *SK;
     int *row_ptr, *col_ind;
+    bool warmStart;                     //start the solver from warmStartPHI, and keep the solution in it after the run
+    std::vector<double> warmStartPHI;   //initial guess for PHI (previous time step on the same mesh)
+    int solverIterations;               //CG iterations done in the last simulate_wind()
+    RunStatistics runStats;             //timings and solver counters of the last simulate_wind()
+    boost::shared_ptr<const DomainCache> domainCache;   //mesh and SK structure shared by runs on the same domain
+    bool sharedStructure;               //row_ptr and col_ind point into domainCache, don't delete them
+    boost::shared_ptr<const QuadratureGeometry> quadGeometry;  //precomputed element geometry (NINJA_QUADRATURE_CACHE), or empty
     double alphaH; //alpha horizontal from governing equation, weighting for change in horizontal winds
     double alpha;                //alpha = alphaH/alphaV, determined by stability
     AsciiGrid<double> *uDiurnal, *vDiurnal, *wDiurnal, *height;
@@ -440,10 +469,6 @@ private:
 
     double cblas_dnrm2(const int N, const double *X, const int incX);
 
-    void mkl_dcsrmv(char *transa, int *m, int *k, double *alpha, char *matdescra,
-                    double *val, int *indx, int *pntrb, int *pntre, double *x,
-                    double *beta, double *y);
-
     void cblas_dscal(const int N, const double alpha, double *X, const int incX);
     void mkl_trans_dcsrmv(char *transa, int *m, int *k, double *alpha, char *matdescra, double *val, int *indx, int *pntrb, int *pntre, double *x, double *beta, double *y);
 
@@ -476,8 +501,18 @@ private:
     //double stability_function(double z_over_L, double L_switch);
     bool writePrjFile(std::string inPrjString, std::string outFileName);
     bool checkForNullRun();
+    void startSimulation();
+    void initializeFlow();
+    void buildEquations();
+    void deleteEquations();
+    bool finishSimulation();
     void discretize(); 
+    void prepareQuadratureGeometry();
+    void computeElementEquations(element &elem, const int elemNum);
+    void addElementEquations(element &elem, const int elemNum, const bool useAtomics);
     void setBoundaryConditions();
+    void addElementGradient(element &elem, const int elemNum, const double *WGHT,
+                            double *uSum, double *vSum, double *wSum, double *diagSum);
     void computeUVWField();
     void prepareOutput();
     bool matched(int iter);
@@ -35,6 +35,9 @@
 */
 ninjaArmy::ninjaArmy()
 : writeFarsiteAtmFile(false)
+, warmStartSolver(false)
+, batchSolve(false)
+, outputCubeFormat("")
 {
     ninjas.push_back(new ninja());
     initLocalData();
@@ -49,6 +52,9 @@ ninjaArmy::ninjaArmy()
 #ifdef NINJAFOAM
 ninjaArmy::ninjaArmy(int numNinjas, bool momentumFlag)
 : writeFarsiteAtmFile(false)
+, warmStartSolver(false)
+, batchSolve(false)
+, outputCubeFormat("")
 {
     ninjas.resize(numNinjas);  //allocate vector with enough memory for all ninjas
     for(unsigned int i = 0; i < ninjas.size(); i++)
@@ -72,6 +78,9 @@ ninjaArmy::ninjaArmy(int numNinjas, bool momentumFlag)
 #ifndef NINJAFOAM
 ninjaArmy::ninjaArmy(int numNinjas)
 : writeFarsiteAtmFile(false)
+, warmStartSolver(false)
+, batchSolve(false)
+, outputCubeFormat("")
 {
     ninjas.resize(numNinjas);  //allocate vector with enough memory for all ninjas
     for(unsigned int i = 0; i < ninjas.size(); i++)
@@ -90,6 +99,11 @@ ninjaArmy::ninjaArmy(int numNinjas)
 ninjaArmy::ninjaArmy(const ninjaArmy& A)
 {
     writeFarsiteAtmFile = A.writeFarsiteAtmFile;
+    warmStartSolver = A.warmStartSolver;
+    batchSolve = A.batchSolve;
+    outputCubeFormat = A.outputCubeFormat;
+    wxStationList = A.wxStationList;
+    wxStationFileName = A.wxStationFileName;
     ninjas = A.ninjas;
     copyLocalData( A );
 }
@@ -115,6 +129,11 @@ ninjaArmy& ninjaArmy::operator= (ninjaArmy const& A)
     if(&A != this)
     {
         writeFarsiteAtmFile = A.writeFarsiteAtmFile;
+        warmStartSolver = A.warmStartSolver;
+        batchSolve = A.batchSolve;
+        outputCubeFormat = A.outputCubeFormat;
+        wxStationList = A.wxStationList;
+        wxStationFileName = A.wxStationFileName;
         ninjas = A.ninjas;
         copyLocalData( A );
     }
@@ -134,6 +153,11 @@ int ninjaArmy::getSize()
 
 /**
  * @brief ninjaArmy::makeStationArmy Makes an army (array) of ninjas for a Point Initialization run.
+ *
+ * The stations are kept once by the army and copied into a run when it is
+ * started (see setRunStations()), each run's copy holds the whole time series
+ * of every station.
+ *
  * @param timeList vector of simulation times
  * @param timeZone
  * @param stationFileName
@@ -212,23 +236,59 @@ void ninjaArmy::makeStationArmy(std::vector<boost::posix_time::ptime> timeList,
             boost::local_time::local_date_time aLocal(aGlobal, timeZonePtr);
             stationList[k].set_localDateTime(aLocal);
         }
+        if (wxStation::check_station(stationList[k])==false)
+        {
+            throw std::range_error("Error in weather station parameters.");
+        }
     }
+    if(stationFileName.empty())
+        throw std::runtime_error("Weather station filename empty in ninjaArmy::makeStationArmy().");
 
     for(unsigned int i = 0; i<timeList.size(); i++)
     {
         ninjas[i]->set_stationFetchFlag(true);
         ninjas[i]->set_date_time(localTimeList[i]);
-        for(int k=0; k<stationList.size(); k++)
-        {
-            stationList[k].set_currentTimeStep(ninjas[i]->get_date_time());
-        }
-        ninjas[i]->set_wxStations(stationList);
-        ninjas[i]->set_wxStationFilename(stationFileName);
-        //Setting the filename also implicitly sets the stations, set above
-        //in set_wxStations. Also it gets the units from the first station
-        //The function name is a bit misleading as to what it really does.
         ninjas[i]->set_initializationMethod(WindNinjaInputs::pointInitializationFlag, matchPoints);
-   }
+    }
+    wxStationList.swap(stationList);
+    wxStationFileName = stationFileName;
+}
+
+/**
+ * @brief Copies the stations of a point initialization army into a run.
+ *
+ * The stations are set to the time step of the run.  Nothing is done if the
+ * army wasn't made by makeStationArmy() or the run already has its stations.
+ *
+ * @param nIndex index of the run
+ */
+void ninjaArmy::setRunStations(int nIndex)
+{
+    if(wxStationList.empty() || !ninjas[nIndex]->input.stations.empty())
+        return;
+
+    std::vector<wxStation> stations = getRunStations(nIndex);
+    ninjas[nIndex]->set_wxStations(stations);
+    ninjas[nIndex]->set_wxStationFilename(wxStationFileName);
+    //Setting the filename also implicitly sets the stations, set above
+    //in set_wxStations. Also it gets the units from the first station
+    //The function name is a bit misleading as to what it really does.
+}
+
+/**
+ * @brief The stations of the army at the time step of a run.
+ *
+ * @param nIndex index of the run
+ * @return A copy of the army's stations
+ */
+std::vector<wxStation> ninjaArmy::getRunStations(int nIndex)
+{
+    std::vector<wxStation> stations(wxStationList);
+    for(unsigned int k=0; k<stations.size(); k++)
+    {
+        stations[k].set_currentTimeStep(ninjas[nIndex]->get_date_time());
+    }
+    return stations;
 }
 
 /**
@@ -255,6 +315,7 @@ void ninjaArmy::makeArmy(std::string forecastFilename, std::string timeZone, std
     wxModelInitialization* model;
     
     tz = timeZone;
+    wxStationList.clear();
     
     //for a list of paths forecast files
     if( strstr( forecastFilename.c_str(), ".csv" ) ){
@@ -361,6 +422,60 @@ void ninjaArmy::set_writeFarsiteAtmFile(bool flag)
     writeFarsiteAtmFile = flag;
 }
 
+/**
+* @brief Warm start the solver in a time series.
+*
+* The runs are done one after the other, each with all of the threads passed
+* to startRuns(), and the solver of each run starts from the solution of the
+* previous time step instead of zero.  This only helps when consecutive runs
+* use the same mesh (same DEM and resolution), like a wx model or point
+* initialization time series.
+*
+* @param flag true to warm start.
+*/
+void ninjaArmy::set_warmStartSolver(bool flag)
+{
+    warmStartSolver = flag;
+}
+
+/**
+* @brief Solve the equations of the runs in batches.
+*
+* Runs on the same mesh whose equations only differ in the right hand side
+* (like a domain average or wx model series without the stability option) are
+* solved together, sharing each sparse matrix product of the conjugate
+* gradient iterations.  Ignored for a warm started time series.  The batch size
+* is set with the NINJA_BATCH_SOLVE_SIZE config option.
+*
+* @param flag true to solve in batches.
+*/
+void ninjaArmy::set_batchSolve(bool flag)
+{
+    batchSolve = flag;
+}
+
+/**
+* @brief Write the output grids of all of the runs into one file per variable.
+*
+* The speed, direction and cloud cover grids of each run are set in its band
+* of a multi-band dataset, which is written once all of the runs are done, as
+* a tiled and compressed GeoTIFF or a CF netCDF file with a time dimension
+* (see OutputCube).  The files are named after the DEM ("windninja" for a DEM
+* without a file name), in the output path of the first run.  This is in
+* addition to the per-run outputs, which can be turned off.
+*
+* @param format "GTiff", "netCDF", or "" or "none" to not write a cube.
+*/
+void ninjaArmy::set_outputCubeFormat(std::string format)
+{
+    if(format.empty() || EQUAL(format.c_str(), "none"))
+        outputCubeFormat = "";
+    else if(OutputCube::isValidFormat(format))
+        outputCubeFormat = format;
+    else
+        throw std::runtime_error("The output cube format must be \"GTiff\", \"netCDF\" or \"none\".");
+}
+
 /**
 * @brief Function to start WindNinja core runs using multiple threads.
 *
@@ -395,6 +510,9 @@ bool ninjaArmy::startRuns(int numProcessors)
         throw;
     }
 
+    //statistics of the runs that are freed when they finish
+    runStatistics.assign(ninjas.size(), RunStatistics());
+
 #ifdef NINJAFOAM
     //if it's a ninjafoam run and the user specified an existing case dir, set it here
     if(ninjas[0]->identify() == "ninjafoam" & ninjas[0]->input.existingCaseDirectory != "!set"){
@@ -547,6 +665,7 @@ bool ninjaArmy::startRuns(int numProcessors)
         //set number of threads for the run
         ninjas[0]->set_numberCPUs(numProcessors);
         try{
+            setRunStations(0);
 
             if ((ninjas[0]->identify() == "ninjafoam") && ninjas[0]->input.diurnalWinds)
             {
@@ -694,6 +813,7 @@ bool ninjaArmy::startRuns(int numProcessors)
                 //delete all but ninjas[0] (ninjas[0] is used to set the output path in the GUI)
                 if( i != 0  )
                 {
+                    runStatistics[i] = ninjas[i]->get_runStatistics();
                     delete ninjas[i];
                     ninjas[i] = NULL;
                 }
@@ -748,10 +868,14 @@ bool ninjaArmy::startRuns(int numProcessors)
 #endif //NINJAFOAM            
     else
     {
+        //a warm started time series runs in order, with the threads used inside each solve
+        const bool warmStart = warmStartSolver;
         for(unsigned int i = 0; i < ninjas.size(); i++)
         {
-            ninjas[i]->set_numberCPUs(1);
+            ninjas[i]->set_warmStart(warmStart);
         }
+        std::vector<double> warmStartPHI;   //solution of the previous time step
+        int coldStartIterations = -1;
 
         /*FOR_EVERY(iter_ninja, ninjas)
         {
@@ -770,6 +894,25 @@ bool ninjaArmy::startRuns(int numProcessors)
         ninjas[0]->set_position();
         ninjas[0]->set_uniVegetation();
         ninjas[0]->mesh.buildStandardMesh(ninjas[0]->input);
+
+        //share the mesh coordinates, SK structure and diurnal hill/valley walks between
+        //the runs, they're all on the same DEM
+        const bool sharedDomain = CSLTestBoolean( CPLGetConfigOption( "NINJA_ARMY_DOMAIN_CACHE", "YES" ) );
+        if( sharedDomain )
+        {
+            const bool withQuadratureGeometry =
+                CSLTestBoolean( CPLGetConfigOption( "NINJA_QUADRATURE_CACHE", "NO" ) );
+            boost::shared_ptr<const DomainCache> domainCache( new DomainCache( ninjas[0]->mesh,
+                                                                              withQuadratureGeometry,
+                                                                              numProcessors ) );
+            for( unsigned int i = 0; i < ninjas.size(); i++ )
+            {
+                ninjas[i]->set_domainCache( domainCache );
+                ninjas[i]->input.dem.share_hillValleyField( ninjas[0]->input.dem );
+            }
+            CPLDebug( "NINJA", "Domain cache shared by %d runs: %.1lf MB",
+                      (int)ninjas.size(), domainCache->get_bytes() / (1024.0 * 1024.0) );
+        }
         
         int nXSize = ninjas[0]->input.dem.get_nCols(); //57; 
         int nYSize = ninjas[0]->input.dem.get_nRows(); //70; 
@@ -780,112 +923,209 @@ bool ninjaArmy::startRuns(int numProcessors)
         hDirMemDS = GDALCreate(hDriver, "", nXSize, nYSize, 1, GDT_Float64, NULL);
         hDustMemDS = GDALCreate(hDriver, "", nXSize, nYSize, 1, GDT_Float64, NULL);
 
-	#pragma omp parallel for //spread runs on single threads
-        //FOR_EVERY(iter_ninja, ninjas) //Doesn't work with omp
-        for( int i = 0; i < ninjas.size(); i++ )
+        //one multi-band file per output variable for the whole army
+        boost::shared_ptr<OutputCube> outputCube;
+        if( !outputCubeFormat.empty() )
         {
-            try
+            outputCube.reset( new OutputCube( outputCubeFormat, ninjas.size() ) );
+            for( unsigned int i = 0; i < ninjas.size(); i++ )
+                ninjas[i]->set_outputCube( outputCube.get(), i );
+        }
+
+        //warp each forecast variable once for all of the time steps, not for a list of
+        //forecast files where each run reads its own file
+        boost::shared_ptr<ForecastCache> forecastCache;
+        if( ninjas.size() > 1 && wxList.size() <= 1 &&
+            ninjas[0]->get_initializationMethod() == WindNinjaInputs::wxModelInitializationFlag &&
+            CSLTestBoolean( CPLGetConfigOption( "NINJA_FORECAST_CACHE", "YES" ) ) )
+        {
+            forecastCache.reset( new ForecastCache() );
+            for( unsigned int i = 0; i < ninjas.size(); i++ )
+                ninjas[i]->set_forecastCache( forecastCache.get() );
+        }
+
+        //runs are started in order as the ones in memory finish, at most maxRunsInFlight at a time
+        const int maxRunsInFlight = getMaxRunsInFlight(sharedDomain);
+
+        //solve the runs' equations together, in batches of runs on the same mesh
+        const bool batched = batchSolve && !warmStart && wxList.size() <= 1;
+
+        //split the threads between concurrent runs and the solver of each run,
+        //a batch is solved with all of the threads
+        int threadsPerRun = 1;
+        if(warmStart)
+            threadsPerRun = numProcessors;
+        else if(!batched)
+            threadsPerRun = getThreadsPerRun(numProcessors, maxRunsInFlight);
+        const int runThreads = std::max(1, std::min(numProcessors / threadsPerRun, maxRunsInFlight));
+        //the regions of a run take num_threads(input.numberCPUs), or the count its
+        //thread sets when the run starts (see ninja::startSimulation())
+        for(unsigned int i = 0; i < ninjas.size(); i++)
+        {
+            ninjas[i]->set_numberCPUs(threadsPerRun);
+        }
+
+        if(batched)
+        {
+            status = startBatchedRuns(numProcessors, maxRunsInFlight, anErrors, asMessages) && status;
+        }
+        else
+        {
+#ifdef _OPENMP
+            omp_set_nested(threadsPerRun > 1 && !warmStart);  //the solver regions of a run nest in the run loop
+#endif
+            #pragma omp parallel for if(!warmStart) num_threads(runThreads) schedule(dynamic, 1) //spread runs on runThreads partitions of threadsPerRun threads
+            //FOR_EVERY(iter_ninja, ninjas) //Doesn't work with omp
+            for( int i = 0; i < ninjas.size(); i++ )
             {
-                //list of paths to forecast files, possibly in various zip archives
-                if( wxList.size() > 1 )
+                try
                 {
-                    wxModelInitialization* model;
-                    model = wxModelInitializationFactory::makeWxInitialization(wxList[i]); 
+                    //list of paths to forecast files, possibly in various zip archives
+                    if( wxList.size() > 1 )
+                    {
+                        wxModelInitialization* model;
+                        model = wxModelInitializationFactory::makeWxInitialization(wxList[i]); 
                 
-                    timeList = model->getTimeList(tz);
-                    ninjas[i]->set_date_time(timeList[0]);
-                    ninjas[i]->set_wxModelFilename( wxList[i] );
-                    ninjas[i]->set_date_time( timeList[0] );
-                    //set in-memory datasets for GTiff output writer
-                    ninjas[i]->set_memDs(hSpdMemDS, hDirMemDS, hDustMemDS); 
+                        timeList = model->getTimeList(tz);
+                        ninjas[i]->set_date_time(timeList[0]);
+                        ninjas[i]->set_wxModelFilename( wxList[i] );
+                        ninjas[i]->set_date_time( timeList[0] );
+                        //set in-memory datasets for GTiff output writer
+                        ninjas[i]->set_memDs(hSpdMemDS, hDirMemDS, hDustMemDS); 
                     
-                    delete model;
-                }
+                        delete model;
+                    }
 
-                //start the run
-                ninjas[i]->simulate_wind();	//runs are done on 1 thread each since omp_set_nested(false)
+                    setRunStations(i);
+
+                    if(warmStart)
+                        ninjas[i]->swap_warmStartPHI(warmStartPHI);
+
+                    //start the run
+                    ninjas[i]->simulate_wind();
+
+                    if(warmStart)
+                    {
+                        ninjas[i]->swap_warmStartPHI(warmStartPHI);
+                        if(coldStartIterations < 0)
+                        {
+                            coldStartIterations = ninjas[i]->get_solverIterations();
+                            ninjas[i]->input.Com->ninjaCom(ninjaComClass::ninjaNone,
+                                    "Warm start: time step %d took %d CG iterations from a cold start.",
+                                    i, coldStartIterations);
+                        }else
+                        {
+                            ninjas[i]->input.Com->ninjaCom(ninjaComClass::ninjaNone,
+                                    "Warm start: time step %d took %d CG iterations (%.0f%% fewer than the cold start).",
+                                    i, ninjas[i]->get_solverIterations(),
+                                    coldStartIterations > 0 ?
+                                    100.0 * (coldStartIterations - ninjas[i]->get_solverIterations()) / coldStartIterations : 0.0);
+                        }
+                    }
 
-                //store data for atmosphere file
-                if(writeFarsiteAtmFile)
-                {
-                    atmosphere.push( ninjas[i]->get_date_time(),   ninjas[i]->get_VelFileName(),
-                                     ninjas[i]->get_AngFileName(), ninjas[i]->get_CldFileName() );
-                }
+                    //store data for atmosphere file
+                    if(writeFarsiteAtmFile)
+                    {
+                        atmosphere.push( ninjas[i]->get_date_time(),   ninjas[i]->get_VelFileName(),
+                                         ninjas[i]->get_AngFileName(), ninjas[i]->get_CldFileName() );
+                    }
 
-                //delete all but ninjas[0] (ninjas[0] is used to set the output path in the GUI)
-                if( i != 0  )
-                {
-                    delete ninjas[i];
-                    ninjas[i] = NULL;
-                }
+                    //delete all but ninjas[0] (ninjas[0] is used to set the output path in the GUI)
+                    if( i != 0  )
+                    {
+                        runStatistics[i] = ninjas[i]->get_runStatistics();
+                        delete ninjas[i];
+                        ninjas[i] = NULL;
+                    }
 
-            }catch (bad_alloc& e)
-            {
+                }catch (bad_alloc& e)
+                {
 #ifdef _OPENMP
-                anErrors[omp_get_thread_num()] = STD_BAD_ALLOC_EXC;
-                asMessages[omp_get_thread_num()] = "Exception bad_alloc caught:";
-                asMessages[omp_get_thread_num()] += e.what();
-                asMessages[omp_get_thread_num()] += "\n";
-                status = false;
+                    anErrors[omp_get_thread_num()] = STD_BAD_ALLOC_EXC;
+                    asMessages[omp_get_thread_num()] = "Exception bad_alloc caught:";
+                    asMessages[omp_get_thread_num()] += e.what();
+                    asMessages[omp_get_thread_num()] += "\n";
+                    status = false;
 #else
-                throw;
+                    throw;
 #endif
-            }catch (logic_error& e)
-            {
+                }catch (logic_error& e)
+                {
 #ifdef _OPENMP
-                anErrors[omp_get_thread_num()] = STD_LOGIC_EXC;
-                asMessages[omp_get_thread_num()] = "Exception logic_error caught:";
-                asMessages[omp_get_thread_num()] += e.what();
-                asMessages[omp_get_thread_num()] += "\n";
-                status = false;
+                    anErrors[omp_get_thread_num()] = STD_LOGIC_EXC;
+                    asMessages[omp_get_thread_num()] = "Exception logic_error caught:";
+                    asMessages[omp_get_thread_num()] += e.what();
+                    asMessages[omp_get_thread_num()] += "\n";
+                    status = false;
 #else
-                throw;
+                    throw;
 #endif
-             }catch (cancelledByUser& e)
-            {
+                 }catch (cancelledByUser& e)
+                {
 #ifdef _OPENMP
-                anErrors[omp_get_thread_num()] = NINJA_CANCEL_USER_EXC;
-                asMessages[omp_get_thread_num()] = "Exception cacneled by user caught:";
-                asMessages[omp_get_thread_num()] + e.what();
-                asMessages[omp_get_thread_num()] += "\n";
-                status = false;
+                    anErrors[omp_get_thread_num()] = NINJA_CANCEL_USER_EXC;
+                    asMessages[omp_get_thread_num()] = "Exception cacneled by user caught:";
+                    asMessages[omp_get_thread_num()] + e.what();
+                    asMessages[omp_get_thread_num()] += "\n";
+                    status = false;
 #else
-                throw;
+                    throw;
 #endif
-            }catch (badForecastFile& e)
-            {
+                }catch (badForecastFile& e)
+                {
 #ifdef _OPENMP
-                anErrors[omp_get_thread_num()] = NINJA_BAD_FORECAST_EXC;
-                asMessages[omp_get_thread_num()] = "Exception badForecastFile caught:";
-                asMessages[omp_get_thread_num()] + e.what();
-                asMessages[omp_get_thread_num()] += "\n";
-                status = false;
+                    anErrors[omp_get_thread_num()] = NINJA_BAD_FORECAST_EXC;
+                    asMessages[omp_get_thread_num()] = "Exception badForecastFile caught:";
+                    asMessages[omp_get_thread_num()] + e.what();
+                    asMessages[omp_get_thread_num()] += "\n";
+                    status = false;
 #else
-                throw;
+                    throw;
 #endif
-            }catch (exception& e)
-            {
+                }catch (exception& e)
+                {
 #ifdef _OPENMP
-                anErrors[omp_get_thread_num()] = STD_EXC;
-                asMessages[omp_get_thread_num()] = "Exception caught:";
-                asMessages[omp_get_thread_num()] + e.what();
-                asMessages[omp_get_thread_num()] += "\n";
-                status = false;
+                    anErrors[omp_get_thread_num()] = STD_EXC;
+                    asMessages[omp_get_thread_num()] = "Exception caught:";
+                    asMessages[omp_get_thread_num()] + e.what();
+                    asMessages[omp_get_thread_num()] += "\n";
+                    status = false;
 #else
-                throw;
+                    throw;
 #endif
-            }catch (...)
-            {
+                }catch (...)
+                {
 #ifdef _OPENMP
-                anErrors[omp_get_thread_num()] = STD_UNKNOWN_EXC;
-                asMessages[omp_get_thread_num()] = "Unknown Exception caught:";
-                asMessages[omp_get_thread_num()] += "\n";
-                status = false;
+                    anErrors[omp_get_thread_num()] = STD_UNKNOWN_EXC;
+                    asMessages[omp_get_thread_num()] = "Unknown Exception caught:";
+                    asMessages[omp_get_thread_num()] += "\n";
+                    status = false;
 #else
-                throw;
+                    throw;
 #endif
+                }
             }
         }
+#ifdef _OPENMP
+        omp_set_nested(false);
+        omp_set_num_threads(numProcessors);
+#endif
+        if(outputCube)
+        {
+            //runs that failed aren't deleted, the cube is freed with this scope
+            for( unsigned int i = 0; i < ninjas.size(); i++ )
+                if( ninjas[i] != NULL )
+                    ninjas[i]->set_outputCube( NULL, 0 );
+        }
+        if(forecastCache)
+        {
+            CPLDebug( "NINJA", "Forecast cache: %.1lf MB",
+                      forecastCache->get_bytes() / (1024.0 * 1024.0) );
+            //runs that failed aren't deleted, the cache is freed with this scope
+            for( unsigned int i = 0; i < ninjas.size(); i++ )
+                if( ninjas[i] != NULL )
+                    ninjas[i]->set_forecastCache( NULL );
+        }
 #ifdef _OPENMP
         NinjaRethrowThreadedException( anErrors, asMessages, numProcessors );
 #endif
@@ -894,6 +1134,20 @@ bool ninjaArmy::startRuns(int numProcessors)
             if(writeFarsiteAtmFile)
                 writeFarsiteAtmosphereFile();
 
+            if(outputCube)
+            {
+                //a DEM set from memory through the API may not have a name
+                std::string baseName = CPLGetBasename( ninjas[0]->input.dem.fileName.c_str() );
+                if( baseName.empty() )
+                    baseName = "windninja";
+                std::string rootFilename = CPLFormFilename( ninjas[0]->get_outputPath().c_str(),
+                        baseName.c_str(), NULL );
+                std::vector<std::string> cubeFiles = outputCube->write( rootFilename + "_cube" );
+                for( unsigned int i = 0; i < cubeFiles.size(); i++ )
+                    ninjas[0]->input.Com->ninjaCom( ninjaComClass::ninjaNone,
+                            "Output cube written to %s", cubeFiles[i].c_str() );
+            }
+
         }catch (bad_alloc& e)
         {
             std::cout << "Exception bad_alloc caught: " << e.what() << endl;
@@ -921,6 +1175,293 @@ bool ninjaArmy::startRuns(int numProcessors)
     return status;
 }
 
+/*
+** Store the exception being handled for NinjaRethrowThreadedException(), must
+** be called from a catch block.
+*/
+static void StoreThreadedException( int &nError, std::string &sMessage )
+{
+    try
+    {
+        throw;
+    }catch (bad_alloc& e)
+    {
+        nError = STD_BAD_ALLOC_EXC;
+        sMessage = "Exception bad_alloc caught:";
+        sMessage += e.what();
+    }catch (logic_error& e)
+    {
+        nError = STD_LOGIC_EXC;
+        sMessage = "Exception logic_error caught:";
+        sMessage += e.what();
+    }catch (cancelledByUser& e)
+    {
+        nError = NINJA_CANCEL_USER_EXC;
+        sMessage = "Exception cacneled by user caught:";
+        sMessage += e.what();
+    }catch (badForecastFile& e)
+    {
+        nError = NINJA_BAD_FORECAST_EXC;
+        sMessage = "Exception badForecastFile caught:";
+        sMessage += e.what();
+    }catch (exception& e)
+    {
+        nError = STD_EXC;
+        sMessage = "Exception caught:";
+        sMessage += e.what();
+    }catch (...)
+    {
+        nError = STD_UNKNOWN_EXC;
+        sMessage = "Unknown Exception caught:";
+    }
+    sMessage += "\n";
+}
+
+/**
+ * @brief Do the runs of startRuns() with their equations solved in batches.
+ *
+ * Runs are taken NINJA_BATCH_SOLVE_SIZE (default 8) at a time.  The equations
+ * of a batch are built in parallel, one run per thread, then solved together
+ * with all of the threads (see ninja::solveBatch()), then the runs are
+ * finished and written in parallel.  Runs on the same mesh with a constant
+ * alphaVfield (no stability) have the same matrix, only the right hand sides
+ * differ, so one sparse product per iteration serves the whole batch.  Runs
+ * whose matrix differs from the first run of the batch are solved on their
+ * own.  Each run of a batch holds its equations until the batch is solved,
+ * plus 4 doubles per mesh node of solver work space, so the batch size is
+ * capped by the memory budget.
+ *
+ * @param numProcessors Number of processors to use.
+ * @param maxRunsInFlight Largest batch that fits the memory budget, see
+ * getMaxRunsInFlight().
+ * @param anErrors Per thread error codes for NinjaRethrowThreadedException().
+ * @param asMessages Per thread error messages.
+ * @return true if the runs complete properly.
+ */
+bool ninjaArmy::startBatchedRuns(int numProcessors, int maxRunsInFlight, std::vector<int> &anErrors,
+                                 std::vector<std::string> &asMessages)
+{
+    bool status = true;
+    int batchSize = atoi( CPLGetConfigOption( "NINJA_BATCH_SOLVE_SIZE", "8" ) );
+    if( batchSize > maxRunsInFlight )
+        batchSize = maxRunsInFlight;    //each run of a batch holds its equations until the batch is solved
+    if( batchSize < 1 )
+        batchSize = 1;
+
+    for( int first = 0; first < (int)ninjas.size(); first += batchSize )
+    {
+        const int last = std::min( first + batchSize, (int)ninjas.size() );
+        std::vector<ninja*> batchRuns( ninjas.begin() + first, ninjas.begin() + last );
+
+        //read the inputs and build the equations, one run per thread
+        #pragma omp parallel for num_threads(numProcessors)
+        for( int i = first; i < last; i++ )
+        {
+            try
+            {
+                setRunStations(i);
+                ninjas[i]->buildBatchEquations();
+            }catch (...)
+            {
+#ifdef _OPENMP
+                StoreThreadedException( anErrors[omp_get_thread_num()],
+                                        asMessages[omp_get_thread_num()] );
+                status = false;
+#else
+                throw;
+#endif
+            }
+        }
+#ifdef _OPENMP
+        NinjaRethrowThreadedException( anErrors, asMessages, numProcessors );
+#endif
+
+        //solve the batch with all of the threads
+        ninja::solveBatch( batchRuns, numProcessors );
+
+        //finish the runs and write the outputs, one run per thread
+        #pragma omp parallel for num_threads(numProcessors)
+        for( int i = first; i < last; i++ )
+        {
+            try
+            {
+                ninjas[i]->finishBatchRun();
+
+                //store data for atmosphere file
+                if(writeFarsiteAtmFile)
+                {
+                    #pragma omp critical
+                    atmosphere.push( ninjas[i]->get_date_time(),   ninjas[i]->get_VelFileName(),
+                                     ninjas[i]->get_AngFileName(), ninjas[i]->get_CldFileName() );
+                }
+
+                //delete all but ninjas[0] (ninjas[0] is used to set the output path in the GUI)
+                if( i != 0  )
+                {
+                    runStatistics[i] = ninjas[i]->get_runStatistics();
+                    delete ninjas[i];
+                    ninjas[i] = NULL;
+                }
+            }catch (...)
+            {
+#ifdef _OPENMP
+                StoreThreadedException( anErrors[omp_get_thread_num()],
+                                        asMessages[omp_get_thread_num()] );
+                status = false;
+#else
+                throw;
+#endif
+            }
+        }
+#ifdef _OPENMP
+        NinjaRethrowThreadedException( anErrors, asMessages, numProcessors );
+#endif
+    }
+
+    return status;
+}
+
+/**
+ * @brief Number of runs of the army that can be in memory at the same time.
+ *
+ * Without NINJA_ARMY_MEMORY_BUDGET this is the size of the army.  With it, it
+ * is the number of runs whose equations and grids fit in that many MB,
+ * estimated from the mesh and DEM of the first run, and at least 1.  Runs
+ * that aren't started yet hold their settings, and their DEM if it was set
+ * from memory, which is taken out of the budget (see fitRunsInBudget()).
+ * A run is started when another one has written its outputs, and the runs
+ * at once are also capped by the thread partitions (see getThreadsPerRun())
+ * and cap the size of a batch (see startBatchedRuns()).  With CPL_DEBUG=NINJA
+ * the estimate is printed.
+ *
+ * @param sharedDomain true if the runs share the mesh coordinates and the
+ * stiffness matrix structure through a DomainCache.
+ * @return Largest number of runs to have started and not finished.
+ */
+int ninjaArmy::getMaxRunsInFlight(bool sharedDomain)
+{
+    const double budgetMB = atof( CPLGetConfigOption( "NINJA_ARMY_MEMORY_BUDGET", "0" ) );
+    if( budgetMB <= 0.0 )
+        return ninjas.size();
+
+    const Mesh &mesh = ninjas[0]->mesh;
+    const double nCells = (double)ninjas[0]->input.dem.get_nRows() * ninjas[0]->input.dem.get_nCols();
+    const double runBytes = estimateRunBytes( mesh.NUMNP, DomainCache::countNonZero( mesh ),
+                                              nCells, sharedDomain );
+
+    //DEMs set from memory are already read into the runs that aren't started
+    double residentBytes = 0.0;
+    for( unsigned int i = 1; i < ninjas.size(); i++ )
+        residentBytes += (double)ninjas[i]->input.dem.get_nRows() *
+                         ninjas[i]->input.dem.get_nCols() * sizeof(double);
+
+    const int maxRuns = fitRunsInBudget( budgetMB * 1024.0 * 1024.0, runBytes, residentBytes,
+                                         ninjas.size() );
+    CPLDebug( "NINJA", "Memory budget of %.0lf MB: %d runs at a time of about %.1lf MB each, "
+              "%.1lf MB of DEMs waiting", budgetMB, maxRuns, runBytes / (1024.0 * 1024.0),
+              residentBytes / (1024.0 * 1024.0) );
+    return maxRuns;
+}
+
+/**
+ * @brief Memory used by one run while it is in flight.
+ *
+ * Counts the stiffness matrix, 13 vectors of mesh nodes (PHI, RHS, DIAG, u0,
+ * v0, w0, u, v, w and the solver work space) and about 24 grids of DEM cells.
+ * Without a shared domain the run also holds its own matrix structure and mesh
+ * coordinates.
+ *
+ * @param nNodes Number of mesh nodes.
+ * @param nNonZero Number of stored entries of the stiffness matrix.
+ * @param nCells Number of DEM cells.
+ * @param sharedDomain true if the runs share a DomainCache.
+ * @return Size in bytes.
+ */
+double ninjaArmy::estimateRunBytes(double nNodes, double nNonZero, double nCells, bool sharedDomain)
+{
+    double runBytes = nNonZero * sizeof(double) + 13.0 * nNodes * sizeof(double) +
+                      24.0 * nCells * sizeof(double);
+    if( !sharedDomain )
+        runBytes += nNonZero * sizeof(int) + nNodes * (sizeof(int) + 3 * sizeof(double));
+    return runBytes;
+}
+
+/**
+ * @brief Number of runs that fit in a memory budget at the same time.
+ *
+ * The first run isn't deleted when it is done (the GUI reads its output
+ * path), so one run of the budget is kept for it on top of the runs in
+ * flight.
+ *
+ * @param budgetBytes Memory the army may use.
+ * @param runBytes Memory of a run in flight, see estimateRunBytes().
+ * @param residentBytes Memory held by the runs that aren't started.
+ * @param nRuns Number of runs in the army.
+ * @return Runs in flight, from 1 to nRuns.
+ */
+int ninjaArmy::fitRunsInBudget(double budgetBytes, double runBytes, double residentBytes, int nRuns)
+{
+    const double available = budgetBytes - residentBytes - runBytes;
+    int maxRuns = available > 0.0 ? (int)( available / runBytes ) : 0;
+    return std::max( 1, std::min( maxRuns, nRuns ) );
+}
+
+/**
+ * @brief Number of threads each run of a multi-run simulation solves with.
+ *
+ * See splitThreads(), with NINJA_ARMY_THREADS_PER_RUN and
+ * NINJA_ARMY_NODES_PER_THREAD and the mesh of the first run.  The threads are
+ * split into partitions of this size and one run is solved in each partition
+ * at a time.  With CPL_DEBUG=NINJA the split is printed.  Warm started runs
+ * use all of the threads for one run at a time, and batched runs aren't split.
+ *
+ * @param numProcessors Number of processors to use.
+ * @param maxRunsInFlight Largest number of runs in memory at once, see
+ * getMaxRunsInFlight().
+ * @return Threads per run, from 1 to numProcessors.
+ */
+int ninjaArmy::getThreadsPerRun(int numProcessors, int maxRunsInFlight)
+{
+    const int threadsPerRun =
+        splitThreads( numProcessors, ninjas.size(), maxRunsInFlight, ninjas[0]->mesh.NUMNP,
+                      atoi( CPLGetConfigOption( "NINJA_ARMY_THREADS_PER_RUN", "0" ) ),
+                      atoi( CPLGetConfigOption( "NINJA_ARMY_NODES_PER_THREAD", "20000" ) ) );
+
+    CPLDebug( "NINJA", "%d threads: %d runs at a time with %d threads each",
+              numProcessors, std::max( 1, std::min( numProcessors / threadsPerRun, maxRunsInFlight ) ),
+              threadsPerRun );
+    return threadsPerRun;
+}
+
+/**
+ * @brief Split the threads between concurrent runs and the solver of each run.
+ *
+ * The threads are first spread over the runs that can be in flight at once,
+ * the ones left over go to the solver of each run, e.g. 48 threads and 6 runs
+ * give 8 threads per run.  A run gets at most one thread per nodesPerThread
+ * mesh nodes, the solver doesn't scale on less work than that.
+ *
+ * @param numProcessors Number of processors to use.
+ * @param nRuns Number of runs in the army.
+ * @param maxRunsInFlight Largest number of runs in memory at once.
+ * @param nNodes Number of mesh nodes of a run.
+ * @param threadsPerRun Threads per run to use instead of the split, 0 to split.
+ * @param nodesPerThread Fewest mesh nodes per solver thread, 0 for no limit.
+ * @return Threads per run, from 1 to numProcessors.
+ */
+int ninjaArmy::splitThreads(int numProcessors, int nRuns, int maxRunsInFlight, int nNodes,
+                            int threadsPerRun, int nodesPerThread)
+{
+    if( threadsPerRun < 1 )
+    {
+        const int runsInFlight = std::max( 1, std::min( nRuns, maxRunsInFlight ) );
+        threadsPerRun = numProcessors / runsInFlight;
+        if( nodesPerThread > 0 )
+            threadsPerRun = std::min( threadsPerRun, nNodes / nodesPerThread );
+    }
+    return std::max( 1, std::min( threadsPerRun, numProcessors ) );
+}
+
 /**
  *  @brief Function to start the first ninja run using 1 thread.
  *
@@ -938,6 +1479,8 @@ bool ninjaArmy::startFirstRun()
     ninjas[0]->set_numberCPUs(1);
     try
     {
+        setRunStations(0);
+
         //start the run
         if(!ninjas[0]->simulate_wind())
             printf("Return of false from simulate_wind()");
@@ -1568,6 +2111,7 @@ int ninjaArmy::setWxStationFilename( const int nIndex, const std::string station
                           char ** papszOptions )
 {
     IF_VALID_INDEX_TRY( nIndex, ninjas,
+            setRunStations( nIndex );
             ninjas[ nIndex ]->set_wxStationFilename( station_filename ) );
 }
 
@@ -1575,6 +2119,10 @@ std::vector<wxStation> ninjaArmy::getWxStations( const int nIndex, char ** papsz
 {
     IF_VALID_INDEX( nIndex, ninjas )
     {
+        if( ninjas[ nIndex ] == NULL )
+            return std::vector<wxStation>(); //the run is done and freed
+        if( !wxStationList.empty() && ninjas[ nIndex ]->input.stations.empty() )
+            return getRunStations( nIndex ); //not started yet
         return ninjas[ nIndex ]->get_wxStations();
     }
     std::vector<wxStation> none;
@@ -1795,6 +2343,17 @@ const int ninjaArmy::getOutputGridnRows( const int nIndex, char ** papszOptions
         return ninjas[ nIndex ]->get_outputGridnRows( );
     }
 }
+const RunStatistics* ninjaArmy::getRunStatistics( const int nIndex, char ** papszOptions )
+{
+    IF_VALID_INDEX( nIndex, ninjas )
+    {
+        if( ninjas[ nIndex ] != NULL )
+            return &ninjas[ nIndex ]->get_runStatistics( );
+        if( nIndex >= 0 && nIndex < (int)runStatistics.size() )
+            return &runStatistics[ nIndex ];
+    }
+    return NULL;
+}
 int ninjaArmy::setOutputBufferClipping( const int nIndex, const double percent,
                                         char ** papszOptions )
 {
@@ -1986,6 +2545,14 @@ int ninjaArmy::setVtkOutFlag( const int nIndex, const bool flag, char ** papszOp
             ninjas[ nIndex ]->set_vtkOutFlag( flag ) );
 }
 
+int ninjaArmy::setVtkWriteFormat( const int nIndex, std::string format,
+                                  const bool useFloat32, const bool compress,
+                                  char ** papszOptions )
+{
+    IF_VALID_INDEX_TRY( nIndex, ninjas,
+            ninjas[ nIndex ]->set_vtkWriteFormat( format, useFloat32, compress ) );
+}
+
 int ninjaArmy::setTxtOutFlag( const int nIndex, const bool flag, char ** papszOptions )
 {
     IF_VALID_INDEX_TRY( nIndex, ninjas,
@@ -2065,7 +2632,13 @@ std::string ninjaArmy::getOutputPath( const int nIndex, char ** papszOptions )
 void ninjaArmy::reset()
 {
     ninjas.clear();
+    runStatistics.clear();
     writeFarsiteAtmFile = false;
+    warmStartSolver = false;
+    batchSolve = false;
+    outputCubeFormat = "";
+    wxStationList.clear();
+    wxStationFileName = "";
 }
 
 void ninjaArmy::cancel()
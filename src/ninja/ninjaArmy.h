@@ -41,6 +41,7 @@
 #include "ninja_init.h"
 #include "ninja_threaded_exception.h"
 #include "farsiteAtm.h"
+#include "outputCube.h"
 #include "wxModelInitializationFactory.h"
 #include "ninja_errors.h"
 #include <algorithm>
@@ -141,6 +142,9 @@ public:
     void makeArmy(std::string forecastFilename, std::string timeZone, bool momentumFlag);
     void makeArmy(std::string forecastFilename, std::string timeZone, std::vector<blt::local_date_time> times, bool momentumFlag);
     void set_writeFarsiteAtmFile(bool flag);
+    void set_warmStartSolver(bool flag);
+    void set_batchSolve(bool flag);
+    void set_outputCubeFormat(std::string format);
     bool startRuns(int numProcessors);
     bool startFirstRun();
     
@@ -488,6 +492,12 @@ public:
     */
     int setDEM( const int nIndex, const std::string dem_filename, char ** papszOptions=NULL );
 
+    /**
+    * \brief Set the DEM of a ninja from memory
+    *
+    * The elevations are copied into the ninja when this is called, so each
+    * run of the army holds its own copy of the DEM until the run is done.
+    */
     int setDEM( const int nIndex, const double* demValues, const int nXSize, const int nYSize,
                 const double* geoRef, std::string prj, char ** papszOptions=NULL );
 
@@ -974,6 +984,16 @@ public:
     * \return number of rows in the output grid
     */
     const int getOutputGridnRows( const int nIndex, char ** papszOptions=NULL );
+
+    /**
+    * \brief Get the timings and solver counters of a ninja
+    *
+    * Kept after startRuns() frees the run.
+    *
+    * \param nIndex index of a ninja
+    * \return the statistics, NULL for an invalid index
+    */
+    const RunStatistics* getRunStatistics( const int nIndex, char ** papszOptions=NULL );
     
     /**
     * \brief Set the percent of output buffer clipping for a ninja
@@ -1224,6 +1244,19 @@ public:
     */
     int setVtkOutFlag( const int nIndex, const bool flag, char ** papszOptions=NULL );
     /**
+    * \brief Set the format of the VTK output for a ninja
+    *
+    * \param nIndex index of a ninja
+    * \param format "ascii" or "binary" for legacy VTK files, "vts" for VTK XML
+    *               StructuredGrid files
+    * \param useFloat32 write "vts" data as 32 bit floats
+    * \param compress zlib compress "vts" data
+    * \return errval Returns NINJA_SUCCESS if successful
+    */
+    int setVtkWriteFormat( const int nIndex, std::string format,
+                           const bool useFloat32, const bool compress,
+                           char ** papszOptions=NULL );
+    /**
     * \brief Enable/disable txt output for a ninja
     *
     * \param nIndex index of a ninja
@@ -1325,6 +1358,22 @@ protected:
     std::string tz;
 
     bool writeFarsiteAtmFile;
+    bool warmStartSolver;   //run a time series in order, each run starting from the previous solution
+    bool batchSolve;        //solve the equations of runs on the same mesh together
+    std::string outputCubeFormat;   //"GTiff" or "netCDF" to write the grids of all runs in one file per variable, "" to not
+    std::vector<RunStatistics> runStatistics;   //statistics of each run, saved before the run is freed
+    std::vector<wxStation> wxStationList;   //stations of a point initialization army, copied into a run when it starts
+    std::string wxStationFileName;          //file wxStationList was read from
+    bool startBatchedRuns(int numProcessors, int maxRunsInFlight, std::vector<int> &anErrors,
+                          std::vector<std::string> &asMessages);
+    void setRunStations(int nIndex);
+    std::vector<wxStation> getRunStations(int nIndex);
+    int getMaxRunsInFlight(bool sharedDomain);
+    static double estimateRunBytes(double nNodes, double nNonZero, double nCells, bool sharedDomain);
+    static int fitRunsInBudget(double budgetBytes, double runBytes, double residentBytes, int nRuns);
+    int getThreadsPerRun(int numProcessors, int maxRunsInFlight);
+    static int splitThreads(int numProcessors, int nRuns, int maxRunsInFlight, int nNodes,
+                            int threadsPerRun, int nodesPerThread);
     void writeFarsiteAtmosphereFile();
     void setAtmFlags();
 
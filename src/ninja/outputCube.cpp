@@ -0,0 +1,285 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Multi-band output of the runs of an army
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include "outputCube.h"
+
+#include <stdexcept>
+
+#include "cpl_conv.h"
+#include "cpl_string.h"
+
+static const float fOutputCubeNoData = -9999.0f;
+
+static const char *OutputCubeLongName(std::string const& variable)
+{
+    if(variable == "vel")
+        return "wind speed";
+    else if(variable == "ang")
+        return "wind direction (degrees clockwise from north)";
+    else if(variable == "cld")
+        return "cloud cover";
+    return variable.c_str();
+}
+
+/**
+ * @brief Make an empty cube.
+ *
+ * @param format "GTiff" or "netCDF" (not case sensitive).
+ * @param nBands Number of bands, one per run.
+ */
+OutputCube::OutputCube(std::string format, int nBands)
+    : nBands_(nBands)
+    , times_(nBands > 0 ? nBands : 0)
+{
+    if(!isValidFormat(format))
+        throw std::runtime_error("The output cube format must be \"GTiff\" or \"netCDF\".");
+    if(nBands < 1)
+        throw std::runtime_error("The output cube needs at least one band.");
+    format_ = EQUAL(format.c_str(), "GTiff") ? "GTiff" : "netCDF";
+}
+
+OutputCube::~OutputCube()
+{
+    for(std::map<std::string, Variable>::iterator it = variables_.begin(); it != variables_.end(); ++it)
+    {
+        if(it->second.hMemDS != NULL)
+            GDALClose(it->second.hMemDS);
+    }
+}
+
+bool OutputCube::isValidFormat(std::string const& format)
+{
+    return EQUAL(format.c_str(), "GTiff") || EQUAL(format.c_str(), "netCDF");
+}
+
+/**
+ * @brief Find a variable, creating its dataset with the size and georeferencing
+ * of grid the first time.  Must be called inside the outputCube critical section.
+ */
+OutputCube::Variable &OutputCube::get_variable(std::string const& variable,
+                                               AsciiGrid<double> const& grid,
+                                               std::string const& units)
+{
+    std::map<std::string, Variable>::iterator it = variables_.find(variable);
+    if(it != variables_.end())
+    {
+        if(GDALGetRasterXSize(it->second.hMemDS) != grid.get_nCols() ||
+           GDALGetRasterYSize(it->second.hMemDS) != grid.get_nRows())
+            throw std::runtime_error("The " + variable + " grids of the runs in the output cube have different sizes.");
+        return it->second;
+    }
+
+    const int nCols = grid.get_nCols();
+    const int nRows = grid.get_nRows();
+    const size_t bandSize = static_cast<size_t>(nCols) * nRows;
+
+    Variable &var = variables_[variable];
+    var.units = units;
+    var.values.assign(bandSize * nBands_, fOutputCubeNoData); //bands of failed runs stay no data
+    var.hMemDS = GDALCreate(GDALGetDriverByName("MEM"), "", nCols, nRows, 0, GDT_Float32, NULL);
+    if(var.hMemDS == NULL)
+    {
+        variables_.erase(variable);
+        throw std::runtime_error("Cannot create the in-memory dataset of the output cube.");
+    }
+
+    double adfGeoTransform[6];
+    adfGeoTransform[0] = grid.get_xllCorner();
+    adfGeoTransform[1] = grid.get_cellSize();
+    adfGeoTransform[2] = 0;
+    adfGeoTransform[3] = grid.get_yllCorner() + nRows * grid.get_cellSize();
+    adfGeoTransform[4] = 0;
+    adfGeoTransform[5] = -grid.get_cellSize();
+    GDALSetGeoTransform(var.hMemDS, adfGeoTransform);
+    GDALSetProjection(var.hMemDS, grid.prjString.c_str());
+
+    //the bands use the memory of values, so they can be set without going through GDAL
+    for(int band = 0; band < nBands_; band++)
+    {
+        char szPointer[64];
+        szPointer[CPLPrintPointer(szPointer, &var.values[band * bandSize], sizeof(szPointer))] = '\0';
+        char **papszOptions = CSLSetNameValue(NULL, "DATAPOINTER", szPointer);
+        GDALAddBand(var.hMemDS, GDT_Float32, papszOptions);
+        CSLDestroy(papszOptions);
+        GDALSetRasterNoDataValue(GDALGetRasterBand(var.hMemDS, band + 1), fOutputCubeNoData);
+    }
+    return var;
+}
+
+/**
+ * @brief Set the band of a run.  Can be called by runs on different threads.
+ *
+ * @param band Index of the run in the army.
+ * @param variable Short name of the output, used in the file name ("vel",
+ *                 "ang" or "cld").
+ * @param grid Output grid of the run.
+ * @param units Units of the grid values.
+ * @param time Time of the run, not_a_date_time if the run has no time.
+ */
+void OutputCube::set_band(int band, std::string const& variable, AsciiGrid<double> const& grid,
+                          std::string const& units, boost::posix_time::ptime const& time)
+{
+    if(band < 0 || band >= nBands_)
+        throw std::range_error("The output cube band is out of range.");
+
+    Variable *var = NULL;
+    std::string error;
+    #pragma omp critical(outputCube)
+    {
+        try
+        {
+            var = &get_variable(variable, grid, units);
+            times_[band] = time;
+        }catch(std::exception &e)
+        {
+            error = e.what();
+        }
+    }
+    if(var == NULL)
+        throw std::runtime_error(error);
+
+    //AsciiGrid rows go south to north, raster rows north to south
+    const int nCols = grid.get_nCols();
+    const int nRows = grid.get_nRows();
+    const double noData = grid.get_noDataValue();
+    float *values = &var->values[static_cast<size_t>(band) * nCols * nRows];
+    for(int i = 0; i < nRows; i++)
+    {
+        for(int j = 0; j < nCols; j++)
+        {
+            const double value = grid.get_cellValue(nRows - 1 - i, j);
+            values[static_cast<size_t>(i) * nCols + j] =
+                (value == noData) ? fOutputCubeNoData : static_cast<float>(value);
+        }
+    }
+}
+
+/**
+ * @brief Write one file per variable, named rootFilename_variable.tif (or .nc).
+ *
+ * The bands are tagged with the hours since the first run ("DT", as in the
+ * GTiff output of the OutputWriter), which is also the time coordinate of the
+ * netCDF files.  Runs without a time are numbered instead.
+ *
+ * @return The names of the files written.
+ */
+std::vector<std::string> OutputCube::write(std::string const& rootFilename)
+{
+    boost::posix_time::ptime t0;
+    for(int band = 0; band < nBands_ && t0.is_not_a_date_time(); band++)
+        t0 = times_[band];
+
+    std::vector<double> hours(nBands_);
+    std::string timeValues;
+    for(int band = 0; band < nBands_; band++)
+    {
+        if(t0.is_not_a_date_time() || times_[band].is_not_a_date_time())
+            hours[band] = band;
+        else
+            hours[band] = (times_[band] - t0).total_seconds() / 3600.0;
+        timeValues += CPLSPrintf(band == 0 ? "%.15g" : ",%.15g", hours[band]);
+    }
+
+    GDALDriverH hDriver = GDALGetDriverByName(format_.c_str());
+    if(hDriver == NULL)
+        throw std::runtime_error("The GDAL " + format_ + " driver is not available for the output cube.");
+
+    char **papszOptions = NULL;
+    std::string extension;
+    if(format_ == "GTiff")
+    {
+        papszOptions = CSLSetNameValue(papszOptions, "TILED", "YES");
+        papszOptions = CSLSetNameValue(papszOptions, "COMPRESS", "DEFLATE");
+        papszOptions = CSLSetNameValue(papszOptions, "PREDICTOR", "3");
+        papszOptions = CSLSetNameValue(papszOptions, "BIGTIFF", "IF_SAFER");
+        extension = ".tif";
+    }
+    else
+    {
+        papszOptions = CSLSetNameValue(papszOptions, "FORMAT", "NC4C");
+        papszOptions = CSLSetNameValue(papszOptions, "COMPRESS", "DEFLATE");
+        extension = ".nc";
+    }
+
+    std::vector<std::string> files;
+    for(std::map<std::string, Variable>::iterator it = variables_.begin(); it != variables_.end(); ++it)
+    {
+        GDALDatasetH hMemDS = it->second.hMemDS;
+
+        if(!t0.is_not_a_date_time())
+        {
+            const boost::gregorian::date d = t0.date();
+            const boost::posix_time::time_duration td = t0.time_of_day();
+            GDALSetMetadataItem(hMemDS, "TIFFTAG_DATETIME",
+                                CPLSPrintf("%04d:%02d:%02d %02d:%02d:%02d", (int)d.year(), (int)d.month(),
+                                           (int)d.day(), (int)td.hours(), (int)td.minutes(), (int)td.seconds()), NULL);
+            if(format_ == "netCDF")
+                GDALSetMetadataItem(hMemDS, "time#units",
+                                    CPLSPrintf("hours since %04d-%02d-%02d %02d:%02d:%02d", (int)d.year(), (int)d.month(),
+                                               (int)d.day(), (int)td.hours(), (int)td.minutes(), (int)td.seconds()), NULL);
+        }
+        if(format_ == "netCDF")
+        {
+            //CF time dimension, see the netCDF driver's NETCDF_DIM_ metadata
+            GDALSetMetadataItem(hMemDS, "NETCDF_DIM_EXTRA", "{time}", NULL);
+            GDALSetMetadataItem(hMemDS, "NETCDF_DIM_time_DEF", CPLSPrintf("{%d,6}", nBands_), NULL);
+            GDALSetMetadataItem(hMemDS, "NETCDF_DIM_time_VALUES", ("{" + timeValues + "}").c_str(), NULL);
+            GDALSetMetadataItem(hMemDS, "time#standard_name", "time", NULL);
+            GDALSetMetadataItem(hMemDS, "time#axis", "T", NULL);
+        }
+
+        for(int band = 0; band < nBands_; band++)
+        {
+            GDALRasterBandH hBand = GDALGetRasterBand(hMemDS, band + 1);
+            GDALSetMetadataItem(hBand, "DT", CPLSPrintf("%.15g", hours[band]), NULL);
+            GDALSetMetadataItem(hBand, "units", it->second.units.c_str(), NULL);
+            GDALSetMetadataItem(hBand, "long_name", OutputCubeLongName(it->first), NULL);
+            if(!times_[band].is_not_a_date_time())
+                GDALSetDescription(hBand, boost::posix_time::to_iso_extended_string(times_[band]).c_str());
+            if(format_ == "netCDF")
+            {
+                GDALSetMetadataItem(hBand, "NETCDF_VARNAME", it->first.c_str(), NULL);
+                GDALSetMetadataItem(hBand, "NETCDF_DIM_time", CPLSPrintf("%.15g", hours[band]), NULL);
+            }
+        }
+
+        const std::string filename = rootFilename + "_" + it->first + extension;
+        GDALDatasetH hDS = GDALCreateCopy(hDriver, filename.c_str(), hMemDS, FALSE,
+                                          papszOptions, NULL, NULL);
+        if(hDS == NULL)
+        {
+            CSLDestroy(papszOptions);
+            throw std::runtime_error("Cannot write the output cube file " + filename + ".");
+        }
+        GDALClose(hDS);
+        files.push_back(filename);
+    }
+    CSLDestroy(papszOptions);
+    return files;
+}
@@ -0,0 +1,91 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Multi-band output of the runs of an army
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef OUTPUT_CUBE_H
+#define OUTPUT_CUBE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gdal.h"
+
+#include "boost/date_time/posix_time/posix_time.hpp"
+
+#include "ascii_grid.h"
+
+/**
+ * @brief Output grids of all of the runs of an army, one band per run.
+ *
+ * Each output variable (speed, direction, cloud cover) is kept in an
+ * in-memory (MEM) dataset with one Float32 band per run.  Once all of the runs
+ * are done, every variable is copied to a single tiled, compressed GeoTIFF or a
+ * CF netCDF file with a time dimension (time x rows x cols), instead of one set
+ * of files per run.
+ *
+ * The band memory of a variable is allocated when its first grid is set, so
+ * runs on different threads set their own bands at the same time without any
+ * locking.  All of the runs must have the same output grids.
+ */
+class OutputCube
+{
+public:
+    OutputCube(std::string format, int nBands);
+    ~OutputCube();
+
+    void set_band(int band, std::string const& variable, AsciiGrid<double> const& grid,
+                  std::string const& units, boost::posix_time::ptime const& time);
+    std::vector<std::string> write(std::string const& rootFilename);
+
+    const std::string &get_format() const { return format_; }
+    int get_nBands() const { return nBands_; }
+
+    static bool isValidFormat(std::string const& format);
+
+private:
+    OutputCube(OutputCube const&);              //not copyable, owns the datasets
+    OutputCube &operator=(OutputCube const&);
+
+    struct Variable
+    {
+        GDALDatasetH hMemDS;
+        std::vector<float> values;  //band, row (north to south), column
+        std::string units;
+    };
+
+    Variable &get_variable(std::string const& variable, AsciiGrid<double> const& grid,
+                           std::string const& units);
+
+    std::string format_;
+    int nBands_;
+    std::map<std::string, Variable> variables_;
+    std::vector<boost::posix_time::ptime> times_;
+};
+
+#endif /* OUTPUT_CUBE_H */
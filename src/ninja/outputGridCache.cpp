@@ -0,0 +1,111 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Resampled output grids shared by the output writers of a run
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include "outputGridCache.h"
+
+#include <algorithm>
+
+#ifdef _OPENMP
+#include "omp_guard.h"
+#endif
+
+bool OutputGridCache::Key::operator<(Key const& rhs) const
+{
+    if(grid != rhs.grid)
+        return grid < rhs.grid;
+    if(resolution != rhs.resolution)
+        return resolution < rhs.resolution;
+    return interpType < rhs.interpType;
+}
+
+OutputGridCache::Entry::Entry()
+    : ready(false)
+{
+#ifdef _OPENMP
+    omp_init_lock(&lock);
+#endif
+}
+
+OutputGridCache::Entry::~Entry()
+{
+#ifdef _OPENMP
+    omp_destroy_lock(&lock);
+#endif
+}
+
+OutputGridCache::OutputGridCache()
+{
+}
+
+OutputGridCache::~OutputGridCache()
+{
+    for(std::map<Key, Entry*>::iterator it = entries_.begin(); it != entries_.end(); ++it)
+        delete it->second;
+}
+
+/**
+ * @brief Get grid resampled to a cell size.
+ *
+ * @param grid Grid to resample.  It is identified by its address.
+ * @param resolution Cell size of the resampled grid.
+ * @param interpType Interpolation used to resample.
+ * @return The resampled grid, or grid itself if AsciiGrid::resample_Grid()
+ *         would have returned a copy of it.
+ */
+const AsciiGrid<double> &OutputGridCache::get(const AsciiGrid<double> &grid, double resolution,
+                                              AsciiGrid<double>::interpTypeEnum interpType)
+{
+    if(resolution == grid.get_cellSize() ||
+       resolution > std::min(grid.get_xDimension(), grid.get_yDimension()))
+        return grid;
+
+    Key key;
+    key.grid = &grid;
+    key.resolution = resolution;
+    key.interpType = interpType;
+
+    Entry *entry = NULL;
+    #pragma omp critical(outputGridCache)
+    {
+        Entry *&slot = entries_[key];
+        if(slot == NULL)
+            slot = new Entry();
+        entry = slot;
+    }
+
+#ifdef _OPENMP
+    omp_guard guard(entry->lock);
+#endif
+    if(!entry->ready)
+    {
+        entry->grid = grid.resample_Grid(resolution, interpType);
+        entry->ready = true;
+    }
+    return entry->grid;
+}
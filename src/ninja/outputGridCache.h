@@ -0,0 +1,97 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Resampled output grids shared by the output writers of a run
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef OUTPUT_GRID_CACHE_H
+#define OUTPUT_GRID_CACHE_H
+
+#include <map>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "ascii_grid.h"
+
+/**
+ * @brief Resampled copies of the output grids of a run, made once and shared
+ * by all of the output writers.
+ *
+ * The ascii, shape, kmz and pdf writers of ninja::writeOutputFiles() each need
+ * the speed and direction grids at their output resolution, which is often the
+ * same for several of them.  get() resamples a grid the first time a
+ * (grid, resolution, interpolation) is asked for and hands the same read only
+ * grid to every later caller.  A grid that doesn't need resampling is returned
+ * as is, without a copy.  The shape and pdf writers read the grids in place.
+ * The ascii writer and KmlVector still copy them, because they change their
+ * grids (buffering to the DEM extent, setting the projection), but the
+ * resampling is only done once.
+ *
+ * get() can be called from the omp sections of writeOutputFiles() at the same
+ * time: a writer asking for a grid that another one is resampling waits for it
+ * instead of resampling it again.  The references are valid for the life of
+ * the cache, and the source grids must not change while it is used.
+ */
+class OutputGridCache
+{
+public:
+    OutputGridCache();
+    ~OutputGridCache();
+
+    const AsciiGrid<double> &get(const AsciiGrid<double> &grid, double resolution,
+                                 AsciiGrid<double>::interpTypeEnum interpType = AsciiGrid<double>::order0);
+
+private:
+    OutputGridCache(OutputGridCache const&);
+    OutputGridCache &operator=(OutputGridCache const&);
+
+    struct Key
+    {
+        const AsciiGrid<double> *grid;
+        double resolution;
+        int interpType;
+
+        bool operator<(Key const& rhs) const;
+    };
+
+    struct Entry
+    {
+        Entry();
+        ~Entry();
+
+        AsciiGrid<double> grid;
+        bool ready;
+#ifdef _OPENMP
+        omp_lock_t lock;    //held while the grid is resampled
+#endif
+    };
+
+    std::map<Key, Entry*> entries_;
+};
+
+#endif /* OUTPUT_GRID_CACHE_H */
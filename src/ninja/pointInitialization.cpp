@@ -95,7 +95,7 @@ void pointInitialization::initializeFields(WindNinjaInputs &input,
     
     setInitializationGrids(input);
 
-    initializeWindToZero(mesh, u0, v0, w0);
+    initializeWindToZero(mesh, u0, v0, w0, input.numberCPUs);
 
     initializeBoundaryLayer(input);
 
@@ -154,8 +154,12 @@ void pointInitialization::setInitializationGrids(WindNinjaInputs& input)
     input.inputWindHeight = maxStationHeight;  //for use later during vertical fill of 3D grid
     input.surface.Z = input.inputWindHeight;
 
-    airTempGrid.interpolateFromPoints(T, X, Y, influenceRadius, input.stationsScratch.size(), dfInvDistWeight);
-    cloudCoverGrid.interpolateFromPoints(cc, X, Y, influenceRadius, input.stationsScratch.size(), dfInvDistWeight);
+    //temperature and cloud cover have the same weights, interpolate them together
+    AsciiGrid<double>* tempCloudGrids[2] = { &airTempGrid, &cloudCoverGrid };
+    double* tempCloudData[2] = { T, cc };
+    AsciiGrid<double>::interpolateFromPoints(tempCloudGrids, tempCloudData, 2, X, Y, influenceRadius,
+                                             input.stationsScratch.size(), dfInvDistWeight,
+                                             input.numberCPUs);
 
     //Check one grid to be sure that the interpolation completely filled the grid
     if(cloudCoverGrid.checkForNoDataValues())
@@ -325,8 +329,11 @@ void pointInitialization::setInitializationGrids(WindNinjaInputs& input)
         }
     }
 
-    uInitializationGrid.interpolateFromPoints(u, X, Y, influenceRadius, input.stationsScratch.size(), dfInvDistWeight);
-    vInitializationGrid.interpolateFromPoints(v, X, Y, influenceRadius, input.stationsScratch.size(), dfInvDistWeight);
+    AsciiGrid<double>* uvGrids[2] = { &uInitializationGrid, &vInitializationGrid };
+    double* uvData[2] = { u, v };
+    AsciiGrid<double>::interpolateFromPoints(uvGrids, uvData, 2, X, Y, influenceRadius,
+                                             input.stationsScratch.size(), dfInvDistWeight,
+                                             input.numberCPUs);
 
     input.surface.windSpeedGrid.set_headerData(uInitializationGrid);
     input.surface.windGridExists = true;
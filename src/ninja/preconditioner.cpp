@@ -32,10 +32,15 @@
 Preconditioner::Preconditioner()
 {
 	NUMNP = 0;
+	numThreads = 1;
+#ifdef _OPENMP
+	numThreads = omp_get_max_threads();
+#endif
 	D = NULL;
 	Lt = NULL;
 	U = NULL;
 	scratch = NULL;
+	multigrid = NULL;
 	L_row_ptr = NULL;
 	L_col_ind = NULL;
 	w = 1.0;
@@ -75,11 +80,82 @@ Preconditioner::~Preconditioner()
 	//	delete U_row_ptr;
 	if(L_col_ind)
 		delete[] L_col_ind;
+	if(multigrid)
+		delete multigrid;
 	//if(U_col_ind)
 	//	delete U_col_ind;
 }
 
-bool Preconditioner::initialize(int numnp, double *A, int *row_ptr, int *col_ind, int preconditionerType, char *matdescra)
+/**
+ * @brief Set the number of threads of the parallel regions.
+ *
+ * Call it before initialize(), the multigrid levels are built with it too.
+ *
+ * @param n Number of threads, at least 1.
+ */
+void Preconditioner::set_numThreads(int n)
+{
+	numThreads = n > 0 ? n : 1;
+	if(multigrid)
+		multigrid->set_numThreads(numThreads);
+}
+
+/**
+ * @brief Get a preconditioner type from a string.
+ *
+ * @param type "none", "jacobi", "ssor", "mcssor" or "multigrid" (case insensitive).
+ * @return The matching precondType.
+ */
+int Preconditioner::get_precondType(std::string type)
+{
+	for(unsigned int i = 0; i < type.size(); i++)
+		type[i] = tolower(type[i]);
+
+	if(type == "none")
+		return none;
+	else if(type == "jacobi")
+		return Jacobi;
+	else if(type == "ssor")
+		return SSOR;
+	else if(type == "mcssor")
+		return MCSSOR;
+	else if(type == "multigrid" || type == "mg")
+		return Multigrid;
+	else
+		throw std::range_error("Invalid preconditioner type: " + type);
+}
+
+const char * Preconditioner::get_precondName(int type)
+{
+	if(type == none)
+		return "none";
+	else if(type == Jacobi)
+		return "Jacobi";
+	else if(type == SSOR)
+		return "SSOR";
+	else if(type == MCSSOR)
+		return "multicolor SSOR";
+	else if(type == Multigrid)
+		return "multigrid";
+	return "unknown";
+}
+
+/**
+ * @brief Set up the preconditioner for a matrix.
+ *
+ * @param numnp Number of rows in A.
+ * @param A Matrix in CSR storage (upper triangle only if matdescra[0] is 's').
+ * @param row_ptr Row pointers of A.
+ * @param col_ind Column indices of A.
+ * @param preconditionerType One of precondType.
+ * @param matdescra Matrix description, matdescra[0] is 's' for symmetric or 'g' for general.
+ * @param nrows Number of rows of nodes in the mesh (only used by MCSSOR and Multigrid).
+ * @param ncols Number of columns of nodes in the mesh (only used by MCSSOR and Multigrid).
+ * @param nlayers Number of layers of nodes in the mesh (only used by MCSSOR and Multigrid).
+ * @return true on success.
+ */
+bool Preconditioner::initialize(int numnp, double *A, int *row_ptr, int *col_ind, int preconditionerType, char *matdescra,
+                                int nrows, int ncols, int nlayers)
 {	
 	
 	if(preconditionerType == none)
@@ -176,11 +252,130 @@ bool Preconditioner::initialize(int numnp, double *A, int *row_ptr, int *col_ind
 				count++;
 			}
 		}
+	}else if(preconditionerType == MCSSOR)
+	{
+		if(matdescra[0] != 's')	//needs the symmetric upper triangle storage
+			return false;
+
+		preConditionerType = preconditionerType;
+		NUMNP = numnp;
+
+		return initializeMulticolor(A, row_ptr, col_ind, nrows, ncols, nlayers);
+	}else if(preconditionerType == Multigrid)
+	{
+		if(matdescra[0] != 's')	//needs the symmetric upper triangle storage
+			return false;
+
+		preConditionerType = preconditionerType;
+		NUMNP = numnp;
+
+		if(multigrid == NULL)
+			multigrid = new GeometricMultigrid;
+		multigrid->set_numThreads(numThreads);
+		return multigrid->initialize(numnp, A, row_ptr, col_ind, nrows, ncols, nlayers);
 	}
 
 	return true;
 }
 
+bool Preconditioner::initializeMulticolor(double *A, int *row_ptr, int *col_ind, int nrows, int ncols, int nlayers)
+{
+	int i, j, k, c, n, p;
+
+	if(nrows < 2 || ncols < 2 || nlayers < 2 || (long long)nrows*ncols*nlayers != NUMNP)
+		return false;
+
+	const int nxy = nrows*ncols;
+	std::vector<int> color(NUMNP);
+	int color_count[nColors] = {0, 0, 0, 0, 0, 0, 0, 0};
+
+	for(k=0; k<nlayers; k++)
+		for(i=0; i<nrows; i++)
+			for(j=0; j<ncols; j++)
+			{
+				n = k*nxy + i*ncols + j;
+				color[n] = (i & 1) + 2*(j & 1) + 4*(k & 1);
+				color_count[color[n]]++;
+			}
+
+	//color ordered rows, nodes stay in increasing order within a color
+	color_start[0] = 0;
+	for(c=0; c<nColors; c++)
+		color_start[c+1] = color_start[c] + color_count[c];
+
+	mc_node.resize(NUMNP);
+	std::vector<int> position(NUMNP);	//color ordered row of each node
+	std::vector<int> next(color_start, color_start+nColors);
+	for(n=0; n<NUMNP; n++)
+	{
+		position[n] = next[color[n]]++;
+		mc_node[position[n]] = n;
+	}
+
+	//off-diagonal entries per row of the full matrix
+	mc_Dinv.resize(NUMNP);
+	std::vector<int> row_count(NUMNP, 0);
+	for(n=0; n<NUMNP; n++)
+	{
+		if(col_ind[row_ptr[n]] != n || A[row_ptr[n]] == 0.0)	//diagonal must be stored first and be non-zero
+			return false;
+		mc_Dinv[n] = 1./A[row_ptr[n]];
+		for(j=row_ptr[n]+1; j<row_ptr[n+1]; j++)
+		{
+			if(color[col_ind[j]] == color[n])	//not a 27 point stencil on this mesh
+				return false;
+			row_count[n]++;
+			row_count[col_ind[j]]++;
+		}
+	}
+
+	mc_row_ptr.resize(NUMNP+1);
+	mc_row_ptr[0] = 0;
+	for(p=0; p<NUMNP; p++)
+		mc_row_ptr[p+1] = mc_row_ptr[p] + row_count[mc_node[p]];
+
+	mc_col_ind.resize(mc_row_ptr[NUMNP]);
+	mc_val.resize(mc_row_ptr[NUMNP]);
+	for(p=0; p<NUMNP; p++)
+		row_count[mc_node[p]] = mc_row_ptr[p];	//reuse as the fill position of each node's row
+
+	for(n=0; n<NUMNP; n++)
+	{
+		for(j=row_ptr[n]+1; j<row_ptr[n+1]; j++)
+		{
+			mc_col_ind[row_count[n]] = col_ind[j];
+			mc_val[row_count[n]++] = A[j];
+			mc_col_ind[row_count[col_ind[j]]] = n;
+			mc_val[row_count[col_ind[j]]++] = A[j];
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief Gauss-Seidel relaxation of all nodes of one color.
+ *
+ * z[n] = (r[n] - sum over neighbors m of A(n,m)*z[m]) / A(n,n)
+ *
+ * Nodes of one color don't depend on each other, so the loop is parallel.
+ */
+void Preconditioner::relaxColor(int color, const double *r, double *z)
+{
+	int p, j, n;
+	double sum;
+
+	#pragma omp for private(j,n,sum)
+	for(p=color_start[color]; p<color_start[color+1]; p++)
+	{
+		n = mc_node[p];
+		sum = r[n];
+		for(j=mc_row_ptr[p]; j<mc_row_ptr[p+1]; j++)
+			sum -= mc_val[j]*z[mc_col_ind[j]];
+		z[n] = sum*mc_Dinv[n];
+	}
+}
+
 bool Preconditioner::solve(double *r, double *z, int *row_ptr, int *col_ind)
 {	//solves M*z=r;  ie z=M^(-1)*r
 
@@ -206,6 +401,42 @@ bool Preconditioner::solve(double *r, double *z, int *row_ptr, int *col_ind)
 		mkl_dcsrsv(&L_transa, &NUMNP, &one, L_matdescra, Lt, L_col_ind, L_row_ptr, &L_row_ptr[1], r, scratch);
 		mkl_dcsrsv(&U_transa, &NUMNP, &one, U_matdescra, U, col_ind, row_ptr, &row_ptr[1], scratch, z);
 
+		return true;
+	}else if(preConditionerType == MCSSOR)
+	{
+		//--------------------------------------------------
+		//One symmetric Gauss-Seidel sweep from z = 0:
+		//	forward over colors 0..7, then backward 6..0
+		//	(color 7 would not change in between).
+		//This is SSOR (w=1) in the color ordering of the
+		//unknowns, so M is symmetric positive definite.
+		//--------------------------------------------------
+		int c, i, n;
+
+		#pragma omp parallel private(c) num_threads(numThreads)
+		{
+			#pragma omp for
+			for(i=0; i<NUMNP; i++)
+				z[i] = 0.0;
+
+			#pragma omp for private(n)
+			for(i=color_start[0]; i<color_start[1]; i++)
+			{
+				n = mc_node[i];
+				z[n] = r[n]*mc_Dinv[n];	//color 0 neighbors are all still zero
+			}
+
+			for(c=1; c<nColors; c++)
+				relaxColor(c, r, z);	//implied barrier after each color
+			for(c=nColors-2; c>=0; c--)
+				relaxColor(c, r, z);
+		}
+
+		return true;
+	}else if(preConditionerType == Multigrid)
+	{
+		multigrid->apply(r, z);
+
 		return true;
 	}
 
@@ -36,9 +36,14 @@
 #include <new>
 
 #include <iostream>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <ctype.h>
 	
 
 #include "ninjaException.h"
+#include "multigrid.h"
 
 
 #ifdef _OPENMP
@@ -54,16 +59,26 @@ public:
 
 	enum precondType{
 		none,
-		Jacobi,
-		SSOR
+		Jacobi,	//diagonal scaling
+		SSOR,	//symmetric successive over-relaxation, serial
+		MCSSOR,	//multicolor SSOR (symmetric Gauss-Seidel) on the structured mesh, runs in parallel,
+				//takes more iterations than SSOR but scales with the number of threads
+		Multigrid	//geometric multigrid V-cycle on the structured mesh, the number of iterations
+					//stays nearly flat as the resolution increases
 	};
     
-    bool initialize(int numnp, double *A, int *row_ptr, int *col_ind, int preconditionerType, char *matdescra);
+    bool initialize(int numnp, double *A, int *row_ptr, int *col_ind, int preconditionerType, char *matdescra,
+                    int nrows = 0, int ncols = 0, int nlayers = 0);
 	bool solve(double *r, double *z, int *row_ptr, int *col_ind);
+	void set_numThreads(int n);
+
+	static int get_precondType(std::string type);
+	static const char * get_precondName(int type);
 
 private:
 	
 	int NUMNP;
+	int numThreads;	//threads of the parallel regions, omp_get_max_threads() when constructed
 	int preConditionerType;
 	double *D;	//This is the inverse of the diagonal for Jacobi preconditioning, ie M^(-1)
 	double *Lt, *U;	//These are the upper and lower triangular matrices for the SSOR preconditioner
@@ -79,6 +94,23 @@ private:
 	char U_transa;	//solve using regular matrix (not transpose) y := alpha*inv(A)*x
 	char U_matdescra[6];
 
+	//storage for the multicolor SSOR preconditioner
+	//Nodes are colored by the parity of their (i,j,k) index, so nodes of the same color are never
+	//neighbors in the 27 point stencil and can be relaxed at the same time.  The off-diagonal part of
+	//the full (both triangles) matrix is stored with the rows in color order.
+	enum{ nColors = 8 };
+	int color_start[nColors+1];	//first row of each color in the color ordered storage
+	std::vector<int> mc_node;	//node number of each color ordered row
+	std::vector<int> mc_row_ptr;
+	std::vector<int> mc_col_ind;
+	std::vector<double> mc_val;
+	std::vector<double> mc_Dinv;	//inverse of the diagonal, by node number
+
+	GeometricMultigrid *multigrid;	//only allocated for the Multigrid type
+
+	bool initializeMulticolor(double *A, int *row_ptr, int *col_ind, int nrows, int ncols, int nlayers);
+	void relaxColor(int color, const double *r, double *z);
+
 	void mkl_dcsrsv(char *transa, int *m, double *alpha, char *matdescra, double *val, int *indx, int *pntrb, int *pntre, double *x, double *y);
 	void cblas_dcopy(const int N, const double *X, const int incX, double *Y, const int incY);
 };
@@ -0,0 +1,141 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Per element quadrature point geometry tables
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include <cmath>
+
+#include "quadratureGeometry.h"
+#include "element.h"
+
+/**
+ * @brief Compute the tables for every element of a mesh.
+ *
+ * The values are computed with element::computeJacobianQuadraturePoint(), so
+ * they are the same as the ones computed on the fly.
+ *
+ * @param mesh Built mesh.  Its coordinates must not change while the tables are used.
+ * @param numThreads Number of threads computing the tables.
+ */
+QuadratureGeometry::QuadratureGeometry(const Mesh &mesh, int numThreads)
+{
+    element elem(&mesh);
+
+    numElems = mesh.NUMEL;
+    numQuadPts = elem.NUMQPTV;
+    numNodesPerElem = mesh.NNPE;
+    xord = mesh.XORD.get_data();
+
+    const size_t nPts = (size_t)numElems*numQuadPts;
+    const size_t nPtNodes = nPts*numNodesPerElem;
+
+    DETJ.resize(nPts);
+    XJ.resize(nPts);
+    YJ.resize(nPts);
+    ZJ.resize(nPts);
+    DNDX.resize(nPtNodes);
+    DNDY.resize(nPtNodes);
+    DNDZ.resize(nPtNodes);
+    WGHT.resize(nPtNodes);
+
+    int i;
+#pragma omp parallel num_threads(numThreads) default(shared) private(i)
+    {
+        element e(&mesh);
+        double XK, YK, ZK, wght;
+
+#pragma omp for
+        for(i=0;i<numElems;i++)
+        {
+            for(int j=0;j<numQuadPts;j++)
+            {
+                const size_t p = (size_t)i*numQuadPts + j;
+                e.computeJacobianQuadraturePoint(j, i, XJ[p], YJ[p], ZJ[p]);
+                DETJ[p] = e.DETJ;
+
+                for(int k=0;k<numNodesPerElem;k++)
+                {
+                    DNDX[p*numNodesPerElem + k] = e.DNDX[k];
+                    DNDY[p*numNodesPerElem + k] = e.DNDY[k];
+                    DNDZ[p*numNodesPerElem + k] = e.DNDZ[k];
+
+                    //same weight as the gradient recovery in ninja::computeUVWField()
+                    e.NPK = mesh.get_global_node(k, i);
+                    XK = mesh.XORD(e.NPK);
+                    YK = mesh.YORD(e.NPK);
+                    ZK = mesh.ZORD(e.NPK);
+                    wght = std::pow((XK-XJ[p]),2)+std::pow((YK-YJ[p]),2)+std::pow((ZK-ZJ[p]),2);
+                    WGHT[p*numNodesPerElem + k] = 1.0/(std::sqrt(wght));
+                }
+            }
+        }
+    }
+}
+
+QuadratureGeometry::~QuadratureGeometry()
+{
+}
+
+/**
+ * @brief Check if the tables were built for a mesh.
+ *
+ * The mesh must have the same number of elements and use the same coordinate
+ * storage, for example a mesh sharing its coordinates through
+ * Mesh::buildStandardMesh(input, sharedMesh).
+ *
+ * @param mesh Mesh to check.
+ * @return true if the tables can be used for mesh.
+ */
+bool QuadratureGeometry::hasMesh(const Mesh &mesh) const
+{
+    return mesh.NUMEL == numElems && mesh.NNPE == numNodesPerElem &&
+           mesh.XORD.get_data() == xord;
+}
+
+/**
+ * @brief Memory used by the tables, in bytes.
+ */
+size_t QuadratureGeometry::get_bytes() const
+{
+    return (DETJ.size() + XJ.size() + YJ.size() + ZJ.size() +
+            DNDX.size() + DNDY.size() + DNDZ.size() + WGHT.size()) * sizeof(double);
+}
+
+/**
+ * @brief Memory the tables would use for a mesh, in bytes.
+ *
+ * Can be used to decide if the tables should be built before building them.
+ *
+ * @param mesh Built mesh.
+ */
+size_t QuadratureGeometry::estimateBytes(const Mesh &mesh)
+{
+    element elem(&mesh);
+    const size_t nPts = (size_t)mesh.NUMEL*elem.NUMQPTV;
+
+    return (4*nPts + 4*nPts*mesh.NNPE) * sizeof(double);
+}
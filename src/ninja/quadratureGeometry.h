@@ -0,0 +1,86 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Per element quadrature point geometry tables
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef QUADRATURE_GEOMETRY_H
+#define QUADRATURE_GEOMETRY_H
+
+#include <vector>
+#include <cstddef>
+
+class Mesh;
+
+/**
+ * @brief Geometry of every quadrature point of every element of a mesh,
+ * computed once and reused by each pass over the elements.
+ *
+ * element::computeJacobianQuadraturePoint() rebuilds the Jacobian, its inverse
+ * and the shape function derivatives from the node coordinates every time it
+ * is called.  These only depend on the mesh, so they can be stored instead.
+ * The values are kept in separate arrays (structure of arrays), indexed by
+ * quadrature point p = elemNum*NUMQPTV + localQuadPointNum:
+ *
+ *   DETJ[p]                 determinant of the Jacobian
+ *   DNDX[p*NNPE + k], ...   dN/dx, dN/dy, dN/dz of local node k
+ *   XJ[p], YJ[p], ZJ[p]     coordinates of the quadrature point
+ *   WGHT[p*NNPE + k]        inverse distance from the quadrature point to node k
+ *                           (weights of the gradient recovery in computeUVWField())
+ *
+ * With one point quadrature this takes 36 doubles per element, see get_bytes().
+ * The tables are not changed after they are built, so one object can be
+ * read by several threads or runs at the same time.
+ */
+class QuadratureGeometry
+{
+public:
+    QuadratureGeometry(const Mesh &mesh, int numThreads);
+    ~QuadratureGeometry();
+
+    int get_numQuadPts() const { return numQuadPts; }
+    int get_numNodesPerElem() const { return numNodesPerElem; }
+    bool hasMesh(const Mesh &mesh) const;
+    size_t get_bytes() const;
+
+    static size_t estimateBytes(const Mesh &mesh);
+
+    std::vector<double> DETJ;
+    std::vector<double> DNDX, DNDY, DNDZ;
+    std::vector<double> XJ, YJ, ZJ;
+    std::vector<double> WGHT;
+
+private:
+    int numElems;
+    int numQuadPts;
+    int numNodesPerElem;
+    const double *xord;     //coordinates the tables were built from (only used to check the mesh)
+
+    QuadratureGeometry(const QuadratureGeometry &rhs);
+    QuadratureGeometry &operator=(const QuadratureGeometry &rhs);
+};
+
+#endif	//QUADRATURE_GEOMETRY_H
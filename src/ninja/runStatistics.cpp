@@ -0,0 +1,160 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Per-phase timings and solver counters of a simulation
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+
+#include <cmath>
+#include <iomanip>
+#include <locale>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "runStatistics.h"
+
+RunStatistics::RunStatistics()
+{
+    reset();
+}
+
+/**
+ * @brief Clear all of the counters and times.
+ */
+void RunStatistics::reset()
+{
+    runNumber = -1;
+    numThreads = 0;
+    numNodes = 0;
+    preconditioner.clear();
+    solverIterations = 0;
+    finalResidual = -1.0;
+
+    meshTime = 0.0;
+    initializationTime = 0.0;
+    equationBuildTime = 0.0;
+    preconditionerSetupTime = 0.0;
+    solverTime = 0.0;
+    spmvTime = 0.0;
+    preconditionerTime = 0.0;
+    gradientRecoveryTime = 0.0;
+    outputTime = 0.0;
+    totalTime = 0.0;
+
+    peakMemoryMB = -1.0;
+
+    residualHistory.clear();
+}
+
+/*
+** JSON text of a double: all of its digits with '.' as the decimal separator
+** whatever the locale of the process, and null for nan and inf, which JSON
+** can't represent.  The stream keeps its own C locale, so runs writing at the
+** same time don't change the process locale under each other.
+*/
+static std::string jsonNumber(double value)
+{
+    if(!std::isfinite(value))
+        return "null";
+    std::ostringstream os;
+    os.imbue(std::locale::classic());
+    os << std::setprecision(17) << value;
+    return os.str();
+}
+
+/**
+ * @brief Write the statistics as a JSON object.
+ *
+ * The numbers don't depend on the locale, and the ones that aren't finite
+ * are written as null.
+ *
+ * @param filename Path of the file to write.
+ * @return true on success, false if the file can't be written.
+ */
+bool RunStatistics::writeJson(const std::string &filename) const
+{
+    FILE *fout = fopen(filename.c_str(), "w");
+    if(fout == NULL)
+        return false;
+
+    fprintf(fout, "{\n");
+    fprintf(fout, "\"run_number\":%d,\n", runNumber);
+    fprintf(fout, "\"threads\":%d,\n", numThreads);
+    fprintf(fout, "\"nodes\":%d,\n", numNodes);
+    fprintf(fout, "\"preconditioner\":\"%s\",\n", preconditioner.c_str());
+    fprintf(fout, "\"solver_iterations\":%d,\n", solverIterations);
+    fprintf(fout, "\"final_residual\":%s,\n", jsonNumber(finalResidual).c_str());
+    fprintf(fout, "\"time\":{\n");
+    fprintf(fout, "  \"mesh\":%s,\n", jsonNumber(meshTime).c_str());
+    fprintf(fout, "  \"initialization\":%s,\n", jsonNumber(initializationTime).c_str());
+    fprintf(fout, "  \"equation_build\":%s,\n", jsonNumber(equationBuildTime).c_str());
+    fprintf(fout, "  \"preconditioner_setup\":%s,\n", jsonNumber(preconditionerSetupTime).c_str());
+    fprintf(fout, "  \"solver\":%s,\n", jsonNumber(solverTime).c_str());
+    fprintf(fout, "  \"spmv\":%s,\n", jsonNumber(spmvTime).c_str());
+    fprintf(fout, "  \"preconditioner\":%s,\n", jsonNumber(preconditionerTime).c_str());
+    fprintf(fout, "  \"gradient_recovery\":%s,\n", jsonNumber(gradientRecoveryTime).c_str());
+    fprintf(fout, "  \"output\":%s,\n", jsonNumber(outputTime).c_str());
+    fprintf(fout, "  \"total\":%s\n", jsonNumber(totalTime).c_str());
+    fprintf(fout, "},\n");
+    fprintf(fout, "\"peak_memory_mb\":%s,\n", jsonNumber(peakMemoryMB).c_str());
+    fprintf(fout, "\"residual_history\":[");
+    for(size_t i=0; i<residualHistory.size(); i++)
+        fprintf(fout, i == 0 ? "%s" : ",%s", jsonNumber(residualHistory[i]).c_str());
+    fprintf(fout, "]\n}\n");
+
+    return fclose(fout) == 0;
+}
+
+/**
+ * @brief Peak resident memory of the process so far.
+ *
+ * @return Peak memory in MB, -1 if it can't be determined.
+ */
+double RunStatistics::getPeakMemoryMB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if(GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return pmc.PeakWorkingSetSize / (1024.0 * 1024.0);
+    return -1.0;
+#else
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1.0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);    //bytes
+#else
+    return usage.ru_maxrss / 1024.0;               //kilobytes
+#endif
+#endif
+}
@@ -0,0 +1,80 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Per-phase timings and solver counters of a simulation
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef RUN_STATISTICS_H
+#define RUN_STATISTICS_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Machine readable performance counters of one ninja run.
+ *
+ * Filled in by ninja::simulate_wind() (or the batched army path) and kept by
+ * the ninjaArmy after the run is freed, see ninjaArmy::getRunStatistics() and
+ * NinjaGetRunStatistics() in the C API.  Times are wall clock seconds from
+ * omp_get_wtime().  Phases that run more than once (the solve and velocity
+ * computation of a "matching" point initialization) are summed.  With
+ * NINJA_RUN_STATISTICS_JSON=YES they are also written to <output name>_stats.json
+ * next to the outputs of the run, see writeJson().
+ */
+class RunStatistics
+{
+public:
+    RunStatistics();
+
+    void reset();
+    bool writeJson(const std::string &filename) const;
+
+    static double getPeakMemoryMB();
+
+    int runNumber;
+    int numThreads;
+    int numNodes;               //mesh nodes, the number of equations
+    std::string preconditioner; //name of the preconditioner used by the last solve
+    int solverIterations;       //CG iterations of all solves
+    double finalResidual;       //relative residual at the end of the last solve
+
+    double meshTime;
+    double initializationTime;
+    double equationBuildTime;       //assembly and boundary conditions
+    double preconditionerSetupTime;
+    double solverTime;              //includes the preconditioner setup
+    double spmvTime;                //matrix-vector products in the solver
+    double preconditionerTime;      //preconditioner applications in the solver
+    double gradientRecoveryTime;    //velocities from the potential (computeUVWField())
+    double outputTime;
+    double totalTime;
+
+    double peakMemoryMB;            //peak resident memory of the process when the run finished
+
+    std::vector<double> residualHistory;    //relative residual after each CG iteration
+};
+
+#endif	//RUN_STATISTICS_H
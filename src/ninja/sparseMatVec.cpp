@@ -0,0 +1,570 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Sparse matrix-vector products for the solver
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include "sparseMatVec.h"
+
+/*
+** The expanded and stencil products, for double or float coefficients.  The
+** sums are always done in double.
+*/
+template <class C>
+static void ExpandedProduct(int NUMNP, const int *full_row_ptr, const int *full_col_ind,
+                            const C *full_val, const double *x, double *y, int numThreads)
+{
+    int i, j;
+    double sum;
+
+    #pragma omp parallel for private(j,sum) num_threads(numThreads)
+    for(i=0; i<NUMNP; i++)
+    {
+        sum = 0.0;
+        for(j=full_row_ptr[i]; j<full_row_ptr[i+1]; j++)
+            sum += full_val[j]*x[full_col_ind[j]];
+        y[i] = sum;
+    }
+}
+
+template <class C>
+static void StencilProduct(int NUMNP, int nStencilTerms, const int *stencil_offset,
+                           const C *coef, const double *x, double *y, int numThreads)
+{
+    //blocks keep the piece of y being accumulated in cache across the 27 passes
+    const int blockSize = 2048;
+    const int nBlocks = (NUMNP + blockSize - 1) / blockSize;
+    int b;
+
+    #pragma omp parallel for num_threads(numThreads)
+    for(b=0; b<nBlocks; b++)
+    {
+        const int start = b*blockSize;
+        const int end = start+blockSize < NUMNP ? start+blockSize : NUMNP;
+        int n, s, offset, lo, hi;
+        const C *c;
+
+        for(n=start; n<end; n++)
+            y[n] = coef[n]*x[n];	// diagonal
+
+        for(s=1; s<nStencilTerms; s++)
+        {
+            offset = stencil_offset[s];
+            c = coef + (size_t)s*NUMNP;
+
+            hi = end < NUMNP-offset ? end : NUMNP-offset;
+            for(n=start; n<hi; n++)
+                y[n] += c[n]*x[n+offset];	//upper neighbor, coefficient stored on this node
+
+            lo = start > offset ? start : offset;
+            for(n=lo; n<end; n++)
+                y[n] += c[n-offset]*x[n-offset];	//lower neighbor, coefficient stored on that node
+        }
+    }
+}
+
+template <class C>
+static void BlockExpandedProduct(int NUMNP, const int *full_row_ptr, const int *full_col_ind,
+                                 const C *full_val, const double *X, double *Y, int nVec,
+                                 int numThreads)
+{
+    int i;
+
+    #pragma omp parallel for num_threads(numThreads)
+    for(i=0; i<NUMNP; i++)
+    {
+        double *y = Y + (size_t)i*nVec;
+        const double *x;
+        double a;
+        int j, v;
+
+        for(v=0; v<nVec; v++)
+            y[v] = 0.0;
+        for(j=full_row_ptr[i]; j<full_row_ptr[i+1]; j++)
+        {
+            a = full_val[j];
+            x = X + (size_t)full_col_ind[j]*nVec;
+            for(v=0; v<nVec; v++)
+                y[v] += a*x[v];
+        }
+    }
+}
+
+template <class C>
+static void BlockStencilProduct(int NUMNP, int nStencilTerms, const int *stencil_offset,
+                                const C *coef, const double *X, double *Y, int nVec,
+                                int numThreads)
+{
+    //smaller blocks than StencilProduct(), each node has nVec values
+    const int blockSize = 2048/nVec > 64 ? 2048/nVec : 64;
+    const int nBlocks = (NUMNP + blockSize - 1) / blockSize;
+    int b;
+
+    #pragma omp parallel for num_threads(numThreads)
+    for(b=0; b<nBlocks; b++)
+    {
+        const int start = b*blockSize;
+        const int end = start+blockSize < NUMNP ? start+blockSize : NUMNP;
+        int n, s, v, offset, lo, hi;
+        const C *c;
+        const double *x;
+        double *y, a;
+
+        for(n=start; n<end; n++)
+        {
+            a = coef[n];	// diagonal
+            x = X + (size_t)n*nVec;
+            y = Y + (size_t)n*nVec;
+            for(v=0; v<nVec; v++)
+                y[v] = a*x[v];
+        }
+
+        for(s=1; s<nStencilTerms; s++)
+        {
+            offset = stencil_offset[s];
+            c = coef + (size_t)s*NUMNP;
+
+            hi = end < NUMNP-offset ? end : NUMNP-offset;
+            for(n=start; n<hi; n++)
+            {
+                a = c[n];	//upper neighbor, coefficient stored on this node
+                x = X + (size_t)(n+offset)*nVec;
+                y = Y + (size_t)n*nVec;
+                for(v=0; v<nVec; v++)
+                    y[v] += a*x[v];
+            }
+
+            lo = start > offset ? start : offset;
+            for(n=lo; n<end; n++)
+            {
+                a = c[n-offset];	//lower neighbor, coefficient stored on that node
+                x = X + (size_t)(n-offset)*nVec;
+                y = Y + (size_t)n*nVec;
+                for(v=0; v<nVec; v++)
+                    y[v] += a*x[v];
+            }
+        }
+    }
+}
+
+SparseMatVec::SparseMatVec()
+{
+    NUMNP = 0;
+    numThreads = 1;
+#ifdef _OPENMP
+    numThreads = omp_get_max_threads();
+#endif
+    mode = symmetric;
+    A = NULL;
+    row_ptr = NULL;
+    col_ind = NULL;
+    bandwidth = 0;
+    singlePrecision = false;
+}
+
+SparseMatVec::~SparseMatVec()
+{
+
+}
+
+/**
+ * @brief Get a SpMV mode from a string.
+ *
+ * @param mode "serial", "symmetric", "expanded" or "stencil" (case insensitive).
+ * @return The matching mode.
+ */
+SparseMatVec::eSpMVMode SparseMatVec::get_eSpMVMode(std::string mode)
+{
+    for(unsigned int i = 0; i < mode.size(); i++)
+        mode[i] = tolower(mode[i]);
+
+    if(mode == "serial")
+        return serial;
+    else if(mode == "symmetric")
+        return symmetric;
+    else if(mode == "expanded")
+        return expanded;
+    else if(mode == "stencil")
+        return stencil;
+    else
+        throw std::range_error("Invalid sparse matrix-vector mode: " + mode);
+}
+
+/**
+ * @brief Set up the product for a matrix.
+ *
+ * @param numnp Number of rows (and columns) in A.
+ * @param A Upper triangle of the symmetric matrix in CSR storage, diagonal first in each row.
+ * @param row_ptr Row pointers into A, size numnp+1.
+ * @param col_ind Column index of each entry in A.
+ * @param mode Which algorithm to use in multiply().
+ * @param nrows Number of rows in the mesh (only used by the stencil mode).
+ * @param ncols Number of columns in the mesh (only used by the stencil mode).
+ * @param nlayers Number of layers in the mesh (only used by the stencil mode).
+ * @return true on success, false if the mode can't be used for this matrix.
+ */
+bool SparseMatVec::initialize(int numnp, double *A, int *row_ptr, int *col_ind, eSpMVMode mode,
+                              int nrows, int ncols, int nlayers)
+{
+    int i, j;
+
+    NUMNP = numnp;
+    this->A = A;
+    this->row_ptr = row_ptr;
+    this->col_ind = col_ind;
+    this->mode = mode;
+
+    bandwidth = 0;
+    for(i=0; i<NUMNP; i++)
+    {
+        for(j=row_ptr[i]+1; j<row_ptr[i+1]; j++)
+        {
+            if(col_ind[j]-i > bandwidth)
+                bandwidth = col_ind[j]-i;
+        }
+    }
+
+    halo.clear();
+    full_val.clear();
+    full_row_ptr.clear();
+    full_col_ind.clear();
+    stencil_coef.clear();
+    full_val_single.clear();
+    stencil_coef_single.clear();
+    singlePrecision = false;
+
+    if(mode == expanded)
+    {
+        //count the entries in each row of the full matrix
+        full_row_ptr.assign(NUMNP+1, 0);
+        for(i=0; i<NUMNP; i++)
+        {
+            full_row_ptr[i+1] += row_ptr[i+1] - row_ptr[i];
+            for(j=row_ptr[i]+1; j<row_ptr[i+1]; j++)
+                full_row_ptr[col_ind[j]+1]++;
+        }
+        for(i=0; i<NUMNP; i++)
+            full_row_ptr[i+1] += full_row_ptr[i];
+
+        full_val.resize(full_row_ptr[NUMNP]);
+        full_col_ind.resize(full_row_ptr[NUMNP]);
+
+        //fill the lower triangle first so each row ends up in ascending column order
+        std::vector<int> next(full_row_ptr.begin(), full_row_ptr.end()-1);
+        for(i=0; i<NUMNP; i++)
+        {
+            for(j=row_ptr[i]+1; j<row_ptr[i+1]; j++)
+            {
+                full_col_ind[next[col_ind[j]]] = i;
+                full_val[next[col_ind[j]]] = A[j];
+                next[col_ind[j]]++;
+            }
+        }
+        for(i=0; i<NUMNP; i++)
+        {
+            for(j=row_ptr[i]; j<row_ptr[i+1]; j++)
+            {
+                full_col_ind[next[i]] = col_ind[j];
+                full_val[next[i]] = A[j];
+                next[i]++;
+            }
+        }
+    }
+    else if(mode == stencil)
+    {
+        return buildStencil(nrows, ncols, nlayers);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Copy the CSR matrix into per-node stencil coefficients.
+ *
+ * Entries for neighbors outside of the mesh are left as zero, which also
+ * takes care of the offsets that "wrap" to the next row or layer at the
+ * edges of the domain.
+ *
+ * @return false if the dimensions don't match or A has an entry outside of
+ * the 27 point stencil.
+ */
+bool SparseMatVec::buildStencil(int nrows, int ncols, int nlayers)
+{
+    int i, j, s;
+
+    if(nrows < 3 || ncols < 3 || nlayers < 2 || (long long)nrows*ncols*nlayers != NUMNP)
+        return false;
+
+    //upper neighbors in increasing offset order: (kk, ii, jj) > (0, 0, 0)
+    const int nxy = nrows*ncols;
+    int kk, ii, jj;
+    s = 0;
+    stencil_offset[s++] = 0;
+    for(kk=0; kk<2; kk++)
+        for(ii=-1; ii<2; ii++)
+            for(jj=-1; jj<2; jj++)
+            {
+                int offset = kk*nxy + ii*ncols + jj;
+                if(offset > 0)
+                    stencil_offset[s++] = offset;
+            }
+
+    stencil_coef.assign((size_t)nStencilTerms*NUMNP, 0.0);
+
+    for(i=0; i<NUMNP; i++)
+    {
+        for(j=row_ptr[i]; j<row_ptr[i+1]; j++)
+        {
+            int offset = col_ind[j] - i;
+            for(s=0; s<nStencilTerms; s++)
+            {
+                if(stencil_offset[s] == offset)
+                    break;
+            }
+            if(s == nStencilTerms)
+            {
+                stencil_coef.clear();
+                return false;
+            }
+            stencil_coef[(size_t)s*NUMNP + i] = A[j];
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Store the matrix coefficients as floats.
+ *
+ * Only for the expanded and stencil modes, which have their own copy of the
+ * matrix; the double copy is freed.  Call after initialize().
+ *
+ * @return false if the mode reads the caller's CSR arrays.
+ */
+bool SparseMatVec::convertToSinglePrecision()
+{
+    if(mode == expanded)
+    {
+        full_val_single.assign(full_val.begin(), full_val.end());
+        std::vector<double>().swap(full_val);
+    }
+    else if(mode == stencil)
+    {
+        stencil_coef_single.assign(stencil_coef.begin(), stencil_coef.end());
+        std::vector<double>().swap(stencil_coef);
+    }
+    else
+        return false;
+
+    singlePrecision = true;
+    return true;
+}
+
+/**
+ * @brief Bytes of matrix storage read by multiply() in the current mode.
+ *
+ * For the serial and symmetric modes this is the caller's CSR arrays, for the
+ * other modes it is the copy owned by this object (the caller's CSR arrays are
+ * no longer needed for the product).
+ */
+size_t SparseMatVec::get_matrixBytes() const
+{
+    if(mode == expanded)
+        return full_val.size()*sizeof(double) + full_val_single.size()*sizeof(float) +
+               full_col_ind.size()*sizeof(int) + full_row_ptr.size()*sizeof(int);
+    else if(mode == stencil)
+        return stencil_coef.size()*sizeof(double) + stencil_coef_single.size()*sizeof(float);
+    else if(NUMNP > 0)
+        return (size_t)row_ptr[NUMNP]*(sizeof(double)+sizeof(int)) + (size_t)(NUMNP+1)*sizeof(int);
+    return 0;
+}
+
+/**
+ * @brief Computes y = A*x.
+ *
+ * @param x Vector of size NUMNP.
+ * @param y Vector of size NUMNP to store the result in.  Must not alias x.
+ */
+void SparseMatVec::multiply(const double *x, double *y)
+{
+    if(mode == serial)
+        multiplySerial(x, y);
+    else if(mode == symmetric)
+        multiplySymmetric(x, y);
+    else if(mode == expanded)
+        multiplyExpanded(x, y);
+    else if(mode == stencil)
+        multiplyStencil(x, y);
+    else
+        throw std::logic_error("Unknown sparse matrix-vector mode.");
+}
+
+void SparseMatVec::multiplySerial(const double *x, double *y)
+{
+    int i, j;
+
+    #pragma omp parallel private(i,j) num_threads(numThreads)
+    {
+        #pragma omp for
+        for(i=0;i<NUMNP;i++)
+        {
+            y[i] = A[row_ptr[i]]*x[i];	// diagonal
+            for(j=row_ptr[i]+1;j<row_ptr[i+1];j++)
+                y[i] += A[j]*x[col_ind[j]];
+        }
+    }	//end parallel region
+
+    for(i=0;i<NUMNP;i++)
+    {
+        for(j=row_ptr[i]+1;j<row_ptr[i+1];j++)
+            y[col_ind[j]] += A[j]*x[i];
+    }
+}
+
+void SparseMatVec::multiplySymmetric(const double *x, double *y)
+{
+    if(halo.size() < (size_t)numThreads*bandwidth)
+        halo.resize((size_t)numThreads*bandwidth);
+
+    #pragma omp parallel num_threads(numThreads)
+    {
+        int nThreads = 1;
+        int thread = 0;
+#ifdef _OPENMP
+        nThreads = omp_get_num_threads();
+        thread = omp_get_thread_num();
+#endif
+        int start = (int)(((long long)NUMNP*thread)/nThreads);
+        int end = (int)(((long long)NUMNP*(thread+1))/nThreads);
+        double *myHalo = halo.empty() ? NULL : &halo[0] + (size_t)thread*bandwidth;
+        int i, j, col;
+        double xi, sum;
+
+        for(i=0; i<bandwidth; i++)
+            myHalo[i] = 0.0;
+        for(i=start; i<end; i++)
+            y[i] = 0.0;
+
+        for(i=start; i<end; i++)
+        {
+            xi = x[i];
+            sum = A[row_ptr[i]]*xi;	// diagonal
+            for(j=row_ptr[i]+1; j<row_ptr[i+1]; j++)
+            {
+                col = col_ind[j];
+                sum += A[j]*x[col];
+                if(col < end)
+                    y[col] += A[j]*xi;	//lower triangle, row owned by this thread
+                else
+                    myHalo[col-end] += A[j]*xi;	//lower triangle, row owned by a later thread
+            }
+            y[i] += sum;
+        }
+
+        #pragma omp barrier
+
+        //gather the halo contributions of earlier threads into the rows we own
+        int t, lo, hi, tEnd;
+        const double *tHalo;
+        for(t=0; t<thread && bandwidth>0; t++)
+        {
+            tEnd = (int)(((long long)NUMNP*(t+1))/nThreads);
+            lo = tEnd > start ? tEnd : start;
+            hi = tEnd+bandwidth < end ? tEnd+bandwidth : end;
+            tHalo = &halo[0] + (size_t)t*bandwidth;
+            for(i=lo; i<hi; i++)
+                y[i] += tHalo[i-tEnd];
+        }
+    }	//end parallel region
+}
+
+void SparseMatVec::multiplyExpanded(const double *x, double *y)
+{
+    if(singlePrecision)
+        ExpandedProduct(NUMNP, &full_row_ptr[0], &full_col_ind[0], &full_val_single[0], x, y, numThreads);
+    else
+        ExpandedProduct(NUMNP, &full_row_ptr[0], &full_col_ind[0], &full_val[0], x, y, numThreads);
+}
+
+void SparseMatVec::multiplyStencil(const double *x, double *y)
+{
+    if(singlePrecision)
+        StencilProduct(NUMNP, nStencilTerms, stencil_offset, &stencil_coef_single[0], x, y, numThreads);
+    else
+        StencilProduct(NUMNP, nStencilTerms, stencil_offset, &stencil_coef[0], x, y, numThreads);
+}
+
+/**
+ * @brief Computes Y = A*X for nVec vectors.
+ *
+ * The vectors are interleaved: value n of vector v is X[n*nVec + v], so the
+ * values of all of the vectors for a node are next to each other.
+ *
+ * @param X Vectors of size NUMNP*nVec.
+ * @param Y Vectors of size NUMNP*nVec to store the result in.  Must not alias X.
+ * @param nVec Number of vectors.
+ */
+void SparseMatVec::multiplyBlock(const double *X, double *Y, int nVec)
+{
+    if(nVec == 1)
+        multiply(X, Y);
+    else if(mode == expanded)
+        multiplyBlockExpanded(X, Y, nVec);
+    else if(mode == stencil)
+        multiplyBlockStencil(X, Y, nVec);
+    else
+    {
+        //no block product for the upper triangle storage, do the vectors one at a time
+        std::vector<double> x(NUMNP), y(NUMNP);
+        int i, v;
+        for(v=0; v<nVec; v++)
+        {
+            #pragma omp parallel for num_threads(numThreads)
+            for(i=0; i<NUMNP; i++)
+                x[i] = X[(size_t)i*nVec + v];
+            multiply(&x[0], &y[0]);
+            #pragma omp parallel for num_threads(numThreads)
+            for(i=0; i<NUMNP; i++)
+                Y[(size_t)i*nVec + v] = y[i];
+        }
+    }
+}
+
+void SparseMatVec::multiplyBlockExpanded(const double *X, double *Y, int nVec)
+{
+    if(singlePrecision)
+        BlockExpandedProduct(NUMNP, &full_row_ptr[0], &full_col_ind[0], &full_val_single[0], X, Y, nVec, numThreads);
+    else
+        BlockExpandedProduct(NUMNP, &full_row_ptr[0], &full_col_ind[0], &full_val[0], X, Y, nVec, numThreads);
+}
+
+void SparseMatVec::multiplyBlockStencil(const double *X, double *Y, int nVec)
+{
+    if(singlePrecision)
+        BlockStencilProduct(NUMNP, nStencilTerms, stencil_offset, &stencil_coef_single[0], X, Y, nVec, numThreads);
+    else
+        BlockStencilProduct(NUMNP, nStencilTerms, stencil_offset, &stencil_coef[0], X, Y, nVec, numThreads);
+}
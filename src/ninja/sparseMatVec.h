@@ -0,0 +1,155 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Sparse matrix-vector products for the solver
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef SPARSE_MAT_VEC_H
+#define SPARSE_MAT_VEC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+
+#include "ninjaException.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * @brief Computes y = A*x for the symmetric, upper triangle CSR matrix built
+ * in ninja::discretize().
+ *
+ * Only the upper triangle (including the diagonal) of A is stored, so each
+ * stored off-diagonal entry contributes to two rows of y: once as a row
+ * product and once as a "transpose" scatter into a later row.  The original
+ * ninja::mkl_dcsrmv() did the scatter serially.  The modes here remove that
+ * serial sweep:
+ *
+ *   serial    - the original algorithm, kept for comparison/debugging.
+ *   symmetric - rows are split into one contiguous block per thread.  Scatter
+ *               targets inside the block are written directly; targets past
+ *               the end of the block (at most "bandwidth" rows away) go to a
+ *               small per-thread halo buffer that is gathered after a barrier.
+ *               Extra memory is nThreads*bandwidth, not nThreads*NUMNP.
+ *   expanded  - a full (both triangles) CSR copy is built once, and each
+ *               product is a plain parallel row gather.  Costs roughly twice
+ *               the matrix memory.
+ *   stencil   - uses the structured (k,i,j) layout of the mesh.  The diagonal
+ *               and the 13 "upper" neighbor coefficients of every node are
+ *               stored as 14 NUMNP long arrays, so there is no col_ind at all.
+ *               Lower neighbor coefficients are read from the neighbor node's
+ *               mirrored slot.  The product is a gather over fixed offsets with
+ *               unit stride, so the inner loops vectorize.  Needs the grid
+ *               dimensions and a matrix with at most the 27 point pattern.
+ *
+ * multiplyBlock() does the product for several vectors at once.  Each matrix
+ * coefficient is read once for all of them, so the cost of a product with n
+ * vectors is much less than n products, because the product is limited by the
+ * memory bandwidth.  Only the expanded and stencil modes have a real block
+ * product, the other modes multiply the vectors one at a time.
+ *
+ * convertToSinglePrecision() stores the expanded or stencil coefficients as
+ * floats.  The products still take and return doubles and sum in double, but
+ * read half the bytes of matrix, for the mixed precision solve in
+ * ninja::solve().
+ *
+ * Like the Preconditioner, the object is initialized once per solve and the
+ * matrix values must not change between initialize() and multiply() (the
+ * expanded mode copies them).
+ */
+class SparseMatVec
+{
+public:
+    SparseMatVec();
+    ~SparseMatVec();
+
+    enum eSpMVMode{
+        serial,
+        symmetric,
+        expanded,
+        stencil
+    };
+
+    bool initialize(int numnp, double *A, int *row_ptr, int *col_ind, eSpMVMode mode,
+                    int nrows = 0, int ncols = 0, int nlayers = 0);
+    void multiply(const double *x, double *y);
+    void multiplyBlock(const double *X, double *Y, int nVec);
+
+    bool convertToSinglePrecision();
+
+    eSpMVMode get_mode() const { return mode; }
+    bool is_singlePrecision() const { return singlePrecision; }
+    int get_bandwidth() const { return bandwidth; }
+    size_t get_matrixBytes() const;
+
+    void set_numThreads(int n) { numThreads = n > 0 ? n : 1; }
+    int get_numThreads() const { return numThreads; }
+
+    static eSpMVMode get_eSpMVMode(std::string mode);
+
+private:
+    int NUMNP;
+    int numThreads; //threads of the parallel regions, omp_get_max_threads() when constructed
+    eSpMVMode mode;
+    double *A;
+    int *row_ptr, *col_ind;
+    int bandwidth;  //largest (column - row) distance in the upper triangle
+    bool singlePrecision;   //coefficients are in full_val_single/stencil_coef_single
+
+    std::vector<double> halo;  //per-thread scatter buffers for the symmetric mode
+
+    //full storage for the expanded mode
+    std::vector<double> full_val;
+    std::vector<int> full_row_ptr;
+    std::vector<int> full_col_ind;
+
+    //coefficients for the stencil mode, stencil_coef[s*NUMNP+node]; s=0 is the diagonal
+    enum{ nStencilTerms = 14 };
+    std::vector<double> stencil_coef;
+    int stencil_offset[nStencilTerms];
+
+    //float copies of full_val/stencil_coef after convertToSinglePrecision()
+    std::vector<float> full_val_single;
+    std::vector<float> stencil_coef_single;
+
+    void multiplySerial(const double *x, double *y);
+    void multiplySymmetric(const double *x, double *y);
+    void multiplyExpanded(const double *x, double *y);
+    void multiplyStencil(const double *x, double *y);
+    void multiplyBlockExpanded(const double *X, double *Y, int nVec);
+    void multiplyBlockStencil(const double *X, double *Y, int nVec);
+    bool buildStencil(int nrows, int ncols, int nlayers);
+
+    SparseMatVec(const SparseMatVec &rhs);
+    SparseMatVec &operator=(const SparseMatVec &rhs);
+};
+
+#endif	//SPARSE_MAT_VEC_H
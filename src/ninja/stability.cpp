@@ -339,7 +339,7 @@ void Stability::SetPointInitializationAlpha(WindNinjaInputs &input,
         influenceRadius[ii] = input.stations[ii].get_influenceRadius();
     }
 
-    cloudCoverGrid.interpolateFromPoints(cc, X, Y, influenceRadius, input.stations.size(), 2.0);
+    cloudCoverGrid.interpolateFromPoints(cc, X, Y, influenceRadius, input.stations.size(), 2.0, input.numberCPUs);
 
 	//Check one grid to be sure that the interpolation completely filled the grid
 	if(cloudCoverGrid.checkForNoDataValues())
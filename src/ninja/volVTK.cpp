@@ -29,6 +29,11 @@
 
 #include "volVTK.h"
 
+#include <vector>
+
+#include "cpl_conv.h"
+#include "cpl_vsi.h"
+
 volVTK::volVTK()
 {
 
@@ -36,7 +41,8 @@ volVTK::volVTK()
 
 volVTK::volVTK(wn_3dScalarField const& u, wn_3dScalarField const& v, wn_3dScalarField const& w, 
                wn_3dArray& x, wn_3dArray& y, wn_3dArray& z, 
-               int i, int j, int k, std::string filename, std::string vtkWriteFormat)
+               int i, int j, int k, std::string filename, std::string vtkWriteFormat,
+               bool useFloat32, bool compress)
 {
     // determine byte order of this machine only once
     // sets value of isBigEndian for binary output
@@ -48,9 +54,12 @@ volVTK::volVTK(wn_3dScalarField const& u, wn_3dScalarField const& v, wn_3dScalar
     } else if (vtkWriteFormat == "binary" )
     {
         writeVolVTK_binary(u, v, w, x, y, z, i, j, k, filename);
+    } else if (vtkWriteFormat == "vts" )
+    {
+        writeVolVTS(u, v, w, x, y, z, i, j, k, filename, useFloat32, compress);
     } else
     {
-        throw std::runtime_error("vtkWriteFormat must be \"ascii\" or \"binary\".");
+        throw std::runtime_error("vtkWriteFormat must be \"ascii\", \"binary\" or \"vts\".");
     }
 }
 
@@ -445,4 +454,165 @@ bool volVTK::writeMeshVolVTK_binary(wn_3dArray& x, wn_3dArray& y, wn_3dArray& z,
     return true;
 }
 
+static void WriteVTSBytes(const void *data, size_t nBytes, VSILFILE *fout)
+{
+    if( VSIFWriteL(data, 1, nBytes, fout) != nBytes )
+        throw std::runtime_error("VTK file cannot be written.");
+}
+
+/*
+** Write one appended DataArray of 3 component vectors, a mesh layer at a time.
+** Only a single layer is ever staged, converted to T and interleaved.  A
+** compressed array gets one zlib block per layer, which is the block layout of
+** vtkZLibDataCompressor; its block size table is filled in once the layers have
+** been written.  Returns the number of bytes written.
+*/
+template<class T, class Field>
+static GUIntBig WriteVTSVectors(VSILFILE *fout, Field const& a, Field const& b, Field const& c,
+                                int nLayerPoints, int firstLayer, int nLayers, bool compress)
+{
+    const size_t layerBytes = 3 * static_cast<size_t>(nLayerPoints) * sizeof(T);
+    std::vector<T> layer(3 * static_cast<size_t>(nLayerPoints));
+    std::vector<GUIntBig> header;
+    std::vector<char> deflated;
+    const vsi_l_offset start = VSIFTellL(fout);
+
+    if( compress )
+    {
+        //number of blocks, block size, size of a partial last block (none),
+        //then the compressed size of every block
+        header.assign(3 + nLayers, 0);
+        header[0] = nLayers;
+        header[1] = layerBytes;
+        deflated.resize(layerBytes + layerBytes / 1000 + 64);
+    }
+    else
+        header.assign(1, static_cast<GUIntBig>(layerBytes) * nLayers);
+    WriteVTSBytes(&header[0], header.size() * sizeof(GUIntBig), fout);
+
+    for(int kk=0; kk<nLayers; kk++)
+    {
+        const int offset = (firstLayer + kk) * nLayerPoints;
+        for(int n=0; n<nLayerPoints; n++)
+        {
+            layer[3*n]     = static_cast<T>(a(offset + n));
+            layer[3*n + 1] = static_cast<T>(b(offset + n));
+            layer[3*n + 2] = static_cast<T>(c(offset + n));
+        }
+        if( compress )
+        {
+            //fastest level, the files are written for inspection, not archiving
+            size_t nDeflated = 0;
+            if( CPLZLibDeflate(&layer[0], layerBytes, 1, &deflated[0],
+                               deflated.size(), &nDeflated) == NULL )
+                throw std::runtime_error("VTK data block cannot be compressed.");
+            header[3 + kk] = nDeflated;
+            WriteVTSBytes(&deflated[0], nDeflated, fout);
+        }
+        else
+            WriteVTSBytes(&layer[0], layerBytes, fout);
+    }
+
+    const vsi_l_offset end = VSIFTellL(fout);
+    if( compress )
+    {
+        VSIFSeekL(fout, start, SEEK_SET);
+        WriteVTSBytes(&header[0], header.size() * sizeof(GUIntBig), fout);
+        VSIFSeekL(fout, end, SEEK_SET);
+    }
+    return end - start;
+}
+
+/*
+** Write a VTK XML StructuredGrid (.vts) of layers [firstLayer, firstLayer +
+** nLayers) with the data in one raw appended section.  The points come first;
+** the wind offset is written as a fixed width placeholder and patched after the
+** data, because the compressed size of the points is not known up front.  If u is NULL only the points are
+** written.
+*/
+template<class T>
+static void WriteVTSFile(std::string const& filename, const char *typeName,
+                         bool isBigEndian, bool compress,
+                         wn_3dScalarField const* u, wn_3dScalarField const* v, wn_3dScalarField const* w,
+                         wn_3dArray const& x, wn_3dArray const& y, wn_3dArray const& z,
+                         int i, int j, int firstLayer, int nLayers)
+{
+    VSILFILE *fout = VSIFOpenL(filename.c_str(), "wb");
+    if( fout == NULL )
+        throw std::runtime_error("VTK file cannot be opened for writing.");
+
+    try
+    {
+        const std::string extent = CPLSPrintf("0 %d 0 %d 0 %d", i - 1, j - 1, nLayers - 1);
+        VSIFPrintfL(fout, "<?xml version=\"1.0\"?>\n");
+        VSIFPrintfL(fout, "<VTKFile type=\"StructuredGrid\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\"%s>\n",
+                    isBigEndian ? "BigEndian" : "LittleEndian",
+                    compress ? " compressor=\"vtkZLibDataCompressor\"" : "");
+        VSIFPrintfL(fout, "  <StructuredGrid WholeExtent=\"%s\">\n", extent.c_str());
+        VSIFPrintfL(fout, "    <Piece Extent=\"%s\">\n", extent.c_str());
+
+        vsi_l_offset windOffsetPos = 0;
+        if( u != NULL )
+        {
+            VSIFPrintfL(fout, "      <PointData Vectors=\"wind_vectors\">\n");
+            VSIFPrintfL(fout, "        <DataArray type=\"%s\" Name=\"wind_vectors\" NumberOfComponents=\"3\" format=\"appended\" offset=\"", typeName);
+            windOffsetPos = VSIFTellL(fout);
+            VSIFPrintfL(fout, "%020d\"/>\n", 0);
+            VSIFPrintfL(fout, "      </PointData>\n");
+        }
+        VSIFPrintfL(fout, "      <Points>\n");
+        VSIFPrintfL(fout, "        <DataArray type=\"%s\" NumberOfComponents=\"3\" format=\"appended\" offset=\"0\"/>\n", typeName);
+        VSIFPrintfL(fout, "      </Points>\n");
+        VSIFPrintfL(fout, "    </Piece>\n");
+        VSIFPrintfL(fout, "  </StructuredGrid>\n");
+        VSIFPrintfL(fout, "  <AppendedData encoding=\"raw\">\n   _");
+
+        const GUIntBig pointsBytes = WriteVTSVectors<T>(fout, x, y, z, i*j, firstLayer, nLayers, compress);
+        if( u != NULL )
+            WriteVTSVectors<T>(fout, *u, *v, *w, i*j, firstLayer, nLayers, compress);
+
+        VSIFPrintfL(fout, "\n  </AppendedData>\n");
+        VSIFPrintfL(fout, "</VTKFile>\n");
+
+        if( u != NULL )
+        {
+            VSIFSeekL(fout, windOffsetPos, SEEK_SET);
+            VSIFPrintfL(fout, "%020" CPL_FRMT_GB_WITHOUT_PREFIX "u", pointsBytes);
+        }
+    }
+    catch( ... )
+    {
+        VSIFCloseL(fout);
+        throw;
+    }
+    VSIFCloseL(fout);
+}
+
+// VTK XML files declare their byte order, so unlike the "legacy" binary format the
+// data is written in the native order, and streamed instead of written value by value.
+bool volVTK::writeVolVTS(wn_3dScalarField const& u, wn_3dScalarField const& v, wn_3dScalarField const& w,
+                         wn_3dArray const& x, wn_3dArray const& y, wn_3dArray const& z,
+                         int i, int j, int k, std::string filename, bool useFloat32, bool compress)
+{
+    std::string surface_filename;
+    surface_filename = filename;
+    int pos;
+    pos = surface_filename.find_last_of(".");
+    surface_filename.erase(pos, surface_filename.size());
+    surface_filename.append("_surf.vts");
 
+    if( useFloat32 )
+    {
+        WriteVTSFile<float>(surface_filename, "Float32", isBigEndian, compress,
+                            NULL, NULL, NULL, x, y, z, i, j, 1, 1);
+        WriteVTSFile<float>(filename, "Float32", isBigEndian, compress,
+                            &u, &v, &w, x, y, z, i, j, 0, k);
+    } else
+    {
+        WriteVTSFile<double>(surface_filename, "Float64", isBigEndian, compress,
+                             NULL, NULL, NULL, x, y, z, i, j, 1, 1);
+        WriteVTSFile<double>(filename, "Float64", isBigEndian, compress,
+                             &u, &v, &w, x, y, z, i, j, 0, k);
+    }
+    return true;
+}
@@ -45,7 +45,8 @@ public:
 	volVTK();
     volVTK(wn_3dScalarField const& u, wn_3dScalarField const& v, wn_3dScalarField const& w, 
            wn_3dArray& x, wn_3dArray& y, wn_3dArray& z, 
-           int i, int j, int k, std::string filename, std::string vtkWriteFormat);
+           int i, int j, int k, std::string filename, std::string vtkWriteFormat,
+           bool useFloat32 = false, bool compress = false);
 	~volVTK();
 
     bool writeVolVTK(wn_3dScalarField const& u, wn_3dScalarField const& v, wn_3dScalarField const& w, 
@@ -67,6 +68,10 @@ public:
     bool writeMeshVolVTK_binary(wn_3dArray& x, wn_3dArray& y, wn_3dArray& z,
                                 int i, int j, int k, std::string filename);
 
+    bool writeVolVTS(wn_3dScalarField const& u, wn_3dScalarField const& v, wn_3dScalarField const& w,
+                     wn_3dArray const& x, wn_3dArray const& y, wn_3dArray const& z,
+                     int i, int j, int k, std::string filename, bool useFloat32, bool compress);
+
 private:
 	
 };
@@ -57,144 +57,105 @@ windProfile::~windProfile()
 
 double windProfile::getWindSpeed()
 {
-	//Initialize u0, v0, and w0 at all nodes (could enter coding here to interpolate from data such as MM5)
-    if(profile_switch==uniform)         //uniform profile
-    {
-		if(AGL==0.0)
-		{
-			velocity = 0.0;
-			return velocity;
-		}else if(useUpper && AGL+GroundASL>=inputWindUpperLimit)
+	double numerator, denominator, scale;
+	bool upper;
+
+	getProfileShape(numerator, denominator, scale, upper);
+	if(numerator == 0.0)
+		velocity = 0.0;
+	else
+		velocity = scaleWindSpeed((upper ? inputWindUpperSpeed : inputWindSpeed), numerator, denominator, scale);
+	return velocity;
+}
+
+/**
+ * Computes the shape of the profile at AGL, the part of getWindSpeed() that
+ * doesn't depend on the input wind speed.  The velocity for an input speed is
+ * scaleWindSpeed(speed, numerator, denominator, scale), which gives the same
+ * value as getWindSpeed(), so a column of nodes can be shaped once for u and v.
+ * @param numerator Numerator of the profile ratio, 0 where the velocity is 0.
+ * @param denominator Denominator of the profile ratio.
+ * @param scale Factor applied after the ratio (linear part below 7*z0).
+ * @param upper True if the speed to use is inputWindUpperSpeed instead of
+ * inputWindSpeed.
+ */
+void windProfile::getProfileShape(double &numerator, double &denominator, double &scale, bool &upper)
+{
+	upper = useUpper && AGL+GroundASL>=inputWindUpperLimit;
+	const double windHeight = upper ? inputWindUpperHeight : inputWindHeight;
+
+	numerator = 0.0;
+	denominator = 1.0;
+	scale = 1.0;
+
+	if(profile_switch==uniform)         //uniform profile
+	{
+		if(AGL!=0.0)
+			numerator = 1.0;
+	}else if(profile_switch==logarithmic)   //log law equation profile
+	{
+		if(AGL!=0.0)
 		{
-			velocity = inputWindUpperSpeed;
-			return velocity;
-		}else{
-			velocity = inputWindSpeed;
-			return velocity;
+			inwindheight = (windHeight + Rough_h) - (Rough_d);	//height of input wind (from z=0 of log profile)
+			if(AGL >= (Rough_d + Roughness))	//if we're below the log profile, velocity of zero
+				numerator = 1.0;	//*((log((AGL-Rough_d)/Roughness))/(log((inwindheight)/Roughness)));
 		}
-    }else if(profile_switch==logarithmic)   //log law equation profile
+	}else if(profile_switch==power_law_askervein)   //power law equation profile
 	{
-		if(AGL==0.0)
-		{
-			velocity = 0.0;
-			return velocity;
-		}else if(useUpper && AGL+GroundASL>=inputWindUpperLimit)
-		{
-			inwindheight = (inputWindUpperHeight + Rough_h) - (Rough_d);	//height of input wind (from z=0 of log profile)
-            if(AGL < (Rough_d + Roughness))	//if we're below the log profile, return velocity of zero
-			{
-				velocity = 0.0;
-				return velocity;
-			}else{
-				velocity = inputWindUpperSpeed;//*((log((AGL-Rough_d)/Roughness))/(log((inwindheight)/Roughness)));
-				return velocity;
-			}
-		}else
+		if(AGL!=0.0)
+			numerator = std::pow((AGL/windHeight),powerLawPower);
+	}else if(profile_switch==monin_obukov_similarity)   //Monin-Obukov similarity profile
+	{
+		if(AGL!=0.0)
 		{
-			inwindheight = (inputWindHeight + Rough_h) - (Rough_d);	//height of input wind (from z=0 of log profile)
-            if(AGL < (Rough_d + Roughness))	//if we're below the log profile, return velocity of zero
-			{
-				velocity = 0.0;
-				return velocity;
-			}else{
-				velocity = inputWindSpeed;//*((log((AGL-Rough_d)/Roughness))/(log((inwindheight)/Roughness)));
-				return velocity;
+			inwindheight = (windHeight + Rough_h) - (Rough_d); //height of input wind (from z=0 of log profile)
+
+			//If the input wind is at a height where the log profile isn't defined (can happen on output interpolation),
+			//just linearly interpolate. Use three times the roughness height to avoid issues that can arise sampling
+			//too close to where the log profile goes to 0.
+			if(inwindheight < 3.0*Roughness){
+				numerator = AGL/(inwindheight + Rough_d);
+			}else{ //else, just do standard profile stuff
+				if(AGL < (Rough_d + 7.0*Roughness))	//linearly interpolate, as in AERMOD, if below 7*z0
+				{
+					monin_obukov_terms(7.0*Roughness, inwindheight, Roughness, ObukovLength, numerator, denominator);	//windspeeds at 7*z0 height
+					scale = AGL/(7.0*Roughness + Rough_d);
+				}else if(AGL < (Rough_d + ABL_height))	//if below ABL top, monin-obukov similarity (log profile)
+				{
+					monin_obukov_terms((AGL - Rough_d), inwindheight, Roughness, ObukovLength, numerator, denominator);
+				}else if(ABL_height>0.0)	//else we're above the ABL...
+				{
+					//ABL_height<=0.0 can happen if input velocity is 0 which gives u_star=0 (typically if diurnal is off)
+					monin_obukov_terms(ABL_height, inwindheight, Roughness, ObukovLength, numerator, denominator);
+				}
 			}
 		}
-    }else if(profile_switch==power_law_askervein)   //power law equation profile
-    {
-		 if(AGL==0.0)
-		 {
-			velocity = 0.0;
-			return velocity;
-		 }else if (useUpper && AGL+GroundASL>=inputWindUpperLimit)
-         {
-              velocity = inputWindUpperSpeed*std::pow((AGL/inputWindUpperHeight),powerLawPower);
-			  return velocity;
-         }else
-         {
-              velocity = inputWindSpeed*std::pow((AGL/inputWindHeight),powerLawPower);
-			  return velocity;
-         }
-	}else if(profile_switch==monin_obukov_similarity)   //Monin-Obukov similarity profile
-    {
-                if(AGL==0.0)
-		{
-                    velocity = 0.0;
-                    return velocity;
-		}else if (useUpper && AGL+GroundASL>=inputWindUpperLimit)
-                {		
-		    inwindheight = (inputWindUpperHeight + Rough_h) - (Rough_d); //height of input wind (from z=0 of log profile)
-
-                    //If the input wind is at a height where the log profile isn't defined (can happen on output interpolation),
-                    //just linearly interpolate. Use three times the roughness height to avoid issues that can arise sampling
-                    //too close to where the log profile goes to 0.
-                    if(inwindheight < 3.0*Roughness){
-                        velocity = inputWindUpperSpeed * (AGL/(inwindheight + Rough_d));
-                        return velocity;
-                    }else{ //else, just do standard profile stuff
-                        if(AGL < (Rough_d + 7.0*Roughness))	//linearly interpolate, as in AERMOD, if below 7*z0
-                        {
-                            vel7z0 = monin_obukov(7.0*Roughness, inputWindUpperSpeed, inwindheight, Roughness, ObukovLength);	//compute windspeeds at 7*z0 height
-                            velocity = vel7z0 * (AGL/(7.0*Roughness + Rough_d));
-                            return velocity;
-                        }else if(AGL < (Rough_d + ABL_height))	//if below ABL top, monin-obukov similarity (log profile)
-                        {
-                            velocity = monin_obukov((AGL - Rough_d), inputWindUpperSpeed, inwindheight, Roughness, ObukovLength);
-                            return velocity;
-                        }else{	//else we're above the ABL...
-                            if(ABL_height<=0.0) //This can happen if input velocity is 0 which gives u_star=0 (typically if diurnal is off)
-                                velocity = 0.0;
-                            else
-                                velocity = monin_obukov(ABL_height, inputWindUpperSpeed, inwindheight, Roughness, ObukovLength);
-                        return velocity;
-                        }
-                    }
-                }else
-                {		
-		    inwindheight = (inputWindHeight + Rough_h) - (Rough_d); //height of input wind (from z=0 of log profile)
-
-                    //If the input wind is at a height where the log profile isn't defined (can happen on output interpolation),
-                    //just linearly interpolate. Use three times the roughness height to avoid issues that can arise sampling
-                    //too close to where the log profile goes to 0.
-                    if(inwindheight < 3.0*Roughness){
-                        velocity = inputWindSpeed * (AGL/(inwindheight + Rough_d));
-                        return velocity;
-                    }else{ //else, just do standard profile stuff
-                        if(AGL < (Rough_d + 7.0*Roughness))	//linearly interpolate, as in AERMOD, if below 7*z0
-                        {
-                            vel7z0 = monin_obukov(7.0*Roughness, inputWindSpeed, inwindheight, Roughness, ObukovLength);	//compute windspeeds at 7*z0 height
-                            velocity = vel7z0 * (AGL/(7.0*Roughness + Rough_d));
-                            return velocity;
-                        }else if(AGL < (Rough_d + ABL_height))	//if below ABL top, monin-obukov similarity (log profile)
-                        {
-                            velocity = monin_obukov((AGL - Rough_d), inputWindSpeed, inwindheight, Roughness, ObukovLength);
-                            return velocity;
-                        }else{	//else we're above the ABL...
-                            if(ABL_height<=0.0) //This can happen if input velocity is 0 which gives u_star=0 (typically if diurnal is off)
-                                velocity = 0.0;
-                            else
-                                velocity = monin_obukov(ABL_height, inputWindSpeed, inwindheight, Roughness, ObukovLength);
-                        return velocity;
-                        }
-                    }
-                }
 	}else
-	    throw std::runtime_error("Could not identify profile switch.\n");
+		throw std::runtime_error("Could not identify profile switch.\n");
 }
 
 double windProfile::monin_obukov(double z, double const& U1, double const& z1, double const& z0, double const& L)
 {
-	double speed;
+	double numerator, denominator;
+
+	monin_obukov_terms(z, z1, z0, L, numerator, denominator);
+	return U1*numerator/denominator;
+}
+
+void windProfile::monin_obukov_terms(double z, double const& z1, double const& z0, double const& L,
+                                     double &numerator, double &denominator)
+{
     if(z/z0<1)  //If this happens, log below will give nonsensical results, don't let it happen.
         z = z0;
     assert(z1/z0 >=1);
 	if(L == 0.0)
-		speed = U1*(log(z/z0))/(log(z1/z0));
-	else
-		speed = U1*(log(z/z0)-stability_function(z/L,L))/(log(z1/z0)-stability_function(z1/L,L));
-
-	return speed;
+	{
+		numerator = log(z/z0);
+		denominator = log(z1/z0);
+	}else{
+		numerator = log(z/z0)-stability_function(z/L,L);
+		denominator = log(z1/z0)-stability_function(z1/L,L);
+	}
 }
 
 double windProfile::stability_function(double const& z_over_L, double const& L_switch)
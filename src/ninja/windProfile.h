@@ -67,13 +67,19 @@ class windProfile
 		double inputWindUpperHeight;
 
 		double getWindSpeed();		//function returns wind velocity given the inputs (profile_switch, AGL, etc...)
+		void getProfileShape(double &numerator, double &denominator, double &scale, bool &upper);	//getWindSpeed() without the input speed
+		static double scaleWindSpeed(double speed, double numerator, double denominator, double scale)
+		{
+			return ((speed*numerator)/denominator)*scale;	//velocity from getProfileShape() values
+		}
         double monin_obukov(double z, double const& U1, double const& z1, double const& z0, double const& L);
+        void monin_obukov_terms(double z, double const& z1, double const& z0, double const& L,
+                                double &numerator, double &denominator);
 		double stability_function(double const& z_over_L, double const& L_switch);
 
 	private:
 		double inwindheight;		//height of input wind (from z=0 of log profile)
 		double velocity;			//velocity computed at height AGL
-		double vel7z0;				//used in monin_obukov_similarity
 };
 
 #endif /* WIND_PROFILE_H */
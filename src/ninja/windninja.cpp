@@ -1169,6 +1169,86 @@ WINDNINJADLL_EXPORT const int NinjaGetOutputGridnRows
     }
 }
 
+/**
+ * \brief Get the timings and solver counters of a finished run.
+ *
+ * Includes the time of each phase (meshing, initialization, equation
+ * building, preconditioner setup, solver with its matrix-vector product and
+ * preconditioner split, velocity computation and output), the number of
+ * solver iterations and the peak memory.  Available after NinjaStartRuns(),
+ * the runs may have been freed.  Set the NINJA_RUN_STATISTICS_JSON config
+ * option to also write them next to the outputs.
+ *
+ * \see NinjaGetRunResidualHistory
+ *
+ * \param ninja An opaque handle to a valid ninjaArmy.
+ * \param nIndex The run to get the statistics of.
+ * \param stats The statistics, filled in on success.
+ *
+ * \return NINJA_SUCCESS on success, non-zero otherwise.
+ */
+WINDNINJADLL_EXPORT NinjaErr NinjaGetRunStatistics
+    ( NinjaH * ninja, const int nIndex, NinjaRunStatistics * stats )
+{
+    if( NULL == ninja || NULL == stats )
+    {
+        return NINJA_E_NULL_PTR;
+    }
+    const RunStatistics *runStats =
+        reinterpret_cast<ninjaArmy*>( ninja )->getRunStatistics( nIndex );
+    if( NULL == runStats )
+    {
+        return NINJA_E_INVALID;
+    }
+    stats->runNumber = runStats->runNumber;
+    stats->numThreads = runStats->numThreads;
+    stats->numNodes = runStats->numNodes;
+    stats->solverIterations = runStats->solverIterations;
+    stats->numResiduals = (int)runStats->residualHistory.size();
+    stats->finalResidual = runStats->finalResidual;
+    stats->meshTime = runStats->meshTime;
+    stats->initializationTime = runStats->initializationTime;
+    stats->equationBuildTime = runStats->equationBuildTime;
+    stats->preconditionerSetupTime = runStats->preconditionerSetupTime;
+    stats->solverTime = runStats->solverTime;
+    stats->spmvTime = runStats->spmvTime;
+    stats->preconditionerTime = runStats->preconditionerTime;
+    stats->gradientRecoveryTime = runStats->gradientRecoveryTime;
+    stats->outputTime = runStats->outputTime;
+    stats->totalTime = runStats->totalTime;
+    stats->peakMemoryMB = runStats->peakMemoryMB;
+    return NINJA_SUCCESS;
+}
+
+/**
+ * \brief Get the relative residual after each solver iteration of a run.
+ *
+ * \see NinjaGetRunStatistics
+ *
+ * \param ninja An opaque handle to a valid ninjaArmy.
+ * \param nIndex The run to get the residuals of.
+ * \param nCount Set to the number of residuals.
+ *
+ * \return An array of nCount residuals, owned by the ninjaArmy, or NULL.
+ */
+WINDNINJADLL_EXPORT const double* NinjaGetRunResidualHistory
+    ( NinjaH * ninja, const int nIndex, int * nCount )
+{
+    if( NULL == ninja || NULL == nCount )
+    {
+        return NULL;
+    }
+    const RunStatistics *runStats =
+        reinterpret_cast<ninjaArmy*>( ninja )->getRunStatistics( nIndex );
+    if( NULL == runStats || runStats->residualHistory.empty() )
+    {
+        *nCount = 0;
+        return NULL;
+    }
+    *nCount = (int)runStats->residualHistory.size();
+    return &runStats->residualHistory[0];
+}
+
 /**
  * \brief Set the output buffer clipping for a simulation.
  *
@@ -1480,6 +1560,33 @@ WINDNINJADLL_EXPORT NinjaErr NinjaSetVtkOutFlag
     }
 }
 
+/**
+ * \brief Set the format of the VTK output for a simulation.
+ *
+ * \param ninja An opaque handle to a valid ninjaArmy.
+ * \param nIndex The run to apply the setting to.
+ * \param format "ascii" or "binary" for legacy VTK files, "vts" for VTK XML
+ *               StructuredGrid files with appended binary data.
+ * \param useFloat32 Write "vts" data as 32 bit floats (0 = no, 1 = yes).
+ * \param compress Compress "vts" data with zlib (0 = no, 1 = yes).
+ *
+ * \return NINJA_SUCCESS on success, non-zero otherwise.
+ */
+WINDNINJADLL_EXPORT NinjaErr NinjaSetVtkWriteFormat
+    ( NinjaH * ninja, const int nIndex, const char * format,
+      const int useFloat32, const int compress )
+{
+    if( NULL != ninja && NULL != format )
+    {
+        return reinterpret_cast<ninjaArmy*>( ninja )->setVtkWriteFormat
+            ( nIndex, std::string( format ), useFloat32, compress );
+    }
+    else
+    {
+        return NINJA_E_NULL_PTR;
+    }
+}
+
 WINDNINJADLL_EXPORT NinjaErr NinjaSetTxtOutFlag
     ( NinjaH * ninja, const int nIndex, const int flag )
 {
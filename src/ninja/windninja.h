@@ -70,6 +70,29 @@ struct NinjaH;
 typedef struct NinjaH NinjaH;
 typedef int  NinjaErr;
 
+/* Timings and solver counters of a run, see NinjaGetRunStatistics().  Times
+ * are wall clock seconds. */
+typedef struct NinjaRunStatistics
+{
+    int    runNumber;
+    int    numThreads;
+    int    numNodes;
+    int    solverIterations;
+    int    numResiduals;            /* size of NinjaGetRunResidualHistory() */
+    double finalResidual;
+    double meshTime;
+    double initializationTime;
+    double equationBuildTime;
+    double preconditionerSetupTime;
+    double solverTime;
+    double spmvTime;
+    double preconditionerTime;
+    double gradientRecoveryTime;
+    double outputTime;
+    double totalTime;
+    double peakMemoryMB;            /* peak for the whole process at the end of the run */
+} NinjaRunStatistics;
+
 
     /*-----------------------------------------------------------------------------
      *  Contructor/Destructors
@@ -253,6 +276,12 @@ WINDNINJADLL_EXPORT NinjaErr NinjaSetEnvironment
     WINDNINJADLL_EXPORT const int NinjaGetOutputGridnRows
         ( NinjaH * ninja, const int nIndex );
 
+    WINDNINJADLL_EXPORT NinjaErr NinjaGetRunStatistics
+        ( NinjaH * ninja, const int nIndex, NinjaRunStatistics * stats );
+
+    WINDNINJADLL_EXPORT const double* NinjaGetRunResidualHistory
+        ( NinjaH * ninja, const int nIndex, int * nCount );
+
     WINDNINJADLL_EXPORT NinjaErr NinjaSetOutputBufferClipping
         ( NinjaH * ninja, const int nIndex, const double percent );
 
@@ -295,6 +324,10 @@ WINDNINJADLL_EXPORT NinjaErr NinjaSetEnvironment
     WINDNINJADLL_EXPORT NinjaErr NinjaSetVtkOutFlag
         ( NinjaH * ninja, const int nIndex, const int flag );
 
+    WINDNINJADLL_EXPORT NinjaErr NinjaSetVtkWriteFormat
+        ( NinjaH * ninja, const int nIndex, const char * format,
+          const int useFloat32, const int compress );
+
     WINDNINJADLL_EXPORT NinjaErr NinjaSetTxtOutFlag
         ( NinjaH * ninja, const int nIndex, const int flag );
 
@@ -46,16 +46,24 @@ wn_3dArray::wn_3dArray(int rows, int cols, int layers)
 	if (rows <= 0 || cols <= 0 || layers <= 0)
 		throw std::range_error("Rows, columns, or layers are less than or equal to 0 in wn_3dArray::wn_3dArray(int rows, int cols, int layers).");
 #endif
+	data_ = NULL;
 	if(rows>0 && cols>0 && layers>0)
-	    data_ = new double[rows * cols * layers];
+	{
+	    storage_.reset(new double[rows * cols * layers]);
+	    data_ = storage_.get();
+	}
 }
 
 wn_3dArray::~wn_3dArray()
 {
-	delete[] data_;
+	//storage_ frees data_ when the last array using it is gone
 }
 
 wn_3dArray::wn_3dArray(wn_3dArray const& m)	// Copy constructor
+	: rows_ (0)
+	, cols_ (0)
+	, layers_ (0)
+	, data_ (NULL)
 {
 	allocate(m.rows_, m.cols_, m.layers_);
 
@@ -81,7 +89,7 @@ void wn_3dArray::allocate(int rows, int cols, int layers)
     if (rows <= 0 || cols <= 0 || layers <= 0)
         throw std::range_error("Rows, columns, or layers are less than or equal to 0 in wn_3dArray::allocate(int rows, int cols, int layers).");
 #endif
-    delete[] data_;
+    storage_.reset();
     data_ = NULL;
 
     rows_ = rows;
@@ -89,13 +97,15 @@ void wn_3dArray::allocate(int rows, int cols, int layers)
     layers_ = layers;
 
     if(rows>0 && cols>0 && layers>0)
-        data_ = new double[rows * cols * layers];
+    {
+        storage_.reset(new double[rows * cols * layers]);
+        data_ = storage_.get();
+    }
 }
 
 void wn_3dArray::deallocate()
 {
-	if(data_ != NULL)
-			delete[] data_;
+	storage_.reset();
 	data_ = NULL;
 
 	rows_ = 0;
@@ -103,6 +113,29 @@ void wn_3dArray::deallocate()
 	layers_ = 0;
 }
 
+/**
+ * @brief Make this array a read only view of the memory of m.
+ *
+ * No values are copied.  The memory stays allocated until every array using
+ * it is deallocated, re-allocated or destroyed.  Writing to either array
+ * changes both, so this is only meant for data that is not changed after it
+ * is built (like the mesh coordinates shared between runs).
+ *
+ * @param m Array to share.
+ */
+void wn_3dArray::share(wn_3dArray const& m)
+{
+	if(&m == this)
+		return;
+
+	storage_ = m.storage_;
+	data_ = m.data_;
+
+	rows_ = m.rows_;
+	cols_ = m.cols_;
+	layers_ = m.layers_;
+}
+
 double& wn_3dArray::operator() (int row, int col, int layer)
 {
 #ifdef NINJA_DEBUG
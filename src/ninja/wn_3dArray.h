@@ -32,6 +32,8 @@
 
 #include "ninjaException.h"
 
+#include <boost/shared_array.hpp>
+
 class wn_3dArray
 {
 	public:
@@ -44,17 +46,20 @@ class wn_3dArray
 
 		void allocate(int rows, int cols, int layers);	//make 3d array of this size, re-allocate if necessary
 		void deallocate();			//kills memory (data_ array)
+		void share(wn_3dArray const& m);	//use the memory of m instead of a copy, the values must not be changed
 		
 		double& operator() (int row, int col, int layer);
 		double  operator() (int row, int col, int layer) const;
 		double& operator() (int num);
 		double  operator() (int num) const;
+		const double* get_data() const {return data_;}	//start of the values, used to check if two arrays share memory
 		
 		int rows_, cols_, layers_;
 
 	private:
 		
 		double* data_;
+		boost::shared_array<double> storage_;	//owns data_, may be shared with other arrays (see share())
 };
 
 #endif /* WN_3D_ARRAY_H */
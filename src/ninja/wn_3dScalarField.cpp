@@ -531,7 +531,7 @@ void wn_3dScalarField::ComputeGradient(WindNinjaInputs &input, wn_3dVectorField
         DIAG[i]=0.;
     }
 
-	#pragma omp parallel default(shared) private(i,j,k)
+	#pragma omp parallel default(shared) private(i,j,k) num_threads(input.numberCPUs)
     {
 
     element elem(mesh_);
@@ -28,6 +28,8 @@
  *****************************************************************************/
 
 #include "wxModelInitialization.h"
+#include "gridResampler.h"
+#include "forecastCache.h"
 
 // #define NC_NOERR        0       /* No Error */
 
@@ -1162,7 +1164,7 @@ void wxModelInitialization::initializeFields(WindNinjaInputs &input,
     //Write wx model grids
     writeWxModelGrids(input);
 
-    initializeWindToZero(mesh, u0, v0, w0);
+    initializeWindToZero(mesh, u0, v0, w0, input.numberCPUs);
 
     initializeBoundaryLayer(input);
 
@@ -1192,11 +1194,24 @@ void wxModelInitialization::initializeFields(WindNinjaInputs &input,
 
 void wxModelInitialization::interpolateWxGridsToNinjaGrids(WindNinjaInputs &input)
 {
-    //Interpolate from original wxModel grids to dem coincident grids
-    airTempGrid.interpolateFromGrid(airTempGrid_wxModel, AsciiGrid<double>::order1);
-    cloudCoverGrid.interpolateFromGrid(cloudCoverGrid_wxModel, AsciiGrid<double>::order1);
-    uInitializationGrid.interpolateFromGrid(uGrid_wxModel, AsciiGrid<double>::order1);
-    vInitializationGrid.interpolateFromGrid(vGrid_wxModel, AsciiGrid<double>::order1);
+    //Interpolate from original wxModel grids to dem coincident grids, all
+    //four in one pass when they share the headers (they normally do)
+    const AsciiGrid<double> *wxGrids[] = {&airTempGrid_wxModel, &cloudCoverGrid_wxModel,
+                                          &uGrid_wxModel, &vGrid_wxModel};
+    AsciiGrid<double> *ninjaGrids[] = {&airTempGrid, &cloudCoverGrid,
+                                       &uInitializationGrid, &vInitializationGrid};
+    boost::shared_ptr<const GridResampler> resampler =
+        GridResampler::get(uGrid_wxModel, uInitializationGrid, AsciiGrid<double>::order1);
+    bool sameHeaders = true;
+    for(int k = 0; k < 4; k++)
+        sameHeaders = sameHeaders && resampler->matches(*wxGrids[k], *ninjaGrids[k], AsciiGrid<double>::order1);
+    if(sameHeaders)
+        resampler->interpolate(wxGrids, ninjaGrids, 4, input.numberCPUs);
+    else
+    {
+        for(int k = 0; k < 4; k++)
+            ninjaGrids[k]->interpolateFromGrid(*wxGrids[k], AsciiGrid<double>::order1);
+    }
 
     /*
     ** Fill in speed and direction grids from interpolated U and V grids.
@@ -1249,76 +1264,106 @@ void wxModelInitialization::initializeWindFrom3dData(WindNinjaInputs &input,
                                 wn_3dScalarField& v0,
                                 wn_3dScalarField& w0)
 { 
-    int kk;
-    int i, j, k;
-    double tempGradient;
-//#pragma omp parallel for default(shared) firstprivate(profile) private(i,j,k)
-    for(i = 0; i < input.dem.get_nRows(); i++){
-        for(j = 0; j < input.dem.get_nCols(); j++){
-
-            profile.ObukovLength = L(i,j);
-            profile.ABL_height = bl_height(i,j);
-            profile.Roughness = input.surface.Roughness(i,j);
-            profile.Rough_h = input.surface.Rough_h(i,j);
-            profile.Rough_d = input.surface.Rough_d(i,j);
-
-            for(k = 0; k < mesh.nlayers; k++){
-                profile.AGL=mesh.ZORD(i, j, k)-input.dem(i,j);  // height above the ground
-
-                if(u3d(i,j,k) != -9999) {  // if have 3d winds for current cell
-                    u0(i, j, k) = u3d(i,j,k);
-                }
-                else{ // use log profile from first 3d layer down to ground
-                    kk = k;
-                    do{
-                        kk++;
-                        profile.inputWindHeight = mesh.ZORD(i,j,kk) - mesh.ZORD(i,j,0) - input.surface.Rough_h(i,j); // height above vegetation
-                        profile.inputWindSpeed = u3d(i,j,kk);
-                    }while (u3d(i,j,kk) == -9999);
-                    u0(i, j, k) += profile.getWindSpeed();
-                }
-                if(v3d(i,j,k) != -9999){  // if have 3d winds for current cell
-                    v0(i, j, k) = v3d(i,j,k);
-                }
-                else{
-                    kk = k;
-                    do{
-                        kk++;
-                        profile.inputWindHeight = mesh.ZORD(i,j,kk) - mesh.ZORD(i,j,0) - input.surface.Rough_h(i,j); // height above vegetation
-                        profile.inputWindSpeed = v3d(i,j,kk);
-                    }while (v3d(i,j,kk) == -9999);
-
-                    v0(i, j, k) += profile.getWindSpeed();
-                }
-                if(w3d(i,j,k) != -9999){  // if have 3d winds for current cell
-                    w0(i, j, k) = w3d(i,j,k);
-                }
-                else{
-                    kk = k;
-                    do{
-                        kk++;
-                        profile.inputWindHeight = mesh.ZORD(i,j,kk) - mesh.ZORD(i,j,0) - input.surface.Rough_h(i,j); // height above vegetation
-                        profile.inputWindSpeed = w3d(i,j,kk);
-                    }while (w3d(i,j,kk) == -9999);
-
-                    w0(i, j, k) += profile.getWindSpeed();
-                }
-                if(air3d(i,j,k) == -9999){ //if don't have 3d T for current cell
-                    kk = k;
-                    do{ // find lowest 3d layer; these are perturbation potetential temperatures, not temperature!
-                        kk++;
-                    }while (air3d(i,j,kk) == -9999);
-                    tempGradient = ( air3d(i,j,kk) - air3d(i,j,kk+1) ) /
-                                   ( mesh.ZORD(i,j,kk+1) - mesh.ZORD(i,j,kk) ); // find gradient between lowest two 3D layers
-
-                    for(int m = k; m<kk; m++){
-                        air3d(i,j,m) = air3d(i,j,kk) + (tempGradient *
-                                       ( mesh.ZORD(i,j,kk) - mesh.ZORD(i,j,m) )); //apply this gradient to current layer
+    bool badProfile = false;
+
+    //Below the lowest 3d layer the winds follow the profile from that layer
+    //down to the ground.  The shape of the profile only depends on the node
+    //and the layer it's taken from, so u, v and w share it when their lowest
+    //3d layer is the same.
+#pragma omp parallel default(shared) num_threads(input.numberCPUs)
+    {
+        windProfile columnProfile(profile);
+        double numerator = 0.0, denominator = 1.0, scale = 1.0;
+        bool upper;
+        int shapeLayer;
+        int kk;
+        int i, j, k;
+        double tempGradient;
+
+#pragma omp for
+        for(i = 0; i < input.dem.get_nRows(); i++){
+            try
+            {
+                for(j = 0; j < input.dem.get_nCols(); j++){
+
+                    columnProfile.ObukovLength = L(i,j);
+                    columnProfile.ABL_height = bl_height(i,j);
+                    columnProfile.Roughness = input.surface.Roughness(i,j);
+                    columnProfile.Rough_h = input.surface.Rough_h(i,j);
+                    columnProfile.Rough_d = input.surface.Rough_d(i,j);
+
+                    for(k = 0; k < mesh.nlayers; k++){
+                        columnProfile.AGL=mesh.ZORD(i, j, k)-input.dem(i,j);  // height above the ground
+                        shapeLayer = -1;    //layer the shape was computed from at this node
+
+                        if(u3d(i,j,k) != -9999) {  // if have 3d winds for current cell
+                            u0(i, j, k) = u3d(i,j,k);
+                        }
+                        else{ // use log profile from first 3d layer down to ground
+                            kk = k;
+                            do{
+                                kk++;
+                            }while (u3d(i,j,kk) == -9999);
+                            if(kk != shapeLayer){
+                                columnProfile.inputWindHeight = mesh.ZORD(i,j,kk) - mesh.ZORD(i,j,0) - input.surface.Rough_h(i,j); // height above vegetation
+                                columnProfile.getProfileShape(numerator, denominator, scale, upper);
+                                shapeLayer = kk;
+                            }
+                            u0(i, j, k) += windProfile::scaleWindSpeed(u3d(i,j,kk), numerator, denominator, scale);
+                        }
+                        if(v3d(i,j,k) != -9999){  // if have 3d winds for current cell
+                            v0(i, j, k) = v3d(i,j,k);
+                        }
+                        else{
+                            kk = k;
+                            do{
+                                kk++;
+                            }while (v3d(i,j,kk) == -9999);
+                            if(kk != shapeLayer){
+                                columnProfile.inputWindHeight = mesh.ZORD(i,j,kk) - mesh.ZORD(i,j,0) - input.surface.Rough_h(i,j); // height above vegetation
+                                columnProfile.getProfileShape(numerator, denominator, scale, upper);
+                                shapeLayer = kk;
+                            }
+                            v0(i, j, k) += windProfile::scaleWindSpeed(v3d(i,j,kk), numerator, denominator, scale);
+                        }
+                        if(w3d(i,j,k) != -9999){  // if have 3d winds for current cell
+                            w0(i, j, k) = w3d(i,j,k);
+                        }
+                        else{
+                            kk = k;
+                            do{
+                                kk++;
+                            }while (w3d(i,j,kk) == -9999);
+                            if(kk != shapeLayer){
+                                columnProfile.inputWindHeight = mesh.ZORD(i,j,kk) - mesh.ZORD(i,j,0) - input.surface.Rough_h(i,j); // height above vegetation
+                                columnProfile.getProfileShape(numerator, denominator, scale, upper);
+                                shapeLayer = kk;
+                            }
+                            w0(i, j, k) += windProfile::scaleWindSpeed(w3d(i,j,kk), numerator, denominator, scale);
+                        }
+                        if(air3d(i,j,k) == -9999){ //if don't have 3d T for current cell
+                            kk = k;
+                            do{ // find lowest 3d layer; these are perturbation potetential temperatures, not temperature!
+                                kk++;
+                            }while (air3d(i,j,kk) == -9999);
+                            tempGradient = ( air3d(i,j,kk) - air3d(i,j,kk+1) ) /
+                                           ( mesh.ZORD(i,j,kk+1) - mesh.ZORD(i,j,kk) ); // find gradient between lowest two 3D layers
+
+                            for(int m = k; m<kk; m++){
+                                air3d(i,j,m) = air3d(i,j,kk) + (tempGradient *
+                                               ( mesh.ZORD(i,j,kk) - mesh.ZORD(i,j,m) )); //apply this gradient to current layer
+                            }
+                        }
                     }
                 }
+            }catch(std::runtime_error &e)
+            {
+                badProfile = true;
             }
         }
     }
+    if(badProfile)
+        throw std::runtime_error("Could not identify profile switch.\n");
     u3d.deallocate();
     v3d.deallocate();
     w3d.deallocate();
@@ -1514,7 +1559,7 @@ void wxModelInitialization::writeWxModelGrids(WindNinjaInputs &input)
     }
     velocityUnits::fromBaseUnits(speedInitializationGrid_wxModel, input.outputSpeedUnits);
 
-#pragma omp parallel sections
+#pragma omp parallel sections num_threads(input.numberCPUs)
     {
     //write FARSITE files
 #pragma omp section
@@ -1660,6 +1705,35 @@ double wxModelInitialization::GetWindHeight(std::string varName)
     return d;
 }
 
+/**
+ * Warp a forecast variable to the DEM projection.
+ *
+ * When the run is part of an army with a forecast cache, the variable is only
+ * warped by the first run that asks for it (see ForecastCache), otherwise
+ * this is GDALAutoCreateWarpedVRT().
+ *
+ * @param input inputs of the run
+ * @param srcName name srcDS was opened with
+ * @param srcDS opened forecast variable
+ * @param srcWkt projection of the forecast
+ * @param dstWkt projection of the DEM
+ * @param psWarpOptions warp options, still owned by the caller
+ * @return warped dataset to close with GDALClose(), NULL on failure
+ */
+GDALDataset *wxModelInitialization::warpForecast( WindNinjaInputs &input,
+                                                  std::string const& srcName, GDALDataset *srcDS,
+                                                  std::string const& srcWkt, std::string const& dstWkt,
+                                                  GDALWarpOptions *psWarpOptions )
+{
+    if( input.forecastCache != NULL )
+        return input.forecastCache->warp( srcName, srcDS, srcWkt, dstWkt, psWarpOptions );
+
+    return (GDALDataset*) GDALAutoCreateWarpedVRT( srcDS, srcWkt.c_str(),
+                                                   dstWkt.c_str(),
+                                                   GRA_NearestNeighbour,
+                                                   1.0, psWarpOptions );
+}
+
 /**
  * Get the name of the time dimension for a given variable
  *
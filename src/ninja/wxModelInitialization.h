@@ -170,6 +170,11 @@ class wxModelInitialization : public initialize
     #endif
 
     std::string GetTimeName(const char *pszVariable);
+
+    GDALDataset *warpForecast( WindNinjaInputs &input,
+                               std::string const& srcName, GDALDataset *srcDS,
+                               std::string const& srcWkt, std::string const& dstWkt,
+                               GDALWarpOptions *psWarpOptions );
     
     int wxModel_nLayers;
     int wxModel_nCols; //wx model ncols/nrows in reprojected coords (DEM space) after ndvs are stripped
@@ -0,0 +1,649 @@
+/******************************************************************************
+ *
+ * $Id$
+ *
+ * Project:  WindNinja
+ * Purpose:  Benchmark for the sparse solver kernels on a synthetic mesh system
+ * Author:   
+ *
+ ******************************************************************************
+ *
+ * THIS SOFTWARE WAS DEVELOPED AT THE ROCKY MOUNTAIN RESEARCH STATION (RMRS)
+ * MISSOULA FIRE SCIENCES LABORATORY BY EMPLOYEES OF THE FEDERAL GOVERNMENT 
+ * IN THE COURSE OF THEIR OFFICIAL DUTIES. PURSUANT TO TITLE 17 SECTION 105 
+ * OF THE UNITED STATES CODE, THIS SOFTWARE IS NOT SUBJECT TO COPYRIGHT 
+ * PROTECTION AND IS IN THE PUBLIC DOMAIN. RMRS MISSOULA FIRE SCIENCES 
+ * LABORATORY ASSUMES NO RESPONSIBILITY WHATSOEVER FOR ITS USE BY OTHER 
+ * PARTIES,  AND MAKES NO GUARANTEES, EXPRESSED OR IMPLIED, ABOUT ITS QUALITY, 
+ * RELIABILITY, OR ANY OTHER CHARACTERISTIC.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "sparseMatVec.h"
+#include "preconditioner.h"
+#include "batchSolver.h"
+
+/*
+** Build a system with the same layout ninja::discretize() and
+** ninja::setBoundaryConditions() produce: nodes ordered k, i, j, a 27 point
+** stencil, only the upper triangle stored in CSR with the diagonal first, and
+** Dirichlet rows on the sides and top of the domain.  The values come from
+** trilinear brick elements with thin vertical layers, so the conditioning is
+** close to that of a real run on flat terrain.
+*/
+struct BenchSystem
+{
+    int nrows, ncols, nlayers, NUMNP;
+    std::vector<double> SK;
+    std::vector<int> row_ptr;
+    std::vector<int> col_ind;
+    std::vector<double> RHS;
+};
+
+static void BuildElementMatrix(double hx, double hy, double hz, double *S)
+{
+    const double g = 1.0 / sqrt(3.0);
+    double dN[8][3];
+    int a, b, c, q, m, n;
+
+    for(m=0; m<64; m++)
+        S[m] = 0.0;
+
+    for(q=0; q<8; q++)
+    {
+        double xi = (q & 1) ? g : -g;
+        double eta = (q & 2) ? g : -g;
+        double zeta = (q & 4) ? g : -g;
+        for(c=0; c<2; c++)
+        {
+            for(b=0; b<2; b++)
+            {
+                for(a=0; a<2; a++)
+                {
+                    double sa = a ? 1.0 : -1.0;
+                    double sb = b ? 1.0 : -1.0;
+                    double sc = c ? 1.0 : -1.0;
+                    n = c*4 + b*2 + a;
+                    dN[n][0] = 0.125*sa*(1+sb*eta)*(1+sc*zeta) * 2.0/hx;
+                    dN[n][1] = 0.125*sb*(1+sa*xi)*(1+sc*zeta) * 2.0/hy;
+                    dN[n][2] = 0.125*sc*(1+sa*xi)*(1+sb*eta) * 2.0/hz;
+                }
+            }
+        }
+        double detJ = hx*hy*hz/8.0;
+        for(m=0; m<8; m++)
+            for(n=0; n<8; n++)
+                S[m*8+n] += (dN[m][0]*dN[n][0] + dN[m][1]*dN[n][1] + dN[m][2]*dN[n][2]) * detJ;
+    }
+}
+
+/*
+** Sum the element matrices into sys.SK the way ninja::discretize() does by
+** default.  The elements are split into 8 colors by the parity of their
+** (i, j, k) index.  Elements of one color share no nodes, so each color is
+** done in parallel without atomics, and the colors are done in order.  Every
+** entry is summed in the same order for any number of threads.
+*/
+static void AssembleElements(BenchSystem &sys, int nThreads)
+{
+    const int nxy = sys.nrows*sys.ncols;
+    const double hx = 100.0, hy = 100.0;
+    int e;
+
+    std::fill(sys.SK.begin(), sys.SK.end(), 0.0);
+    for(int color=0; color<8; color++)
+    {
+        const int ci = color & 1;
+        const int cj = (color >> 1) & 1;
+        const int ck = (color >> 2) & 1;
+        const int ni = (sys.nrows - 1 - ci + 1)/2;  //number of elements of this color in each direction
+        const int nj = (sys.ncols - 1 - cj + 1)/2;
+        const int nk = (sys.nlayers - 1 - ck + 1)/2;
+
+#pragma omp parallel for num_threads(nThreads) schedule(static)
+        for(e=0; e<ni*nj*nk; e++)
+        {
+            const int k = ck + 2*(e/(ni*nj));
+            const int i = ci + 2*((e/nj)%ni);
+            const int j = cj + 2*(e%nj);
+            double S[64];
+            int nodes[8];
+
+            //alphaH = 1 and thin layers near the ground, like a real mesh
+            BuildElementMatrix(hx, hy, 2.0 * pow(1.2, k), S);
+            for(int n=0; n<8; n++)
+                nodes[n] = (k+(n>>2))*nxy + (i+((n>>1)&1))*sys.ncols + (j+(n&1));
+            for(int a=0; a<8; a++)
+            {
+                for(int b=0; b<8; b++)
+                {
+                    if(nodes[b] < nodes[a])
+                        continue;
+                    const int *first = &sys.col_ind[sys.row_ptr[nodes[a]]];
+                    const int *last = &sys.col_ind[0] + sys.row_ptr[nodes[a]+1];
+                    const int pos = (int)(std::lower_bound(first, last, nodes[b]) - &sys.col_ind[0]);
+                    sys.SK[pos] += S[a*8+b];
+                }
+            }
+        }
+    }
+}
+
+static void BuildSystem(int nrows, int ncols, int nlayers, BenchSystem &sys)
+{
+    int i, j, k, ii, jj, kk;
+    const int nxy = nrows*ncols;
+
+    sys.nrows = nrows;
+    sys.ncols = ncols;
+    sys.nlayers = nlayers;
+    sys.NUMNP = nrows*ncols*nlayers;
+    sys.row_ptr.assign(sys.NUMNP+1, 0);
+    sys.col_ind.clear();
+
+    for(k=0; k<nlayers; k++)
+    {
+        for(i=0; i<nrows; i++)
+        {
+            for(j=0; j<ncols; j++)
+            {
+                int row = k*nxy + i*ncols + j;
+                sys.row_ptr[row] = (int)sys.col_ind.size();
+                for(kk=-1; kk<2; kk++)
+                    for(ii=-1; ii<2; ii++)
+                        for(jj=-1; jj<2; jj++)
+                        {
+                            if(i+ii < 0 || i+ii > nrows-1 || j+jj < 0 || j+jj > ncols-1 ||
+                               k+kk < 0 || k+kk > nlayers-1)
+                                continue;
+                            int col = (k+kk)*nxy + (i+ii)*ncols + (j+jj);
+                            if(col >= row)
+                                sys.col_ind.push_back(col);
+                        }
+            }
+        }
+    }
+    sys.row_ptr[sys.NUMNP] = (int)sys.col_ind.size();
+    sys.SK.assign(sys.col_ind.size(), 0.0);
+    sys.RHS.assign(sys.NUMNP, 0.0);
+
+    AssembleElements(sys, 1);
+
+    //smooth right hand side, Dirichlet (phi = 0) on the sides and top
+    std::vector<char> isBoundary(sys.NUMNP, 0);
+    for(k=0; k<nlayers; k++)
+        for(i=0; i<nrows; i++)
+            for(j=0; j<ncols; j++)
+            {
+                int n = k*nxy + i*ncols + j;
+                isBoundary[n] = (j==0 || j==ncols-1 || i==0 || i==nrows-1 || k==nlayers-1);
+                sys.RHS[n] = sin(0.1*i) * cos(0.07*j) * exp(-0.1*k);
+            }
+    for(int row=0; row<sys.NUMNP; row++)
+    {
+        for(int l=sys.row_ptr[row]; l<sys.row_ptr[row+1]; l++)
+        {
+            int col = sys.col_ind[l];
+            if(isBoundary[col])
+                sys.SK[l] = 0.0;
+            if(isBoundary[row])
+                sys.SK[l] = (col == row) ? 1.0 : 0.0;
+        }
+        if(isBoundary[row])
+            sys.RHS[row] = 0.0;
+    }
+}
+
+static double Now()
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/*
+** Preconditioned conjugate gradient, the same iteration as ninja::solve().
+** Returns the number of iterations needed to reduce the relative residual
+** below dfTol, or -1 if nMaxIter was reached.
+**
+** If poCheck is given, Ax is a single precision product and the residual is
+** checked with poCheck when it reaches dfTol, starting the iterations over
+** from x if it is still too large (the mixed precision solve).  The number of
+** restarts is returned in pnRefinements.
+*/
+static int SolvePCG(BenchSystem &sys, SparseMatVec &Ax, Preconditioner &M,
+                    double *x, double dfTol, int nMaxIter,
+                    SparseMatVec *poCheck = NULL, int *pnRefinements = NULL)
+{
+    const int n = sys.NUMNP;
+    std::vector<double> r(n), z(n), p(n), q(n);
+    double rho, rho_1 = 1.0, alpha, beta, normb = 0.0, resid;
+    int i, j, nStart = 1;
+
+    if(pnRefinements)
+        *pnRefinements = 0;
+
+    for(j=0; j<n; j++)
+    {
+        x[j] = 0.0;
+        r[j] = sys.RHS[j];
+        normb += sys.RHS[j]*sys.RHS[j];
+    }
+    normb = sqrt(normb);
+    if(normb == 0.0)
+        normb = 1.0;
+
+    for(i=1; i<=nMaxIter; i++)
+    {
+        M.solve(&r[0], &z[0], &sys.row_ptr[0], &sys.col_ind[0]);
+        rho = 0.0;
+        for(j=0; j<n; j++)
+            rho += z[j]*r[j];
+        beta = (i == nStart) ? 0.0 : rho / rho_1;
+        for(j=0; j<n; j++)
+            p[j] = z[j] + beta*p[j];
+        Ax.multiply(&p[0], &q[0]);
+        double pq = 0.0;
+        for(j=0; j<n; j++)
+            pq += p[j]*q[j];
+        alpha = rho / pq;
+        resid = 0.0;
+        for(j=0; j<n; j++)
+        {
+            x[j] += alpha*p[j];
+            r[j] -= alpha*q[j];
+            resid += r[j]*r[j];
+        }
+        if(sqrt(resid) / normb <= dfTol && poCheck)
+        {
+            poCheck->multiply(x, &q[0]);
+            resid = 0.0;
+            for(j=0; j<n; j++)
+            {
+                r[j] = sys.RHS[j] - q[j];
+                resid += r[j]*r[j];
+            }
+            if(sqrt(resid) / normb > dfTol)
+            {
+                if(pnRefinements)
+                    (*pnRefinements)++;
+                nStart = i+1;
+                continue;
+            }
+        }
+        if(sqrt(resid) / normb <= dfTol)
+            return i;
+        rho_1 = rho;
+    }
+    return -1;
+}
+
+static void Usage(const char *pszError)
+{
+    printf("solver_bench [--rows n] [--cols n] [--layers n] [--max-threads n]\n"
+           "             [--reps n] [--batch n] [--runs n]\n"
+           "\n"
+           "Builds a synthetic rows x cols x layers mesh system and times the\n"
+           "colored assembly of its element matrices and the symmetric sparse\n"
+           "matrix-vector product for 1..max-threads threads, then the\n"
+           "conjugate gradient solve with each preconditioner, then\n"
+           "the mixed precision solve against the double precision one, then\n"
+           "batch right hand sides solved one at a time and together, then\n"
+           "runs independent solves with the threads split into concurrent\n"
+           "runs times solver threads per run, like a ninjaArmy.\n"
+           "\n"
+           "Defaults:\n"
+           "    --rows 200 --cols 200 --layers 20 --reps 50 --batch 8 --runs 6\n");
+    if(pszError)
+    {
+        fprintf(stderr, "%s\n", pszError);
+    }
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int nRows = 200;
+    int nCols = 200;
+    int nLayers = 20;
+    int nReps = 50;
+    int nBatch = 8;
+    int nRuns = 6;
+    int nMaxThreads = 1;
+#ifdef _OPENMP
+    nMaxThreads = omp_get_max_threads();
+#endif
+
+    int i = 1;
+    while(i < argc)
+    {
+        if(strcmp(argv[i], "--rows") == 0 && i+1 < argc)
+            nRows = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--cols") == 0 && i+1 < argc)
+            nCols = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--layers") == 0 && i+1 < argc)
+            nLayers = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--max-threads") == 0 && i+1 < argc)
+            nMaxThreads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--reps") == 0 && i+1 < argc)
+            nReps = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--batch") == 0 && i+1 < argc)
+            nBatch = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--runs") == 0 && i+1 < argc)
+            nRuns = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--help") == 0)
+            Usage(NULL);
+        else
+            Usage("Invalid argument");
+        i++;
+    }
+    if(nRows < 3 || nCols < 3 || nLayers < 3 || nReps < 1 || nMaxThreads < 1 || nBatch < 1 ||
+       nRuns < 1)
+        Usage("Invalid mesh size, thread count or repetitions");
+
+    BenchSystem sys;
+    BuildSystem(nRows, nCols, nLayers, sys);
+    printf("Mesh %d x %d x %d: %d nodes, %d stored nonzeros\n",
+           nRows, nCols, nLayers, sys.NUMNP, (int)sys.SK.size());
+
+    printf("\nAssembly time (ms), speedup vs. 1 thread, same bits as 1 thread\n");
+    printf("%8s %12s %10s %10s\n", "threads", "ms", "speedup", "identical");
+    {
+        BenchSystem assembled = sys;
+        std::vector<double> SKRef;
+        double dfBase = 0.0;
+        for(int nThreads=1; nThreads<=nMaxThreads; nThreads = (nThreads < nMaxThreads && nThreads*2 > nMaxThreads) ? nMaxThreads : nThreads*2)
+        {
+            double dfStart = Now();
+            AssembleElements(assembled, nThreads);
+            double dfTime = (Now() - dfStart) * 1000.0;
+            if(nThreads == 1)
+            {
+                dfBase = dfTime;
+                SKRef = assembled.SK;
+            }
+            const bool bIdentical = memcmp(&assembled.SK[0], &SKRef[0], SKRef.size()*sizeof(double)) == 0;
+            printf("%8d %12.3f %10.2f %10s\n", nThreads, dfTime, dfBase / dfTime, bIdentical ? "yes" : "NO");
+            if(nThreads == nMaxThreads)
+                break;
+        }
+    }
+
+    std::vector<double> x(sys.NUMNP), y(sys.NUMNP), yRef(sys.NUMNP);
+    for(i=0; i<sys.NUMNP; i++)
+        x[i] = 1.0 + 0.001*(i % 997);
+
+    const char *apszModes[] = {"serial", "symmetric", "expanded", "stencil"};
+    const int nModes = 4;
+
+    {
+        SparseMatVec ref;
+        ref.initialize(sys.NUMNP, &sys.SK[0], &sys.row_ptr[0], &sys.col_ind[0], SparseMatVec::serial);
+        ref.multiply(&x[0], &yRef[0]);
+    }
+
+    printf("\nSpMV time per product (ms), speedup vs. 1 thread of the same mode\n");
+    printf("%-10s %8s %12s %10s %12s\n", "mode", "threads", "ms", "speedup", "max |diff|");
+    for(int m=0; m<nModes; m++)
+    {
+        SparseMatVec Ax;
+        if(!Ax.initialize(sys.NUMNP, &sys.SK[0], &sys.row_ptr[0], &sys.col_ind[0],
+                          SparseMatVec::get_eSpMVMode(apszModes[m]),
+                          sys.nrows, sys.ncols, sys.nlayers))
+        {
+            printf("%-10s initialization failed\n", apszModes[m]);
+            continue;
+        }
+        printf("%-10s matrix storage %.1f MB\n", apszModes[m], Ax.get_matrixBytes() / 1048576.0);
+        double dfBase = 0.0;
+        for(int nThreads=1; nThreads<=nMaxThreads; nThreads = (nThreads < nMaxThreads && nThreads*2 > nMaxThreads) ? nMaxThreads : nThreads*2)
+        {
+            Ax.set_numThreads(nThreads);
+            Ax.multiply(&x[0], &y[0]);  //warm up
+            double dfStart = Now();
+            for(int r=0; r<nReps; r++)
+                Ax.multiply(&x[0], &y[0]);
+            double dfTime = (Now() - dfStart) / nReps * 1000.0;
+            if(nThreads == 1)
+                dfBase = dfTime;
+
+            double dfDiff = 0.0;
+            for(i=0; i<sys.NUMNP; i++)
+                dfDiff = std::max(dfDiff, fabs(y[i] - yRef[i]));
+
+            printf("%-10s %8d %12.3f %10.2f %12.3e\n", apszModes[m], nThreads,
+                   dfTime, dfBase / dfTime, dfDiff);
+            if(nThreads == nMaxThreads)
+                break;
+        }
+    }
+
+    //preconditioned CG to a relative residual of 1e-8, at max-threads
+    char matdescra[6] = {'s', 'u', 'n', 'c', 0, 0};
+    const char *apszPrecond[] = {"jacobi", "ssor", "mcssor", "multigrid"};
+    const int nPrecond = 4;
+    SparseMatVec Ax;
+    Ax.set_numThreads(nMaxThreads);
+    Ax.initialize(sys.NUMNP, &sys.SK[0], &sys.row_ptr[0], &sys.col_ind[0], SparseMatVec::symmetric);
+    std::vector<double> solution(sys.NUMNP), solutionRef;
+
+    printf("\nPCG solve with %d threads (relative residual 1e-8)\n", nMaxThreads);
+    printf("%-10s %10s %12s %12s %12s\n", "precond", "iters", "setup ms", "solve ms", "max |diff|");
+    for(int m=0; m<nPrecond; m++)
+    {
+        Preconditioner M;
+        M.set_numThreads(nMaxThreads);
+        double dfStart = Now();
+        if(!M.initialize(sys.NUMNP, &sys.SK[0], &sys.row_ptr[0], &sys.col_ind[0],
+                         Preconditioner::get_precondType(apszPrecond[m]), matdescra,
+                         sys.nrows, sys.ncols, sys.nlayers))
+        {
+            printf("%-10s initialization failed\n", apszPrecond[m]);
+            continue;
+        }
+        double dfSetup = (Now() - dfStart) * 1000.0;
+        dfStart = Now();
+        int nIters = SolvePCG(sys, Ax, M, &solution[0], 1e-8, 100000);
+        double dfSolve = (Now() - dfStart) * 1000.0;
+
+        if(solutionRef.empty())
+            solutionRef = solution;
+        double dfDiff = 0.0;
+        for(i=0; i<sys.NUMNP; i++)
+            dfDiff = std::max(dfDiff, fabs(solution[i] - solutionRef[i]));
+
+        printf("%-10s %10d %12.1f %12.1f %12.3e\n", apszPrecond[m], nIters,
+               dfSetup, dfSolve, dfDiff);
+    }
+
+    //mixed precision: float stencil coefficients with double sums, refined against
+    //the double matrix, vs. the double stencil product.  1e-1 is the tolerance
+    //ninja::solve() is called with.
+    {
+        SparseMatVec AxDouble, AxSingle, AxCheck;
+        AxDouble.set_numThreads(nMaxThreads);
+        AxSingle.set_numThreads(nMaxThreads);
+        AxCheck.set_numThreads(nMaxThreads);
+        AxDouble.initialize(sys.NUMNP, &sys.SK[0], &sys.row_ptr[0], &sys.col_ind[0],
+                            SparseMatVec::stencil, sys.nrows, sys.ncols, sys.nlayers);
+        AxSingle.initialize(sys.NUMNP, &sys.SK[0], &sys.row_ptr[0], &sys.col_ind[0],
+                            SparseMatVec::stencil, sys.nrows, sys.ncols, sys.nlayers);
+        AxSingle.convertToSinglePrecision();
+        AxCheck.initialize(sys.NUMNP, &sys.SK[0], &sys.row_ptr[0], &sys.col_ind[0],
+                           SparseMatVec::symmetric);
+
+        AxDouble.multiply(&x[0], &yRef[0]);
+        AxSingle.multiply(&x[0], &y[0]);
+        double dfStart = Now();
+        for(int r=0; r<nReps; r++)
+            AxDouble.multiply(&x[0], &yRef[0]);
+        double dfDouble = (Now() - dfStart) / nReps * 1000.0;
+        dfStart = Now();
+        for(int r=0; r<nReps; r++)
+            AxSingle.multiply(&x[0], &y[0]);
+        double dfSingle = (Now() - dfStart) / nReps * 1000.0;
+        double dfDiff = 0.0, dfMax = 0.0;
+        for(i=0; i<sys.NUMNP; i++)
+        {
+            dfDiff = std::max(dfDiff, fabs(y[i] - yRef[i]));
+            dfMax = std::max(dfMax, fabs(yRef[i]));
+        }
+
+        printf("\nMixed precision with %d threads (stencil product, mcssor)\n", nMaxThreads);
+        printf("SpMV: double %.1f MB %.3f ms, float %.1f MB %.3f ms, speedup %.2f, max rel diff %.3e\n",
+               AxDouble.get_matrixBytes() / 1048576.0, dfDouble,
+               AxSingle.get_matrixBytes() / 1048576.0, dfSingle, dfDouble / dfSingle,
+               dfDiff / dfMax);
+
+        Preconditioner M;
+        M.set_numThreads(nMaxThreads);
+        M.initialize(sys.NUMNP, &sys.SK[0], &sys.row_ptr[0], &sys.col_ind[0],
+                     Preconditioner::get_precondType("mcssor"), matdescra,
+                     sys.nrows, sys.ncols, sys.nlayers);
+        std::vector<double> solutionDouble(sys.NUMNP);
+        const double adfTol[] = {1e-1, 1e-8};
+        printf("%-8s %12s %10s %12s %12s %10s %12s\n", "tol", "double its", "double ms",
+               "mixed its", "refinements", "mixed ms", "max rel diff");
+        for(int t=0; t<2; t++)
+        {
+            dfStart = Now();
+            int nItersDouble = SolvePCG(sys, AxDouble, M, &solutionDouble[0], adfTol[t], 100000);
+            dfDouble = (Now() - dfStart) * 1000.0;
+            int nRefinements;
+            dfStart = Now();
+            int nItersMixed = SolvePCG(sys, AxSingle, M, &solution[0], adfTol[t], 100000,
+                                       &AxCheck, &nRefinements);
+            dfSingle = (Now() - dfStart) * 1000.0;
+
+            dfDiff = 0.0;
+            dfMax = 0.0;
+            for(i=0; i<sys.NUMNP; i++)
+            {
+                dfDiff = std::max(dfDiff, fabs(solution[i] - solutionDouble[i]));
+                dfMax = std::max(dfMax, fabs(solutionDouble[i]));
+            }
+            printf("%-8.0e %12d %10.1f %12d %12d %10.1f %12.3e\n", adfTol[t], nItersDouble, dfDouble,
+                   nItersMixed, nRefinements, dfSingle, dfMax > 0.0 ? dfDiff / dfMax : 0.0);
+        }
+    }
+
+    //several right hand sides on the same matrix (like a domain average sweep),
+    //one solve each vs. one batched solve, stencil product
+    std::vector<std::vector<double> > rhs(nBatch, std::vector<double>(sys.NUMNP));
+    std::vector<std::vector<double> > xs(nBatch, std::vector<double>(sys.NUMNP));
+    std::vector<double*> b(nBatch), xb(nBatch);
+    const int nxy = sys.nrows*sys.ncols;
+    for(int v=0; v<nBatch; v++)
+    {
+        for(i=0; i<sys.NUMNP; i++)
+        {
+            int k = i / nxy, r = (i % nxy) / sys.ncols, c = i % sys.ncols;
+            rhs[v][i] = sys.RHS[i] == 0.0 ? 0.0 :
+                        sin(0.1*r + 0.6*v) * cos(0.07*c - 0.3*v) * exp(-0.1*k);
+        }
+        b[v] = &rhs[v][0];
+        xb[v] = &xs[v][0];
+    }
+    const char *apszBatchPrecond[] = {"jacobi", "mcssor"};
+    printf("\n%d right hand sides with %d threads (relative residual 1e-8, stencil product)\n",
+           nBatch, nMaxThreads);
+    printf("%-10s %10s %14s %14s %10s\n", "precond", "max iters", "one at a time", "batched ms", "speedup");
+    for(int m=0; m<2; m++)
+    {
+        BatchSolver batch;
+        batch.set_numThreads(nMaxThreads);
+        if(!batch.initialize(sys.NUMNP, &sys.SK[0], &sys.row_ptr[0], &sys.col_ind[0],
+                             Preconditioner::get_precondType(apszBatchPrecond[m]),
+                             SparseMatVec::stencil, sys.nrows, sys.ncols, sys.nlayers))
+        {
+            printf("%-10s initialization failed\n", apszBatchPrecond[m]);
+            continue;
+        }
+
+        double dfStart = Now();
+        for(int v=0; v<nBatch; v++)
+        {
+            std::fill(xs[v].begin(), xs[v].end(), 0.0);
+            batch.solve(std::vector<double*>(1, b[v]), std::vector<double*>(1, xb[v]), 100000, 1e-8);
+        }
+        double dfSingle = (Now() - dfStart) * 1000.0;
+
+        for(int v=0; v<nBatch; v++)
+            std::fill(xs[v].begin(), xs[v].end(), 0.0);
+        dfStart = Now();
+        batch.solve(b, xb, 100000, 1e-8);
+        double dfBatch = (Now() - dfStart) * 1000.0;
+
+        printf("%-10s %10d %14.1f %14.1f %10.2f\n", apszBatchPrecond[m],
+               *std::max_element(batch.get_iterations().begin(), batch.get_iterations().end()),
+               dfSingle, dfBatch, dfSingle / dfBatch);
+    }
+
+    //independent runs, like the runs of a ninjaArmy: the threads are split into
+    //nOuter concurrent runs of nInner solver threads each (see
+    //ninjaArmy::splitThreads()).  Each run has its own product and
+    //preconditioner, symmetric product and mcssor, to the tolerance
+    //ninja::solve() is called with.
+    printf("\n%d runs with %d threads (relative residual 1e-1, symmetric product, mcssor)\n",
+           nRuns, nMaxThreads);
+    printf("%8s %8s %12s %10s %10s\n", "runs at", "threads", "total ms", "runs/s", "speedup");
+    std::vector<std::vector<double> > runSolutions(nRuns, std::vector<double>(sys.NUMNP));
+    double dfBaseRate = 0.0;
+#ifdef _OPENMP
+    omp_set_nested(1);
+#endif
+    for(int nInner=1; nInner<=nMaxThreads; nInner = (nInner < nMaxThreads && nInner*2 > nMaxThreads) ? nMaxThreads : nInner*2)
+    {
+        const int nOuter = std::max(1, std::min(nMaxThreads / nInner, nRuns));
+        double dfStart = Now();
+        #pragma omp parallel for num_threads(nOuter) schedule(dynamic, 1)
+        for(int r=0; r<nRuns; r++)
+        {
+            SparseMatVec runAx;
+            runAx.set_numThreads(nInner);
+            runAx.initialize(sys.NUMNP, &sys.SK[0], &sys.row_ptr[0], &sys.col_ind[0],
+                             SparseMatVec::symmetric);
+            Preconditioner runM;
+            runM.set_numThreads(nInner);
+            runM.initialize(sys.NUMNP, &sys.SK[0], &sys.row_ptr[0], &sys.col_ind[0],
+                            Preconditioner::get_precondType("mcssor"), matdescra,
+                            sys.nrows, sys.ncols, sys.nlayers);
+            SolvePCG(sys, runAx, runM, &runSolutions[r][0], 1e-1, 100000);
+        }
+        double dfTime = (Now() - dfStart) * 1000.0;
+        double dfRate = nRuns / (dfTime / 1000.0);
+        if(nInner == 1)
+            dfBaseRate = dfRate;
+        printf("%8d %8d %12.1f %10.2f %10.2f\n", nOuter, nInner, dfTime, dfRate, dfRate / dfBaseRate);
+        if(nInner == nMaxThreads)
+            break;
+    }
+#ifdef _OPENMP
+    omp_set_nested(0);
+#endif
+
+    return 0;
+}